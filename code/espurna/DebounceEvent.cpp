@@ -80,6 +80,11 @@ bool EventEmitter::isPressed() {
     return (_value != _default_value);
 }
 
+// Released, but the click is not reported until the repeat delay expires
+bool EventEmitter::isPending() const {
+    return _ready;
+}
+
 const BasePinPtr& EventEmitter::pin() const {
     return _pin;
 }
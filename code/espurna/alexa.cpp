@@ -271,7 +271,7 @@ void setup() {
 #endif
 
     espurnaRegisterReload(configure);
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("alexa"));
 }
 
 } // namespace
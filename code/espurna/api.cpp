@@ -200,75 +200,17 @@ error:
     return false;
 }
 
-espurna::StringView PathParts::wildcard(const PathParts& pattern, const PathParts& value, int index) {
+#if WEB_SUPPORT
+String ApiRequest::wildcard(int index) const {
     if (index < 0) {
         index = std::abs(index + 1);
     }
 
-    espurna::StringView out;
-
-    if (std::abs(index) < pattern.parts().size()) {
-        const auto& pattern_parts = pattern.parts();
-        int counter { 0 };
-
-        for (size_t part = 0; part < pattern.size(); ++part) {
-            const auto& lhs = pattern_parts[part];
-            const auto& rhs = value.parts()[part];
-
-            const auto path = value.path();
-
-            switch (lhs.type) {
-            case PathPart::Type::Value:
-            case PathPart::Type::Unknown:
-                break;
-
-            case PathPart::Type::SingleWildcard:
-                if (counter == index) {
-                    out = espurna::StringView(
-                        path.begin() + rhs.offset, path.begin() + rhs.offset + rhs.length);
-                    return out;
-                }
-                ++counter;
-                break;
-
-            case PathPart::Type::MultiWildcard:
-                if (counter == index) {
-                    out = espurna::StringView(
-                        path.begin() + rhs.offset, path.end());
-                }
-                return out;
-            }
-        }
-    }
-
-    return out;
-}
-
-size_t PathParts::wildcards(const PathParts& pattern) {
-    size_t out { 0 };
-
-    for (const auto& part : pattern) {
-        switch (part.type) {
-        case PathPart::Type::Unknown:
-        case PathPart::Type::Value:
-        case PathPart::Type::MultiWildcard:
-            break;
-        case PathPart::Type::SingleWildcard:
-            ++out;
-            break;
-        }
-    }
-
-    return out;
-}
-
-#if WEB_SUPPORT
-String ApiRequest::wildcard(int index) const {
-    return PathParts::wildcard(_pattern, _parts, index).toString();
+    return _captures[index].toString();
 }
 
 size_t ApiRequest::wildcards() const {
-    return PathParts::wildcards(_pattern);
+    return _captures.size();
 }
 #endif
 
@@ -349,8 +291,6 @@ bool is_json(AsyncWebServerRequest* request) {
 }
 
 // Because the webserver request is split between multiple separate function invocations, we need to preserve some state.
-// TODO: in case we are dealing with multicore, perhaps enforcing static-size data structs instead of the vector would we better,
-//       to avoid calling generic malloc when paths are parsed?
 //
 // Some quirks to deal with:
 // - handleBody is called before handleRequest, and there's no way to signal completion / success of both callbacks to the server
@@ -388,26 +328,20 @@ public:
     BaseWebHandler(BaseWebHandler&&) = delete;
     BaseWebHandler& operator=(BaseWebHandler&&) = delete;
 
-    // In case this needs to be copied or moved, ensure PathParts copy references the new object's string
+    // Routes reference the pattern string, handlers are never copied or moved
     template <typename T,
               typename = typename std::enable_if<
                   std::is_constructible<String, T>::value>::type>
     explicit BaseWebHandler(T&& pattern) :
-        _pattern(std::forward<T>(pattern)),
-        _parts(_pattern)
+        _pattern(std::forward<T>(pattern))
     {}
 
     const String& pattern() const {
         return _pattern;
     }
 
-    const PathParts& parts() const {
-        return _parts;
-    }
-
 private:
     String _pattern;
-    PathParts _parts;
 };
 
 // 'Modernized' API configuration:
@@ -423,6 +357,7 @@ private:
 class JsonWebHandler final : public BaseWebHandler {
 public:
     static constexpr size_t BufferSize { API_JSON_BUFFER_SIZE };
+    static constexpr bool Trivial { true };
 
     JsonWebHandler() = delete;
 
@@ -440,40 +375,36 @@ public:
     {}
 
     bool isRequestHandlerTrivial() override {
-        return true;
+        return Trivial;
     }
 
+    // path was already matched by the dispatcher
     bool canHandle(AsyncWebServerRequest* request) override {
-        if (!apiEnabled()) {
+        if (!apiAuthenticate(request)) {
             return false;
         }
 
-        auto helper = RequestHelper(*request, parts());
-        if (helper.match() && apiAuthenticate(request)) {
-            switch (request->method()) {
-            case HTTP_HEAD:
-                return true;
-            case HTTP_PUT:
-                if (!is_json(request)) {
-                    return false;
-                }
-                if (!_put) {
-                    return false;
-                }
-                // fallthrough!
-            case HTTP_GET:
-                if (!_get) {
-                    return false;
-                }
-                break;
-            default:
+        switch (request->method()) {
+        case HTTP_HEAD:
+            return true;
+        case HTTP_PUT:
+            if (!is_json(request)) {
                 return false;
             }
-            attach_helper(*request, std::move(helper));
-            return true;
+            if (!_put) {
+                return false;
+            }
+            // fallthrough!
+        case HTTP_GET:
+            if (!_get) {
+                return false;
+            }
+            break;
+        default:
+            return false;
         }
 
-        return false;
+        return true;
     }
 
     void _handleGet(AsyncWebServerRequest* request, Request& apireq) {
@@ -561,7 +492,6 @@ public:
     }
 
     using BaseWebHandler::pattern;
-    using BaseWebHandler::parts;
 
 private:
     JsonHandler _get;
@@ -576,6 +506,8 @@ private:
 
 class BasicWebHandler final : public BaseWebHandler {
 public:
+    static constexpr bool Trivial { false };
+
     template <typename Path, typename Get, typename Put>
     BasicWebHandler(Path&& path, Get&& get, Put&& put) :
         BaseWebHandler(std::forward<Path>(path)),
@@ -584,14 +516,11 @@ public:
     {}
 
     bool isRequestHandlerTrivial() override {
-        return false;
+        return Trivial;
     }
 
+    // path was already matched by the dispatcher
     bool canHandle(AsyncWebServerRequest* request) override {
-        if (!apiEnabled()) {
-            return false;
-        }
-
         switch (request->method()) {
         case HTTP_HEAD:
         case HTTP_GET:
@@ -605,13 +534,7 @@ public:
             return false;
         }
 
-        auto helper = RequestHelper(*request, parts());
-        if (helper.match()) {
-            attach_helper(*request, std::move(helper));
-            return true;
-        }
-
-        return false;
+        return true;
     }
 
     void handleRequest(AsyncWebServerRequest* request) override {
@@ -682,17 +605,67 @@ public:
     }
 
     using BaseWebHandler::pattern;
-    using BaseWebHandler::parts;
 
 private:
     BasicHandler _get;
     BasicHandler _put;
 };
 
+// Instead of asking every registered handler to parse and compare request path, server only
+// knows about the dispatcher. Path is looked up in the route tree, and only then the handler is asked
+// whether it accepts the request method and contents. Wildcard values are captured during the lookup.
+// Handler kinds are dispatched separately, since server checks `isRequestHandlerTrivial()`
+// without referencing the request.
+template <typename T>
+class Dispatcher final : public AsyncWebHandler {
+public:
+    bool add(T& handler) {
+        return _routes.add(handler.pattern(), &handler);
+    }
+
+    bool isRequestHandlerTrivial() override {
+        return T::Trivial;
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override {
+        if (!apiEnabled()) {
+            return false;
+        }
+
+        Captures captures;
+
+        const auto* handler = _routes.find(request->url(), captures);
+        if (handler && (*handler)->canHandle(request)) {
+            attach_helper(*request, RequestHelper(*request, **handler, captures));
+            return true;
+        }
+
+        return false;
+    }
+
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override {
+        helper(request).handler().handleBody(request, data, len, index, total);
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override {
+        helper(request).handler().handleRequest(request);
+    }
+
+private:
+    static RequestHelper& helper(AsyncWebServerRequest* request) {
+        return *reinterpret_cast<RequestHelper*>(request->_tempObject);
+    }
+
+    Routes<T*> _routes;
+};
+
 namespace internal {
 
 std::forward_list<BaseWebHandler*> list;
 
+Dispatcher<JsonWebHandler>* json { nullptr };
+Dispatcher<BasicWebHandler>* basic { nullptr };
+
 } // namespace internal
 
 namespace simple {
@@ -713,11 +686,30 @@ bool error(ApiRequest& request) {
 
 STRING_VIEW_INLINE(BasePath, API_BASE_PATH);
 
-void add(BaseWebHandler* ptr) {
-    webServer().addHandler(ptr);
+template <typename T>
+void add(Dispatcher<T>*& dispatcher, T* ptr) {
+    if (!dispatcher) {
+        dispatcher = new Dispatcher<T>();
+        webServer().addHandler(dispatcher);
+    }
+
+    if (!dispatcher->add(*ptr)) {
+        DEBUG_MSG_P(PSTR("[API] Cannot route %s\n"), ptr->pattern().c_str());
+        delete ptr;
+        return;
+    }
+
     internal::list.emplace_front(ptr);
 }
 
+void add(JsonWebHandler* ptr) {
+    add(internal::json, ptr);
+}
+
+void add(BasicWebHandler* ptr) {
+    add(internal::basic, ptr);
+}
+
 template <typename Handler, typename Get, typename Put>
 void add(String path, Get&& get, Put&& put) {
     add(new Handler(
@@ -16,6 +16,7 @@ Copyright (C) 2020 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 
 #include "api_async_server.h"
 #include "api_path.h"
+#include "api_route.h"
 
 namespace espurna {
 namespace api {
@@ -31,10 +32,9 @@ struct Request {
     Request(Request&&) noexcept = default;
     Request& operator=(Request&&) = delete;
 
-    Request(AsyncWebServerRequest& request, const PathParts& pattern, const PathParts& parts) :
+    Request(AsyncWebServerRequest& request, const Captures& captures) :
         _request(request),
-        _pattern(pattern),
-        _parts(parts)
+        _captures(captures)
     {}
 
     template <typename T>
@@ -66,15 +66,11 @@ struct Request {
         return _done;
     }
 
-    const PathParts& parts() const {
-        return _parts;
+    const Captures& captures() const {
+        return _captures;
     }
 
-    String part(size_t index) const {
-        return _parts[index].toString();
-    }
-
-    // Only works when pattern cointains '+', retrieving the part at the same index from the real path
+    // Only works when pattern cointains '+' or '#', retrieving the matching part of the real path
     // e.g. for the pair of `some/+/path` and `some/data/path`, calling `wildcard(0)` will return `data`
     String wildcard(int index) const;
     size_t wildcards() const;
@@ -91,8 +87,7 @@ private:
     bool _done { false };
 
     AsyncWebServerRequest& _request;
-    const PathParts& _pattern;
-    const PathParts& _parts;
+    const Captures& _captures;
 };
 
 struct RequestHelper {
@@ -104,31 +99,29 @@ struct RequestHelper {
     RequestHelper(RequestHelper&&) noexcept = default;
     RequestHelper& operator=(RequestHelper&&) = delete;
 
-    // &path is expected to be request->url(), which is valid throughout the request's lifetime
-    RequestHelper(AsyncWebServerRequest& request, const PathParts& pattern) :
+    // captures are expected to point to request->url(), which is valid throughout the request's lifetime
+    RequestHelper(AsyncWebServerRequest& request, AsyncWebHandler& handler, const Captures& captures) :
         _request(request),
-        _pattern(pattern),
-        _path(request.url()),
-        _match(_pattern.match(_path))
+        _handler(handler),
+        _captures(captures)
     {}
 
     Request request() const {
-        return Request(_request, _pattern, _path);
+        return Request(_request, _captures);
     }
 
-    const PathParts& parts() const {
-        return _path;
+    AsyncWebHandler& handler() const {
+        return _handler;
     }
 
-    bool match() const {
-        return _match;
+    const Captures& captures() const {
+        return _captures;
     }
 
 private:
     AsyncWebServerRequest& _request;
-    const PathParts& _pattern;
-    PathParts _path;
-    bool _match;
+    AsyncWebHandler& _handler;
+    Captures _captures;
 };
 
 } // namespace api
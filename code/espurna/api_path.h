@@ -100,9 +100,6 @@ struct PathParts {
         return match(PathParts(path));
     }
 
-    static espurna::StringView wildcard(const PathParts& pattern, const PathParts& value, int index);
-    static size_t wildcards(const PathParts& pattern);
-
 private:
     espurna::StringView get(const PathPart& part) const {
         return espurna::StringView(
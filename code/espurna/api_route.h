@@ -0,0 +1,281 @@
+/*
+
+Part of the API MODULE
+
+Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+namespace espurna {
+namespace api {
+
+// Wildcard values of the matched path, in the same order as they appear in the pattern.
+// Values are not copied and point to the path string itself.
+struct Captures {
+    static constexpr size_t Size { 4 };
+
+    StringView operator[](size_t index) const {
+        return (index < _size)
+            ? _values[index]
+            : StringView();
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool push(StringView value) {
+        if (_size < Size) {
+            _values[_size] = value;
+            ++_size;
+            return true;
+        }
+
+        return false;
+    }
+
+    void pop() {
+        if (_size) {
+            --_size;
+        }
+    }
+
+    void clear() {
+        _size = 0;
+    }
+
+private:
+    std::array<StringView, Size> _values{};
+    size_t _size { 0 };
+};
+
+// Path patterns split into '/'-separated segments and stored as a tree, built once when routes are registered.
+// Literal segments are compared as-is, '+' accepts any single segment and '#' accepts the rest of the path.
+// When several branches are possible, literal segment is preferred over '+', and '+' over '#'.
+// Pattern strings are not copied and are expected to outlive the tree.
+template <typename T>
+class Routes {
+public:
+    // false when pattern is malformed or it is already taken by some other value
+    bool add(StringView pattern, T value) {
+        // tree only references the pattern, nothing should be added until it is known to be valid
+        if (!valid(pattern)) {
+            return false;
+        }
+
+        auto* node = &_root;
+
+        const auto* it = pattern.begin();
+        const auto* end = pattern.end();
+
+        for (;;) {
+            const auto* next = std::find(it, end, '/');
+            const auto segment = StringView(it, next);
+
+            switch (wildcard(segment)) {
+            case Wildcard::Single:
+                if (!node->single) {
+                    node->single.reset(new Node(segment));
+                }
+                node = node->single.get();
+                break;
+
+            case Wildcard::Multi:
+                if (!node->multi) {
+                    node->multi.reset(new Node(segment));
+                }
+                node = node->multi.get();
+                break;
+
+            case Wildcard::None:
+            case Wildcard::Invalid:
+                node = &child(*node, segment);
+                break;
+            }
+
+            if (next == end) {
+                break;
+            }
+
+            it = next + 1;
+        }
+
+        if (node->leaf) {
+            return false;
+        }
+
+        node->leaf = true;
+        node->value = std::move(value);
+        ++_size;
+
+        return true;
+    }
+
+    // captured values point to the path, and are only valid while the path string is
+    const T* find(StringView path, Captures& captures) const {
+        captures.clear();
+        if (!path.length()) {
+            return nullptr;
+        }
+
+        const auto* node = find(_root, path.begin(), path.end(), captures);
+        if (node) {
+            return &node->value;
+        }
+
+        return nullptr;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    enum class Wildcard {
+        None,
+        Single,
+        Multi,
+        Invalid,
+    };
+
+    struct Node {
+        Node() = default;
+        explicit Node(StringView segment) :
+            segment(segment)
+        {}
+
+        StringView segment;
+        std::vector<Node> children;
+        std::unique_ptr<Node> single;
+        std::unique_ptr<Node> multi;
+        T value{};
+        bool leaf { false };
+    };
+
+    static Wildcard wildcard(StringView segment) {
+        const auto single = std::count(segment.begin(), segment.end(), '+');
+        const auto multi = std::count(segment.begin(), segment.end(), '#');
+        if (!single && !multi) {
+            return Wildcard::None;
+        }
+
+        if (segment.length() != 1) {
+            return Wildcard::Invalid;
+        }
+
+        return single
+            ? Wildcard::Single
+            : Wildcard::Multi;
+    }
+
+    // wildcards must be the only character in the segment, and '#' must be the last segment
+    static bool valid(StringView pattern) {
+        if (!pattern.length()) {
+            return false;
+        }
+
+        const auto* it = pattern.begin();
+        const auto* end = pattern.end();
+
+        for (;;) {
+            const auto* next = std::find(it, end, '/');
+
+            switch (wildcard(StringView(it, next))) {
+            case Wildcard::None:
+            case Wildcard::Single:
+                break;
+
+            case Wildcard::Multi:
+                if (next != end) {
+                    return false;
+                }
+                break;
+
+            case Wildcard::Invalid:
+                return false;
+            }
+
+            if (next == end) {
+                break;
+            }
+
+            it = next + 1;
+        }
+
+        return true;
+    }
+
+    static Node& child(Node& node, StringView segment) {
+        for (auto& entry : node.children) {
+            if (entry.segment == segment) {
+                return entry;
+            }
+        }
+
+        node.children.emplace_back(segment);
+        return node.children.back();
+    }
+
+    // `it` is the beginning of the current segment, or nullptr when the path was already consumed.
+    // recursion depth is limited by the depth of the tree, not by the path
+    static const Node* find(const Node& node, const char* it, const char* end, Captures& captures) {
+        if (!it) {
+            if (node.leaf) {
+                return &node;
+            }
+
+            if (node.multi && node.multi->leaf && captures.push(StringView())) {
+                return node.multi.get();
+            }
+
+            return nullptr;
+        }
+
+        const auto* next = std::find(it, end, '/');
+        const auto segment = StringView(it, next);
+        const auto* following = (next != end)
+            ? (next + 1)
+            : nullptr;
+
+        for (const auto& entry : node.children) {
+            if (entry.segment == segment) {
+                const auto* result = find(entry, following, end, captures);
+                if (result) {
+                    return result;
+                }
+                break;
+            }
+        }
+
+        if (node.single && captures.push(segment)) {
+            const auto* result = find(*node.single, following, end, captures);
+            if (result) {
+                return result;
+            }
+            captures.pop();
+        }
+
+        if (node.multi && node.multi->leaf && captures.push(StringView(it, end))) {
+            return node.multi.get();
+        }
+
+        return nullptr;
+    }
+
+    Node _root;
+    size_t _size { 0 };
+};
+
+} // namespace api
+} // namespace espurna
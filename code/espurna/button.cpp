@@ -290,6 +290,11 @@ namespace {
 
 static std::vector<Button> buttons;
 
+#if LOOP_TICKLESS_SUPPORT
+// At least one of the buttons is not able to wake up the loop by itself
+bool polled { false };
+#endif
+
 } // namespace
 } // namespace internal
 
@@ -621,6 +626,11 @@ constexpr ButtonProvider provider(size_t index) {
     );
 }
 
+#if LOOP_TICKLESS_SUPPORT
+// Same as the shortest `loopDelay`
+constexpr espurna::duration::Milliseconds PollInterval { 10 };
+#endif
+
 } // namespace
 } // namespace build
 
@@ -1273,6 +1283,33 @@ void buttonLoop() {
     }
 }
 
+#if LOOP_TICKLESS_SUPPORT
+namespace {
+
+// Hardware GPIO edges wake up the loop, but nothing happens when the click is only
+// waiting for the repeat delay to expire. Pins without interrupts are always polled
+espurna::duration::Milliseconds _buttonDeadline() {
+    if (espurna::button::internal::polled) {
+        return espurna::button::build::PollInterval;
+    }
+
+    for (const auto& button : espurna::button::internal::buttons) {
+        if (button.event_emitter && button.event_emitter->isPending()) {
+            return espurna::button::build::PollInterval;
+        }
+    }
+
+    return LoopIdle;
+}
+
+espurna::duration::Milliseconds _buttonLoop() {
+    buttonLoop();
+    return _buttonDeadline();
+}
+
+} // namespace
+#endif
+
 // Resistor ladder buttons. Inspired by:
 // - https://gitter.im/tinkerman-cat/espurna?at=5f5d44c8df4af236f902e25d
 // - https://github.com/bxparks/AceButton/tree/develop/docs/resistor_ladder (especially thx @bxparks for the great documentation!)
@@ -1429,6 +1466,15 @@ BasePinPtr _buttonGpioPin(size_t index, ButtonProvider provider) {
         }
 
         result = base->pin(pin);
+
+#if LOOP_TICKLESS_SUPPORT
+        // edges of the hardware pins end the loop sleep early, debouncing is still done in the loop
+        if (base == &hardwareGpio()) {
+            attachInterrupt(pin, espurnaLoopWake, CHANGE);
+        } else {
+            espurna::button::internal::polled = true;
+        }
+#endif
 #endif
         break;
     }
@@ -1445,6 +1491,9 @@ BasePinPtr _buttonGpioPin(size_t index, ButtonProvider provider) {
         }
 
         result.reset(new AnalogPin(pin, level));
+#if LOOP_TICKLESS_SUPPORT
+        espurna::button::internal::polled = true;
+#endif
 #endif
         break;
     }
@@ -1514,6 +1563,9 @@ bool _buttonSetupProvider(size_t index, ButtonProvider provider) {
 #ifdef FOXEL_LIGHTFOX_DUAL
         _buttonAddWithPin(index, lightfoxMakeButtonPin(index));
         result = true;
+#if LOOP_TICKLESS_SUPPORT
+        espurna::button::internal::polled = true;
+#endif
 #endif
         break;
 
@@ -1563,7 +1615,11 @@ void buttonSetup() {
         _buttonConfigure();
         espurnaRegisterReload(_buttonConfigure);
 
-        espurnaRegisterLoop(buttonLoop);
+#if LOOP_TICKLESS_SUPPORT
+        espurnaRegisterLoop(_buttonLoop, STRING_VIEW("button"));
+#else
+        espurnaRegisterLoop(buttonLoop, STRING_VIEW("button"));
+#endif
     }
 }
 
@@ -151,6 +151,10 @@
 #define RFB_SUPPORT RF_SUPPORT
 #endif
 
+#if defined(EMON_MAX_TIME) || defined(EMON_FILTER_SPEED)
+#warning "EMON_MAX_TIME and EMON_FILTER_SPEED are no longer used! Samples are collected in the background, see EMON_SAMPLE_CYCLES"
+#endif
+
 #ifdef PZEM004T_ADDRESSES
 #warning "PZEM004T_ADDRESSES is deprecated! Addresses can be set by using individual flags PZEM004T_ADDRESS_{1,2,3}"
 #endif
@@ -28,6 +28,26 @@
                                                 // - https://github.com/esp8266/Arduino/issues/5825
 #endif
 
+#ifndef LOOP_TICKLESS_SUPPORT
+#define LOOP_TICKLESS_SUPPORT   0               // Instead of waiting `loopDelay` every iteration, sleep until the nearest loop deadline
+                                                // Loop is woken up early by timers, scheduled callbacks and espurnaLoopWake()
+#endif
+
+#ifndef LOOP_TICKLESS_MAX
+#define LOOP_TICKLESS_MAX       100             // Longest sleep (in milliseconds) when in tickless mode,
+                                                // callbacks without deadlines are called at least this often
+#endif
+
+#ifndef LOOP_PROFILER_SUPPORT
+#define LOOP_PROFILER_SUPPORT   0               // Measure execution time of every loop callback
+                                                // Results are available through the LOOP terminal command and /api/loop
+#endif
+
+#ifndef LOOP_PROFILER_BUDGET
+#define LOOP_PROFILER_BUDGET    50              // Report loop callbacks running longer than this (in milliseconds)
+                                                // Can be changed at runtime with the `loopBudget` setting, 0 disables reports
+#endif
+
 //------------------------------------------------------------------------------
 // HEARTBEAT
 //------------------------------------------------------------------------------
@@ -147,6 +167,14 @@
 #define TELNET_LINE_BUFFER_SIZE 256             // Temporary buffer, when data arrives in multiple packets without a new-line
 #endif
 
+#ifndef TELNET_OUTPUT_BUFFERS
+#define TELNET_OUTPUT_BUFFERS   4               // Output buffers shared by all clients, used when network buffers are full (TCP_MSS bytes each)
+#endif
+
+#ifndef TELNET_SLOW_CLIENT_TIMEOUT
+#define TELNET_SLOW_CLIENT_TIMEOUT 5000         // Disconnect the client when it does not receive any of the buffered output for this long (in milliseconds)
+#endif
+
 // Enable this flag to add support for reverse telnet (+800 bytes)
 // This is useful to telnet to a device behind a NAT or firewall
 // To use this feature, start a listen server on a publicly reachable host with e.g. "ncat -vlp <port>" and use the MQTT reverse telnet command to connect
@@ -215,6 +243,13 @@
                                                 // If not defined the firmware will use a number based
                                                 // on the number of available sectors
 
+#ifndef EEPROM_DEFERRED_COMMIT_DELAY
+#define EEPROM_DEFERRED_COMMIT_DELAY 0          // Delay (ms) before writing frequently changing values that are also
+                                                // kept in RTC memory, e.g. relay status and energy totals
+                                                // By default (0) they are committed right away. Anything written during
+                                                // the delay is lost on power loss, since RTC memory does not survive it
+#endif
+
 #ifndef SAVE_CRASH_ENABLED
 #define SAVE_CRASH_ENABLED          1           // Save stack trace to EEPROM by default
                                                 // Depends on DEBUG_SUPPORT == 1
@@ -240,6 +275,14 @@
 #define GARLAND_LEDS                60          // Number of LEDs
 #endif
 
+#ifndef GARLAND_FRAME_RATE
+#define GARLAND_FRAME_RATE          60          // Target frames per second (at the maximum animation speed)
+#endif
+
+#ifndef GARLAND_STATS_INTERVAL
+#define GARLAND_STATS_INTERVAL      60000       // Publish animation timings to the garland/stats topic every N ms
+#endif
+
 //------------------------------------------------------------------------------
 // THERMOSTAT
 //------------------------------------------------------------------------------
@@ -351,6 +394,10 @@
 #define HEARTBEAT_REPORT_BSSID       0
 #endif
 
+#ifndef HEARTBEAT_REPORT_CONNECT_TIME
+#define HEARTBEAT_REPORT_CONNECT_TIME 0
+#endif
+
 //------------------------------------------------------------------------------
 // Load average
 //------------------------------------------------------------------------------
@@ -596,6 +643,16 @@
                                                            // Configured networks are used in order.
 #endif
 
+#ifndef WIFI_FAST_CONNECT
+#define WIFI_FAST_CONNECT               1                  // Remember BSSID and channel of the last connection in the RTC memory,
+                                                           // and connect to it directly after reboot or deep sleep without scanning
+#endif
+
+#ifndef WIFI_FAST_CONNECT_IP
+#define WIFI_FAST_CONNECT_IP            0                  // (optional) Also re-use the last DHCP lease as a static IP
+                                                           // when connecting directly. Lease expiration is not tracked
+#endif
+
 #ifndef WIFI_SCAN_RSSI_THRESHOLD
 #define WIFI_SCAN_RSSI_THRESHOLD        -73                // Consider current network for a reconnection cycle
                                                            // when it's RSSI value is below the specified threshold
@@ -839,6 +896,12 @@
 #define OTA_WEB_SUPPORT             WEB_SUPPORT             // Support `/upgrade` endpoint and WebUI OTA handler
 #endif
 
+#ifndef OTA_INFLATE_WINDOW_BITS
+#define OTA_INFLATE_WINDOW_BITS     13          // Window size for zlib'ed OTA images, as 2^N bytes (8..15)
+                                                // Images compressed with a larger window are rejected
+                                                // (e.g. Python `zlib.compressobj(9, zlib.DEFLATED, 13)`)
+#endif
+
 #define OTA_GITHUB_FP               "CA:06:F5:6B:25:8B:7A:0D:4F:2B:05:47:09:39:47:86:51:15:19:84"
 
 #ifndef OTA_FINGERPRINT
@@ -915,6 +978,11 @@
                                                 // If buffer fills up before we are able to send, old data gets discarded
 #endif
 
+#ifndef UART_MQTT_OUTPUT_SIZE
+#define UART_MQTT_OUTPUT_SIZE       512         // Buffer up to N bytes of MQTT payloads, before they are written to the serial.
+                                                // Payload that does not fit into the remaining space gets discarded
+#endif
+
 #ifndef UART_MQTT_TERMINATE_OUT
 #define UART_MQTT_TERMINATE_OUT     '\n'        // Write this byte after every received payload
                                                 // Set to `\0` to disable
@@ -1263,6 +1331,10 @@
 #define HOMEASSISTANT_RETAIN    MQTT_RETAIN     // Make broker retain the messages
 #endif
 
+#ifndef HOMEASSISTANT_DISCOVERY_INFLIGHT
+#define HOMEASSISTANT_DISCOVERY_INFLIGHT 4      // Number of discovery messages waiting for the broker ack at the same time
+#endif
+
 // -----------------------------------------------------------------------------
 // INFLUXDB
 // -----------------------------------------------------------------------------
@@ -1365,6 +1437,25 @@
 #define THINGSPEAK_FIELDS           8               // Maximum number of fields that will be prepared
 #endif
 
+// Instead of sending the latest values, record them locally and send them all at once.
+// Every record is timestamped, so the channel keeps every value even when they change more often
+// than the MIN_INTERVAL allows. Requires the CHANNEL ID and synced time (NTP_SUPPORT=1)
+#ifndef THINGSPEAK_BULK_ENABLED
+#define THINGSPEAK_BULK_ENABLED     0               // Use bulk updates
+#endif
+
+#ifndef THINGSPEAK_CHANNEL
+#define THINGSPEAK_CHANNEL          ""              // Channel ID, used for the bulk update address
+#endif
+
+#ifndef THINGSPEAK_BULK_INTERVAL
+#define THINGSPEAK_BULK_INTERVAL    300             // Send recorded values every N seconds (no less than MIN_INTERVAL)
+#endif
+
+#ifndef THINGSPEAK_BULK_RECORDS
+#define THINGSPEAK_BULK_RECORDS     32              // Maximum number of records kept in memory until they are sent
+#endif
+
 // -----------------------------------------------------------------------------
 // SCHEDULER
 // -----------------------------------------------------------------------------
@@ -1500,10 +1591,20 @@
 #define RFB_SEND_DELAY              500             // Interval between sendings in ms
 #endif
 
+#ifndef RFB_SEND_QUEUE_SIZE
+#define RFB_SEND_QUEUE_SIZE         16              // Number of messages waiting to be sent. Same amount is reserved
+                                                    // for the repeats of the messages that were already sent once
+#endif
+
 #ifndef RFB_RECEIVE_DELAY
 #define RFB_RECEIVE_DELAY           500             // Interval between recieving in ms (avoid bouncing)
 #endif
 
+#ifndef RFB_RECEIVE_REPEAT_WINDOW
+#define RFB_RECEIVE_REPEAT_WINDOW   500             // Identical codes received within this interval (in ms) are not
+                                                    // matched with relays or sent via MQTT. Set to 0 to disable
+#endif
+
 #ifndef RFB_TRANSMIT_REPEATS
 #define RFB_TRANSMIT_REPEATS        5               // How many times RCSwitch will repeat the message
 #endif
@@ -1608,6 +1709,16 @@
                                                     // (when using series >1, will also wait between the same message)
 #endif
 
+#ifndef IR_TX_QUEUE_SIZE
+#define IR_TX_QUEUE_SIZE            8               // (number) maximum number of messages waiting to be transmitted
+#endif
+
+#ifndef IR_TX_ARENA_SIZE
+#define IR_TX_ARENA_SIZE            2048            // (bytes) preallocated storage for the queued messages and their payloads
+                                                    // (default fits the longest raw payload of a MQTT_BUFFER_MAX_SIZE message, ~512 time values.
+                                                    //  payloads that do not fit are dropped, and the drop is logged)
+#endif
+
 #ifndef IR_RX_DELAY
 #define IR_RX_DELAY                 100             // (ms) minimum amount of time to wait before processing incomming message
 #endif
@@ -1725,6 +1836,11 @@
 #define MCP23S08_SUPPORT            0
 #endif
 
+#ifndef MCP23S08_INT_PIN
+#define MCP23S08_INT_PIN            GPIO_NONE   // GPIO connected to the expander INT output. Port is only read when it is LOW.
+                                                // When not connected, port is read (at most) once every loop()
+#endif
+
 //--------------------------------------------------------------------------------
 // Support prometheus metrics export
 //--------------------------------------------------------------------------------
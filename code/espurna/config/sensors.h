@@ -431,15 +431,15 @@
 //------------------------------------------------------------------------------
 
 #ifndef EMON_MAX_SAMPLES
-#define EMON_MAX_SAMPLES                1000        // Max number of samples to get
+#define EMON_MAX_SAMPLES                1000        // Max number of samples to get for every reading
 #endif
 
-#ifndef EMON_MAX_TIME
-#define EMON_MAX_TIME                   250         // Max time in ms to sample
+#ifndef EMON_MAINS_FREQUENCY
+#define EMON_MAINS_FREQUENCY            50          // Mains frequency (Hz)
 #endif
 
-#ifndef EMON_FILTER_SPEED
-#define EMON_FILTER_SPEED               512         // Mobile average filter speed
+#ifndef EMON_SAMPLE_CYCLES
+#define EMON_SAMPLE_CYCLES              1           // Number of whole mains cycles to sample on every loop iteration
 #endif
 
 #ifndef EMON_REFERENCE_VOLTAGE
@@ -1045,6 +1045,11 @@
 #define PZEM004TV30_DEBUG                  0
 #endif
 
+#ifndef PZEM004TV30_DEVICES_MAX
+#define PZEM004TV30_DEVICES_MAX            4      // Maximum number of devices sharing the same port
+                                                  // Every one needs an unique address, set via `pzemv30Addr#`
+#endif
+
 //------------------------------------------------------------------------------
 // SDS011 particulates sensor
 // Enable support by passing SDS011_SUPPORT=1 build flag
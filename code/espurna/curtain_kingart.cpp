@@ -482,7 +482,7 @@ void kingartCurtainSetup() {
 #endif
 
     // Register loop to poll the UART for new messages
-    espurnaRegisterLoop(_KACurtainLoop);
+    espurnaRegisterLoop(_KACurtainLoop, STRING_VIEW("curtain"));
 
 }
 
@@ -0,0 +1,150 @@
+/*
+
+Part of NTP MODULE
+
+Based on:
+- http://howardhinnant.github.io/date_algorithms.html chrono-Compatible Low-Level Date Algorithms
+
+Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+namespace espurna {
+namespace datetime {
+
+// Proleptic Gregorian calendar, days are counted from the 1970-01-01
+// (as opposed to `tm`, month is 1..12)
+struct Date {
+    int year;
+    int month;
+    int day;
+};
+
+inline int64_t days_from_civil(int year, int month, int day) {
+    year -= (month <= 2) ? 1 : 0;
+
+    const int64_t era = ((year >= 0) ? year : (year - 399)) / 400;
+    const int64_t yoe = year - (era * 400);
+    const int64_t doy = (153 * ((month > 2) ? (month - 3) : (month + 9)) + 2) / 5 + day - 1;
+    const int64_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+    return (era * 146097) + doe - 719468;
+}
+
+inline Date civil_from_days(int64_t days) {
+    days += 719468;
+
+    const int64_t era = ((days >= 0) ? days : (days - 146096)) / 146097;
+    const int64_t doe = days - (era * 146097);
+    const int64_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+    const int64_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+    const int64_t mp = ((5 * doy) + 2) / 153;
+
+    const int month = (mp < 10) ? (mp + 3) : (mp - 9);
+
+    return Date{
+        static_cast<int>(yoe + (era * 400) + ((month <= 2) ? 1 : 0)),
+        month,
+        static_cast<int>(doy - ((153 * mp) + 2) / 5 + 1)};
+}
+
+// 0 is Sunday, same as `tm.tm_wday`
+inline int weekday_from_days(int64_t days) {
+    return (days >= -4)
+        ? static_cast<int>((days + 4) % 7)
+        : static_cast<int>((days + 5) % 7 + 6);
+}
+
+// Same as gmtime_r, but without going through the libc
+inline tm utc(time_t timestamp) {
+    static constexpr int64_t SecondsPerDay { 24 * 60 * 60 };
+
+    const int64_t value = timestamp;
+    int64_t days = value / SecondsPerDay;
+    int64_t seconds = value % SecondsPerDay;
+    if (seconds < 0) {
+        seconds += SecondsPerDay;
+        days -= 1;
+    }
+
+    const auto date = civil_from_days(days);
+
+    tm out{};
+    out.tm_sec = seconds % 60;
+    out.tm_min = (seconds / 60) % 60;
+    out.tm_hour = seconds / (60 * 60);
+    out.tm_mday = date.day;
+    out.tm_mon = date.month - 1;
+    out.tm_year = date.year - 1900;
+    out.tm_wday = weekday_from_days(days);
+    out.tm_yday = days - days_from_civil(date.year, 1, 1);
+    out.tm_isdst = 0;
+
+    return out;
+}
+
+// Difference between the broken down local time and the UTC timestamp it was made from
+inline int32_t offset(const tm& local, time_t timestamp) {
+    const auto days = days_from_civil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+    const auto seconds = (days * 24 * 60 * 60)
+        + (local.tm_hour * 60 * 60)
+        + (local.tm_min * 60)
+        + local.tm_sec;
+
+    return static_cast<int32_t>(seconds - static_cast<int64_t>(timestamp));
+}
+
+// Local time is UTC with the offset of the current zone, which only changes at the DST transition.
+// Transitions happen at some local hour, and zones are offset from UTC in multiples of 15 minutes.
+// So, the offset stays the same for the whole 15 minute block of UTC time and localtime_r is only
+// needed once for every block, instead of parsing TZ rules every time.
+// (does not hold for TZ rules with transitions at some arbitrary minute, which are not in the tzdata)
+class Local {
+public:
+    static constexpr time_t Block { 15 * 60 };
+
+    tm operator()(time_t timestamp) {
+        const auto block = floor(timestamp);
+        if (!_valid || (block != _block)) {
+            tm out{};
+            localtime_r(&timestamp, &out);
+
+            _valid = true;
+            _block = block;
+            _offset = offset(out, timestamp);
+            _isdst = out.tm_isdst;
+
+            return out;
+        }
+
+        auto out = utc(timestamp + _offset);
+        out.tm_isdst = _isdst;
+
+        return out;
+    }
+
+    // TZ was changed
+    void reset() {
+        _valid = false;
+    }
+
+private:
+    static time_t floor(time_t timestamp) {
+        return (timestamp >= 0)
+            ? (timestamp / Block)
+            : ((timestamp - Block + 1) / Block);
+    }
+
+    time_t _block { 0 };
+    int32_t _offset { 0 };
+    int _isdst { 0 };
+    bool _valid { false };
+};
+
+} // namespace datetime
+} // namespace espurna
@@ -19,8 +19,9 @@
 
 // Should include our own prototypes, since the original code does not provide them
 #include "libs/esp8266_pwm.h"
+#include "libs/esp8266_pwm_phases.h"
 
-/* Set the following three defines to your needs */
+/* Set the following four defines to your needs */
 
 #ifndef SDK_PWM_PERIOD_COMPAT_MODE
 #define SDK_PWM_PERIOD_COMPAT_MODE  0
@@ -30,11 +31,25 @@
 #define PWM_MAX_CHANNELS            8
 #endif
 
+/* Extra bits of duty resolution, at the cost of (1 << bits) phase tables
+ * and running pwm_start() phase preparation as many times.
+ * Duty alternates between adjacent tick values across the consecutive
+ * periods, see pwm_dither_ticks(). Interrupt load stays the same. */
+#ifndef PWM_DITHER_BITS
+#define PWM_DITHER_BITS             0
+#endif
+
 #define PWM_DEBUG                   0
 #define PWM_USE_NMI                 1
 
 /* no user servicable parts beyond this point */
 
+#if (PWM_DITHER_BITS < 0) || (PWM_DITHER_BITS > 4)
+#error "PWM_DITHER_BITS must be between 0 and 4"
+#endif
+
+#define PWM_DITHER_FRAMES           (1 << PWM_DITHER_BITS)
+
 #define PWM_MAX_TICKS               0x7fffff
 #if SDK_PWM_PERIOD_COMPAT_MODE
 #define PWM_PERIOD_TO_TICKS(x)      (x * 0.2)
@@ -56,25 +71,26 @@
 #define TIMER1_DIVIDE_BY_16         0x0004
 #define TIMER1_ENABLE_TIMER         0x0080
 
-struct pwm_phase {
-	uint32_t ticks;    ///< delay until next phase, in 200ns units
-	uint16_t on_mask;  ///< GPIO mask to switch on
-	uint16_t off_mask; ///< GPIO mask to switch off
-};
-
 /* Three sets of PWM phases, the active one, the one used
  * starting with the next cycle, and the one updated
  * by pwm_start. After the update pwm_next_set
  * is set to the last updated set. pwm_current_set is set to
  * pwm_next_set from the interrupt routine during the first
  * pwm phase
+ * When dithering, every set consists of PWM_DITHER_FRAMES phase
+ * tables placed one after another. Interrupt routine moves to
+ * the next frame of the same set at the end of every period
  */
 #define PWM_PHASES_MAX (PWM_MAX_CHANNELS + 2)
-typedef struct pwm_phase (pwm_phase_array)[PWM_PHASES_MAX];
+typedef struct pwm_phase (pwm_phase_array)[PWM_DITHER_FRAMES * PWM_PHASES_MAX];
 static pwm_phase_array pwm_phases[3];
 static struct {
 	struct pwm_phase* next_set;
 	struct pwm_phase* current_set;
+#if PWM_DITHER_BITS
+	struct pwm_phase* current_base;
+	uint8_t current_frame;
+#endif
 	uint8_t current_phase;
 } pwm_state;
 
@@ -117,7 +133,18 @@ pwm_intr_handler(void)
 {
 	const struct pwm_phase current_phase = pwm_state.current_set[pwm_state.current_phase];
 	if ((current_phase.off_mask == 0) && (current_phase.on_mask == 0)) {
+#if PWM_DITHER_BITS
+		if (pwm_state.current_base != pwm_state.next_set) {
+			pwm_state.current_base = pwm_state.next_set;
+			pwm_state.current_frame = 0;
+		} else {
+			pwm_state.current_frame = (pwm_state.current_frame + 1) & (PWM_DITHER_FRAMES - 1);
+		}
+		pwm_state.current_set = pwm_state.current_base
+			+ (pwm_state.current_frame * PWM_PHASES_MAX);
+#else
 		pwm_state.current_set = pwm_state.next_set;
+#endif
 		pwm_state.current_phase = 0;
 	}
 
@@ -173,13 +200,17 @@ pwm_init(uint32_t period, uint32_t *duty, uint32_t pwm_channel_num,
 		pwm_channels = PWM_MAX_CHANNELS;
 
 	for (i = 0; i < 3; i++) {
-		for (j = 0; j < (PWM_MAX_CHANNELS + 2); j++) {
+		for (j = 0; j < (PWM_DITHER_FRAMES * PWM_PHASES_MAX); j++) {
 			pwm_phases[i][j].ticks = 0;
 			pwm_phases[i][j].on_mask = 0;
 			pwm_phases[i][j].off_mask = 0;
 		}
 	}
 	pwm_state.current_set = pwm_state.next_set = 0;
+#if PWM_DITHER_BITS
+	pwm_state.current_base = 0;
+	pwm_state.current_frame = 0;
+#endif
 	pwm_state.current_phase = 0;
 
 	uint32_t all = 0;
@@ -212,142 +243,20 @@ pwm_init(uint32_t period, uint32_t *duty, uint32_t pwm_channel_num,
 
 __attribute__ ((noinline))
 static uint8_t ICACHE_FLASH_ATTR
-_pwm_phases_prep(struct pwm_phase* pwm)
+_pwm_phases_prep(struct pwm_phase* pwm, uint8_t frame)
 {
+	uint32_t ticks[PWM_MAX_CHANNELS];
 	uint8_t n, phases;
 
-	for (n = 0; n < pwm_channels + 2; n++) {
-		pwm[n].ticks = 0;
-		pwm[n].on_mask = 0;
-		pwm[n].off_mask = 0;
-	}
-	phases = 1;
 	for (n = 0; n < pwm_channels; n++) {
-		uint32_t ticks = PWM_DUTY_TO_TICKS(pwm_duty[n]);
-		if (ticks == 0) {
-			pwm[0].off_mask |= gpio_mask[n];
-		} else if (ticks >= pwm_period_ticks) {
-			pwm[0].on_mask |= gpio_mask[n];
-		} else {
-			if (ticks < (pwm_period_ticks/2)) {
-				pwm[phases].ticks = ticks;
-				pwm[0].on_mask |= gpio_mask[n];
-				pwm[phases].off_mask = gpio_mask[n];
-			} else {
-				pwm[phases].ticks = pwm_period_ticks - ticks;
-				pwm[phases].on_mask = gpio_mask[n];
-				pwm[0].off_mask |= gpio_mask[n];
-			}
-			phases++;
-		}
-	}
-	pwm[phases].ticks = pwm_period_ticks;
-
-	// bubble sort, lowest to hightest duty
-	n = 2;
-	while (n < phases) {
-		if (pwm[n].ticks < pwm[n - 1].ticks) {
-			struct pwm_phase t = pwm[n];
-			pwm[n] = pwm[n - 1];
-			pwm[n - 1] = t;
-			if (n > 2)
-				n--;
-		} else {
-			n++;
-		}
-	}
-
-#if PWM_DEBUG
-        int t = 0;
-	for (t = 0; t <= phases; t++) {
-		ets_printf("%d @%d:   %04x %04x\n", t, pwm[t].ticks, pwm[t].on_mask, pwm[t].off_mask);
-	}
-#endif
-
-	// shift left to align right edge;
-	uint8_t l = 0, r = 1;
-	while (r <= phases) {
-		uint32_t diff = pwm[r].ticks - pwm[l].ticks;
-		if (diff && (diff <= 16)) {
-			uint16_t mask = pwm[r].on_mask | pwm[r].off_mask;
-			pwm[l].off_mask ^= pwm[r].off_mask;
-			pwm[l].on_mask ^= pwm[r].on_mask;
-			pwm[0].off_mask ^= pwm[r].on_mask;
-			pwm[0].on_mask ^= pwm[r].off_mask;
-			pwm[r].ticks = pwm_period_ticks - diff;
-			pwm[r].on_mask ^= mask;
-			pwm[r].off_mask ^= mask;
-		} else {
-			l = r;
-		}
-		r++;
-	}
-
-#if PWM_DEBUG
-	for (t = 0; t <= phases; t++) {
-		ets_printf("%d @%d:   %04x %04x\n", t, pwm[t].ticks, pwm[t].on_mask, pwm[t].off_mask);
-	}
-#endif
-
-	// sort again
-	n = 2;
-	while (n <= phases) {
-		if (pwm[n].ticks < pwm[n - 1].ticks) {
-			struct pwm_phase t = pwm[n];
-			pwm[n] = pwm[n - 1];
-			pwm[n - 1] = t;
-			if (n > 2)
-				n--;
-		} else {
-			n++;
-		}
-	}
-
-	// merge same duty
-	l = 0, r = 1;
-	while (r <= phases) {
-		if (pwm[r].ticks == pwm[l].ticks) {
-			pwm[l].off_mask |= pwm[r].off_mask;
-			pwm[l].on_mask |= pwm[r].on_mask;
-			pwm[r].on_mask = 0;
-			pwm[r].off_mask = 0;
-		} else {
-			l++;
-			if (l != r) {
-				struct pwm_phase t = pwm[l];
-				pwm[l] = pwm[r];
-				pwm[r] = t;
-			}
-		}
-		r++;
-	}
-	phases = l;
-
-#if PWM_DEBUG
-	for (t = 0; t <= phases; t++) {
-		ets_printf("%d @%d:   %04x %04x\n", t, pwm[t].ticks, pwm[t].on_mask, pwm[t].off_mask);
+		ticks[n] = pwm_dither_ticks(
+			PWM_DUTY_TO_TICKS(pwm_duty[n]), frame, PWM_DITHER_BITS);
 	}
-#endif
 
-	// transform absolute end time to phase durations
-	for (n = 0; n < phases; n++) {
-		pwm[n].ticks =
-			pwm[n + 1].ticks - pwm[n].ticks;
-		// subtract common overhead
-		pwm[n].ticks--;
-	}
-	pwm[phases].ticks = 0;
-
-	// do a cyclic shift if last phase is short
-	if (pwm[phases - 1].ticks < 16) {
-		for (n = 0; n < phases - 1; n++) {
-			struct pwm_phase t = pwm[n];
-			pwm[n] = pwm[n + 1];
-			pwm[n + 1] = t;
-		}
-	}
+	phases = pwm_phases_prep(pwm, ticks, gpio_mask, pwm_channels, pwm_period_ticks);
 
 #if PWM_DEBUG
+	int t = 0;
 	for (t = 0; t <= phases; t++) {
 		ets_printf("%d +%d:   %04x %04x\n", t, pwm[t].ticks, pwm[t].on_mask, pwm[t].off_mask);
 	}
@@ -362,17 +271,35 @@ pwm_start(void)
 {
 	pwm_phase_array* pwm = &pwm_phases[0];
 
+#if PWM_DITHER_BITS
+	struct pwm_phase* current = pwm_state.current_base;
+#else
+	struct pwm_phase* current = pwm_state.current_set;
+#endif
+
 	if ((*pwm == pwm_state.next_set) ||
-	    (*pwm == pwm_state.current_set))
+	    (*pwm == current))
 		pwm++;
 	if ((*pwm == pwm_state.next_set) ||
-	    (*pwm == pwm_state.current_set))
+	    (*pwm == current))
 		pwm++;
 
-	uint8_t phases = _pwm_phases_prep(*pwm);
+	uint8_t phases = _pwm_phases_prep(*pwm, 0);
+
+#if PWM_DITHER_BITS
+	// every frame must have static 0% / 100% duty to stop
+	uint8_t frame, frame_phases = phases;
+	for (frame = 1; frame < PWM_DITHER_FRAMES; frame++) {
+		uint8_t result = _pwm_phases_prep(&(*pwm)[frame * PWM_PHASES_MAX], frame);
+		if (result > frame_phases)
+			frame_phases = result;
+	}
+#else
+	const uint8_t frame_phases = phases;
+#endif
 
         // all with 0% / 100% duty - stop timer
-	if (phases == 1) {
+	if (frame_phases == 1) {
 		if (pwm_state.next_set) {
 #if PWM_DEBUG
 			ets_printf("PWM stop\n");
@@ -394,6 +321,10 @@ pwm_start(void)
 		ets_printf("PWM start\n");
 #endif
 		pwm_state.current_set = pwm_state.next_set = *pwm;
+#if PWM_DITHER_BITS
+		pwm_state.current_base = *pwm;
+		pwm_state.current_frame = 0;
+#endif
 		pwm_state.current_phase = phases - 1;
 		ETS_FRC1_INTR_ENABLE();
 		#if defined(TIMER_REG_WRITE)
@@ -417,17 +348,44 @@ pwm_set_duty(uint32_t duty, uint8_t channel)
 	if (duty > PWM_MAX_DUTY)
 		duty = PWM_MAX_DUTY;
 
-	pwm_duty[channel] = duty;
+	pwm_duty[channel] = duty << PWM_DITHER_BITS;
 }
 
 uint32_t ICACHE_FLASH_ATTR
 pwm_get_duty(uint8_t channel)
+{
+	if (channel >= PWM_MAX_CHANNELS)
+		return 0;
+	return pwm_duty[channel] >> PWM_DITHER_BITS;
+}
+
+void ICACHE_FLASH_ATTR
+pwm_set_duty_dithered(uint32_t duty, uint8_t channel)
+{
+	if (channel >= PWM_MAX_CHANNELS)
+		return;
+
+	const uint32_t max = (uint32_t)(PWM_MAX_DUTY) << PWM_DITHER_BITS;
+	if (duty > max)
+		duty = max;
+
+	pwm_duty[channel] = duty;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+pwm_get_duty_dithered(uint8_t channel)
 {
 	if (channel >= PWM_MAX_CHANNELS)
 		return 0;
 	return pwm_duty[channel];
 }
 
+uint8_t ICACHE_FLASH_ATTR
+pwm_get_dither_bits(void)
+{
+	return PWM_DITHER_BITS;
+}
+
 void ICACHE_FLASH_ATTR
 pwm_set_period(uint32_t period)
 {
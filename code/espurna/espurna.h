@@ -60,7 +60,19 @@ void espurnaRegisterReload(ReloadCallback);
 void espurnaReload();
 
 using LoopCallback = void (*)();
-void espurnaRegisterLoop(LoopCallback);
+void espurnaRegisterLoop(LoopCallback, espurna::StringView name = espurna::StringView());
+
+// Returns the time until the callback needs to be called again, `LoopIdle` when
+// there is nothing to do until something else calls espurnaLoopWake()
+// (when LOOP_TICKLESS_SUPPORT is disabled, called on every loop iteration regardless)
+using LoopDeadlineCallback = espurna::duration::Milliseconds (*)();
+void espurnaRegisterLoop(LoopDeadlineCallback, espurna::StringView name = espurna::StringView());
+
+constexpr auto LoopIdle = espurna::duration::Milliseconds::max();
+
+// Run deadline callbacks on the next loop iteration, ending the current sleep early.
+// Safe to call from the SYS context (timers, network callbacks) and from ISRs
+void espurnaLoopWake();
 
 void espurnaRegisterOnce(espurna::Callback);
 void espurnaRegisterOnceUnique(espurna::Callback::Type);
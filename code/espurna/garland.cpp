@@ -8,8 +8,11 @@ Tested on 300 led strip.
 
 The most time consuming operation is actually showing leds by Adafruit Neopixel. It take about 1870 mcs.
 More long strip can take more time to show.
-Currently animation calculation, brightness calculation/transition and showing makes in one loop cycle.
+Animation calculation, brightness calculation/transition and showing are done in separate loop cycles.
+Frames are scheduled by wall time, at most "garlandFps" per second. Frames that could not be shown in time are dropped.
 Debug output shows timings. Overal timing should be not more that 3000 ms.
+Per-animation timings histograms are available via GARLAND.STATS terminal command and "garland/stats" MQTT topic
+(published every GARLAND_STATS_INTERVAL and when the scene changes).
 
 MQTT control:
 Topic: $root/garland/set
@@ -57,6 +60,7 @@ Infinite commands can be interrupted by immediate command or by reset command.
 
 #include "garland.h"
 #include "mqtt.h"
+#include "terminal.h"
 #include "ws.h"
 
 namespace {
@@ -68,6 +72,7 @@ namespace {
 alignas(4) static constexpr char NAME_GARLAND_ENABLED[] = "garlandEnabled";
 alignas(4) static constexpr char NAME_GARLAND_BRIGHTNESS[] = "garlandBrightness";
 alignas(4) static constexpr char NAME_GARLAND_SPEED[] = "garlandSpeed";
+alignas(4) static constexpr char NAME_GARLAND_FPS[] = "garlandFps";
 
 alignas(4) static constexpr char NAME_GARLAND_SWITCH[] = "garland_switch";
 alignas(4) static constexpr char NAME_GARLAND_SET_BRIGHTNESS[] = "garland_set_brightness";
@@ -75,6 +80,7 @@ alignas(4) static constexpr char NAME_GARLAND_SET_SPEED[] = "garland_set_speed";
 alignas(4) static constexpr char NAME_GARLAND_SET_DEFAULT[] = "garland_set_default";
 
 alignas(4) static constexpr char MQTT_TOPIC_GARLAND[] = "garland";
+alignas(4) static constexpr char MQTT_TOPIC_GARLAND_STATS[] = "garland/stats";
 
 alignas(4) static constexpr char MQTT_PAYLOAD_COMMAND[] = "command";
 alignas(4) static constexpr char MQTT_PAYLOAD_ENABLE[] = "enable";
@@ -97,6 +103,7 @@ alignas(4) static constexpr char MQTT_COMMAND_SEQUENCE[] = "sequence"; // place
 bool          _garland_enabled          = true;
 unsigned long _lastTimeUpdate           = 0;
 unsigned long _currentDuration          = ULONG_MAX;
+unsigned long _lastStatsUpdate          = 0;
 unsigned int  _currentCommandInSequence = 0;
 String        _immediate_command;
 std::queue<String>  _command_queue;
@@ -190,8 +197,11 @@ void _garlandConfigure() {
     float speed = getSetting(NAME_GARLAND_SPEED, 50);
     scene.setSpeed(speed);
 
-    DEBUG_MSG_P(PSTR("[GARLAND] enabled %s brightness %d speed %s\n"),
-            _garland_enabled ? "YES" : "NO", brightness, String(speed).c_str());
+    const auto fps = getSetting(NAME_GARLAND_FPS, uint16_t(GARLAND_FRAME_RATE));
+    scene.setFrameRate(fps);
+
+    DEBUG_MSG_P(PSTR("[GARLAND] enabled %s brightness %d speed %s fps %hu\n"),
+            _garland_enabled ? "YES" : "NO", brightness, String(speed).c_str(), scene.getFrameRate());
 }
 
 //------------------------------------------------------------------------------
@@ -230,7 +240,8 @@ void _garlandWebSocketOnConnected(JsonObject& root) {
 bool _garlandWebSocketOnKeyCheck(espurna::StringView key, const JsonVariant&) {
     return espurna::settings::query::samePrefix(key, NAME_GARLAND_ENABLED)
         || espurna::settings::query::samePrefix(key, NAME_GARLAND_BRIGHTNESS)
-        || espurna::settings::query::samePrefix(key, NAME_GARLAND_SPEED);
+        || espurna::settings::query::samePrefix(key, NAME_GARLAND_SPEED)
+        || espurna::settings::query::samePrefix(key, NAME_GARLAND_FPS);
 }
 
 //------------------------------------------------------------------------------
@@ -263,6 +274,108 @@ void _garlandWebSocketOnAction(uint32_t client_id, const char* action, JsonObjec
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Stats
+//------------------------------------------------------------------------------
+void _garlandStatsJson(JsonObject& root, const char* name, const StageTimings& timings) {
+    JsonObject& stage = root.createNestedObject(name);
+    stage["min"] = timings.min();
+    stage["avg"] = timings.avg();
+    stage["max"] = timings.max();
+
+    JsonArray& hist = stage.createNestedArray("hist");
+    for (size_t index = 0; index < StageTimings::Buckets; ++index) {
+        hist.add(timings.bucket(index));
+    }
+}
+
+void _garlandPublishStats(const Anim& anim) {
+    const auto& stats = anim.stats();
+
+    DynamicJsonBuffer jsonBuffer;
+    JsonObject& root = jsonBuffer.createObject();
+    root["anim"] = anim.name();
+    root["frames"] = stats.frames;
+    root["dropped"] = stats.dropped;
+    _garlandStatsJson(root, "calc", stats.calc);
+    _garlandStatsJson(root, "pixl", stats.pixl);
+    _garlandStatsJson(root, "show", stats.show);
+
+    String payload;
+    root.printTo(payload);
+    mqttSend(MQTT_TOPIC_GARLAND_STATS, payload.c_str());
+}
+
+#if TERMINAL_SUPPORT
+void _garlandPrintStats(Print& out, const char* name, const StageTimings& timings) {
+    out.printf_P(PSTR("  %s min %lu avg %lu max %lu (us) hist"),
+        name, timings.min(), timings.avg(), timings.max());
+    for (size_t index = 0; index < StageTimings::Buckets; ++index) {
+        out.printf_P(PSTR(" %lu"), timings.bucket(index));
+    }
+    out.print('\n');
+}
+
+PROGMEM_STRING(GarlandCommandStats, "GARLAND.STATS");
+
+static void _garlandCommandStats(::terminal::CommandContext&& ctx) {
+    if (ctx.argv.size() > 2) {
+        terminalError(ctx, F("GARLAND.STATS [reset]"));
+        return;
+    }
+
+    if (ctx.argv.size() == 2) {
+        if (!ctx.argv[1].equalsIgnoreCase(F("reset"))) {
+            terminalError(ctx, F("Invalid argument"));
+            return;
+        }
+
+        for (auto* anim : anims) {
+            anim->stats().reset();
+        }
+
+        terminalOK(ctx);
+        return;
+    }
+
+    ctx.output.printf_P(PSTR("leds %u fps %hu buckets (us)"),
+        scene.getLeds(), scene.getFrameRate());
+    for (size_t index = 0; index < StageTimings::Buckets; ++index) {
+        const auto limit = StageTimings::bucketLimit(index);
+        if (limit) {
+            ctx.output.printf_P(PSTR(" <%lu"), limit);
+        } else {
+            ctx.output.printf_P(PSTR(" >=%lu"), StageTimings::bucketLimit(index - 1));
+        }
+    }
+    ctx.output.print('\n');
+
+    for (const auto* anim : anims) {
+        const auto& stats = anim->stats();
+        if (!stats.frames && !stats.dropped) {
+            continue;
+        }
+
+        ctx.output.printf_P(PSTR("%s%s frames %lu dropped %lu\n"),
+            anim->name(), (anim == scene.getAnim()) ? " (active)" : "",
+            stats.frames, stats.dropped);
+        _garlandPrintStats(ctx.output, "calc", stats.calc);
+        _garlandPrintStats(ctx.output, "pixl", stats.pixl);
+        _garlandPrintStats(ctx.output, "show", stats.show);
+    }
+
+    terminalOK(ctx);
+}
+
+static constexpr ::terminal::Command GarlandCommands[] PROGMEM {
+    {GarlandCommandStats, _garlandCommandStats},
+};
+
+void _garlandCommandsSetup() {
+    espurna::terminal::add(GarlandCommands);
+}
+#endif
+
 //------------------------------------------------------------------------------
 void setupScene(Anim* new_anim, Palette* new_palette, unsigned long new_duration) {
     unsigned long currentAnimRunTime = millis() - _lastTimeUpdate;
@@ -272,9 +385,11 @@ void setupScene(Anim* new_anim, Palette* new_palette, unsigned long new_duration
     int frameRate = currentAnimRunTime > 0 ? numShows * 1000 / currentAnimRunTime : 0;
 
     static String palette_name = "Start";
-    DEBUG_MSG_P(PSTR("[GARLAND] Anim: %-10s Pal: %-8s timings: calc: %4d pixl: %3d show: %4d frate: %d\n"),
+    DEBUG_MSG_P(PSTR("[GARLAND] Anim: %-10s Pal: %-8s timings: calc: %4d pixl: %3d show: %4d frate: %d dropped: %lu\n"),
                 scene.getAnim()->name(), palette_name.c_str(),
-                scene.getAvgCalcTime(), scene.getAvgPixlTime(), scene.getAvgShowTime(), frameRate);
+                scene.getAvgCalcTime(), scene.getAvgPixlTime(), scene.getAvgShowTime(), frameRate,
+                scene.getNumDropped());
+    _garlandPublishStats(*scene.getAnim());
 
     _currentDuration = new_duration;
     palette_name = new_palette->name();
@@ -381,6 +496,13 @@ void garlandLoop(void) {
 
     scene.run();
 
+    if (millis() - _lastStatsUpdate > GARLAND_STATS_INTERVAL) {
+        _lastStatsUpdate = millis();
+        if (mqttConnected()) {
+            _garlandPublishStats(*scene.getAnim());
+        }
+    }
+
     unsigned long currentAnimRunTime = millis() - _lastTimeUpdate;
     if (currentAnimRunTime > _currentDuration && scene.finishedAnimCycle()) {
         bool scene_setup_done = false;
@@ -464,6 +586,7 @@ void garlandMqttCallback(unsigned int type, espurna::StringView topic, espurna::
 
 #define GARLAND_SCENE_TRANSITION_MS      1000    // transition time between animations, ms
 #define GARLAND_SCENE_DEFAULT_BRIGHTNESS 255
+#define GARLAND_SCENE_PAUSE_US           1000000 // frame delay considered to be a pause rather than a missed frame, us
 
 template<uint16_t Leds>
 void Scene<Leds>::setPalette(Palette* palette) {
@@ -494,85 +617,143 @@ void Scene<Leds>::setDefault() {
     this->setSpeed(GARLAND_SCENE_DEFAULT_SPEED);
 }
 
+template<uint16_t Leds>
+void Scene<Leds>::setFrameRate(uint16_t value) {
+    frameRate = std::clamp(value, uint16_t(GARLAND_SCENE_FRAME_RATE_MIN), uint16_t(GARLAND_SCENE_FRAME_RATE_MAX));
+    frameInterval = 1000000ul / frameRate;
+    DEBUG_MSG_P(PSTR("[GARLAND] new frame rate = %hu\n"), frameRate);
+}
+
+// Every stage runs in a separate loop iteration, so the rest of the loop gets some time in between.
+// Only the calculation is scheduled, pixels are prepared and shown on the next iterations right after it.
 template<uint16_t Leds>
 void Scene<Leds>::run() {
-    unsigned long iteration_start_time = micros();
-
-    if (state == Calculate || cyclesRemain < 1) {
-        // Calculate number of cycles for this animation iteration
-        float cycleSum = cycleFactor * (_anim ? _anim->getCycleFactor() : 1.0) + cycleTail;
-        cyclesRemain = cycleSum;
-        if (cyclesRemain < 1) {
-            cyclesRemain = 1;
-            cycleSum = 0;
-            cycleTail = 0;
-        } else {
-            cycleTail = cycleSum - cyclesRemain;
+    switch (state) {
+    case Calculate:
+        if (calculate()) {
+            state = Transition;
         }
+        break;
+    case Transition:
+        transition();
+        state = Show;
+        break;
+    case Show:
+        show();
+        state = Calculate;
+        break;
+    }
+}
+
+template<uint16_t Leds>
+bool Scene<Leds>::calculate() {
+    const unsigned long iteration_start_time = micros();
 
+    // Frame is not due yet, nothing to do
+    if (static_cast<long>(iteration_start_time - nextFrame) < 0) {
+        return false;
+    }
+
+    // Animation step interval, depends on both global and animation speeds
+    const unsigned long stepInterval = std::max(1ul,
+        static_cast<unsigned long>(frameInterval * cycleFactor * (_anim ? _anim->getCycleFactor() : 1.0)));
+
+    // When we are late for more than a single step, skip the missed ones and schedule from the current time.
+    // Drawing them in a burst would only make things worse for everything else running in the loop.
+    // (but, not when the scene was paused, e.g. when garland was disabled for a while)
+    const unsigned long late = iteration_start_time - nextFrame;
+    if (late >= GARLAND_SCENE_PAUSE_US) {
+        nextFrame = iteration_start_time;
+    } else if (late >= stepInterval) {
+        const unsigned long dropped = late / stepInterval;
+        numDropped += dropped;
         if (_anim) {
-            _anim->Run();
+            _anim->stats().dropped += dropped;
         }
+        nextFrame += dropped * stepInterval;
+    }
 
-        sum_calc_time += (micros() - iteration_start_time);
-        iteration_start_time = micros();
-        ++calc_num;
-        state = Transition;
-    }
-
-    if (state == Transition && cyclesRemain < 3) {
-        // transition coef, if within 0..1 - transition is active
-        // changes from 1 to 0 during transition, so we interpolate from current
-        // color to previous
-        float transc = (float)((long)transms - (long)millis()) / GARLAND_SCENE_TRANSITION_MS;
-        Color* leds_prev = (_leds == &_leds1[0]) ? &_leds2[0] : &_leds1[0];
-
-        if (transc > 0) {
-            for (int i = 0; i < Leds; i++) {
-                // transition is in progress
-                Color c = _leds[i].interpolate(leds_prev[i], transc);
-                byte r = (int)(bri_lvl[c.r]) * brightness / 256;
-                byte g = (int)(bri_lvl[c.g]) * brightness / 256;
-                byte b = (int)(bri_lvl[c.b]) * brightness / 256;
-                _pixels->setPixelColor(i, _pixels->Color(r, g, b));
-            }
-        } else {
-            for (int i = 0; i < Leds; i++) {
-                // regular operation
-                byte r = (int)(bri_lvl[_leds[i].r]) * brightness / 256;
-                byte g = (int)(bri_lvl[_leds[i].g]) * brightness / 256;
-                byte b = (int)(bri_lvl[_leds[i].b]) * brightness / 256;
-                _pixels->setPixelColor(i, _pixels->Color(r, g, b));
-            }
-        }
+    nextFrame += stepInterval;
 
-        sum_pixl_time += (micros() - iteration_start_time);
-        iteration_start_time = micros();
-        ++pixl_num;
-        state = Show;
+    if (_anim) {
+        _anim->Run();
     }
 
-    if (state == Show && cyclesRemain < 2) {
-        /* Showing pixels (actually transmitting their RGB data) is most time consuming operation in the
-        garland workflow. Using 800 kHz gives 1.25 μs per bit. -> 30 μs (0.03 ms) per RGB LED.
-        So for example 3 ms for 100 LEDs. Unfortunately it can't be postponed and resumed later as it
-        will lead to reseting the transmition operation. From other hand, long operation can cause
-        Soft WDT reset. To avoid wdt reset we need to switch soft wdt off for long strips.
-        It is not best practice, but assuming that it is only garland, it can be acceptable.
-        Tested up to 300 leds. */
-        if (Leds > NUMLEDS_CAN_CAUSE_WDT_RESET) {
-            ESP.wdtDisable();
+    const unsigned long elapsed = micros() - iteration_start_time;
+    sum_calc_time += elapsed;
+    ++calc_num;
+    if (_anim) {
+        _anim->stats().calc.add(elapsed);
+    }
+
+    return true;
+}
+
+template<uint16_t Leds>
+void Scene<Leds>::transition() {
+    const unsigned long iteration_start_time = micros();
+
+    // transition coef, if within 0..1 - transition is active
+    // changes from 1 to 0 during transition, so we interpolate from current
+    // color to previous
+    float transc = (float)((long)transms - (long)millis()) / GARLAND_SCENE_TRANSITION_MS;
+    Color* leds_prev = (_leds == &_leds1[0]) ? &_leds2[0] : &_leds1[0];
+
+    if (transc > 0) {
+        for (int i = 0; i < Leds; i++) {
+            // transition is in progress
+            Color c = _leds[i].interpolate(leds_prev[i], transc);
+            byte r = (int)(bri_lvl[c.r]) * brightness / 256;
+            byte g = (int)(bri_lvl[c.g]) * brightness / 256;
+            byte b = (int)(bri_lvl[c.b]) * brightness / 256;
+            _pixels->setPixelColor(i, _pixels->Color(r, g, b));
         }
-        _pixels->show();
-        if (Leds > NUMLEDS_CAN_CAUSE_WDT_RESET) {
-            ESP.wdtEnable(5000);
+    } else {
+        for (int i = 0; i < Leds; i++) {
+            // regular operation
+            byte r = (int)(bri_lvl[_leds[i].r]) * brightness / 256;
+            byte g = (int)(bri_lvl[_leds[i].g]) * brightness / 256;
+            byte b = (int)(bri_lvl[_leds[i].b]) * brightness / 256;
+            _pixels->setPixelColor(i, _pixels->Color(r, g, b));
         }
-        sum_show_time += (micros() - iteration_start_time);
-        ++show_num;
-        state = Calculate;
-        ++numShows;
     }
-    --cyclesRemain;
+
+    const unsigned long elapsed = micros() - iteration_start_time;
+    sum_pixl_time += elapsed;
+    ++pixl_num;
+    if (_anim) {
+        _anim->stats().pixl.add(elapsed);
+    }
+}
+
+template<uint16_t Leds>
+void Scene<Leds>::show() {
+    const unsigned long iteration_start_time = micros();
+
+    /* Showing pixels (actually transmitting their RGB data) is most time consuming operation in the
+    garland workflow. Using 800 kHz gives 1.25 μs per bit. -> 30 μs (0.03 ms) per RGB LED.
+    So for example 3 ms for 100 LEDs. Unfortunately it can't be postponed and resumed later as it
+    will lead to reseting the transmition operation. From other hand, long operation can cause
+    Soft WDT reset. To avoid wdt reset we need to switch soft wdt off for long strips.
+    It is not best practice, but assuming that it is only garland, it can be acceptable.
+    Tested up to 300 leds. */
+    if (Leds > NUMLEDS_CAN_CAUSE_WDT_RESET) {
+        ESP.wdtDisable();
+    }
+    _pixels->show();
+    if (Leds > NUMLEDS_CAN_CAUSE_WDT_RESET) {
+        ESP.wdtEnable(5000);
+    }
+
+    const unsigned long elapsed = micros() - iteration_start_time;
+    sum_show_time += elapsed;
+    ++show_num;
+    if (_anim) {
+        _anim->stats().show.add(elapsed);
+        ++_anim->stats().frames;
+    }
+
+    ++numShows;
 }
 
 template<uint16_t Leds>
@@ -600,6 +781,9 @@ void Scene<Leds>::setup() {
     pixl_num = 0;
     show_num = 0;
     numShows = 0;
+    numDropped = 0;
+    nextFrame = micros();
+    state = Calculate;
 
     if (!setUpOnPalChange) {
         setupImpl();
@@ -735,7 +919,11 @@ void garlandSetup() {
         .onAction(_garlandWebSocketOnAction);
 #endif
 
-    espurnaRegisterLoop(garlandLoop);
+#if TERMINAL_SUPPORT
+    _garlandCommandsSetup();
+#endif
+
+    espurnaRegisterLoop(garlandLoop, STRING_VIEW("garland"));
     espurnaRegisterReload(_garlandReload);
 
     pixels.begin();
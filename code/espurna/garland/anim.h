@@ -8,6 +8,7 @@ Inspired by https://github.com/Vasil-Pahomov/ArWs2812 (currently https://github.
 #pragma once
 
 #include "color.h"
+#include "stats.h"
 
 #define BRA_AMP_SHIFT          1    // brigthness animation amplitude shift. true BrA amplitude is calculated
                                     // as (0..127) value shifted right by this amount
@@ -25,6 +26,10 @@ public:
     virtual void setCycleFactor(float new_cycle_factor) { cycleFactor = new_cycle_factor; }
     virtual float getCycleFactor() { return cycleFactor; }
 
+    // frame costs are tracked per animation, so it is possible to tell which one fits into the loop budget
+    AnimStats& stats() { return _stats; }
+    const AnimStats& stats() const { return _stats; }
+
 protected:
     uint16_t    numLeds     = 0;
     Palette*    palette     = nullptr;
@@ -79,6 +84,7 @@ protected:
 
 private:
     const char* _name;
+    AnimStats   _stats;
 };
 
 bool fiftyFifty();
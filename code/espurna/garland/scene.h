@@ -27,6 +27,8 @@ Inspired by https://github.com/Vasil-Pahomov/ArWs2812 (currently https://github.
 #define GARLAND_SCENE_SPEED_MAX          70
 #define GARLAND_SCENE_SPEED_FACTOR       10
 #define GARLAND_SCENE_DEFAULT_SPEED      40
+#define GARLAND_SCENE_FRAME_RATE_MIN     1
+#define GARLAND_SCENE_FRAME_RATE_MAX     200
 
 template <uint16_t Leds>
 class Scene {
@@ -39,6 +41,8 @@ public:
     unsigned long getAvgPixlTime() { return pixl_num > 0 ? sum_pixl_time / pixl_num : 0; }
     unsigned long getAvgShowTime() { return show_num > 0 ? sum_show_time / show_num : 0; }
     int getNumShows() { return numShows; }
+    unsigned long getNumDropped() { return numDropped; }
+    uint16_t getFrameRate() { return frameRate; }
     byte getBrightness() { return brightness; }
     byte getSpeed() { return speed; }
     float getCycleFactor(byte speed) { return (float)(GARLAND_SCENE_SPEED_MAX - speed) / GARLAND_SCENE_SPEED_FACTOR; }
@@ -50,6 +54,7 @@ public:
     void setPals(Palette* palettes, size_t palsNum) { _pals = palettes; _palsNum = palsNum; }
     void setBrightness(byte value);
     void setSpeed(byte speed);
+    void setFrameRate(uint16_t value);
     void setDefault();
     void run();
     void setup();
@@ -76,9 +81,8 @@ private:
 
     byte               brightness = 0;
 
-    // cycleFactor is actually number of cycles to calculate and draw one animation step
-    // if cycleFactor is 2 or more, than calculation and drawing made in different cycles
-    // cycleFactor is float. For example cycleFactor=2.5 gives one step 2 than next 3 cycles per anim step
+    // cycleFactor is actually number of frames to calculate and draw one animation step
+    // cycleFactor is float. For example cycleFactor=2.5 gives one step every 2.5 frame intervals
     // Recommended values: 1 < cycleFactor < 4
     float              cycleFactor = getCycleFactor(GARLAND_SCENE_DEFAULT_SPEED);
     // speed is reverse to cycleFactor. For forward direction control of animation speed.
@@ -87,16 +91,28 @@ private:
     //   speed=60, cycleFactor=1
     //   speed=30, cycleFactor=4
     byte               speed = GARLAND_SCENE_DEFAULT_SPEED;
-    float              cycleTail = 0;
-    int                cyclesRemain = 0;
 
+    // frames are scheduled using wall time instead of loop iterations.
+    // frameRate is the number of frames per second when cycleFactor=1, and the
+    // actual animation step interval is frameInterval * cycleFactor * anim cycleFactor.
+    // when loop is late for more than one step, missed steps are dropped instead of being shown in a burst
+    uint16_t           frameRate = GARLAND_FRAME_RATE;
+    unsigned long      frameInterval = 1000000ul / GARLAND_FRAME_RATE;
+    unsigned long      nextFrame = 0;
+
+    int                numShows = 0;
+    unsigned long      numDropped = 0;
+
+    // calculation, pixel preparation and show are done in separate loop iterations
     enum State {
         Calculate,
         Transition,
         Show
     }                  state = Calculate;
 
-    int                numShows = 0;
+    bool calculate();
+    void transition();
+    void show();
 
     //whether to call SetUp on palette change
     //(some animations require full transition with fade, otherwise the colors would change in a step, some not)
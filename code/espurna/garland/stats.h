@@ -0,0 +1,69 @@
+/*
+Part of the GARLAND MODULE
+Copyright (C) 2020 by Dmitry Blinov <dblinov76 at gmail dot com>
+
+Inspired by https://github.com/Vasil-Pahomov/ArWs2812 (currently https://github.com/Vasil-Pahomov/Liana)
+*/
+
+#pragma once
+
+// Execution time histogram of a single frame stage, in microseconds.
+// Buckets are power-of-two sized, starting at 256us: [0,256), [256,512), ..., [16384,inf)
+class StageTimings {
+public:
+    static constexpr size_t Buckets = 8;
+    static constexpr unsigned long BucketShift = 8;
+
+    void add(unsigned long value) {
+        ++_count;
+        _sum += value;
+        if (value < _min) {
+            _min = value;
+        }
+        if (value > _max) {
+            _max = value;
+        }
+
+        size_t bucket = 0;
+        for (unsigned long tmp = value >> BucketShift; tmp && (bucket < (Buckets - 1)); tmp >>= 1) {
+            ++bucket;
+        }
+
+        ++_buckets[bucket];
+    }
+
+    void reset() {
+        *this = StageTimings();
+    }
+
+    unsigned long count() const { return _count; }
+    unsigned long min() const { return _count ? _min : 0; }
+    unsigned long max() const { return _max; }
+    unsigned long avg() const { return _count ? (_sum / _count) : 0; }
+    unsigned long bucket(size_t index) const { return _buckets[index]; }
+
+    // upper boundary of the bucket, 0 when it is unbounded
+    static constexpr unsigned long bucketLimit(size_t index) {
+        return (index < (Buckets - 1)) ? (1ul << (BucketShift + index)) : 0;
+    }
+
+private:
+    std::array<unsigned long, Buckets> _buckets{};
+    unsigned long long _sum = 0;
+    unsigned long _count = 0;
+    unsigned long _min = ULONG_MAX;
+    unsigned long _max = 0;
+};
+
+// Accumulated per-animation cost, kept for the whole uptime (or until reset)
+struct AnimStats {
+    StageTimings calc;
+    StageTimings pixl;
+    StageTimings show;
+    unsigned long frames = 0;
+    unsigned long dropped = 0;
+
+    void reset() {
+        *this = AnimStats();
+    }
+};
@@ -23,8 +23,10 @@ Copyright (C) 2019-2022 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 
 #include <ArduinoJson.h>
 
+#include <algorithm>
 #include <forward_list>
 #include <memory>
+#include <vector>
 
 namespace espurna {
 namespace homeassistant {
@@ -46,6 +48,10 @@ constexpr bool retain() {
     return 1 == HOMEASSISTANT_RETAIN;
 }
 
+constexpr size_t inflight() {
+    return HOMEASSISTANT_DISCOVERY_INFLIGHT;
+}
+
 } // namespace build
 
 namespace settings {
@@ -139,128 +145,182 @@ BuildStrings make_build_strings() {
     return out;
 }
 
-class Device {
+// Discovery payloads are flat objects with a couple of nested values and arrays.
+// Instead of building the JsonObject tree first, write them directly into the output string.
+// Keys are expected to be plain ascii and are never escaped, values always are.
+class Payload {
 public:
-    // XXX: take care when adding / removing keys and values below
-    // - `const char*` is copied by pointer value, persistent pointers make sure
-    //   it is valid for the duration of this objects lifetime
-    // - `F(...)` aka `__FlashStringHelpe` **will take more space**
-    //   it is **copied inside of the buffer**, and will take `strlen()` bytes
-    // - allocating more objects **will silently corrupt** buffer region
-    //   while there are *some* checks, current version is going to break
-    static constexpr size_t BufferSize { JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(6) };
-
-    using Buffer = StaticJsonBuffer<BufferSize>;
-    using BufferPtr = std::unique_ptr<Buffer>;
-
-    Device() = delete;
-
-    Device(const Device&) = delete;
-    Device& operator=(const Device&) = delete;
-
-    Device(Device&&) = delete;
-    Device& operator=(Device&&) = delete;
-
-    Device(ConfigStrings config, BuildStrings build) :
-        _config(std::make_unique<ConfigStrings>(std::move(config))),
-        _build(std::make_unique<BuildStrings>(std::move(build))),
-        _buffer(std::make_unique<Buffer>()),
-        _root(_buffer->createObject())
+    Payload() = delete;
+
+    explicit Payload(String& out) :
+        _out(out)
     {
-        _root["name"] = _config->name.c_str();
+        // keeps the allocated buffer, previous payload is likely of a similar size
+        _out = "";
+        _out += '{';
+    }
 
-        auto& ids = _root.createNestedArray("ids");
-        ids.add(_config->identifier.c_str());
+    // value is expected to already be a valid json
+    Payload& raw(StringView key, StringView value) {
+        _key(key);
+        _out.concat(value.c_str(), value.length());
+        return *this;
+    }
 
-        _root["sw"] = _build->version.c_str();
-        _root["mf"] = _build->manufacturer.c_str();
-        _root["mdl"] = _build->device.c_str();
+    Payload& string(StringView key, StringView value) {
+        _key(key);
+        _string(value);
+        return *this;
     }
 
-    const String& name() const {
-        return _config->name;
+    Payload& number(StringView key, long value) {
+        _key(key);
+
+        char buffer[16];
+        snprintf_P(buffer, sizeof(buffer), PSTR("%ld"), value);
+        _out += buffer;
+
+        return *this;
     }
 
-    const String& prefix() const {
-        return _config->prefix;
+    Payload& boolean(StringView key, bool value) {
+        _key(key);
+
+        const auto out = value
+            ? STRING_VIEW("true")
+            : STRING_VIEW("false");
+        _out.concat(out.c_str(), out.length());
+
+        return *this;
     }
 
-    const String& identifier() const {
-        return _config->identifier;
+    Payload& array(StringView key) {
+        _key(key);
+        _out += '[';
+        _first = true;
+        return *this;
+    }
+
+    Payload& item(StringView value) {
+        _comma();
+        _string(value);
+        return *this;
     }
 
-    JsonObject& root() {
-        return _root;
+    Payload& close() {
+        _out += ']';
+        _first = false;
+        return *this;
+    }
+
+    const String& finish() {
+        _out += '}';
+        return _out;
     }
 
 private:
-    using ConfigStringsPtr = std::unique_ptr<ConfigStrings>;
-    ConfigStringsPtr _config;
+    void _comma() {
+        if (!_first) {
+            _out += ',';
+        }
+
+        _first = false;
+    }
+
+    void _key(StringView key) {
+        _comma();
+        _out += '"';
+        _out.concat(key.c_str(), key.length());
+        _out += '"';
+        _out += ':';
+    }
+
+    // value may be located in flash, only read it with pgm_read_byte
+    void _string(StringView value) {
+        _out += '"';
+
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            const auto c = static_cast<char>(pgm_read_byte(it));
+            switch (c) {
+            case '"':
+            case '\\':
+                _out += '\\';
+                _out += c;
+                break;
+            default:
+                if (static_cast<uint8_t>(c) < 0x20) {
+                    char buffer[7];
+                    snprintf_P(buffer, sizeof(buffer), PSTR("\\u%04x"), static_cast<uint8_t>(c));
+                    _out += buffer;
+                    break;
+                }
+                _out += c;
+                break;
+            }
+        }
 
-    using BuildStringsPtr = std::unique_ptr<BuildStrings>;
-    BuildStringsPtr _build;
+        _out += '"';
+    }
 
-    BufferPtr _buffer;
-    JsonObject& _root;
+    String& _out;
+    bool _first { true };
 };
 
-using DevicePtr = std::unique_ptr<Device>;
-using JsonBufferPtr = std::unique_ptr<DynamicJsonBuffer>;
+// Device object is the same for every entity, only render it once per discovery
+String make_device_json(const ConfigStrings& config, const BuildStrings& build) {
+    String out;
+
+    Payload(out)
+        .string(STRING_VIEW("name"), config.name)
+        .array(STRING_VIEW("ids"))
+            .item(config.identifier)
+            .close()
+        .string(STRING_VIEW("sw"), build.version)
+        .string(STRING_VIEW("mf"), build.manufacturer)
+        .string(STRING_VIEW("mdl"), build.device)
+        .finish();
+
+    return out;
+}
 
 class Context {
 public:
+    // most of the payloads fit, light one might need to grow it once
+    static constexpr size_t MessageSize { 512 };
+
     Context() = delete;
-    Context(DevicePtr device, size_t capacity) :
-        _device(std::move(device)),
-        _capacity(capacity)
-    {}
+    Context(ConfigStrings config, BuildStrings build) :
+        _config(std::move(config)),
+        _device(make_device_json(_config, build))
+    {
+        _message.reserve(MessageSize);
+    }
 
     const String& name() const {
-        return _device->name();
+        return _config.name;
     }
 
     const String& prefix() const {
-        return _device->prefix();
+        return _config.prefix;
     }
 
     const String& identifier() const {
-        return _device->identifier();
-    }
-
-    JsonObject& device() {
-        return _device->root();
-    }
-
-    void reset() {
-        _json = std::make_unique<DynamicJsonBuffer>(_capacity);
-    }
-
-    size_t capacity() const {
-        return _capacity;
+        return _config.identifier;
     }
 
-    size_t size() {
-        if (_json) {
-            return _json->size();
-        }
-
-        return 0;
+    StringView device() const {
+        return _device;
     }
 
-    JsonObject& makeObject() {
-        if (!_json) {
-            reset();
-        }
-
-        return _json->createObject();
+    // every entity shares the same output buffer, previous payload is overwritten
+    Payload payload() {
+        return Payload(_message);
     }
 
 private:
-    String _prefix;
-    DevicePtr _device;
-
-    JsonBufferPtr _json { nullptr };
-    size_t _capacity { 0ul };
+    ConfigStrings _config;
+    String _device;
+    String _message;
 };
 
 String quote(String&& value) {
@@ -286,12 +346,10 @@ String quote(String&& value) {
 
 // - Discovery object is expected to accept Context reference as input
 //   (and all implementations do just that)
-// - topic() & message() return refs, since those *may* be called multiple times before advancing to the next 'entity'
+// - topic() returns a ref, since it *may* be called multiple times before advancing to the next 'entity'
+// - message() is written into the shared Context buffer. It is only valid until the next message() call,
+//   from this or any other Discovery object
 // - We use short-hand names right away, since we don't expect this to be used to generate yaml
-// - In case the object uses the JSON makeObject() as state, make sure we don't use it (state)
-//   and the object itself after next() or ok() return false
-// - Make sure JSON state is not created on construction, but lazy-loaded as soon as it is needed.
-//   Meaning, we don't cause invalid refs immediatly when there are more than 1 discovery object present and we reset the storage.
 
 class Discovery {
 public:
@@ -332,14 +390,6 @@ public:
         _relays(relayCount())
     {}
 
-    JsonObject& root() {
-        if (!_root) {
-            _root = &_ctx.makeObject();
-        }
-
-        return *_root;
-    }
-
     bool ok() const override {
         return (_relays > 0)
             && (_index < _relays);
@@ -363,21 +413,18 @@ public:
     }
 
     const String& message() override {
-        if (!_message.length()) {
-            auto& json = root();
-            json[F("dev")] = _ctx.device();
-            json[F("avty_t")] = _relay.availability.c_str();
-            json[F("pl_avail")] = _relay.payload_available.c_str();
-            json[F("pl_not_avail")] = _relay.payload_not_available.c_str();
-            json[F("pl_on")] = _relay.payload_on.c_str();
-            json[F("pl_off")] = _relay.payload_off.c_str();
-            json[F("uniq_id")] = uniqueId();
-            json[F("name")] = _ctx.name() + ' ' + _index;
-            json[F("stat_t")] = mqttTopic(MQTT_TOPIC_RELAY, _index);
-            json[F("cmd_t")] = mqttTopicSetter(MQTT_TOPIC_RELAY, _index);
-            json.printTo(_message);
-        }
-        return _message;
+        return _ctx.payload()
+            .raw(STRING_VIEW("dev"), _ctx.device())
+            .string(STRING_VIEW("avty_t"), _relay.availability)
+            .string(STRING_VIEW("pl_avail"), _relay.payload_available)
+            .string(STRING_VIEW("pl_not_avail"), _relay.payload_not_available)
+            .string(STRING_VIEW("pl_on"), _relay.payload_on)
+            .string(STRING_VIEW("pl_off"), _relay.payload_off)
+            .string(STRING_VIEW("uniq_id"), uniqueId())
+            .string(STRING_VIEW("name"), _ctx.name() + ' ' + _index)
+            .string(STRING_VIEW("stat_t"), mqttTopic(MQTT_TOPIC_RELAY, _index))
+            .string(STRING_VIEW("cmd_t"), mqttTopicSetter(MQTT_TOPIC_RELAY, _index))
+            .finish();
     }
 
     bool next() override {
@@ -387,7 +434,6 @@ public:
             if ((_index > current) && (_index < _relays)) {
                 _unique_id = "";
                 _topic = "";
-                _message = "";
                 return true;
             }
         }
@@ -397,7 +443,6 @@ public:
 
 private:
     Context& _ctx;
-    JsonObject* _root { nullptr };
 
     RelayContext _relay;
     unsigned char _index { 0u };
@@ -405,7 +450,6 @@ private:
 
     String _unique_id;
     String _topic;
-    String _message;
 };
 
 #endif
@@ -436,14 +480,6 @@ public:
         _ctx(ctx)
     {}
 
-    JsonObject& root() {
-        if (!_root) {
-            _root = &_ctx.makeObject();
-        }
-
-        return *_root;
-    }
-
     bool ok() const override {
         return true;
     }
@@ -472,80 +508,86 @@ public:
     }
 
     const String& message() override {
-        if (!_message.length()) {
-            auto& json = root();
-
-            json[F("schema")] = "json";
-            json[F("uniq_id")] = uniqueId();
-
-            json[F("name")] = _ctx.name() + ' ' + F("Light");
-
-            json[F("stat_t")] = mqttTopic(Topic);
-            json[F("cmd_t")] = mqttTopicSetter(Topic);
-
-            json[F("avty_t")] = mqttTopic(MQTT_TOPIC_STATUS);
-            json[F("pl_avail")] = quote(mqttPayloadStatus(true));
-            json[F("pl_not_avail")] = quote(mqttPayloadStatus(false));
-
-            // Note that since we send back the values immediately, HS mode sliders
-            // *will jump*, as calculations of input do not always match the output.
-            // (especially, when gamma table is used, as we modify the results)
-            // In case or RGB, channel values input is expected to match the output exactly.
-
-            // Since 2022.9.x we have a different payload setup
-            // - https://github.com/xoseperez/espurna/issues/2539
-            // - https://github.com/home-assistant/core/blob/2022.9.7/homeassistant/components/mqtt/light/schema_json.py
-            // * ignore 'onoff' and 'brightness'
-            //   both described as 'Must be the only supported mode'
-            // * 'hs' is always supported, but HA UI depends on our setting and
-            //   what gets sent in the json payload
-            // * 'c' and 'w' mean different things depending on *our* context
-            //   'rgbw' - we receive and map to 'w' to our 'warm'
-            //   'rgbww' - we receive and map 'c' to our 'cold' and 'w' to our 'warm'
-            //   'cw' / 'ww' without 'rgb' are not supported; see 'brightness' or 'color_temp'
-            json["brightness"] = true;
-            json["color_mode"] = true;
-            JsonArray& modes = json.createNestedArray("supported_color_modes");
-
-            if (lightHasColor()) {
-                modes.add("hs");
-                modes.add("rgb");
-                if (lightHasWarmWhite() && lightHasColdWhite()) {
-                    modes.add("rgbww");
-                } else if (lightHasWarmWhite()) {
-                    modes.add("rgbw");
-                }
+        auto payload = _ctx.payload();
+
+        payload
+            .string(STRING_VIEW("schema"), STRING_VIEW("json"))
+            .string(STRING_VIEW("uniq_id"), uniqueId())
+            .string(STRING_VIEW("name"), _ctx.name() + ' ' + F("Light"))
+            .string(STRING_VIEW("stat_t"), mqttTopic(Topic))
+            .string(STRING_VIEW("cmd_t"), mqttTopicSetter(Topic))
+            .string(STRING_VIEW("avty_t"), mqttTopic(MQTT_TOPIC_STATUS))
+            .string(STRING_VIEW("pl_avail"), quote(mqttPayloadStatus(true)))
+            .string(STRING_VIEW("pl_not_avail"), quote(mqttPayloadStatus(false)));
+
+        // Note that since we send back the values immediately, HS mode sliders
+        // *will jump*, as calculations of input do not always match the output.
+        // (especially, when gamma table is used, as we modify the results)
+        // In case or RGB, channel values input is expected to match the output exactly.
+
+        // Since 2022.9.x we have a different payload setup
+        // - https://github.com/xoseperez/espurna/issues/2539
+        // - https://github.com/home-assistant/core/blob/2022.9.7/homeassistant/components/mqtt/light/schema_json.py
+        // * ignore 'onoff' and 'brightness'
+        //   both described as 'Must be the only supported mode'
+        // * 'hs' is always supported, but HA UI depends on our setting and
+        //   what gets sent in the json payload
+        // * 'c' and 'w' mean different things depending on *our* context
+        //   'rgbw' - we receive and map to 'w' to our 'warm'
+        //   'rgbww' - we receive and map 'c' to our 'cold' and 'w' to our 'warm'
+        //   'cw' / 'ww' without 'rgb' are not supported; see 'brightness' or 'color_temp'
+        payload
+            .boolean(STRING_VIEW("brightness"), true)
+            .boolean(STRING_VIEW("color_mode"), true)
+            .array(STRING_VIEW("supported_color_modes"));
+
+        bool modes { false };
+
+        if (lightHasColor()) {
+            payload
+                .item(STRING_VIEW("hs"))
+                .item(STRING_VIEW("rgb"));
+            if (lightHasWarmWhite() && lightHasColdWhite()) {
+                payload.item(STRING_VIEW("rgbww"));
+            } else if (lightHasWarmWhite()) {
+                payload.item(STRING_VIEW("rgbw"));
             }
+            modes = true;
+        }
 
-            // Mired is only an input, we never send this value back
-            // (...besides the internally pinned value, ref. MQTT_TOPIC_MIRED. not used here though)
-            // - in RGB mode, we convert the temperature into a specific color
-            // - in CCT mode, white channels are used
-            if (lightHasColor() || lightHasWhite()) {
-                const auto range = lightMiredsRange();
-                json["min_mirs"] = range.cold();
-                json["max_mirs"] = range.warm();
-                modes.add("color_temp");
-                modes.add("white");
-            }
+        // Mired is only an input, we never send this value back
+        // (...besides the internally pinned value, ref. MQTT_TOPIC_MIRED. not used here though)
+        // - in RGB mode, we convert the temperature into a specific color
+        // - in CCT mode, white channels are used
+        const bool mireds = lightHasColor() || lightHasWhite();
+        if (mireds) {
+            payload
+                .item(STRING_VIEW("color_temp"))
+                .item(STRING_VIEW("white"));
+            modes = true;
+        }
 
-            if (!modes.size()) {
-                modes.add("brightness");
-            }
+        if (!modes) {
+            payload.item(STRING_VIEW("brightness"));
+        }
 
-            json.printTo(_message);
+        payload.close();
+
+        if (mireds) {
+            const auto range = lightMiredsRange();
+            payload
+                .number(STRING_VIEW("min_mirs"), range.cold())
+                .number(STRING_VIEW("max_mirs"), range.warm());
         }
 
-        return _message;
+        return payload.finish();
     }
 
 private:
     Context& _ctx;
-    JsonObject* _root { nullptr };
 
     String _unique_id;
     String _topic;
-    String _message;
 };
 
 void heartbeat_rgb(JsonObject& root, JsonObject& color) {
@@ -699,14 +741,6 @@ public:
         }
     }
 
-    JsonObject& root() {
-        if (!_root) {
-            _root = &_ctx.makeObject();
-        }
-
-        return *_root;
-    }
-
     bool ok() const override {
         return (_magnitudes > 0)
             && (_index < _magnitudes);
@@ -724,19 +758,13 @@ public:
     }
 
     const String& message() override {
-        if (!_message.length()) {
-            auto& json = root();
-            json[F("dev")] = _ctx.device();
-            json[F("uniq_id")] = uniqueId();
-
-            json[F("name")] = _ctx.name() + ' ' + name() + ' ' + localId();
-            json[F("stat_t")] = mqttTopic(_info.topic);
-            json[F("unit_of_meas")] = magnitudeUnitsName(_info.units);
-
-            json.printTo(_message);
-        }
-
-        return _message;
+        return _ctx.payload()
+            .raw(STRING_VIEW("dev"), _ctx.device())
+            .string(STRING_VIEW("uniq_id"), uniqueId())
+            .string(STRING_VIEW("name"), _ctx.name() + ' ' + name() + ' ' + localId())
+            .string(STRING_VIEW("stat_t"), mqttTopic(_info.topic))
+            .string(STRING_VIEW("unit_of_meas"), magnitudeUnitsName(_info.units))
+            .finish();
     }
 
     const String& name() {
@@ -768,7 +796,6 @@ public:
                 _unique_id = "";
                 _name = "";
                 _topic = "";
-                _message = "";
                 return true;
             }
         }
@@ -778,7 +805,6 @@ public:
 
 private:
     Context& _ctx;
-    JsonObject* _root { nullptr };
 
     unsigned char _magnitudes { 0u };
     unsigned char _index { 0u };
@@ -787,23 +813,36 @@ private:
     String _unique_id;
     String _name;
     String _topic;
-    String _message;
 };
 
 #endif
 
-DevicePtr make_device_ptr() {
-    return std::make_unique<Device>(
+Context make_context() {
+    return Context(
         make_config_strings(),
         make_build_strings());
 }
 
-Context make_context() {
-    return Context(make_device_ptr(), 2048);
+// Entity config digest, FNV-1a of both the topic and the message (both are expected to be in RAM)
+constexpr uint32_t DigestBasis { 2166136261ul };
+constexpr uint32_t DigestPrime { 16777619ul };
+
+uint32_t digest(uint32_t hash, StringView value) {
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        hash = (hash ^ static_cast<uint8_t>(*it)) * DigestPrime;
+    }
+
+    return hash;
 }
 
-// Reworked discovery class. Try to send and wait for MQTT QoS 1 publish ACK to continue.
-// Topic and message are generated on demand and most of JSON payload is cached for re-use to save RAM.
+uint32_t digest(StringView topic, StringView message) {
+    return digest(digest(DigestBasis, topic), message);
+}
+
+using Digests = std::vector<uint32_t>;
+
+// Reworked discovery class. Topic and message are generated on demand, one entity at a time.
+// Entities that were already published with the exact same config (and retained by the broker) are skipped.
 class DiscoveryTask {
 public:
     using Entity = std::unique_ptr<Discovery>;
@@ -821,8 +860,9 @@ public:
     DiscoveryTask(DiscoveryTask&&) = delete;
     DiscoveryTask& operator=(DiscoveryTask&&) = delete;
 
-    DiscoveryTask(Context ctx, bool enabled) :
+    DiscoveryTask(Context ctx, bool enabled, const Digests* published) :
         _enabled(enabled),
+        _published(published),
         _ctx(std::move(ctx))
     {}
 
@@ -851,49 +891,72 @@ public:
         return _entities.empty();
     }
 
-    bool ok() const {
-        if ((_retry > 0) && !_entities.empty()) {
-            auto& entity = _entities.front();
-            return entity->ok();
-        }
+    size_t sent() const {
+        return _sent;
+    }
 
-        return false;
+    size_t skipped() const {
+        return _skipped;
     }
 
+    // sorted, ready to be used as `published` for the next task
+    Digests digests() {
+        std::sort(_digests.begin(), _digests.end());
+        return std::move(_digests);
+    }
+
+    // Advances to the next entity, either publishing it via `action(topic, message)` or skipping it when unchanged.
+    // Returns `false` only when `action` fails, entity is not advanced in that case
     template <typename T>
     bool send(T&& action) {
         while (!_entities.empty()) {
             auto& entity = _entities.front();
             if (!entity->ok()) {
                 _entities.pop_front();
-                _ctx.reset();
                 continue;
             }
 
-            const auto* topic = entity->topic().c_str();
-            const auto* msg = _enabled
-                ? entity->message().c_str()
-                : "";
+            const auto& topic = entity->topic();
+            const StringView message = _enabled
+                ? StringView(entity->message())
+                : StringView("");
+
+            const auto current = digest(topic, message);
+            if (_unchanged(current)) {
+                ++_skipped;
+            } else if (action(topic.c_str(), message.c_str())) {
+                ++_sent;
+                _retry = Retries;
+            } else {
+                return false;
+            }
 
-            if (action(topic, msg)) {
-                if (!entity->next()) {
-                    _retry = Retries;
-                    _entities.pop_front();
-                    _ctx.reset();
-                }
-                return true;
+            _digests.push_back(current);
+            if (!entity->next()) {
+                _entities.pop_front();
             }
 
-            return false;
+            return true;
         }
 
-        return false;
+        return true;
     }
 
 private:
+    bool _unchanged(uint32_t value) const {
+        return _published
+            && std::binary_search(_published->begin(), _published->end(), value);
+    }
+
     bool _enabled { false };
     int _retry { Retries };
 
+    const Digests* _published;
+    Digests _digests;
+
+    size_t _sent { 0 };
+    size_t _skipped { 0 };
+
     Entities _entities;
     Context _ctx;
 };
@@ -904,11 +967,16 @@ constexpr duration::Milliseconds DiscoveryTask::WaitLong;
 namespace internal {
 
 using TaskPtr = std::shared_ptr<DiscoveryTask>;
-using FlagPtr = std::shared_ptr<bool>;
+
+// number of publishes waiting for the broker ack
+using InflightPtr = std::shared_ptr<size_t>;
 
 bool retain { false };
 bool enabled { false };
 
+// entities published during the last successful discovery of the current MQTT connection
+Digests published;
+
 enum class State {
     Initial,
     Pending,
@@ -918,7 +986,7 @@ enum class State {
 State state { State::Initial };
 timer::SystemTimer timer;
 
-void send(TaskPtr ptr, FlagPtr flag_ptr);
+void send(TaskPtr ptr, InflightPtr inflight_ptr);
 
 void stop(bool done) {
     timer.stop();
@@ -931,66 +999,86 @@ void stop(bool done) {
     }
 }
 
-void schedule(duration::Milliseconds wait, TaskPtr ptr, FlagPtr flag_ptr) {
+void finish(DiscoveryTask& task) {
+    DEBUG_MSG_P(PSTR("[HA] Discovery sent %u, unchanged %u\n"),
+        task.sent(), task.skipped());
+
+    // skipping is only safe when the broker has the previous config
+    if (retain) {
+        published = task.digests();
+    }
+
+    stop(true);
+}
+
+void schedule(duration::Milliseconds wait, TaskPtr ptr, InflightPtr inflight_ptr) {
     timer.schedule_once(
         wait,
-        [ptr, flag_ptr]() {
-            send(ptr, flag_ptr);
+        [ptr, inflight_ptr]() {
+            send(ptr, inflight_ptr);
         });
 }
 
-void schedule(TaskPtr ptr, FlagPtr flag_ptr) {
-    schedule(DiscoveryTask::WaitShort, ptr, flag_ptr);
+void schedule(TaskPtr ptr, InflightPtr inflight_ptr) {
+    schedule(DiscoveryTask::WaitShort, ptr, inflight_ptr);
 }
 
 void schedule(TaskPtr ptr) {
-    schedule(DiscoveryTask::WaitShort, ptr, std::make_shared<bool>(true));
+    schedule(DiscoveryTask::WaitShort, ptr, std::make_shared<size_t>(0));
 }
 
-void send(TaskPtr ptr, FlagPtr flag_ptr) {
+// Instead of waiting for every ack, keep up to `build::inflight()` publishes in flight.
+void send(TaskPtr ptr, InflightPtr inflight_ptr) {
     auto& task = *ptr;
-    if (!mqttConnected() || task.done()) {
+    if (!mqttConnected()) {
         stop(true);
         return;
     }
 
-    auto& flag = *flag_ptr;
-    if (!flag) {
+    auto& inflight = *inflight_ptr;
+    if (task.done() && !inflight) {
+        finish(task);
+        return;
+    }
+
+    if (task.done() || (inflight >= build::inflight())) {
         if (task.retry()) {
-            schedule(ptr, flag_ptr);
+            schedule(ptr, inflight_ptr);
         } else {
             stop(false);
         }
         return;
     }
 
-    uint16_t pid { 0u };
-    auto res = task.send([&](const char* topic, const char* message) {
-        pid = ::mqttSendRaw(topic, message, internal::retain, 1);
-        return pid > 0;
-    });
+    bool res { true };
+    while (res && !task.done() && (inflight < build::inflight())) {
+        uint16_t pid { 0u };
+        res = task.send([&](const char* topic, const char* message) {
+            pid = ::mqttSendRaw(topic, message, internal::retain, 1);
+            return pid > 0;
+        });
 
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
-    // - async fails when disconneted and when it's buffers are filled, which should be resolved after $LATENCY
-    // and the time it takes for the lwip to process it. future versions use queue, but could still fail when low on RAM
-    // - lwmqtt will fail when disconnected (already checked above) and *will* disconnect in case publish fails.
-    // ::publish() will wait for the puback, so we don't have to do it ourselves. not tested.
-    // - pubsub will fail when it can't buffer the payload *or* the underlying WiFiClient calls fail. also not tested.
-
-    if (res) {
-        flag = false;
-        mqttOnPublish(pid, [flag_ptr]() {
-            (*flag_ptr) = true;
-        });
-    }
+        // - async fails when disconneted and when it's buffers are filled, which should be resolved after $LATENCY
+        // and the time it takes for the lwip to process it. future versions use queue, but could still fail when low on RAM
+        // - lwmqtt will fail when disconnected (already checked above) and *will* disconnect in case publish fails.
+        // ::publish() will wait for the puback, so we don't have to do it ourselves. not tested.
+        // - pubsub will fail when it can't buffer the payload *or* the underlying WiFiClient calls fail. also not tested.
+        if (res && pid) {
+            ++inflight;
+            mqttOnPublish(pid, [inflight_ptr]() {
+                --(*inflight_ptr);
+            });
+        }
 #endif
+    }
 
     auto wait = res
         ? DiscoveryTask::WaitShort
         : DiscoveryTask::WaitLong;
 
     if (res || task.retry()) {
-        schedule(wait, ptr, flag_ptr);
+        schedule(wait, ptr, inflight_ptr);
         return;
     }
 
@@ -1005,7 +1093,8 @@ void publishDiscovery() {
     }
 
     auto task = std::make_shared<DiscoveryTask>(
-        make_context(), internal::enabled);
+        make_context(), internal::enabled,
+        internal::retain ? &internal::published : nullptr);
 
 #if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
     task->add<LightDiscovery>();
@@ -1028,7 +1117,13 @@ void publishDiscovery() {
 void configure() {
     bool current = internal::enabled;
     internal::enabled = settings::enabled();
-    internal::retain = settings::retain();
+
+    // whatever was published before may no longer be on the broker
+    const bool retain = settings::retain();
+    if (internal::retain != retain) {
+        internal::published.clear();
+    }
+    internal::retain = retain;
 
     if (internal::enabled != current) {
         internal::state = internal::State::Pending;
@@ -1043,6 +1138,9 @@ void mqttCallback(unsigned int type, StringView topic, StringView payload) {
             internal::state = internal::State::Pending;
         }
         internal::timer.stop();
+
+        // broker may not be the same one after reconnecting, or it may have lost the retained messages
+        internal::published.clear();
         return;
     }
 
@@ -1095,6 +1193,7 @@ namespace terminal {
 PROGMEM_STRING(Send, "HA.SEND");
 
 void send(::terminal::CommandContext&& ctx) {
+    internal::published.clear();
     internal::state = internal::State::Pending;
     publishDiscovery();
     terminalOK(ctx);
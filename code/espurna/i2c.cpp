@@ -128,7 +128,7 @@ unsigned long sclFrequency() {
 // - 3 if NACK happened when writing data
 bool find(uint8_t address) {
 #if I2C_USE_BRZO
-    i2c::start_brzo_transaction(address);
+    brzo_i2c_start_transaction(address);
     brzo_i2c_ACK_polling(1000);
     return 0 == brzo_i2c_end_transaction();
 #else
@@ -196,6 +196,115 @@ void bootScan() {
     }
 }
 
+namespace stats {
+
+struct Bus {
+    uint32_t transactions { 0 };
+    uint32_t errors { 0 };
+    uint32_t bytes { 0 };
+    duration::Microseconds busy{};
+};
+
+Bus bus;
+
+} // namespace stats
+
+// every bus transaction made through the API below is accounted for in the stats.
+// address probing is not, as NACKs from the missing devices are expected there
+template <typename T>
+uint8_t measure(size_t bytes, T&& callback) {
+    const auto start = time::micros();
+    const uint8_t result = callback();
+
+    stats::bus.busy += time::micros() - start;
+    ++stats::bus.transactions;
+    stats::bus.bytes += bytes;
+    if (result) {
+        ++stats::bus.errors;
+    }
+
+    return result;
+}
+
+// in addition to the codes mentioned above, return this when less bytes than expected were received
+constexpr uint8_t ShortRead { 5 };
+
+uint8_t write(uint8_t address, const uint8_t* data, size_t size) {
+    return measure(size, [&]() -> uint8_t {
+#if I2C_USE_BRZO
+        brzo_i2c_start_transaction(address);
+        if (size) {
+            brzo_i2c_write(const_cast<uint8_t*>(data), size, false);
+        }
+        return brzo_i2c_end_transaction();
+#else
+        Wire.beginTransmission(address);
+        if (size) {
+            Wire.write(data, size);
+        }
+        return Wire.endTransmission();
+#endif
+    });
+}
+
+// write `out` (when not empty) and then read `in`. `stop` is only used by Wire, BRZO always uses repeated START
+uint8_t transfer(uint8_t address, const uint8_t* out, size_t out_size, uint8_t* in, size_t in_size, bool stop) {
+    return measure(out_size + in_size, [&]() -> uint8_t {
+#if I2C_USE_BRZO
+        (void)stop;
+        brzo_i2c_start_transaction(address);
+        if (out_size) {
+            brzo_i2c_write(const_cast<uint8_t*>(out), out_size, true);
+        }
+        if (in_size) {
+            brzo_i2c_read(in, in_size, false);
+        }
+        return brzo_i2c_end_transaction();
+#else
+        uint8_t result { 0 };
+        if (out_size) {
+            Wire.beginTransmission(address);
+            Wire.write(out, out_size);
+            result = Wire.endTransmission(stop);
+        }
+
+        if (in_size) {
+            const auto received = Wire.requestFrom(address, in_size, true);
+            for (size_t index = 0; index < in_size; ++index) {
+                in[index] = Wire.read();
+            }
+
+            if (!result && (received != in_size)) {
+                result = ShortRead;
+            }
+        }
+
+        return result;
+#endif
+    });
+}
+
+struct BusTransport : public Transport {
+    uint8_t write(uint8_t address, const uint8_t* data, size_t size) override {
+        return i2c::write(address, data, size);
+    }
+
+    uint8_t transfer(uint8_t address, const uint8_t* out, size_t out_size, uint8_t* in, size_t in_size) override {
+        return i2c::transfer(address, out, out_size, in, in_size, false);
+    }
+};
+
+namespace internal {
+
+BusTransport transport;
+Scheduler scheduler(transport);
+
+} // namespace internal
+
+void loop() {
+    internal::scheduler.tick(time::micros().time_since_epoch());
+}
+
 int clear(unsigned char sda, unsigned char scl) {
 #if defined(TWCR) && defined(TWEN)
     // Disable the Atmel 2-Wire interface so we can control the SDA and SCL pins directly
@@ -326,6 +435,33 @@ void locked(::terminal::CommandContext&& ctx) {
     terminalOK(ctx);
 }
 
+// utilization is relative to the uptime, in hundredths of a percent
+void dump(Print& out) {
+    const auto& bus = stats::bus;
+    out.printf_P(PSTR("transactions %u, errors %u, bytes %u\n"),
+        bus.transactions, bus.errors, bus.bytes);
+
+    const auto uptime = time::micros().time_since_epoch();
+    const auto utilization = uptime.count()
+        ? static_cast<uint32_t>((bus.busy.count() * 10000) / uptime.count())
+        : 0;
+    out.printf_P(PSTR("busy %u (ms), utilization %u.%02u%%\n"),
+        static_cast<uint32_t>(bus.busy.count() / 1000),
+        utilization / 100, utilization % 100);
+
+    const auto& scheduler = internal::scheduler.stats();
+    out.printf_P(PSTR("plans completed %u, failed %u, waits %u, pending %zu (max %u)\n"),
+        scheduler.completed, scheduler.failed, scheduler.waits,
+        internal::scheduler.pending(), scheduler.pending_max);
+}
+
+PROGMEM_STRING(Stats, "I2C.STATS");
+
+void stats(::terminal::CommandContext&& ctx) {
+    dump(ctx.output);
+    terminalOK(ctx);
+}
+
 PROGMEM_STRING(Scan, "I2C.SCAN");
 
 void scan(::terminal::CommandContext&& ctx) {
@@ -335,6 +471,8 @@ void scan(::terminal::CommandContext&& ctx) {
         ctx.output.printf_P(PSTR("0x%02X\n"), address);
     });
 
+    dump(ctx.output);
+
     if (devices) {
         ctx.output.printf_P(PSTR("found %zu device(s)\n"), devices);
         terminalOK(ctx);
@@ -354,6 +492,7 @@ void clear(::terminal::CommandContext&& ctx) {
 static constexpr ::terminal::Command Commands[] PROGMEM {
     {Locked, locked},
     {Scan, scan},
+    {Stats, stats},
     {Clear, clear},
 };
 
@@ -372,149 +511,71 @@ void setup() {
 // I2C API
 // ---------------------------------------------------------------------
 
-#if I2C_USE_BRZO
-
 void i2c_wakeup(uint8_t address) {
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_end_transaction();
-}
-
-uint8_t i2c_write_buffer(uint8_t address, uint8_t * buffer, size_t len) {
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_write(buffer, len, false);
-    return brzo_i2c_end_transaction();
+    espurna::i2c::write(address, nullptr, 0);
 }
 
 uint8_t i2c_write_uint8(uint8_t address, uint8_t value) {
-    uint8_t buffer[1] = {value};
-    return i2c_write_buffer(address, buffer, sizeof(buffer));
-}
-
-uint8_t i2c_read_uint8(uint8_t address) {
-    uint8_t buffer[1] = {0};
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_read(buffer, 1, false);
-    brzo_i2c_end_transaction();
-    return buffer[0];
-}
-
-uint8_t i2c_read_uint8(uint8_t address, uint8_t reg) {
-    uint8_t buffer[1] = {reg};
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_write(buffer, 1, true);
-    brzo_i2c_read(buffer, 1, false);
-    brzo_i2c_end_transaction();
-    return buffer[0];
-}
-
-uint16_t i2c_read_uint16(uint8_t address) {
-    uint8_t buffer[2] = {0, 0};
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_read(buffer, 2, false);
-    brzo_i2c_end_transaction();
-    return (buffer[0] * 256) | buffer[1];
-}
-
-uint16_t i2c_read_uint16(uint8_t address, uint8_t reg) {
-    uint8_t buffer[2] = {reg, 0};
-    i2c::brzo_i2c_start_transaction(address);
-    brzo_i2c_write(buffer, 1, true);
-    brzo_i2c_read(buffer, 2, false);
-    brzo_i2c_end_transaction();
-    return (buffer[0] * 256) | buffer[1];
-}
-
-void i2c_read_buffer(uint8_t address, uint8_t * buffer, size_t len) {
-    i2c::start_brzo_transaction(address);
-    brzo_i2c_read(buffer, len, false);
-    brzo_i2c_end_transaction();
-}
-
-#else // not I2C_USE_BRZO
-
-void i2c_wakeup(uint8_t address) {
-    Wire.beginTransmission((uint8_t) address);
-    Wire.endTransmission();
-}
-
-uint8_t i2c_write_uint8(uint8_t address, uint8_t value) {
-    Wire.beginTransmission((uint8_t) address);
-    Wire.write((uint8_t) value);
-    return Wire.endTransmission();
+    return espurna::i2c::write(address, &value, 1);
 }
 
 uint8_t i2c_write_buffer(uint8_t address, uint8_t * buffer, size_t len) {
-    Wire.beginTransmission((uint8_t) address);
-    Wire.write(buffer, len);
-    return Wire.endTransmission();
+    return espurna::i2c::write(address, buffer, len);
 }
 
 uint8_t i2c_read_uint8(uint8_t address) {
-    uint8_t value;
-    Wire.requestFrom((uint8_t) address, (uint8_t) 1);
-    value = Wire.read();
+    uint8_t value { 0 };
+    espurna::i2c::transfer(address, nullptr, 0, &value, 1, true);
     return value;
 }
 
 uint8_t i2c_read_uint8(uint8_t address, uint8_t reg) {
-    uint8_t value;
-    Wire.beginTransmission((uint8_t) address);
-    Wire.write((uint8_t) reg);
-    Wire.endTransmission();
-    Wire.requestFrom((uint8_t) address, (uint8_t) 1);
-    value = Wire.read();
+    uint8_t value { 0 };
+    espurna::i2c::transfer(address, &reg, 1, &value, 1, true);
     return value;
 }
 
 uint16_t i2c_read_uint16(uint8_t address) {
-    uint16_t value;
-    Wire.requestFrom((uint8_t) address, (uint8_t) 2);
-    value = (Wire.read() * 256) | Wire.read();
-    return value;
+    uint8_t buffer[2] {0, 0};
+    espurna::i2c::transfer(address, nullptr, 0, buffer, 2, true);
+    return (buffer[0] * 256) | buffer[1];
 }
 
 uint16_t i2c_read_uint16(uint8_t address, uint8_t reg) {
-    uint16_t value;
-    Wire.beginTransmission((uint8_t) address);
-    Wire.write((uint8_t) reg);
-    Wire.endTransmission();
-    Wire.requestFrom((uint8_t) address, (uint8_t) 2);
-    value = (Wire.read() * 256) | Wire.read();
-    return value;
+    uint8_t buffer[2] {0, 0};
+    espurna::i2c::transfer(address, &reg, 1, buffer, 2, true);
+    return (buffer[0] * 256) | buffer[1];
 }
 
 void i2c_read_buffer(uint8_t address, uint8_t* buffer, size_t len) {
-    Wire.requestFrom(address, (uint8_t) len);
-    for (size_t i=0; i<len; ++i) {
-        buffer[i] = Wire.read();
-    }
+    espurna::i2c::transfer(address, nullptr, 0, buffer, len, true);
 }
 
 void i2c_write_uint(uint8_t address, uint16_t reg, uint32_t input, size_t size) {
     if (size && (size <= sizeof(input))) {
-        Wire.beginTransmission(address);
-        Wire.write((reg >> 8) & 0xff);
-        Wire.write(reg & 0xff);
+        uint8_t buf[2 + sizeof(input)];
+        buf[0] = (reg >> 8) & 0xff;
+        buf[1] = reg & 0xff;
 
-        uint8_t buf[sizeof(input)];
-        std::memcpy(&buf[0], &input, sizeof(buf));
+        for (size_t byte = 0; byte < size; ++byte) {
+            buf[2 + byte] = (input >> (8 * (size - byte - 1))) & 0xff;
+        }
 
-        Wire.write(&buf[sizeof(buf) - size], size);
-        Wire.endTransmission();
+        espurna::i2c::write(address, buf, 2 + size);
     }
 }
 
 uint32_t i2c_read_uint(uint8_t address, uint16_t reg, size_t size, bool stop) {
     uint32_t out { 0 };
     if (size <= sizeof(out)) {
-        Wire.beginTransmission(address);
-        Wire.write((reg >> 8) & 0xff);
-        Wire.write(reg & 0xff);
-        Wire.endTransmission(stop);
-
-        if (size == Wire.requestFrom(address, size)) {
-            for (size_t byte = 0; byte < size; --byte) {
-                out = (out << 8ul) | static_cast<uint8_t>(Wire.read());
+        const uint8_t pointer[2] {
+            static_cast<uint8_t>((reg >> 8) & 0xff),
+            static_cast<uint8_t>(reg & 0xff)};
+
+        uint8_t buf[sizeof(out)];
+        if (0 == espurna::i2c::transfer(address, pointer, sizeof(pointer), buf, size, stop)) {
+            for (size_t byte = 0; byte < size; ++byte) {
+                out = (out << 8ul) | buf[byte];
             }
         }
     }
@@ -522,8 +583,6 @@ uint32_t i2c_read_uint(uint8_t address, uint16_t reg, size_t size, bool stop) {
     return out;
 }
 
-#endif // I2C_USE_BRZO
-
 uint8_t i2c_write_uint8(uint8_t address, uint8_t reg, uint8_t value) {
     uint8_t buffer[2] = {reg, value};
     return i2c_write_buffer(address, buffer, 2);
@@ -590,8 +649,13 @@ uint8_t i2cFindAndLock(const uint8_t* begin, const uint8_t* end) {
     return espurna::i2c::findAndLock(begin, end);
 }
 
+espurna::i2c::Error i2cSchedule(espurna::i2c::Plan plan, espurna::i2c::Scheduler::Callback callback) {
+    return espurna::i2c::internal::scheduler.schedule(std::move(plan), std::move(callback));
+}
+
 void i2cSetup() {
     espurna::i2c::init();
+    espurnaRegisterLoop(espurna::i2c::loop);
 
 #if TERMINAL_SUPPORT
     espurna::i2c::terminal::setup();
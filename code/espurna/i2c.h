@@ -11,6 +11,8 @@ Copyright (C) 2017-2019 by Xose Pérez <xose dot perez at gmail dot com>
 #include <cstddef>
 #include <cstdint>
 
+#include "i2c_scheduler.h"
+
 void i2c_wakeup(uint8_t address);
 uint8_t i2c_write_buffer(uint8_t address, uint8_t * buffer, size_t len);
 uint8_t i2c_write_uint8(uint8_t address, uint8_t value);
@@ -38,5 +40,9 @@ void i2cUnlock(uint8_t address);
 uint8_t i2cFind(const uint8_t* begin, const uint8_t* end);
 uint8_t i2cFindAndLock(const uint8_t* begin, const uint8_t* end);
 
+// Plan is queued and runs from the main loop, without blocking when it waits for the device.
+// Callback is called when all of the steps are done or when any of them failed
+espurna::i2c::Error i2cSchedule(espurna::i2c::Plan, espurna::i2c::Scheduler::Callback);
+
 int i2cClearBus();
 void i2cSetup();
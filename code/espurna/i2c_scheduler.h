@@ -0,0 +1,336 @@
+/*
+
+Part of the I2C MODULE
+
+Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#include "types.h"
+
+namespace espurna {
+namespace i2c {
+
+// Actual bus access, implemented by the I2C module. Both methods return 0 on success
+// and implementation-specific error code otherwise. `transfer()` writes `out` (when not empty)
+// and then reads `in` within the same transaction, using repeated START
+struct Transport {
+    virtual ~Transport() = default;
+
+    virtual uint8_t write(uint8_t address, const uint8_t* data, size_t size) = 0;
+    virtual uint8_t transfer(uint8_t address, const uint8_t* out, size_t out_size, uint8_t* in, size_t in_size) = 0;
+};
+
+// Sequence of transactions for a single device. Payloads are copied into the plan and
+// every read appends to the same result buffer, in the order they appear in the plan.
+// Waits allow the scheduler to run some other plans while the device is busy with the conversion.
+class Plan {
+public:
+    static constexpr size_t StepsMax { 6 };
+    static constexpr size_t PayloadSize { 16 };
+    static constexpr size_t ResultSize { 24 };
+
+    Plan() = default;
+    explicit Plan(uint8_t address) :
+        _address(address)
+    {}
+
+    uint8_t address() const {
+        return _address;
+    }
+
+    Plan& write(std::initializer_list<uint8_t> values) {
+        return write(values.begin(), values.size());
+    }
+
+    Plan& write(const uint8_t* data, size_t size) {
+        if (size && reserve(size, 0)) {
+            _steps[_size++] = Step{Kind::Write, _payload_size, static_cast<uint8_t>(size), 0, 0};
+            append(data, size);
+        }
+
+        return *this;
+    }
+
+    // Register address is sent first and then `size` bytes are read in a single burst
+    Plan& read(uint8_t reg, size_t size) {
+        if (size && reserve(1, size)) {
+            _steps[_size++] = Step{Kind::Read, _payload_size, 1, static_cast<uint8_t>(size), 0};
+            append(&reg, 1);
+            _result_size += size;
+        }
+
+        return *this;
+    }
+
+    // Plain read, without sending anything first
+    Plan& read(size_t size) {
+        if (size && reserve(0, size)) {
+            _steps[_size++] = Step{Kind::Read, _payload_size, 0, static_cast<uint8_t>(size), 0};
+            _result_size += size;
+        }
+
+        return *this;
+    }
+
+    Plan& wait(duration::Microseconds time) {
+        if (reserve(0, 0)) {
+            _steps[_size++] = Step{Kind::Wait, 0, 0, 0, static_cast<uint32_t>(time.count())};
+        }
+
+        return *this;
+    }
+
+    // false when some of the steps did not fit or there is nothing to do
+    bool valid() const {
+        return !_overflow && _size;
+    }
+
+    size_t steps() const {
+        return _size;
+    }
+
+    // Result buffer, only complete after the plan is finished
+    const uint8_t* data() const {
+        return _result.data();
+    }
+
+    size_t size() const {
+        return _result_size;
+    }
+
+    uint8_t operator[](size_t index) const {
+        return (index < _result_size) ? _result[index] : 0;
+    }
+
+    uint16_t value16(size_t offset) const {
+        return static_cast<uint16_t>((*this)[offset] << 8)
+            | static_cast<uint16_t>((*this)[offset + 1]);
+    }
+
+    uint16_t value16_le(size_t offset) const {
+        return static_cast<uint16_t>((*this)[offset])
+            | static_cast<uint16_t>((*this)[offset + 1] << 8);
+    }
+
+private:
+    friend class Scheduler;
+
+    enum class Kind : uint8_t {
+        Write,
+        Read,
+        Wait,
+    };
+
+    struct Step {
+        Kind kind;
+        uint8_t offset;
+        uint8_t out;
+        uint8_t in;
+        uint32_t wait;
+    };
+
+    bool reserve(size_t payload, size_t result) {
+        if ((_size >= _steps.size())
+            || ((_payload_size + payload) > _payload.size())
+            || ((_result_size + result) > _result.size()))
+        {
+            _overflow = true;
+        }
+
+        return !_overflow;
+    }
+
+    void append(const uint8_t* data, size_t size) {
+        std::copy(data, data + size, _payload.begin() + _payload_size);
+        _payload_size += size;
+    }
+
+    std::array<Step, StepsMax> _steps;
+    std::array<uint8_t, PayloadSize> _payload;
+    std::array<uint8_t, ResultSize> _result;
+
+    uint8_t _address { 0 };
+    uint8_t _size { 0 };
+    uint8_t _payload_size { 0 };
+    uint8_t _result_size { 0 };
+    bool _overflow { false };
+};
+
+enum class Error {
+    None,
+    Invalid,
+    QueueFull,
+    Bus,
+};
+
+// Cooperative transaction queue, driven by the tick() from the main loop.
+// Every plan runs its steps back-to-back until it reaches a wait. Then, it is put aside until
+// the wait is over and the next plan in the queue gets to use the bus instead.
+// Plans for the same address always run in the order they were scheduled, one at a time.
+class Scheduler {
+public:
+    // Plan is only valid during the call. Status is the bus error code of the failed step
+    using Callback = std::function<void(Error, uint8_t status, const Plan&)>;
+
+    static constexpr size_t QueueSize { 8 };
+
+    struct Stats {
+        uint32_t completed { 0 };
+        uint32_t failed { 0 };
+        uint32_t waits { 0 };
+        uint32_t pending_max { 0 };
+    };
+
+    explicit Scheduler(Transport& transport) :
+        _transport(transport)
+    {}
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    Error schedule(Plan plan, Callback callback) {
+        if (!plan.valid()) {
+            return Error::Invalid;
+        }
+
+        if (_queue.size() >= QueueSize) {
+            return Error::QueueFull;
+        }
+
+        _queue.push_back(
+            Entry{std::move(plan), std::move(callback)});
+        _stats.pending_max = std::max(
+            _stats.pending_max, static_cast<uint32_t>(_queue.size()));
+
+        return Error::None;
+    }
+
+    // Callbacks are allowed to schedule() more plans, which are only looked at during the next tick()
+    void tick(duration::Microseconds now) {
+        const auto size = _queue.size();
+
+        size_t index = 0;
+        for (size_t visited = 0; visited < size; ++visited) {
+            auto& entry = _queue[index];
+            if (!blocked(index) && ready(entry, now)) {
+                const auto status = run(entry, now);
+                if (status || finished(entry)) {
+                    complete(index, status);
+                    continue;
+                }
+            }
+
+            ++index;
+        }
+    }
+
+    size_t pending() const {
+        return _queue.size();
+    }
+
+    const Stats& stats() const {
+        return _stats;
+    }
+
+    // does not call the callbacks
+    void clear() {
+        _queue.clear();
+    }
+
+private:
+    struct Entry {
+        Plan plan;
+        Callback callback;
+        duration::Microseconds start{};
+        duration::Microseconds wait{};
+        uint8_t step { 0 };
+        uint8_t result { 0 };
+    };
+
+    // some earlier plan for the same device is still in progress
+    bool blocked(size_t index) const {
+        const auto address = _queue[index].plan.address();
+        for (size_t other = 0; other < index; ++other) {
+            if (_queue[other].plan.address() == address) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static bool ready(const Entry& entry, duration::Microseconds now) {
+        return (now - entry.start) >= entry.wait;
+    }
+
+    // trailing wait still has to expire before the plan is considered done
+    static bool finished(const Entry& entry) {
+        return (entry.step >= entry.plan._size)
+            && (entry.wait == duration::Microseconds::zero());
+    }
+
+    uint8_t run(Entry& entry, duration::Microseconds now) {
+        auto& plan = entry.plan;
+        entry.wait = duration::Microseconds::zero();
+
+        uint8_t status = 0;
+        while (!status && (entry.step < plan._size)) {
+            const auto& step = plan._steps[entry.step++];
+            switch (step.kind) {
+            case Plan::Kind::Write:
+                status = _transport.write(plan.address(),
+                    &plan._payload[step.offset], step.out);
+                break;
+
+            case Plan::Kind::Read:
+                status = _transport.transfer(plan.address(),
+                    &plan._payload[step.offset], step.out,
+                    &plan._result[entry.result], step.in);
+                entry.result += step.in;
+                break;
+
+            case Plan::Kind::Wait:
+                entry.start = now;
+                entry.wait = duration::Microseconds(step.wait);
+                ++_stats.waits;
+                return 0;
+            }
+        }
+
+        return status;
+    }
+
+    void complete(size_t index, uint8_t status) {
+        auto entry = std::move(_queue[index]);
+        _queue.erase(_queue.begin() + index);
+
+        if (status) {
+            ++_stats.failed;
+        } else {
+            ++_stats.completed;
+        }
+
+        if (entry.callback) {
+            entry.callback(status ? Error::Bus : Error::None, status, entry.plan);
+        }
+    }
+
+    Transport& _transport;
+    std::vector<Entry> _queue;
+    Stats _stats;
+};
+
+} // namespace i2c
+} // namespace espurna
@@ -323,7 +323,7 @@ void idbSetup() {
     #endif
 
     espurnaRegisterReload(_idbConfigure);
-    espurnaRegisterLoop(_idbFlush);
+    espurnaRegisterLoop(_idbFlush, STRING_VIEW("influxdb"));
 
     #if TERMINAL_SUPPORT
         idbTerminalSetup();
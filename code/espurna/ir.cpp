@@ -37,9 +37,11 @@ $ pio run -e ... \
 #include <IRsend.h>
 #include <IRutils.h>
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <queue>
+#include <array>
+#include <new>
 #include <vector>
 
 // TODO: current library version injects a bunch of stuff into the global scope:
@@ -105,7 +107,13 @@ struct PayloadSenderBase {
     virtual bool reschedule() = 0;
 };
 
-using PayloadSenderPtr = std::unique_ptr<PayloadSenderBase>;
+// senders are placed in the payload arena (see ir_parse.h), deleter needs to know the allocation size
+struct PayloadSenderDeleter {
+    size_t size { 0 };
+    void operator()(PayloadSenderBase*) const;
+};
+
+using PayloadSenderPtr = std::unique_ptr<PayloadSenderBase, PayloadSenderDeleter>;
 
 namespace build {
 
@@ -143,6 +151,11 @@ constexpr unsigned long delay() {
     return IR_TX_DELAY;
 }
 
+// maximum number of messages waiting in the TX queue
+constexpr size_t queueSize() {
+    return IR_TX_QUEUE_SIZE;
+}
+
 } // namespace build
 
 namespace settings {
@@ -182,7 +195,42 @@ unsigned long delay { build::delay() };
 BasePinPtr pin;
 std::unique_ptr<IRsend> instance;
 
-std::queue<PayloadSenderPtr> queue;
+// fixed-size ring of senders, both the entries and the payloads are never on the heap
+struct Queue {
+    bool empty() const {
+        return _size == 0;
+    }
+
+    bool full() const {
+        return _size == _storage.size();
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    PayloadSenderPtr& front() {
+        return _storage[_head];
+    }
+
+    void push(PayloadSenderPtr&& sender) {
+        _storage[(_head + _size) % _storage.size()] = std::move(sender);
+        ++_size;
+    }
+
+    void pop() {
+        _storage[_head].reset();
+        _head = (_head + 1) % _storage.size();
+        --_size;
+    }
+
+private:
+    std::array<PayloadSenderPtr, build::queueSize()> _storage;
+    size_t _head { 0 };
+    size_t _size { 0 };
+};
+
+Queue queue;
 
 } // namespace internal
 } // namespace tx
@@ -301,286 +349,11 @@ std::unique_ptr<IRrecv> instance;
 } // namespace internal
 } // namespace rx
 
-// TODO: since the exceptions are disabled, and parsing failure is not really an 'exceptional' result anyway...
-//       result struct may be in need of an additional struct describing the error, instead of just a boolean true or false
-//       (something like std::expected - http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2019/p0323r8.html)
-//       current implementation may be adjusted, but not the using DecodeResult = std::optional<T> mentioned above
-
-template <typename T>
-struct ParseResult {
-    ParseResult() = default;
-    ParseResult(ParseResult&& other) noexcept {
-        if (other._initialized) {
-            init(std::move(other._result._value));
-        }
-    }
-
-    explicit ParseResult(T&& value) noexcept {
-        init(std::move(value));
-    }
-
-    ~ParseResult() {
-        if (_initialized) {
-            _result._value.~T();
-        }
-    }
-
-    ParseResult(const ParseResult&) = delete;
-    ParseResult& operator=(const T& value) = delete;
-
-    ParseResult& operator=(T&& value) noexcept {
-        init(std::move(value));
-        return *this;
-    }
-
-    explicit operator bool() const noexcept {
-        return _initialized;
-    }
-
-    T* operator->() {
-        return &_result._value;
-    }
-
-    const T* operator->() const {
-        return &_result._value;
-    }
-
-    bool has_value() const noexcept {
-        return _initialized;
-    }
-
-    const T& value() const & {
-        return _result._value;
-    }
-
-    T& value() & {
-        return _result._value;
-    }
-
-    T&& value() && {
-        return std::move(_result._value);
-    }
-
-    const T&& value() const && {
-        return std::move(_result._value);
-    }
-
-private:
-    struct Empty {
-    };
-
-    union Result {
-        Result() :
-            _empty()
-        {}
-
-        ~Result() {
-        }
-
-        Result(const Result&) = delete;
-        Result(Result&&) = delete;
-
-        Result& operator=(const Result&) = delete;
-        Result& operator=(Result&&) = delete;
-
-        template <typename... Args>
-        Result(Args&&... args) :
-            _value(std::forward<Args>(args)...)
-        {}
-
-        template <typename... Args>
-        void update(Args&&... args) {
-            _value = T(std::forward<Args>(args)...);
-        }
-
-        Empty _empty;
-        T _value;
-    };
-
-    void reset() {
-        if (_initialized) {
-            _result._value.~T();
-        }
-    }
-
-    // TODO: c++ std compliance may enforce weird optimizations if T contains const or reference members, ref.
-    // - http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2017/p0532r0.pdf
-    // - https://gcc.gnu.org/bugzilla/show_bug.cgi?id=95349
-
-    template <typename... Args>
-    void init(Args&&... args) {
-        if (!_initialized) {
-            ::new (&_result) Result(std::forward<Args>(args)...);
-            _initialized = true;
-        } else {
-            _result.update(std::forward<Args>(args)...);
-        }
-    }
-
-    bool _initialized { false };
-    Result _result;
-};
-
-template <typename T>
-T sized(StringView value) {
-    const auto result = parseUnsigned(value, 10);
-    constexpr decltype(result.value) Boundary { 1ul << (sizeof(T) * 8) };
-    if (result.ok && (result.value < Boundary)) {
-        return result.value;
-    }
-
-    return 0;
-}
-
-template <>
-unsigned long sized(StringView value) {
-    const auto result = parseUnsigned(value, 10);
-    if (result.ok) {
-        return result.value;
-    }
-
-    return 0;
-}
-
-// Simple messages that transmit the numeric 'value' (up to 8 bytes)
-//
-// Transmitting:
-//   Payload: <protocol>:<value>:<bits>[:<repeats>][:<delay>][:<times>]
-//
-//   Required parameters:
-//     PROTOCOL - decimal ID, will be converted into a named 'decode_type_t'
-//                (ref. IRremoteESP8266.h and it's protocol descriptions)
-//     VALUE    - hexadecimal representation of the value that will be sent
-//                (big endian, maximum 8bytes / 64bit. byte is always zero-padded)
-//     BITS     - number of bits associated with the protocol
-//                (ref. IRremoteESP8266.h and it's protocol descriptions)
-//
-//   Optional payload parameters:
-//     REPEATS  - how many times the message will be sent immediatly
-//                (defaults to 0 or the value set by the PROTOCOL type)
-//     SERIES   - how many times the message will be scheduled for sending
-//                (defaults to 1 aka once, [1...120))
-//     DELAY    - minimum amount of time (ms) between queued messages
-//                (defaults is IR_TX_DELAY, applies to every message in the series)
-//
-// Receiving:
-//   Payload: 2:AABBCCDD:32 (<protocol>:<value>:<bits>)
-
-// TODO: type is numeric based on the previous implementation. note that there are
-// `::typeToString(decode_type_t)` and `::strToDecodeType(const char*)` (IRutils.h)
-// And also see `const char kAllProtocolNames*`, which is a global from the IRtext header with
-// \0-terminated chunks of stringivied decode_type_t (counting 'index' will deduce the type)
-//
-// (but, notice that str->type only works with C strings and *will* do a permissive
-// `strToDecodeType(typeToString(static_cast<decode_type_t>(atoi(str))))` when the
-// intial attempt fails)
+#include "ir_parse.h"
 
 namespace simple {
-
-struct Payload {
-    decode_type_t type;
-    uint64_t value;
-    uint16_t bits;
-    uint16_t repeats;
-    uint8_t series;
-    unsigned long delay;
-};
-
-namespace value {
-
-// TODO: endianness of input is always 'big', output is 'little'
-//       all esp platforms and common build hosts are 'little'
-//       but, actually make sure bswap is necessary?
-
-// To convert from an existing decimal value, there is a python one-liner:
-// >>> bytes(x for x in (123456789).to_bytes(8, 'big', signed=False) if x).hex()
-// '075bcd15'
-// (and also notice that old version *always* cast `u64` into `u32` which cut off part of the code)
-
-uint64_t decode(StringView view) {
-    constexpr size_t RawSize { sizeof(uint64_t) };
-    constexpr size_t BufferSize { (RawSize * 2) + 1 };
-
-    if (!(view.length() % 2) && (view.length() < BufferSize)) {
-        char buffer[BufferSize] {0};
-
-        constexpr size_t BufferLen { BufferSize - 1 };
-        char* ZerolessOffset { std::begin(buffer) + BufferLen - view.length() };
-        std::fill(std::begin(buffer), ZerolessOffset, '0');
-        std::copy(view.begin(), view.end(), ZerolessOffset);
-
-        uint8_t raw[RawSize] {0};
-        if (::hexDecode(buffer, BufferLen, raw, sizeof(raw))) {
-            uint64_t output{0};
-            std::memcpy(&output, &raw, sizeof(raw));
-            return __builtin_bswap64(output);
-        }
-    }
-
-    return 0;
-}
-
-String encode(uint64_t input) {
-    String out;
-
-    if (input) {
-        const uint64_t Value { __builtin_bswap64(input) };
-
-        uint8_t raw[sizeof(Value)] {0};
-        std::memcpy(&raw, &Value, sizeof(raw));
-
-        uint8_t* begin { std::begin(raw) };
-        while (!(*begin)) {
-            ++begin;
-        }
-
-        out = hexEncode(begin, std::end(raw));
-    } else {
-        out.concat(F("00"));
-    }
-
-    return out;
-}
-
-} // namespace value
-
 namespace payload {
 
-decode_type_t type(StringView view) {
-    static_assert(std::is_same<int, std::underlying_type<decode_type_t>::type>::value, "");
-    constexpr int First { -1 };
-    constexpr int Last { static_cast<int>(decode_type_t::kLastDecodeType) };
-
-    String value(view);
-
-    int result { value.toInt() };
-    if ((First < result) && (result < Last)) {
-        return static_cast<decode_type_t>(result);
-    }
-
-    return decode_type_t::UNKNOWN;
-}
-
-uint64_t value(StringView view) {
-    return espurna::ir::simple::value::decode(view);
-}
-
-uint16_t bits(StringView value) {
-    return sized<uint16_t>(value);
-}
-
-uint16_t repeats(StringView value) {
-    return sized<uint16_t>(value);
-}
-
-uint8_t series(StringView value) {
-    return sized<uint8_t>(value);
-}
-
-unsigned long delay(StringView value) {
-    return sized<unsigned long>(value);
-}
-
 template <typename T>
 String encode(T& result) {
     String out;
@@ -598,53 +371,8 @@ String encode(T& result) {
 }
 
 } // namespace payload
-
-Payload prepare(StringView type, StringView value, StringView bits, StringView repeats, StringView series, StringView delay) {
-    Payload result;
-    result.type = payload::type(type);
-    result.value = payload::value(value);
-    result.bits = payload::bits(bits);
-
-    if (repeats.length()) {
-        result.repeats = payload::repeats(repeats);
-    } else {
-        result.repeats = tx::internal::repeats;
-    }
-
-    if (series.length()) {
-        result.series = payload::series(series);
-    } else {
-        result.series = tx::internal::series;
-    }
-
-    if (delay.length()) {
-        result.delay = payload::delay(delay);
-    } else {
-        result.delay = tx::internal::delay;
-    }
-
-    return result;
-}
-
-#include "ir_parse_simple.re.ipp"
-
 } // namespace simple
 
-// Transmitting:
-//   Payload: <frequency>:<series>:<delay>:<μs>,<μs>,<μs>,<μs>,...
-//            |         Options          | |       Message       |
-//
-//   FREQUENCY  - modulation frequency, either in kHz (<1000) or Hz (>=1000)
-//   SERIES     - how many times the message will be scheduled for sending
-//                [1...120)
-//   DELAY      - minimum amount of time (ms) between queued messages
-//
-// Receiving:
-//   Payload: <μs>,<μs>,<μs>,<μs>,...
-//
-// The message is encoded as time in microseconds for the IR LED to be in a certain state.
-// First one is always ON, and the second one - OFF.
-
 // Also see IRutils.h's `String resultToTimingInfo(decode_results*)` for all of timing info, with a nice table output
 // Not really applicable here, though
 
@@ -652,13 +380,6 @@ namespace raw {
 
 static_assert((DECODE_HASH), "");
 
-struct Payload {
-    uint16_t frequency;
-    uint8_t series;
-    unsigned long delay;
-    std::vector<uint16_t> time;
-};
-
 namespace time {
 
 // TODO: compress / decompress with https://tasmota.github.io/docs/IRSend-RAW-Encoding/?
@@ -698,22 +419,6 @@ String encode(const uint16_t* begin, const uint16_t* end) {
 
 namespace payload {
 
-uint16_t frequency(StringView value) {
-    return sized<uint16_t>(value);
-}
-
-uint8_t series(StringView value) {
-    return sized<uint8_t>(value);
-}
-
-unsigned long delay(StringView value) {
-    return sized<unsigned long>(value);
-}
-
-uint16_t time(StringView value) {
-    return sized<uint16_t>(value);
-}
-
 template <typename T>
 String encode(T& result) {
     auto raw = result.raw();
@@ -725,19 +430,6 @@ String encode(T& result) {
 }
 
 } // namespace payload
-
-Payload prepare(StringView frequency, StringView series, StringView delay, decltype(Payload::time)&& time) {
-    Payload result;
-    result.frequency = payload::frequency(frequency);
-    result.series = payload::series(series);
-    result.delay = payload::delay(delay);
-    result.time = std::move(time);
-
-    return result;
-}
-
-#include "ir_parse_raw.re.ipp"
-
 } // namespace raw
 
 // TODO: current solution works directly with the internal 'u8 state[]', both for receiving and sending
@@ -766,65 +458,10 @@ Payload prepare(StringView frequency, StringView series, StringView delay, declt
 
 namespace state {
 
-// State messages transmit an arbitrary amount of bytes, by using the assosicated protocol method
-// Repeats are intended to be handled via the respective PROTOCOL method automatically
-// (and, there's no reliable way besides linking every type with it's method from our side)
-//
-// Transmitting:
-//   Payload: <protocol>:<value>[:<series>][:<delay>]
-//
-//   Required parameters:
-//     PROTOCOL - decimal ID, will be converted into a named 'decode_type_t'
-//                (ref. IRremoteESP8266.h and it's protocol descriptions)
-//     VALUE    - hexadecimal representation of the value that will be sent
-//                (big endian, maximum depends on the protocol settings)
-//
-//   Optional payload parameters:
-//     SERIES   - how many times the message will be scheduled for sending
-//                (defaults to 1 aka once, [1...120))
-//     DELAY    - minimum amount of time (ms) between queued messages
-//                (defaults is IR_TX_DELAY, applies to every message in the series)
-//
-// Receiving:
-//   Payload: 52:112233445566778899AABB (<protocol>:<value>)
-
 static_assert(
     sizeof(decltype(decode_results::state)) >= sizeof(decltype(decode_results::value)),
     "Unsupported version of IRremoteESP8266");
 
-using Value = std::vector<uint8_t>;
-
-struct Payload {
-    decode_type_t type;
-    Value value;
-    uint8_t series;
-    unsigned long delay;
-};
-
-namespace value {
-
-String encode(const uint8_t* begin, const uint8_t* end) {
-    return hexEncode(begin, end);
-}
-
-template <typename T>
-String encode(T&& range) {
-    return hexEncode(range.begin(), range.end());
-}
-
-Value decode(StringView view) {
-    Value out;
-    if (!(view.length() % 2)) {
-        out.resize(view.length() / 2, static_cast<uint8_t>(0));
-        hexDecode(view.begin(), view.end(),
-                out.data(), out.data() + out.size());
-    }
-
-    return out;
-}
-
-} // namespace value
-
 namespace payload {
 
 template <typename T>
@@ -842,29 +479,6 @@ String encode(T& result) {
 }
 
 } // namespace payload
-
-Payload prepare(StringView type, StringView value, StringView series, StringView delay) {
-    Payload result;
-    result.type = espurna::ir::simple::payload::type(type);
-    result.value = value::decode(value);
-
-    if (series.length()) {
-        result.series = simple::payload::series(series);
-    } else {
-        result.series = tx::internal::series;
-    }
-
-    if (delay.length()) {
-        result.delay = simple::payload::delay(delay);
-    } else {
-        result.delay = tx::internal::delay;
-    }
-
-    return result;
-}
-
-#include "ir_parse_state.re.ipp"
-
 } // namespace state
 
 namespace rx {
@@ -1111,18 +725,37 @@ private:
     ir::raw::Payload _payload;
 };
 
+void PayloadSenderDeleter::operator()(PayloadSenderBase* ptr) const {
+    ptr->~PayloadSenderBase();
+    arena().deallocate(ptr, size);
+}
+
 namespace internal {
 
+template <typename T, typename Payload>
+PayloadSenderPtr make_sender(Payload&& payload) {
+    static_assert(alignof(T) <= Arena::Alignment, "");
+
+    auto* ptr = arena().allocate(sizeof(T));
+    if (!ptr) {
+        return PayloadSenderPtr();
+    }
+
+    return PayloadSenderPtr(
+        new (ptr) T(std::move(payload)),
+        PayloadSenderDeleter{sizeof(T)});
+}
+
 PayloadSenderPtr make_sender(ir::simple::Payload&& payload) {
-    return std::make_unique<SimplePayloadSender>(std::move(payload));
+    return make_sender<SimplePayloadSender>(std::move(payload));
 }
 
 PayloadSenderPtr make_sender(ir::state::Payload&& payload) {
-    return std::make_unique<StatePayloadSender>(std::move(payload));
+    return make_sender<StatePayloadSender>(std::move(payload));
 }
 
 PayloadSenderPtr make_sender(ir::raw::Payload&& payload) {
-    return std::make_unique<RawPayloadSender>(std::move(payload));
+    return make_sender<RawPayloadSender>(std::move(payload));
 }
 
 void enqueue(PayloadSenderPtr&& sender) {
@@ -1133,12 +766,30 @@ void enqueue(PayloadSenderPtr&& sender) {
 
 template <typename T>
 bool enqueue(typename ir::ParseResult<T>&& result) {
-    if (result) {
-        internal::enqueue(internal::make_sender(std::move(result).value()));
-        return true;
+    if (!result) {
+        return false;
     }
 
-    return false;
+    if (internal::queue.full()) {
+        DEBUG_MSG_P(PSTR("[IR] TX queue is full, dropping the payload\n"));
+        return false;
+    }
+
+    if (!valid(result.value())) {
+        DEBUG_MSG_P(PSTR("[IR] Invalid payload, or not enough space (%zu / %zu bytes in use, see IR_TX_ARENA_SIZE)\n"),
+            arena().used(), arena().size());
+        return false;
+    }
+
+    auto sender = internal::make_sender(std::move(result).value());
+    if (!sender) {
+        DEBUG_MSG_P(PSTR("[IR] Not enough space to queue the payload (%zu / %zu bytes in use, see IR_TX_ARENA_SIZE)\n"),
+            arena().used(), arena().size());
+        return false;
+    }
+
+    internal::enqueue(std::move(sender));
+    return true;
 }
 
 void loop() {
@@ -1739,15 +1390,15 @@ void setup() {
         ::espurnaRegisterLoop([]() {
             ir::rx::loop();
             ir::tx::loop();
-        });
+        }, STRING_VIEW("ir"));
     } else if (rxPin) {
         ::espurnaRegisterLoop([]() {
             ir::rx::loop();
-        });
+        }, STRING_VIEW("ir"));
     } else if (txPin) {
         ::espurnaRegisterLoop([]() {
             ir::tx::loop();
-        });
+        }, STRING_VIEW("ir"));
     }
 
     if (txPin) {
@@ -2097,9 +1748,11 @@ void setup() {
             IR_TEST(payload.series == 1);
             IR_TEST(payload.delay == 500);
 
-            decltype(raw::Payload::time) expected_time {
+            const uint16_t expected_time[] {
                 100, 200, 150, 250, 50, 100, 100, 150};
-            IR_TEST(expected_time == payload.time);
+            IR_TEST(payload.time.size() == std::size(expected_time));
+            IR_TEST(std::equal(std::begin(payload.time), std::end(payload.time),
+                        std::begin(expected_time)));
         },
         IR_TEST_RUNNER() {
             const uint16_t raw[] {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
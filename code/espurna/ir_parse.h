@@ -0,0 +1,738 @@
+/*
+
+Part of the IR MODULE
+
+Copyright (C) 2020-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+Payload types and string -> Payload parsers, shared with the host tests.
+
+Expected to be included *inside* of the module namespace, after the following is declared:
+- `decode_type_t` (IRremoteESP8266.h, or a stub when testing)
+- `tx::internal::repeats`, `tx::internal::series` and `tx::internal::delay` default values
+- `IR_TX_ARENA_SIZE` (config/general.h)
+
+*/
+
+#pragma once
+
+// TODO: since the exceptions are disabled, and parsing failure is not really an 'exceptional' result anyway...
+//       result struct may be in need of an additional struct describing the error, instead of just a boolean true or false
+//       (something like std::expected - http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2019/p0323r8.html)
+//       current implementation may be adjusted, but not the using DecodeResult = std::optional<T> mentioned above
+
+template <typename T>
+struct ParseResult {
+    ParseResult() = default;
+    ParseResult(ParseResult&& other) noexcept {
+        if (other._initialized) {
+            init(std::move(other._result._value));
+        }
+    }
+
+    explicit ParseResult(T&& value) noexcept {
+        init(std::move(value));
+    }
+
+    ~ParseResult() {
+        if (_initialized) {
+            _result._value.~T();
+        }
+    }
+
+    ParseResult(const ParseResult&) = delete;
+    ParseResult& operator=(const T& value) = delete;
+
+    ParseResult& operator=(T&& value) noexcept {
+        init(std::move(value));
+        return *this;
+    }
+
+    explicit operator bool() const noexcept {
+        return _initialized;
+    }
+
+    T* operator->() {
+        return &_result._value;
+    }
+
+    const T* operator->() const {
+        return &_result._value;
+    }
+
+    bool has_value() const noexcept {
+        return _initialized;
+    }
+
+    const T& value() const & {
+        return _result._value;
+    }
+
+    T& value() & {
+        return _result._value;
+    }
+
+    T&& value() && {
+        return std::move(_result._value);
+    }
+
+    const T&& value() const && {
+        return std::move(_result._value);
+    }
+
+private:
+    struct Empty {
+    };
+
+    union Result {
+        Result() :
+            _empty()
+        {}
+
+        ~Result() {
+        }
+
+        Result(const Result&) = delete;
+        Result(Result&&) = delete;
+
+        Result& operator=(const Result&) = delete;
+        Result& operator=(Result&&) = delete;
+
+        template <typename... Args>
+        Result(Args&&... args) :
+            _value(std::forward<Args>(args)...)
+        {}
+
+        template <typename... Args>
+        void update(Args&&... args) {
+            _value = T(std::forward<Args>(args)...);
+        }
+
+        Empty _empty;
+        T _value;
+    };
+
+    void reset() {
+        if (_initialized) {
+            _result._value.~T();
+        }
+    }
+
+    // TODO: c++ std compliance may enforce weird optimizations if T contains const or reference members, ref.
+    // - http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2017/p0532r0.pdf
+    // - https://gcc.gnu.org/bugzilla/show_bug.cgi?id=95349
+
+    template <typename... Args>
+    void init(Args&&... args) {
+        if (!_initialized) {
+            ::new (&_result) Result(std::forward<Args>(args)...);
+            _initialized = true;
+        } else {
+            _result.update(std::forward<Args>(args)...);
+        }
+    }
+
+    bool _initialized { false };
+    Result _result;
+};
+
+template <typename T>
+T sized(StringView value) {
+    const auto result = parseUnsigned(value, 10);
+    constexpr decltype(result.value) Boundary { 1ul << (sizeof(T) * 8) };
+    if (result.ok && (result.value < Boundary)) {
+        return result.value;
+    }
+
+    return 0;
+}
+
+template <>
+unsigned long sized(StringView value) {
+    const auto result = parseUnsigned(value, 10);
+    if (result.ok) {
+        return result.value;
+    }
+
+    return 0;
+}
+
+// Parsed payloads and the TX queue entries that own them are placed in a single preallocated block of memory,
+// instead of the heap. Long raw captures and large state payloads no longer fragment the heap when sent repeatedly.
+//
+// Queued messages are always transmitted (and destroyed) in the same order they were parsed, so this is just a
+// bump allocator that is rewound once nothing references it anymore (i.e. when the TX queue is drained).
+// Only the most recent allocation can be returned earlier, e.g. when parsing fails or when the actual size
+// becomes known after the fact.
+
+struct Arena {
+    static constexpr size_t Alignment { alignof(std::max_align_t) };
+
+    Arena() = delete;
+    Arena(uint8_t* begin, uint8_t* end) :
+        _begin(begin),
+        _end(end),
+        _cursor(begin)
+    {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // block of exactly 'size' bytes, or nullptr when there's not enough space left
+    void* allocate(size_t size) {
+        auto* out = aligned();
+        if (!size || (out > _end) || (static_cast<size_t>(_end - out) < size)) {
+            return nullptr;
+        }
+
+        _cursor = out + size;
+        ++_users;
+
+        return out;
+    }
+
+    // everything that is left, 'size' is updated with the actual amount
+    void* allocate_all(size_t& size) {
+        auto* out = aligned();
+        if (out >= _end) {
+            size = 0;
+            return nullptr;
+        }
+
+        size = _end - out;
+        _cursor = _end;
+        ++_users;
+
+        return out;
+    }
+
+    // only works for the most recent allocation
+    bool shrink(void* ptr, size_t size, size_t new_size) {
+        auto* tmp = static_cast<uint8_t*>(ptr);
+        if ((tmp + size == _cursor) && (new_size <= size)) {
+            _cursor = tmp + new_size;
+            return true;
+        }
+
+        return false;
+    }
+
+    void deallocate(void* ptr, size_t size) {
+        if (!_users) {
+            return;
+        }
+
+        --_users;
+        if (!_users) {
+            _cursor = _begin;
+            return;
+        }
+
+        auto* tmp = static_cast<uint8_t*>(ptr);
+        if (tmp + size == _cursor) {
+            _cursor = tmp;
+        }
+    }
+
+    size_t size() const {
+        return _end - _begin;
+    }
+
+    size_t used() const {
+        return _cursor - _begin;
+    }
+
+    size_t users() const {
+        return _users;
+    }
+
+private:
+    uint8_t* aligned() const {
+        const size_t offset = ((_cursor - _begin) + Alignment - 1) & ~(Alignment - 1);
+        return _begin + offset;
+    }
+
+    uint8_t* _begin;
+    uint8_t* _end;
+    uint8_t* _cursor;
+    size_t _users { 0 };
+};
+
+Arena& arena() {
+    alignas(Arena::Alignment) static uint8_t storage[IR_TX_ARENA_SIZE];
+    static Arena instance(std::begin(storage), std::end(storage));
+    return instance;
+}
+
+// Fixed capacity array of values, with the storage placed in the arena.
+// Mimics the parts of std::vector used by the parsers. Values that do not fit are
+// discarded and the buffer is marked as overflown, see `overflow()`
+
+template <typename T>
+struct Buffer {
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    static_assert(alignof(T) <= Arena::Alignment, "");
+
+    Buffer() = default;
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&& other) noexcept {
+        take(other);
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+
+        return *this;
+    }
+
+    ~Buffer() {
+        reset();
+    }
+
+    // Exact number of values is not known in advance, so every available byte is claimed.
+    // Call `shrink_to_fit()` when done to give back what was not used.
+    void reserve(size_t) {
+        if (!_data) {
+            claim();
+        }
+    }
+
+    void push_back(T value) {
+        if (!_data) {
+            claim();
+        }
+
+        if (_size < _capacity) {
+            _data[_size++] = value;
+        } else {
+            _overflow = true;
+        }
+    }
+
+    void resize(size_t size, T value) {
+        reset();
+        if (!size) {
+            return;
+        }
+
+        auto* ptr = arena().allocate(size * sizeof(T));
+        if (!ptr) {
+            _overflow = true;
+            return;
+        }
+
+        _data = static_cast<T*>(ptr);
+        _capacity = size;
+        _size = size;
+        std::fill(_data, _data + _size, value);
+    }
+
+    void shrink_to_fit() {
+        if (_data && (_size < _capacity)
+            && arena().shrink(_data, _capacity * sizeof(T), _size * sizeof(T)))
+        {
+            _capacity = _size;
+        }
+    }
+
+    T* data() {
+        return _data;
+    }
+
+    const T* data() const {
+        return _data;
+    }
+
+    T* begin() {
+        return _data;
+    }
+
+    const T* begin() const {
+        return _data;
+    }
+
+    T* end() {
+        return _data + _size;
+    }
+
+    const T* end() const {
+        return _data + _size;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool overflow() const {
+        return _overflow;
+    }
+
+private:
+    void claim() {
+        size_t size { 0 };
+        _data = static_cast<T*>(arena().allocate_all(size));
+        _capacity = size / sizeof(T);
+        _size = 0;
+        _overflow = !_data;
+    }
+
+    void take(Buffer& other) {
+        _data = other._data;
+        _size = other._size;
+        _capacity = other._capacity;
+        _overflow = other._overflow;
+
+        other._data = nullptr;
+        other._size = 0;
+        other._capacity = 0;
+        other._overflow = false;
+    }
+
+    void reset() {
+        if (_data) {
+            arena().deallocate(_data, _capacity * sizeof(T));
+        }
+
+        _data = nullptr;
+        _size = 0;
+        _capacity = 0;
+        _overflow = false;
+    }
+
+    T* _data { nullptr };
+    size_t _size { 0 };
+    size_t _capacity { 0 };
+    bool _overflow { false };
+};
+
+// Simple messages that transmit the numeric 'value' (up to 8 bytes)
+//
+// Transmitting:
+//   Payload: <protocol>:<value>:<bits>[:<repeats>][:<delay>][:<times>]
+//
+//   Required parameters:
+//     PROTOCOL - decimal ID, will be converted into a named 'decode_type_t'
+//                (ref. IRremoteESP8266.h and it's protocol descriptions)
+//     VALUE    - hexadecimal representation of the value that will be sent
+//                (big endian, maximum 8bytes / 64bit. byte is always zero-padded)
+//     BITS     - number of bits associated with the protocol
+//                (ref. IRremoteESP8266.h and it's protocol descriptions)
+//
+//   Optional payload parameters:
+//     REPEATS  - how many times the message will be sent immediatly
+//                (defaults to 0 or the value set by the PROTOCOL type)
+//     SERIES   - how many times the message will be scheduled for sending
+//                (defaults to 1 aka once, [1...120))
+//     DELAY    - minimum amount of time (ms) between queued messages
+//                (defaults is IR_TX_DELAY, applies to every message in the series)
+//
+// Receiving:
+//   Payload: 2:AABBCCDD:32 (<protocol>:<value>:<bits>)
+
+// TODO: type is numeric based on the previous implementation. note that there are
+// `::typeToString(decode_type_t)` and `::strToDecodeType(const char*)` (IRutils.h)
+// And also see `const char kAllProtocolNames*`, which is a global from the IRtext header with
+// \0-terminated chunks of stringivied decode_type_t (counting 'index' will deduce the type)
+//
+// (but, notice that str->type only works with C strings and *will* do a permissive
+// `strToDecodeType(typeToString(static_cast<decode_type_t>(atoi(str))))` when the
+// intial attempt fails)
+
+namespace simple {
+
+struct Payload {
+    decode_type_t type;
+    uint64_t value;
+    uint16_t bits;
+    uint16_t repeats;
+    uint8_t series;
+    unsigned long delay;
+};
+
+namespace value {
+
+// TODO: endianness of input is always 'big', output is 'little'
+//       all esp platforms and common build hosts are 'little'
+//       but, actually make sure bswap is necessary?
+
+// To convert from an existing decimal value, there is a python one-liner:
+// >>> bytes(x for x in (123456789).to_bytes(8, 'big', signed=False) if x).hex()
+// '075bcd15'
+// (and also notice that old version *always* cast `u64` into `u32` which cut off part of the code)
+
+uint64_t decode(StringView view) {
+    constexpr size_t RawSize { sizeof(uint64_t) };
+    constexpr size_t BufferSize { (RawSize * 2) + 1 };
+
+    if (!(view.length() % 2) && (view.length() < BufferSize)) {
+        char buffer[BufferSize] {0};
+
+        constexpr size_t BufferLen { BufferSize - 1 };
+        char* ZerolessOffset { std::begin(buffer) + BufferLen - view.length() };
+        std::fill(std::begin(buffer), ZerolessOffset, '0');
+        std::copy(view.begin(), view.end(), ZerolessOffset);
+
+        uint8_t raw[RawSize] {0};
+        if (::hexDecode(buffer, BufferLen, raw, sizeof(raw))) {
+            uint64_t output{0};
+            std::memcpy(&output, &raw, sizeof(raw));
+            return __builtin_bswap64(output);
+        }
+    }
+
+    return 0;
+}
+
+String encode(uint64_t input) {
+    String out;
+
+    if (input) {
+        const uint64_t Value { __builtin_bswap64(input) };
+
+        uint8_t raw[sizeof(Value)] {0};
+        std::memcpy(&raw, &Value, sizeof(raw));
+
+        uint8_t* begin { std::begin(raw) };
+        while (!(*begin)) {
+            ++begin;
+        }
+
+        out = hexEncode(begin, std::end(raw));
+    } else {
+        out.concat(F("00"));
+    }
+
+    return out;
+}
+
+} // namespace value
+
+namespace payload {
+
+decode_type_t type(StringView view) {
+    static_assert(std::is_same<int, std::underlying_type<decode_type_t>::type>::value, "");
+    constexpr int First { -1 };
+    constexpr int Last { static_cast<int>(decode_type_t::kLastDecodeType) };
+
+    String value(view);
+
+    int result { value.toInt() };
+    if ((First < result) && (result < Last)) {
+        return static_cast<decode_type_t>(result);
+    }
+
+    return decode_type_t::UNKNOWN;
+}
+
+uint64_t value(StringView view) {
+    return espurna::ir::simple::value::decode(view);
+}
+
+uint16_t bits(StringView value) {
+    return sized<uint16_t>(value);
+}
+
+uint16_t repeats(StringView value) {
+    return sized<uint16_t>(value);
+}
+
+uint8_t series(StringView value) {
+    return sized<uint8_t>(value);
+}
+
+unsigned long delay(StringView value) {
+    return sized<unsigned long>(value);
+}
+
+} // namespace payload
+
+Payload prepare(StringView type, StringView value, StringView bits, StringView repeats, StringView series, StringView delay) {
+    Payload result;
+    result.type = payload::type(type);
+    result.value = payload::value(value);
+    result.bits = payload::bits(bits);
+
+    if (repeats.length()) {
+        result.repeats = payload::repeats(repeats);
+    } else {
+        result.repeats = tx::internal::repeats;
+    }
+
+    if (series.length()) {
+        result.series = payload::series(series);
+    } else {
+        result.series = tx::internal::series;
+    }
+
+    if (delay.length()) {
+        result.delay = payload::delay(delay);
+    } else {
+        result.delay = tx::internal::delay;
+    }
+
+    return result;
+}
+
+bool valid(const Payload&) {
+    return true;
+}
+
+#include "ir_parse_simple.re.ipp"
+
+} // namespace simple
+
+// Transmitting:
+//   Payload: <frequency>:<series>:<delay>:<μs>,<μs>,<μs>,<μs>,...
+//            |         Options          | |       Message       |
+//
+//   FREQUENCY  - modulation frequency, either in kHz (<1000) or Hz (>=1000)
+//   SERIES     - how many times the message will be scheduled for sending
+//                [1...120)
+//   DELAY      - minimum amount of time (ms) between queued messages
+//
+// Receiving:
+//   Payload: <μs>,<μs>,<μs>,<μs>,...
+//
+// The message is encoded as time in microseconds for the IR LED to be in a certain state.
+// First one is always ON, and the second one - OFF.
+
+namespace raw {
+
+struct Payload {
+    uint16_t frequency;
+    uint8_t series;
+    unsigned long delay;
+    Buffer<uint16_t> time;
+};
+
+namespace payload {
+
+uint16_t frequency(StringView value) {
+    return sized<uint16_t>(value);
+}
+
+uint8_t series(StringView value) {
+    return sized<uint8_t>(value);
+}
+
+unsigned long delay(StringView value) {
+    return sized<unsigned long>(value);
+}
+
+uint16_t time(StringView value) {
+    return sized<uint16_t>(value);
+}
+
+} // namespace payload
+
+Payload prepare(StringView frequency, StringView series, StringView delay, decltype(Payload::time)&& time) {
+    Payload result;
+    result.frequency = payload::frequency(frequency);
+    result.series = payload::series(series);
+    result.delay = payload::delay(delay);
+    result.time = std::move(time);
+    result.time.shrink_to_fit();
+
+    return result;
+}
+
+// time values that did not fit into the arena are discarded, never send incomplete message
+bool valid(const Payload& payload) {
+    return payload.time.size() && !payload.time.overflow();
+}
+
+#include "ir_parse_raw.re.ipp"
+
+} // namespace raw
+
+namespace state {
+
+// State messages transmit an arbitrary amount of bytes, by using the assosicated protocol method
+// Repeats are intended to be handled via the respective PROTOCOL method automatically
+// (and, there's no reliable way besides linking every type with it's method from our side)
+//
+// Transmitting:
+//   Payload: <protocol>:<value>[:<series>][:<delay>]
+//
+//   Required parameters:
+//     PROTOCOL - decimal ID, will be converted into a named 'decode_type_t'
+//                (ref. IRremoteESP8266.h and it's protocol descriptions)
+//     VALUE    - hexadecimal representation of the value that will be sent
+//                (big endian, maximum depends on the protocol settings)
+//
+//   Optional payload parameters:
+//     SERIES   - how many times the message will be scheduled for sending
+//                (defaults to 1 aka once, [1...120))
+//     DELAY    - minimum amount of time (ms) between queued messages
+//                (defaults is IR_TX_DELAY, applies to every message in the series)
+//
+// Receiving:
+//   Payload: 52:112233445566778899AABB (<protocol>:<value>)
+
+using Value = Buffer<uint8_t>;
+
+struct Payload {
+    decode_type_t type;
+    Value value;
+    uint8_t series;
+    unsigned long delay;
+};
+
+namespace value {
+
+String encode(const uint8_t* begin, const uint8_t* end) {
+    return hexEncode(begin, end);
+}
+
+template <typename T>
+String encode(T&& range) {
+    return hexEncode(range.begin(), range.end());
+}
+
+Value decode(StringView view) {
+    Value out;
+    if (!(view.length() % 2)) {
+        out.resize(view.length() / 2, static_cast<uint8_t>(0));
+        if (out.size()) {
+            hexDecode(view.begin(), view.end(),
+                    out.data(), out.data() + out.size());
+        }
+    }
+
+    return out;
+}
+
+} // namespace value
+
+Payload prepare(StringView type, StringView value, StringView series, StringView delay) {
+    Payload result;
+    result.type = espurna::ir::simple::payload::type(type);
+    result.value = value::decode(value);
+
+    if (series.length()) {
+        result.series = simple::payload::series(series);
+    } else {
+        result.series = tx::internal::series;
+    }
+
+    if (delay.length()) {
+        result.delay = simple::payload::delay(delay);
+    } else {
+        result.delay = tx::internal::delay;
+    }
+
+    return result;
+}
+
+bool valid(const Payload& payload) {
+    return payload.value.size() && !payload.value.overflow();
+}
+
+#include "ir_parse_state.re.ipp"
+
+} // namespace state
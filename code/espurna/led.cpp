@@ -1088,7 +1088,7 @@ void setup() {
         systemBeforeSleep(turn_off);
         systemAfterSleep(schedule);
 
-        ::espurnaRegisterLoop(loop);
+        ::espurnaRegisterLoop(loop, STRING_VIEW("led"));
 
         ::espurnaRegisterReload(configure);
         configure();
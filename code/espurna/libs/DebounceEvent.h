@@ -87,6 +87,7 @@ class EventEmitter {
 
         types::Event loop();
         bool isPressed();
+        bool isPending() const;
 
         const BasePinPtr& pin() const;
         const types::Config& config() const;
@@ -36,6 +36,11 @@ void pwm_start(void);
 
 void pwm_set_duty(uint32_t duty, uint8_t channel);
 uint32_t pwm_get_duty(uint8_t channel);
+
+/* same as above, but duty is (1 << pwm_get_dither_bits()) times finer */
+void pwm_set_duty_dithered(uint32_t duty, uint8_t channel);
+uint32_t pwm_get_duty_dithered(uint8_t channel);
+uint8_t pwm_get_dither_bits(void);
 void pwm_set_period(uint32_t period);
 uint32_t pwm_get_period(void);
 
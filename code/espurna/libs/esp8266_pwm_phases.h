@@ -0,0 +1,176 @@
+/*
+ * https://github.com/StefanBruens/ESP8266_new_pwm
+ * Copyright (C) 2016 Stefan Brüns <stefan.bruens@rwth-aachen.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+// Phase table computation of the esp8266_pwm.c, kept separate from the
+// timer and GPIO handling so it could be built and tested on the host
+
+#pragma once
+
+#include <stdint.h>
+
+struct pwm_phase {
+	uint32_t ticks;    ///< delay until next phase, in 200ns units
+	uint16_t on_mask;  ///< GPIO mask to switch on
+	uint16_t off_mask; ///< GPIO mask to switch off
+};
+
+/* Dithered duty is (1 << bits) times finer than the timer tick. Every frame
+ * (i.e. every PWM period) gets either the lower or the upper tick value, and
+ * the sum of ticks across all of the frames is exactly the requested duty.
+ * Frame number is bit-reversed, so the upper values are spread evenly across
+ * the frames instead of being grouped together at the end
+ */
+static inline uint32_t
+pwm_dither_ticks(uint32_t duty, uint8_t frame, uint8_t bits)
+{
+	uint8_t reversed = 0;
+	uint8_t n;
+
+	for (n = 0; n < bits; n++) {
+		reversed = (reversed << 1) | ((frame >> n) & 1);
+	}
+
+	return (duty + reversed) >> bits;
+}
+
+/* Fills at most (channels + 2) phases, returns the index of the last phase.
+ * Every phase except the last one contains a GPIO mask change and the number
+ * of ticks until the next phase. Last phase has zero ticks and empty masks.
+ * When only 0% and 100% duty values are used, there is only a single phase.
+ */
+static inline uint8_t
+pwm_phases_prep(struct pwm_phase* pwm, const uint32_t* duty_ticks,
+		const uint16_t* gpio_mask, uint8_t channels, uint32_t period_ticks)
+{
+	uint8_t n, phases;
+
+	for (n = 0; n < channels + 2; n++) {
+		pwm[n].ticks = 0;
+		pwm[n].on_mask = 0;
+		pwm[n].off_mask = 0;
+	}
+	phases = 1;
+	for (n = 0; n < channels; n++) {
+		uint32_t ticks = duty_ticks[n];
+		if (ticks == 0) {
+			pwm[0].off_mask |= gpio_mask[n];
+		} else if (ticks >= period_ticks) {
+			pwm[0].on_mask |= gpio_mask[n];
+		} else {
+			if (ticks < (period_ticks/2)) {
+				pwm[phases].ticks = ticks;
+				pwm[0].on_mask |= gpio_mask[n];
+				pwm[phases].off_mask = gpio_mask[n];
+			} else {
+				pwm[phases].ticks = period_ticks - ticks;
+				pwm[phases].on_mask = gpio_mask[n];
+				pwm[0].off_mask |= gpio_mask[n];
+			}
+			phases++;
+		}
+	}
+	pwm[phases].ticks = period_ticks;
+
+	// bubble sort, lowest to hightest duty
+	n = 2;
+	while (n < phases) {
+		if (pwm[n].ticks < pwm[n - 1].ticks) {
+			struct pwm_phase t = pwm[n];
+			pwm[n] = pwm[n - 1];
+			pwm[n - 1] = t;
+			if (n > 2)
+				n--;
+		} else {
+			n++;
+		}
+	}
+
+	// shift left to align right edge;
+	uint8_t l = 0, r = 1;
+	while (r <= phases) {
+		uint32_t diff = pwm[r].ticks - pwm[l].ticks;
+		if (diff && (diff <= 16)) {
+			uint16_t mask = pwm[r].on_mask | pwm[r].off_mask;
+			pwm[l].off_mask ^= pwm[r].off_mask;
+			pwm[l].on_mask ^= pwm[r].on_mask;
+			pwm[0].off_mask ^= pwm[r].on_mask;
+			pwm[0].on_mask ^= pwm[r].off_mask;
+			pwm[r].ticks = period_ticks - diff;
+			pwm[r].on_mask ^= mask;
+			pwm[r].off_mask ^= mask;
+		} else {
+			l = r;
+		}
+		r++;
+	}
+
+	// sort again
+	n = 2;
+	while (n <= phases) {
+		if (pwm[n].ticks < pwm[n - 1].ticks) {
+			struct pwm_phase t = pwm[n];
+			pwm[n] = pwm[n - 1];
+			pwm[n - 1] = t;
+			if (n > 2)
+				n--;
+		} else {
+			n++;
+		}
+	}
+
+	// merge same duty
+	l = 0, r = 1;
+	while (r <= phases) {
+		if (pwm[r].ticks == pwm[l].ticks) {
+			pwm[l].off_mask |= pwm[r].off_mask;
+			pwm[l].on_mask |= pwm[r].on_mask;
+			pwm[r].on_mask = 0;
+			pwm[r].off_mask = 0;
+		} else {
+			l++;
+			if (l != r) {
+				struct pwm_phase t = pwm[l];
+				pwm[l] = pwm[r];
+				pwm[r] = t;
+			}
+		}
+		r++;
+	}
+	phases = l;
+
+	// transform absolute end time to phase durations
+	for (n = 0; n < phases; n++) {
+		pwm[n].ticks =
+			pwm[n + 1].ticks - pwm[n].ticks;
+		// subtract common overhead
+		pwm[n].ticks--;
+	}
+	pwm[phases].ticks = 0;
+
+	// do a cyclic shift if last phase is short
+	if (pwm[phases - 1].ticks < 16) {
+		for (n = 0; n < phases - 1; n++) {
+			struct pwm_phase t = pwm[n];
+			pwm[n] = pwm[n + 1];
+			pwm[n + 1] = t;
+		}
+	}
+
+	return phases;
+}
@@ -3716,7 +3716,7 @@ void lightSetup() {
         _lightUpdate();
         _lightProviderUpdate();
         _lightPostLoop();
-    });
+    }, STRING_VIEW("light"));
 }
 
 #endif // LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
@@ -310,7 +310,7 @@ void setup() {
     terminal::setup();
 #endif
 
-    ::espurnaRegisterLoop(ButtonPin::loop);
+    ::espurnaRegisterLoop(ButtonPin::loop, STRING_VIEW("lightfox"));
 }
 
 } // namespace
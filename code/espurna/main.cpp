@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <array>
 #include <utility>
 
 #include "main.h"
@@ -48,6 +49,12 @@ constexpr espurna::duration::Milliseconds loopDelay() {
     return espurna::duration::Milliseconds { LOOP_DELAY_TIME };
 }
 
+#if LOOP_TICKLESS_SUPPORT
+// Plain loop callbacks are not aware of the deadlines,
+// make sure they are still called every once in a while
+constexpr espurna::duration::Milliseconds LoopTicklessMax { LOOP_TICKLESS_MAX };
+#endif
+
 } // namespace build
 
 namespace settings {
@@ -68,9 +75,25 @@ namespace internal {
 std::vector<LoopCallback> reload_callbacks;
 bool reload_flag { false };
 
-std::vector<LoopCallback> loop_callbacks;
+struct Loop {
+    LoopCallback callback;
+    LoopDeadlineCallback deadline;
+    StringView name;
+
+    // only used with the deadline callback,
+    // time of the last call and the requested wait after it
+    time::CoreClock::time_point last;
+    duration::Milliseconds wait;
+};
+
+std::vector<Loop> loop_callbacks;
 espurna::duration::Milliseconds loop_delay { build::LoopDelayMin };
 
+#if LOOP_TICKLESS_SUPPORT
+// set from timer and interrupt contexts, consumed at the start of the loop
+volatile bool loop_wake { true };
+#endif
+
 std::forward_list<Callback> once_callbacks;
 
 } // namespace internal
@@ -92,8 +115,104 @@ void push_reload(ReloadCallback callback) {
     internal::reload_callbacks.push_back(callback);
 }
 
-void push_loop(LoopCallback callback) {
-    internal::loop_callbacks.push_back(callback);
+#if LOOP_PROFILER_SUPPORT
+namespace profiler {
+
+void push();
+
+} // namespace profiler
+#endif
+
+void push_loop(internal::Loop&& loop) {
+    internal::loop_callbacks.push_back(std::move(loop));
+#if LOOP_PROFILER_SUPPORT
+    profiler::push();
+#endif
+}
+
+void push_loop(LoopCallback callback, StringView name) {
+    push_loop(
+        internal::Loop{
+            .callback = callback,
+            .deadline = nullptr,
+            .name = name,
+            .last = {},
+            .wait = {},
+        });
+}
+
+void push_loop(LoopDeadlineCallback callback, StringView name) {
+    push_loop(
+        internal::Loop{
+            .callback = nullptr,
+            .deadline = callback,
+            .name = name,
+            .last = {},
+            .wait = duration::Milliseconds::zero(),
+        });
+}
+
+// Deadline callbacks are only called when the previously requested wait is over,
+// or when something external woke up the loop. Plain callbacks are always called.
+// Returns `false` when the callback was skipped
+bool run(internal::Loop& loop, time::CoreClock::time_point now, bool wake) {
+    if (loop.callback) {
+        loop.callback();
+        return true;
+    }
+
+    if (!wake && (now - loop.last < loop.wait)) {
+        return false;
+    }
+
+    loop.wait = loop.deadline();
+    loop.last = time::CoreClock::now();
+
+    return true;
+}
+
+#if LOOP_TICKLESS_SUPPORT
+bool consume_wake() {
+    noInterrupts();
+    const bool out = internal::loop_wake;
+    internal::loop_wake = false;
+    interrupts();
+
+    return out;
+}
+
+// Wait until the nearest deadline, but no longer than the maximum.
+// Sleep will end early when woken up either by the SDK or by the espurnaLoopWake()
+duration::Milliseconds next_delay() {
+    if (internal::loop_wake || !internal::once_callbacks.empty()) {
+        return duration::Milliseconds::zero();
+    }
+
+    auto out = build::LoopTicklessMax;
+
+    const auto now = time::CoreClock::now();
+    for (const auto& loop : internal::loop_callbacks) {
+        if (!loop.deadline) {
+            continue;
+        }
+
+        const auto elapsed = now - loop.last;
+        if (elapsed >= loop.wait) {
+            return duration::Milliseconds::zero();
+        }
+
+        out = std::min(out, loop.wait - elapsed);
+    }
+
+    return out;
+}
+#endif
+
+void IRAM_ATTR wake() {
+#if LOOP_TICKLESS_SUPPORT
+    internal::loop_wake = true;
+    esp_schedule();
+#endif
 }
 
 duration::Milliseconds loop_delay() {
@@ -106,6 +225,7 @@ void loop_delay(duration::Milliseconds value) {
 
 void push_once(Callback callback) {
     internal::once_callbacks.push_front(std::move(callback));
+    wake();
 }
 
 void push_once_unique(Callback::Type callback) {
@@ -126,6 +246,235 @@ void push_once_unique(Callback::Type callback) {
     push_once(Callback(callback));
 }
 
+#if LOOP_PROFILER_SUPPORT
+namespace profiler {
+namespace build {
+
+constexpr espurna::duration::Milliseconds budget() {
+    return espurna::duration::Milliseconds { LOOP_PROFILER_BUDGET };
+}
+
+} // namespace build
+
+namespace settings {
+namespace keys {
+
+PROGMEM_STRING(Budget, "loopBudget");
+
+} // namespace keys
+
+espurna::duration::Milliseconds budget() {
+    return getSetting(keys::Budget, build::budget());
+}
+
+} // namespace settings
+
+// Execution time histogram of a single loop callback, in microseconds.
+// Buckets are power-of-two sized, starting at 64us: [0,64), [64,128), ..., [16384,inf)
+class Timings {
+public:
+    static constexpr size_t Buckets = 10;
+    static constexpr uint32_t BucketShift = 6;
+
+    void add(uint32_t value) {
+        ++_count;
+        _sum += value;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+
+        size_t bucket = 0;
+        for (uint32_t tmp = value >> BucketShift; tmp && (bucket < (Buckets - 1)); tmp >>= 1) {
+            ++bucket;
+        }
+
+        ++_buckets[bucket];
+    }
+
+    void overrun() {
+        ++_overruns;
+    }
+
+    void reset() {
+        *this = Timings();
+    }
+
+    uint32_t count() const { return _count; }
+    uint32_t overruns() const { return _overruns; }
+    uint32_t min() const { return _count ? _min : 0; }
+    uint32_t max() const { return _max; }
+    uint32_t avg() const { return _count ? static_cast<uint32_t>(_sum / _count) : 0; }
+
+    // upper boundary of the bucket containing the requested percentile
+    // (or the maximum, when it ends up in the last bucket)
+    uint32_t percentile(uint32_t value) const {
+        const auto target = (static_cast<uint64_t>(_count) * value + 99) / 100;
+
+        uint64_t total = 0;
+        for (size_t index = 0; index < (Buckets - 1); ++index) {
+            total += _buckets[index];
+            if (total && (total >= target)) {
+                return std::min(_max, (1u << (BucketShift + index)) - 1);
+            }
+        }
+
+        return _max;
+    }
+
+private:
+    std::array<uint32_t, Buckets> _buckets{};
+    uint64_t _sum = 0;
+    uint32_t _count = 0;
+    uint32_t _overruns = 0;
+    uint32_t _min = std::numeric_limits<uint32_t>::max();
+    uint32_t _max = 0;
+};
+
+namespace internal {
+
+// same order as loop callbacks
+std::vector<Timings> timings;
+espurna::duration::Microseconds budget { build::budget() };
+
+} // namespace internal
+
+void push() {
+    internal::timings.emplace_back();
+}
+
+void configure() {
+    internal::budget = settings::budget();
+}
+
+String name(const main::internal::Loop& loop) {
+    if (loop.name.length()) {
+        return loop.name.toString();
+    }
+
+    char buffer[16];
+    snprintf_P(buffer, sizeof(buffer), PSTR("%p"),
+        loop.callback
+            ? reinterpret_cast<void*>(loop.callback)
+            : reinterpret_cast<void*>(loop.deadline));
+
+    return buffer;
+}
+
+void reset() {
+    for (auto& timings : internal::timings) {
+        timings.reset();
+    }
+}
+
+void loop(bool wake) {
+    auto& callbacks = main::internal::loop_callbacks;
+    const auto budget = static_cast<uint32_t>(internal::budget.count());
+
+    const auto now = time::CoreClock::now();
+    for (size_t index = 0; index < callbacks.size(); ++index) {
+        auto& loop = callbacks[index];
+
+        const auto start = micros();
+        if (!run(loop, now, wake)) {
+            continue;
+        }
+        const uint32_t elapsed = micros() - start;
+
+        auto& timings = internal::timings[index];
+        timings.add(elapsed);
+
+        if (budget && (elapsed > budget)) {
+            timings.overrun();
+            DEBUG_MSG_P(PSTR("[MAIN] Loop callback %s took %u (us), over the budget of %u (us)\n"),
+                name(loop).c_str(), elapsed, budget);
+        }
+    }
+}
+
+#if TERMINAL_SUPPORT
+namespace terminal {
+
+PROGMEM_STRING(Loop, "LOOP");
+
+void loop(::terminal::CommandContext&& ctx) {
+    if ((ctx.argv.size() == 2) && (ctx.argv[1] == F("reset"))) {
+        reset();
+        terminalOK(ctx);
+        return;
+    }
+
+    const auto& callbacks = main::internal::loop_callbacks;
+    for (size_t index = 0; index < callbacks.size(); ++index) {
+        const auto& timings = internal::timings[index];
+        ctx.output.printf_P(
+            PSTR("%-14s count:%u min:%u avg:%u p99:%u max:%u overruns:%u\n"),
+            name(callbacks[index]).c_str(),
+            timings.count(), timings.min(), timings.avg(),
+            timings.percentile(99), timings.max(), timings.overruns());
+    }
+
+    ctx.output.printf_P(PSTR("Time in (us), budget is %u (ms)\n"),
+        static_cast<uint32_t>(
+            std::chrono::duration_cast<espurna::duration::Milliseconds>(internal::budget).count()));
+    terminalOK(ctx);
+}
+
+static constexpr ::terminal::Command Commands[] PROGMEM {
+    {Loop, loop},
+};
+
+void setup() {
+    espurna::terminal::add(Commands);
+}
+
+} // namespace terminal
+#endif
+
+#if API_SUPPORT
+namespace api {
+
+void setup() {
+    apiRegister(F("loop"),
+        [](ApiRequest&, JsonObject& root) {
+            JsonArray& loops = root.createNestedArray("loop");
+
+            const auto& callbacks = main::internal::loop_callbacks;
+            for (size_t index = 0; index < callbacks.size(); ++index) {
+                const auto& timings = internal::timings[index];
+
+                JsonObject& entry = loops.createNestedObject();
+                entry["name"] = name(callbacks[index]);
+                entry["count"] = timings.count();
+                entry["min"] = timings.min();
+                entry["avg"] = timings.avg();
+                entry["p99"] = timings.percentile(99);
+                entry["max"] = timings.max();
+                entry["overruns"] = timings.overruns();
+            }
+
+            return true;
+        },
+        nullptr
+    );
+}
+
+} // namespace api
+#endif
+
+void setup() {
+    configure();
+    espurnaRegisterReload(configure);
+
+#if TERMINAL_SUPPORT
+    terminal::setup();
+#endif
+#if API_SUPPORT
+    api::setup();
+#endif
+}
+
+} // namespace profiler
+#endif
+
 void loop() {
     // Reload config before running any callbacks
     if (check_reload()) {
@@ -134,11 +483,23 @@ void loop() {
         }
     }
 
+    // Without tickless mode, every callback runs on every iteration
+#if LOOP_TICKLESS_SUPPORT
+    const bool wake = consume_wake();
+#else
+    constexpr bool wake = true;
+#endif
+
     // Loop callbacks, registered some time in setup()
     // Notice that everything is in order of registration
-    for (const auto& callback : internal::loop_callbacks) {
-        callback();
+#if LOOP_PROFILER_SUPPORT
+    profiler::loop(wake);
+#else
+    const auto now = time::CoreClock::now();
+    for (auto& loop : internal::loop_callbacks) {
+        run(loop, now, wake);
     }
+#endif
 
     // One-time callbacks, registered some time during runtime
     // Notice that callback container is LIFO, most recently added
@@ -152,7 +513,11 @@ void loop() {
         }
     }
 
+#if LOOP_TICKLESS_SUPPORT
+    espurna::time::delay(next_delay());
+#else
     espurna::time::delay(internal::loop_delay);
+#endif
 }
 
 void setup() {
@@ -243,6 +608,7 @@ void setup() {
 
     #if API_SUPPORT
         apiSetup();
+        wifiApiSetup();
     #endif
 
     // Run terminal command and send back the result
@@ -369,6 +735,10 @@ void setup() {
         extraSetup();
     #endif
     
+    #if LOOP_PROFILER_SUPPORT
+        profiler::setup();
+    #endif
+
     // Update `cfg` version
     migrate();
 
@@ -394,8 +764,16 @@ void espurnaRegisterReload(LoopCallback callback) {
     espurna::main::push_reload(callback);
 }
 
-void espurnaRegisterLoop(LoopCallback callback) {
-    espurna::main::push_loop(callback);
+void espurnaRegisterLoop(LoopCallback callback, espurna::StringView name) {
+    espurna::main::push_loop(callback, name);
+}
+
+void espurnaRegisterLoop(LoopDeadlineCallback callback, espurna::StringView name) {
+    espurna::main::push_loop(callback, name);
+}
+
+void IRAM_ATTR espurnaLoopWake() {
+    espurna::main::wake();
 }
 
 void espurnaReload() {
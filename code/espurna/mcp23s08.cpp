@@ -46,6 +46,25 @@ static uint8_t  _mcp23s08RxData[16]  __attribute__((aligned(4)));
 
 namespace {
 
+// Register snapshot of the whole port, so pins do not have to talk to the expander
+// on every call. Every pin read shares a single GPIO read, which only happens once
+// per loop() or, when the INT pin is connected, only after some input has changed.
+// Pin writes are applied right away, and OLAT is only written when it actually changes.
+// Multiple writes can be combined into a single one with MCP23S08Begin() & MCP23S08End()
+namespace internal {
+
+uint8_t iodir { 0xff };
+uint8_t gpio { 0 };
+bool gpio_valid { false };
+
+uint8_t olat { 0 };
+uint8_t olat_written { 0 };
+uint8_t batch { 0 };
+
+unsigned char int_pin { GPIO_NONE };
+
+} // namespace internal
+
 class GpioMcp23s08 : public GpioBase {
 public:
     constexpr static size_t Pins { 8ul };
@@ -95,6 +114,78 @@ void MCP23S08Setup()
 
     pinMode(MCP23S08_CS_PIN, OUTPUT);
     digitalWrite(MCP23S08_CS_PIN, HIGH);
+
+    // Keep whatever state expander had before, e.g. after soft reset
+    internal::iodir = MCP23S08ReadRegister(IODIR);
+    internal::olat = MCP23S08ReadRegister(OLAT);
+    internal::olat_written = internal::olat;
+
+    // INT is active-low and stays that way until GPIO is read, so it is enough
+    // to check its level. Interrupt happens when input differs from its previous value
+    const unsigned char int_pin = MCP23S08_INT_PIN;
+    if ((int_pin != GPIO_NONE) && gpioLock(int_pin))
+    {
+        DEBUG_MSG_P(PSTR("[MCP23S08] Using GPIO%hhu as INT\n"), int_pin);
+        pinMode(int_pin, INPUT);
+        internal::int_pin = int_pin;
+
+        MCP23S08WriteRegister(IOCON, 0);
+        MCP23S08WriteRegister(INTCON, 0);
+        MCP23S08WriteRegister(GPINTEN, internal::iodir);
+    }
+
+    espurnaRegisterLoop(MCP23S08Loop, STRING_VIEW("mcp23s08"));
+}
+
+/**
+ * @brief Refresh the port snapshot.
+ *
+ * @return void
+ */
+void MCP23S08Loop()
+{
+    if ((internal::int_pin == GPIO_NONE)
+        || (digitalRead(internal::int_pin) == LOW))
+    {
+        internal::gpio_valid = false;
+    }
+}
+
+/**
+ * @brief Defer pin writes until the matching MCP23S08End().
+ *
+ * @return void
+ */
+void MCP23S08Begin()
+{
+    ++internal::batch;
+}
+
+/**
+ * @brief Write every pin changed since the MCP23S08Begin() at once.
+ *
+ * @return void
+ */
+void MCP23S08End()
+{
+    if (internal::batch && !--internal::batch)
+    {
+        MCP23S08Flush();
+    }
+}
+
+/**
+ * @brief Write OLAT register, when any of the pins changed since the last write.
+ *
+ * @return void
+ */
+void MCP23S08Flush()
+{
+    if (internal::olat != internal::olat_written)
+    {
+        MCP23S08WriteRegister(OLAT, internal::olat);
+        internal::olat_written = internal::olat;
+    }
 }
 
 /**
@@ -107,7 +198,7 @@ void MCP23S08Setup()
  */
 void MCP23S08SetDirection(uint8_t pinNumber, uint8_t mode)
 {
-    uint8_t registerData = MCP23S08ReadRegister(IODIR);
+    uint8_t registerData = internal::iodir;
 
     if (INPUT == mode)
     {
@@ -118,7 +209,23 @@ void MCP23S08SetDirection(uint8_t pinNumber, uint8_t mode)
         registerData &= ~(1 << pinNumber);
     }
 
+    if (registerData == internal::iodir)
+    {
+        return;
+    }
+
+    // Output level must be known before the pin switches to output
+    MCP23S08Flush();
+
+    internal::iodir = registerData;
     MCP23S08WriteRegister(IODIR, registerData);
+
+    if (internal::int_pin != GPIO_NONE)
+    {
+        MCP23S08WriteRegister(GPINTEN, registerData);
+    }
+
+    internal::gpio_valid = false;
 }
 
 /**
@@ -169,22 +276,24 @@ void MCP23S08WriteRegister(uint8_t address, uint8_t data)
  */
 void MCP23S08SetPin(uint8_t pinNumber, bool state)
 {
-    uint8_t registerData = MCP23S08ReadRegister(OLAT);
-
     if (state)
     {
-        registerData |= (1 << pinNumber);
+        internal::olat |= (1 << pinNumber);
     }
     else
     {
-        registerData &= ~(1 << pinNumber);
+        internal::olat &= ~(1 << pinNumber);
     }
 
-    MCP23S08WriteRegister(OLAT, registerData);
+    if (!internal::batch)
+    {
+        MCP23S08Flush();
+    }
 }
 
 /**
  * @brief Get MCP23S08 pin state.
+ * Inputs are read from the port snapshot, outputs from the OLAT value.
  *
  * @param pinNumber The number of pin to get.
  *
@@ -192,9 +301,19 @@ void MCP23S08SetPin(uint8_t pinNumber, bool state)
  */
 bool MCP23S08GetPin(uint8_t pinNumber)
 {
-    uint8_t registerData = MCP23S08ReadRegister(GPIO);
+    const uint8_t mask = (1 << pinNumber);
+    if (!(internal::iodir & mask))
+    {
+        return internal::olat & mask;
+    }
+
+    if (!internal::gpio_valid)
+    {
+        internal::gpio = MCP23S08ReadRegister(GPIO);
+        internal::gpio_valid = true;
+    }
 
-    return registerData & (1 << pinNumber);
+    return internal::gpio & mask;
 }
 
 /**
@@ -20,6 +20,25 @@ Copyright (C) 2016 Plamen Kovandjiev <p.kovandiev@kmpelectronics.eu> & Dimitar A
 constexpr size_t McpGpioPins = 8;
 
 void MCP23S08Setup();
+void MCP23S08Loop();
+void MCP23S08Flush();
+
+// Pin writes between Begin() and End() are written to the expander all at once
+void MCP23S08Begin();
+void MCP23S08End();
+
+struct MCP23S08Batch {
+    MCP23S08Batch() {
+        MCP23S08Begin();
+    }
+
+    ~MCP23S08Batch() {
+        MCP23S08End();
+    }
+
+    MCP23S08Batch(const MCP23S08Batch&) = delete;
+    MCP23S08Batch& operator=(const MCP23S08Batch&) = delete;
+};
 
 uint8_t MCP23S08ReadRegister(uint8_t address);
 void MCP23S08WriteRegister(uint8_t address, uint8_t data);
@@ -72,7 +72,7 @@ void start() {
         addServices();
         espurnaRegisterLoop([]() {
             MDNS.update();
-        });
+        }, STRING_VIEW("mdns"));
         return;
     }
 
@@ -0,0 +1,365 @@
+/*
+
+MODBUS RTU MASTER
+
+Based on:
+- http://www.modbus.org/docs/Modbus_Application_Protocol_V1_1b3.pdf
+- http://www.modbus.org/docs/Modbus_over_serial_line_V1_02.pdf
+
+Copyright (C) 2020 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "types.h"
+
+namespace espurna {
+namespace modbus {
+
+// per MODBUS application protocol specification
+// > 4.1 Protocol description
+// > ...
+// > The size of the MODBUS PDU is limited by the size constraint inherited from the first
+// > MODBUS implementation on Serial Line network (max. RS485 ADU = 256 bytes).
+// However, we only ever expect very small payloads. Up to 13 registers at the same time.
+static constexpr size_t FrameSize { 32 };
+
+static constexpr uint8_t BroadcastAddress { 0 };
+static constexpr uint8_t ExceptionMask { 0x80 };
+
+static constexpr uint8_t ReadCoils { 0x01 };
+static constexpr uint8_t ReadDiscreteInputs { 0x02 };
+static constexpr uint8_t ReadHoldingRegisters { 0x03 };
+static constexpr uint8_t ReadInputRegisters { 0x04 };
+static constexpr uint8_t WriteSingleCoil { 0x05 };
+static constexpr uint8_t WriteSingleRegister { 0x06 };
+static constexpr uint8_t WriteMultipleCoils { 0x0f };
+static constexpr uint8_t WriteMultipleRegisters { 0x10 };
+
+// - generator polynomial is X16 + X15 + X2 +1, the polynomial value used for calculation is 0xA001.
+// - note that we use a simple function instead of a table to save space and RAM.
+inline uint16_t crc16(const uint8_t* data, size_t size) {
+    uint16_t crc = 0xffff;
+    for (size_t index = 0; index < size; ++index) {
+        crc ^= static_cast<uint16_t>(data[index]);
+        for (size_t bit = 0; bit < 8; ++bit) {
+            if (crc & 1) {
+                crc = (crc >> 1) ^ 0xa001;
+            } else {
+                crc = (crc >> 1);
+            }
+        }
+    }
+
+    return crc;
+}
+
+// Serial line ADU, including the address and CRC
+struct Frame {
+    using Buffer = std::array<uint8_t, FrameSize>;
+
+    uint8_t address() const {
+        return size ? buffer[0] : 0;
+    }
+
+    uint8_t code() const {
+        return (size > 1) ? buffer[1] : 0;
+    }
+
+    bool exception() const {
+        return (code() & ExceptionMask) > 0;
+    }
+
+    // Note that CRC order is reversed in comparison to every other value
+    bool valid() const {
+        if (size < 4) {
+            return false;
+        }
+
+        const auto received = static_cast<uint16_t>(buffer[size - 1] << 8)
+            | static_cast<uint16_t>(buffer[size - 2]);
+
+        return received == crc16(buffer.data(), size - 2);
+    }
+
+    // 16bit big-endian value from the PDU data, starting right after the function code
+    uint16_t value(size_t offset) const {
+        offset += 2;
+        if ((offset + 1) < size) {
+            return static_cast<uint16_t>(buffer[offset] << 8)
+                | static_cast<uint16_t>(buffer[offset + 1]);
+        }
+
+        return 0;
+    }
+
+    const uint8_t* begin() const {
+        return buffer.data();
+    }
+
+    const uint8_t* end() const {
+        return buffer.data() + size;
+    }
+
+    Buffer buffer;
+    size_t size { 0 };
+};
+
+// Request ADU, CRC is appended by end(). Returned frame is empty when values did not fit
+struct Builder {
+    Builder(uint8_t address, uint8_t code) {
+        _frame.buffer[0] = address;
+        _frame.buffer[1] = code;
+        _frame.size = 2;
+    }
+
+    Builder& add(uint8_t value) {
+        if (_frame.size < _frame.buffer.size()) {
+            _frame.buffer[_frame.size] = value;
+            _frame.size += 1;
+        } else {
+            _overflow = true;
+        }
+
+        return *this;
+    }
+
+    Builder& add(uint16_t value) {
+        add(static_cast<uint8_t>((value >> 8) & 0xff));
+        add(static_cast<uint8_t>(value & 0xff));
+        return *this;
+    }
+
+    Frame end() {
+        const auto crc = crc16(_frame.buffer.data(), _frame.size);
+        add(static_cast<uint8_t>(crc & 0xff));
+        add(static_cast<uint8_t>((crc >> 8) & 0xff));
+
+        if (_overflow) {
+            return Frame{};
+        }
+
+        return _frame;
+    }
+
+private:
+    Frame _frame{};
+    bool _overflow { false };
+};
+
+enum class Error {
+    None,
+    Invalid,
+    QueueFull,
+    Timeout,
+    Crc,
+    Exception,
+};
+
+// Size of the response, as it is known from the request.
+// Unknown function codes are expected to echo the request back.
+inline size_t expect(const Frame& request) {
+    switch (request.code()) {
+    case ReadCoils:
+    case ReadDiscreteInputs:
+        return 5 + ((request.value(2) + 7) / 8);
+    case ReadHoldingRegisters:
+    case ReadInputRegisters:
+        return 5 + (2 * request.value(2));
+    case WriteSingleCoil:
+    case WriteSingleRegister:
+    case WriteMultipleCoils:
+    case WriteMultipleRegisters:
+        return 8;
+    }
+
+    return request.size;
+}
+
+// Asynchronous master, driven by the tick() from the main loop. Requests are queued and sent
+// one at a time, and every one of them is completed by either the matching response or a timeout.
+// Multiple devices (aka slaves) can share the same serial line, as long as addresses are unique.
+// Response bytes not coming from the requested address are dropped.
+// Bus is expected to be quiet for the 'silence' period before the next request is sent.
+// (3.5 character times, 4ms when using 9600 baud)
+class Master {
+public:
+    using Callback = std::function<void(Error, const Frame&)>;
+
+    static constexpr size_t QueueSize { 8 };
+
+    Master(Stream& port, duration::Milliseconds timeout, duration::Milliseconds silence) :
+        _port(port),
+        _timeout(timeout),
+        _silence(silence)
+    {}
+
+    Master(const Master&) = delete;
+    Master& operator=(const Master&) = delete;
+
+    // Callback is always called from the tick(). Frame is only valid during the call
+    Error send(Frame request, Callback callback) {
+        if (!request.size || (expect(request) > FrameSize)) {
+            return Error::Invalid;
+        }
+
+        if (_queue.size() >= QueueSize) {
+            return Error::QueueFull;
+        }
+
+        _queue.push_back(
+            Transaction{std::move(request), std::move(callback)});
+
+        return Error::None;
+    }
+
+    void tick(duration::Milliseconds now) {
+        switch (_state) {
+        case State::Idle:
+            idle(now);
+            break;
+        case State::Response:
+            response(now);
+            break;
+        }
+    }
+
+    // including the one that is currently in-flight
+    size_t pending() const {
+        return _queue.size();
+    }
+
+    bool busy() const {
+        return _state != State::Idle;
+    }
+
+    // does not call the callbacks
+    void clear() {
+        _queue.clear();
+        _state = State::Idle;
+    }
+
+private:
+    enum class State {
+        Idle,
+        Response,
+    };
+
+    struct Transaction {
+        Frame request;
+        Callback callback;
+    };
+
+    // consume any stray data and wait for the line to stay quiet before sending anything
+    void idle(duration::Milliseconds now) {
+        while (_port.available() > 0) {
+            _port.read();
+            _last = now;
+        }
+
+        if (_queue.empty() || ((now - _last) < _silence)) {
+            return;
+        }
+
+        const auto& request = _queue.front().request;
+        _port.write(request.begin(), request.size);
+
+        _last = now;
+        _start = now;
+
+        _response.size = 0;
+        if (request.address() == BroadcastAddress) {
+            complete(Error::None);
+            return;
+        }
+
+        _expect = expect(request);
+        _state = State::Response;
+    }
+
+    void response(duration::Milliseconds now) {
+        const auto& request = _queue.front().request;
+
+        while ((_response.size < _expect) && (_port.available() > 0)) {
+            const int c = _port.read();
+            if (c < 0) {
+                break;
+            }
+
+            _last = now;
+
+            const auto value = static_cast<uint8_t>(c);
+            switch (_response.size) {
+            case 0:
+                if (request.address() != value) {
+                    continue;
+                }
+                break;
+            case 1:
+                if ((request.code() | ExceptionMask) == value) {
+                    _expect = 5;
+                } else if (request.code() != value) {
+                    // in case this is the address, start over from this byte instead
+                    _response.size = (request.address() == value) ? 1 : 0;
+                    continue;
+                }
+                break;
+            }
+
+            _response.buffer[_response.size++] = value;
+        }
+
+        if (_response.size == _expect) {
+            if (!_response.valid()) {
+                complete(Error::Crc);
+            } else if (_response.exception()) {
+                complete(Error::Exception);
+            } else {
+                complete(Error::None);
+            }
+            return;
+        }
+
+        if ((now - _start) > _timeout) {
+            complete(Error::Timeout);
+        }
+    }
+
+    // callback is allowed to send() more requests
+    void complete(Error error) {
+        auto transaction = std::move(_queue.front());
+        _queue.pop_front();
+        _state = State::Idle;
+
+        if (transaction.callback) {
+            transaction.callback(error, _response);
+        }
+    }
+
+    Stream& _port;
+
+    duration::Milliseconds _timeout;
+    duration::Milliseconds _silence;
+
+    duration::Milliseconds _start{};
+    duration::Milliseconds _last{};
+
+    std::deque<Transaction> _queue;
+
+    State _state { State::Idle };
+
+    Frame _response{};
+    size_t _expect { 0 };
+};
+
+} // namespace modbus
+} // namespace espurna
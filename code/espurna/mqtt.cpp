@@ -1104,6 +1104,9 @@ bool _mqttHeartbeat(espurna::heartbeat::Mask mask) {
     if (mask & espurna::heartbeat::Report::Rssi)
         mqttSend(MQTT_TOPIC_RSSI, String(WiFi.RSSI()).c_str());
 
+    if (mask & espurna::heartbeat::Report::ConnectTime)
+        mqttSend(MQTT_TOPIC_CONNECT_TIME, String(wifiConnectTime().count(), 10).c_str());
+
     if (mask & espurna::heartbeat::Report::Uptime)
         mqttSend(MQTT_TOPIC_UPTIME, String(systemUptime().count()).c_str());
 
@@ -1366,29 +1369,27 @@ String mqttTopicSetter(const String& magnitude, size_t index) {
 
 // -----------------------------------------------------------------------------
 
-uint16_t mqttSendRaw(const char* topic, const char* message, bool retain, int qos) {
+uint16_t mqttSendRaw(const char* topic, const char* message, size_t length, bool retain, int qos) {
     if (_mqtt.connected()) {
         const unsigned int packetId {
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
-            _mqtt.publish(topic, qos, retain, message)
+            _mqtt.publish(topic, qos, retain, message, length)
 #elif MQTT_LIBRARY == MQTT_LIBRARY_ARDUINOMQTT
-            _mqtt.publish(topic, message, retain, qos)
+            _mqtt.publish(topic, message, length, retain, qos)
 #elif MQTT_LIBRARY == MQTT_LIBRARY_PUBSUBCLIENT
-            _mqtt.publish(topic, message, retain)
+            _mqtt.publish(topic, reinterpret_cast<const uint8_t*>(message), length, retain)
 #endif
         };
 
 #if DEBUG_SUPPORT
         {
-            const size_t len = strlen(message);
-
             auto begin = message;
-            auto end = message + len;
+            auto end = message + length;
 
-            if ((len > mqtt::build::MessageLogMax) || (end != std::find(begin, end, '\n'))) {
-                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => (%u bytes) (PID %u)\n"), topic, len, packetId);
+            if ((length > mqtt::build::MessageLogMax) || (end != std::find(begin, end, '\n'))) {
+                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => (%u bytes) (PID %u)\n"), topic, length, packetId);
             } else {
-                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => %s (PID %u)\n"), topic, message, packetId);
+                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => %.*s (PID %u)\n"), topic, static_cast<int>(length), message, packetId);
             }
         }
 #endif
@@ -1399,6 +1400,10 @@ uint16_t mqttSendRaw(const char* topic, const char* message, bool retain, int qo
     return false;
 }
 
+uint16_t mqttSendRaw(const char* topic, const char* message, bool retain, int qos) {
+    return mqttSendRaw(topic, message, strlen(message), retain, qos);
+}
+
 uint16_t mqttSendRaw(const char* topic, const char* message, bool retain) {
     return mqttSendRaw(topic, message, retain, _mqtt_settings.qos);
 }
@@ -1828,7 +1833,7 @@ void mqttSetup() {
     #endif
 
     // Main callbacks
-    espurnaRegisterLoop(mqttLoop);
+    espurnaRegisterLoop(mqttLoop, STRING_VIEW("mqtt"));
     espurnaRegisterReload(_mqttConfigure);
 
 }
@@ -24,6 +24,7 @@ Updated secure client support by Niek van der Maas < mail at niekvandermaas dot
 #define MQTT_TOPIC_IP               "ip"
 #define MQTT_TOPIC_SSID             "ssid"
 #define MQTT_TOPIC_BSSID            "bssid"
+#define MQTT_TOPIC_CONNECT_TIME     "conntime"
 #define MQTT_TOPIC_VERSION          "version"
 #define MQTT_TOPIC_UPTIME           "uptime"
 #define MQTT_TOPIC_DATETIME         "datetime"
@@ -74,6 +75,9 @@ String mqttTopicSetter(const String& magnitude, size_t index);
 
 espurna::StringView mqttMagnitude(espurna::StringView topic);
 
+// message does not have to be null-terminated
+uint16_t mqttSendRaw(const char * topic, const char * message, size_t length, bool retain, int qos);
+
 uint16_t mqttSendRaw(const char * topic, const char * message, bool retain, int qos);
 uint16_t mqttSendRaw(const char * topic, const char * message, bool retain);
 uint16_t mqttSendRaw(const char * topic, const char * message);
@@ -190,7 +190,7 @@ void nofussSetup() {
     #endif
 
     // Main callbacks
-    espurnaRegisterLoop(_nofussLoop);
+    espurnaRegisterLoop(_nofussLoop, STRING_VIEW("nofuss"));
     espurnaRegisterReload(_nofussConfigure);
 
 }
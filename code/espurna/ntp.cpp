@@ -31,6 +31,7 @@ static_assert(
     "lwip must be configured with SNTP_SERVER_DNS"
 );
 
+#include "datetime.h"
 #include "ntp.h"
 #include "ntp_timelib.h"
 #include "utils.h"
@@ -281,16 +282,43 @@ Result timestamp(const String& value) {
 namespace timelib {
 namespace internal {
 
-time_t last_timestamp { 0 };
-tm local;
-tm utc;
+// Most of the time, every consumer asks about the same second. Keep the last result around,
+// and only do the conversion once when the timestamp changes
+struct Cache {
+    time_t timestamp { 0 };
+    tm value{};
+    bool valid { false };
+};
+
+datetime::Local local_time;
+
+Cache local_cache;
+Cache utc_cache;
+
+const tm& local(time_t ts) {
+    if (!local_cache.valid || (local_cache.timestamp != ts)) {
+        local_cache.timestamp = ts;
+        local_cache.value = local_time(ts);
+        local_cache.valid = true;
+    }
+
+    return local_cache.value;
+}
 
-void cache(time_t value) {
-    if (last_timestamp != value) {
-        last_timestamp = value;
-        localtime_r(&last_timestamp, &local);
-        gmtime_r(&last_timestamp, &utc);
+const tm& utc(time_t ts) {
+    if (!utc_cache.valid || (utc_cache.timestamp != ts)) {
+        utc_cache.timestamp = ts;
+        utc_cache.value = datetime::utc(ts);
+        utc_cache.valid = true;
     }
+
+    return utc_cache.value;
+}
+
+// TZ was changed, local time is no longer valid
+void reset() {
+    local_time.reset();
+    local_cache.valid = false;
 }
 
 } // namespace internal
@@ -299,75 +327,61 @@ void cache(time_t value) {
 // This remains (mostly) for historical reasons, since we don't want to break existing config for no reason
 
 int hour(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_hour;
+    return internal::local(ts).tm_hour;
 }
 
 int minute(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_min;
+    return internal::local(ts).tm_min;
 }
 
 int second(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_sec;
+    return internal::local(ts).tm_sec;
 }
 
 int day(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_mday;
+    return internal::local(ts).tm_mday;
 }
 
 // `tm.tm_wday` range is 0..6, TimeLib is 1..7
 int weekday(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_wday + 1;
+    return internal::local(ts).tm_wday + 1;
 }
 
 // `tm.tm_mon` range is 0..11, TimeLib range is 1..12
 int month(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_mon + 1;
+    return internal::local(ts).tm_mon + 1;
 }
 
 int year(time_t ts) {
-    internal::cache(ts);
-    return internal::local.tm_year + 1900;
+    return internal::local(ts).tm_year + 1900;
 }
 
 int utc_hour(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_hour;
+    return internal::utc(ts).tm_hour;
 }
 
 int utc_minute(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_min;
+    return internal::utc(ts).tm_min;
 }
 
 int utc_second(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_sec;
+    return internal::utc(ts).tm_sec;
 }
 
 int utc_day(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_mday;
+    return internal::utc(ts).tm_mday;
 }
 
 int utc_weekday(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_wday + 1;
+    return internal::utc(ts).tm_wday + 1;
 }
 
 int utc_month(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_mon + 1;
+    return internal::utc(ts).tm_mon + 1;
 }
 
 int utc_year(time_t ts) {
-    internal::cache(ts);
-    return internal::utc.tm_year + 1900;
+    return internal::utc(ts).tm_year + 1900;
 }
 
 time_t now() {
@@ -428,8 +442,7 @@ String datetime(tm* timestruct) {
 }
 
 String datetime(time_t ts) {
-    tm timestruct;
-    localtime_r(&ts, &timestruct);
+    auto timestruct = timelib::internal::local(ts);
     return datetime(&timestruct);
 }
 
@@ -440,22 +453,18 @@ String datetime() {
 NtpInfo makeInfo() {
     NtpInfo result;
 
-    const auto sync = internal::status.timestamp();
-    tm sync_datetime{};
-    gmtime_r(&sync, &sync_datetime);
+    auto sync_datetime = espurna::datetime::utc(internal::status.timestamp());
     result.sync = datetime(&sync_datetime);
 
     const auto now = timelib::now();
     result.now = now;
 
-    tm now_datetime{};
-    gmtime_r(&now, &now_datetime);
+    auto now_datetime = timelib::internal::utc(now);
     result.utc = datetime(&now_datetime);
 
     const char* cfg_tz = getenv("TZ");
     if ((cfg_tz != nullptr) && (strcmp(cfg_tz, "UTC0") != 0)) {
-        tm local_datetime{};
-        localtime_r(&now, &local_datetime);
+        auto local_datetime = timelib::internal::local(now);
         result.local = datetime(&local_datetime);
         result.tz = cfg_tz;
     }
@@ -636,9 +645,10 @@ void callback() {
         return;
     }
 
+    // refresh the cache right away, subscribers are expected to ask about the same second
     const auto now = timelib::now();
-    tm local_tm;
-    localtime_r(&now, &local_tm);
+    const auto local_tm = timelib::internal::local(now);
+    timelib::internal::utc(now);
 
     int now_hour = local_tm.tm_hour;
     int now_minute = local_tm.tm_min;
@@ -766,6 +776,7 @@ void configure() {
             unsetenv("TZ");
         }
         tzset();
+        timelib::internal::reset();
     }
 
     const auto cfg_server = espurna::ntp::settings::server();
@@ -913,6 +924,14 @@ NtpInfo ntpInfo() {
     return ::espurna::ntp::makeInfo();
 }
 
+tm ntpLocalTime(time_t ts) {
+    return ::espurna::ntp::timelib::internal::local(ts);
+}
+
+tm ntpUtcTime(time_t ts) {
+    return ::espurna::ntp::timelib::internal::utc(ts);
+}
+
 String ntpDateTime(tm* timestruct) {
     return ::espurna::ntp::datetime(timestruct);
 }
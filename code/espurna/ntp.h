@@ -39,6 +39,11 @@ struct NtpInfo {
 void ntpOnTick(NtpTickCallback);
 NtpInfo ntpInfo();
 
+// Same as localtime_r and gmtime_r. Result for the last requested second is cached,
+// and it is usually the current one. Every other timestamp is converted without calling libc
+tm ntpLocalTime(time_t ts);
+tm ntpUtcTime(time_t ts);
+
 String ntpDateTime(tm* timestruct);
 String ntpDateTime(time_t ts);
 String ntpDateTime();
@@ -6,6 +6,8 @@ OTA MODULE COMMON FUNCTIONS
 
 #include "espurna.h"
 #include "ota.h"
+#include "ota_delta.h"
+#include "ota_inflate.h"
 #include "system.h"
 #include "terminal.h"
 #include "utils.h"
@@ -16,6 +18,111 @@ OTA MODULE COMMON FUNCTIONS
 
 #include "libs/PrintString.h"
 
+#include <array>
+#include <cstring>
+#include <memory>
+
+namespace espurna {
+namespace ota {
+namespace {
+namespace internal {
+
+// only exist while zlib stream or the patch are being written
+std::unique_ptr<Inflate> inflate;
+std::unique_ptr<Delta> delta;
+
+bool started { false };
+
+} // namespace internal
+
+bool update_write(const uint8_t* data, size_t size) {
+    return Update.write(const_cast<uint8_t*>(data), size) == size;
+}
+
+// Old image is the currently running one, starting at the beginning of the flash
+// Flash is only read in aligned chunks, and patch may ask for any offset
+bool delta_source(size_t offset, uint8_t* data, size_t size) {
+    static constexpr auto Alignment = alignof(uint32_t);
+    alignas(Alignment) std::array<uint8_t, 128> buffer;
+
+    while (size) {
+        const auto aligned = offset & ~(Alignment - 1);
+        const auto skip = offset - aligned;
+
+        auto chunk = buffer.size() - skip;
+        if (chunk > size) {
+            chunk = size;
+        }
+
+        const auto length = (skip + chunk + Alignment - 1) & ~(Alignment - 1);
+        if (!ESP.flashRead(aligned, reinterpret_cast<uint32_t*>(buffer.data()), length)) {
+            return false;
+        }
+
+        std::memcpy(data, &buffer[skip], chunk);
+        data += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+// Patch is only valid for the exact image it was made from. Resulting image hash is checked by the Updater itself
+bool delta_verify(const Delta::Header& header) {
+    if ((header.old_size != ESP.getSketchSize())
+        || !ESP.getSketchMD5().equalsIgnoreCase(hexEncode(header.old_hash)))
+    {
+        DEBUG_MSG_P(PSTR("[OTA] Patch does not match the current image\n"));
+        return false;
+    }
+
+    if (header.new_size > Update.size()) {
+        DEBUG_MSG_P(PSTR("[OTA] Patched image is too large\n"));
+        return false;
+    }
+
+    auto hash = hexEncode(header.new_hash);
+    hash.toLowerCase();
+
+    DEBUG_MSG_P(PSTR("[OTA] Patching %u bytes image, expecting md5 %s\n"),
+        header.new_size, hash.c_str());
+
+    return Update.setMD5(hash.c_str());
+}
+
+// Image is either written as-is or goes through the patch first. Since patch can also be zlib'ed, it has to
+// wait until the actual data is available, even the first byte is enough to figure out which one it is
+bool image_write(const uint8_t* data, size_t size) {
+    if (!size) {
+        return true;
+    }
+
+    if (!internal::started) {
+        internal::started = true;
+        if (data[0] == (Delta::Magic & 0xff)) {
+            internal::delta = std::make_unique<Delta>(
+                delta_source, update_write, delta_verify);
+        }
+    }
+
+    if (internal::delta) {
+        return internal::delta->write(data, size) != Delta::Status::Error;
+    }
+
+    return update_write(data, size);
+}
+
+void image_reset() {
+    internal::inflate.reset();
+    internal::delta.reset();
+    internal::started = false;
+}
+
+} // namespace
+} // namespace ota
+} // namespace espurna
+
 void otaPrintError() {
 #if DEBUG_SUPPORT
     if (Update.hasError()) {
@@ -27,8 +134,34 @@ void otaPrintError() {
 }
 
 bool otaFinalize(size_t size, CustomResetReason reason, bool evenIfRemaining) {
+    using namespace espurna::ota;
+
+    auto inflate = std::move(internal::inflate);
+    auto delta = std::move(internal::delta);
+    image_reset();
+
+    // streams must be complete, including the checksum. otherwise, do not mark the image as valid
+    const bool inflated = !inflate || (inflate->status() == Inflate::Status::Done);
+    const bool patched = !delta || (delta->status() == Delta::Status::Done);
+
+    if (!inflated || !patched) {
+        DEBUG_MSG_P(PSTR("[OTA] Image is incomplete or invalid (inflate error %d, patch error %d)\n"),
+            inflate ? static_cast<int>(inflate->error()) : 0,
+            delta ? static_cast<int>(delta->error()) : 0);
+        if (Update.isRunning()) {
+            Update.end(false);
+        }
+        eepromRotate(true);
+        return false;
+    }
+
     if (Update.isRunning() && Update.end(evenIfRemaining)) {
-        DEBUG_MSG_P(PSTR("[OTA] Success: %7u bytes\n"), size);
+        if (inflate || delta) {
+            DEBUG_MSG_P(PSTR("[OTA] Success: %7u bytes (%u written)\n"),
+                size, Update.progress());
+        } else {
+            DEBUG_MSG_P(PSTR("[OTA] Success: %7u bytes\n"), size);
+        }
         prepareReset(reason);
         return true;
     }
@@ -56,6 +189,16 @@ bool otaVerifyHeader(uint8_t* data, size_t len) {
         return true;
     }
 
+    // zlib stream is inflated while it is being written, see otaBegin()
+    if (espurna::ota::Inflate::header(data, len)) {
+        return true;
+    }
+
+    // patch header is verified later, when it is applied
+    if (espurna::ota::Delta::header(data, len)) {
+        return true;
+    }
+
     // Check for magic byte with a normal .bin
     if (data[0] != 0xE9) {
         return false;
@@ -70,6 +213,66 @@ bool otaVerifyHeader(uint8_t* data, size_t len) {
     return true;
 }
 
+// Both raw and gzip'ped images are written as-is. Core bootloader will inflate gzip'ped image on the next boot,
+// which means it has to be kept in the flash as-is and it will only check the gzip stream right before copying it.
+// zlib stream is inflated right here instead, so Updater only ever sees the raw image and can check it as usual.
+// Inflated data could also be a patch for the current image (see ota_delta.h), which is applied on the way as well.
+bool otaBegin(const uint8_t* data, size_t len) {
+    using namespace espurna::ota;
+
+    image_reset();
+    if (Inflate::header(data, len)) {
+        internal::inflate = std::make_unique<Inflate>(
+            OTA_INFLATE_WINDOW_BITS, image_write);
+        DEBUG_MSG_P(PSTR("[OTA] Inflating zlib stream, window is %u bytes\n"),
+            internal::inflate->window());
+    }
+
+    // And make sure to use async mode, b/c it will yield() otherwise
+    Update.runAsync(true);
+    if (!Update.begin((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000)) {
+        image_reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool otaWrite(const uint8_t* data, size_t len) {
+    using namespace espurna::ota;
+
+    // any data after the end of the stream is ignored, same as Update.end(true) would ignore the free space.
+    // failed decoder is kept around until otaFinalize(), Updater itself has no idea the image is broken
+    if (internal::inflate) {
+        return internal::inflate->write(data, len) != Inflate::Status::Error;
+    }
+
+    return image_write(data, len);
+}
+
+bool otaSetMD5(const String& hash) {
+    using namespace espurna::ota;
+
+    if (!internal::started || internal::inflate || internal::delta) {
+        return false;
+    }
+
+    return Update.setMD5(hash.c_str());
+}
+
+bool otaStreamComplete() {
+    using namespace espurna::ota;
+
+    if (!internal::inflate && !internal::delta) {
+        return false;
+    }
+
+    const bool inflated = !internal::inflate || (internal::inflate->status() == Inflate::Status::Done);
+    const bool patched = !internal::delta || (internal::delta->status() == Delta::Status::Done);
+
+    return inflated && patched;
+}
+
 void otaProgress(size_t bytes, size_t each) {
     // Removed to avoid websocket ping back during upgrade (see #1574)
     // TODO: implement as separate from debugging message
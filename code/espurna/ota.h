@@ -21,6 +21,21 @@ void otaClientSetup();
 // because we are not using Stream interface to feed it data.
 bool otaVerifyHeader(uint8_t* data, size_t len);
 
+// Prepare the Updater for the image starting with the `data`. Same as Update.begin(), but
+// zlib'ed image is inflated on the fly and the patch is applied to the current image.
+// Image is written with otaWrite(), which is either a passthrough for the Update.write()
+// or the decompressor / patch applier (that write to the Update themselves)
+bool otaBegin(const uint8_t* data, size_t len);
+bool otaWrite(const uint8_t* data, size_t len);
+
+// Expected hash of the image as it was received. Only applies when the image is written as-is,
+// zlib'ed and patched images are verified by their own checksums. Returns false when not applied
+bool otaSetMD5(const String& hash);
+
+// Whether zlib stream or the patch reached its end. Always false when the image is written as-is,
+// since only the decoders can tell where the image ends without knowing its size beforehand
+bool otaStreamComplete();
+
 void otaProgress(size_t bytes, size_t each);
 void otaProgress(size_t bytes);
 
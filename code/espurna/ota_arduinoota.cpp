@@ -109,7 +109,7 @@ void error(ota_error_t error) {
 }
 
 void setup() {
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("ota.arduino"));
     espurnaRegisterReload(configure);
 
     ArduinoOTA.onStart(start);
@@ -150,9 +150,7 @@ void onData(void* arg, AsyncClient* client, void* data, size_t len) {
             }
 
             // XXX: In case of non-chunked response, really parse headers and specify size via content-length value
-            // And make sure to use async mode, b/c it will yield() otherwise
-            Update.runAsync(true);
-            if (!Update.begin((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000)) {
+            if (!otaBegin((const uint8_t*) ptr, len)) {
                 otaPrintError();
                 client->close(true);
                 return;
@@ -165,7 +163,7 @@ void onData(void* arg, AsyncClient* client, void* data, size_t len) {
             return;
         }
 
-        if (Update.write((uint8_t *) ptr, len) != len) {
+        if (!otaWrite((const uint8_t*) ptr, len)) {
             otaPrintError();
             client->close(true);
             ota_client->state = BasicHttpClient::State::End;
@@ -201,7 +201,7 @@ void otaWebSetup() {
 
     ::espurnaRegisterLoop([]() {
         server.handleClient();
-    });
+    }, STRING_VIEW("ota.basicweb"));
 }
 
 #endif
@@ -0,0 +1,332 @@
+/*
+
+Part of the OTA MODULE
+
+Based on:
+- http://www.daemonology.net/bsdiff/ Naive differences of executable code, Colin Percival
+
+Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace espurna {
+namespace ota {
+
+// Patch is a header followed by the list of records. Every record is a control block of three 32bit LE integers
+// - `add`, number of bytes that are added to the bytes from the old image, starting from the current old position
+// - `extra`, number of bytes that are copied to the new image as-is
+// - `seek`, signed offset that is applied to the old position after both are done
+// ...and then `add` + `extra` bytes of data. Patch ends as soon as the new image is complete.
+// Since changes in the code mostly shift addresses around, `add` data is mostly zeroes and is expected
+// to be compressed further (see ota_inflate.h and scripts/ota_delta.py)
+class Delta {
+public:
+    // false stops the applier
+    using Source = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+    using Output = std::function<bool(const uint8_t*, size_t)>;
+
+    static constexpr size_t HashSize { 16 };
+    using Hash = std::array<uint8_t, HashSize>;
+
+    // md5 of both old and new images
+    struct Header {
+        uint32_t old_size;
+        uint32_t new_size;
+        Hash old_hash;
+        Hash new_hash;
+    };
+
+    // allowed to stop the applier when patch does not match the old image
+    using Verify = std::function<bool(const Header&)>;
+
+    enum class Status {
+        Pending,
+        Done,
+        Error,
+    };
+
+    enum class Error {
+        None,
+        Header,
+        Verify,
+        Control,
+        Source,
+        Output,
+    };
+
+    // 'E' 'D' 'L' 'T', as it would be read from the patch
+    static constexpr uint32_t Magic { 0x544c4445 };
+    static constexpr size_t MagicSize { 4 };
+
+    static constexpr size_t HeaderSize { MagicSize + 8 + (2 * HashSize) };
+    static constexpr size_t ControlSize { 12 };
+
+    static constexpr size_t BufferSize { 256 };
+
+    static bool header(const uint8_t* data, size_t size) {
+        return (size >= MagicSize) && (u32(data) == Magic);
+    }
+
+    Delta(Source source, Output output, Verify verify) :
+        _source(std::move(source)),
+        _output(std::move(output)),
+        _verify(std::move(verify))
+    {}
+
+    Delta(const Delta&) = delete;
+    Delta& operator=(const Delta&) = delete;
+
+    Status status() const {
+        switch (_state) {
+        case State::Done:
+            return Status::Done;
+        case State::Error:
+            return Status::Error;
+        default:
+            break;
+        }
+
+        return Status::Pending;
+    }
+
+    Error error() const {
+        return _error;
+    }
+
+    // only valid after the header was received
+    const Header& info() const {
+        return _header;
+    }
+
+    size_t total_in() const {
+        return _total_in;
+    }
+
+    size_t total_out() const {
+        return _total_out;
+    }
+
+    // Any data after the end of the patch is ignored
+    Status write(const uint8_t* data, size_t size) {
+        const auto* it = data;
+        const auto* end = data + size;
+
+        while ((it != end) && (status() == Status::Pending)) {
+            switch (_state) {
+            case State::Header:
+                if (collect(it, end, HeaderSize)) {
+                    parse_header();
+                }
+                break;
+
+            case State::Control:
+                if (collect(it, end, ControlSize)) {
+                    parse_control();
+                }
+                break;
+
+            case State::Add:
+                it = add(it, end);
+                break;
+
+            case State::Extra:
+                it = extra(it, end);
+                break;
+
+            case State::Done:
+            case State::Error:
+                break;
+            }
+        }
+
+        _total_in += it - data;
+
+        return status();
+    }
+
+private:
+    enum class State {
+        Header,
+        Control,
+        Add,
+        Extra,
+        Done,
+        Error,
+    };
+
+    static uint32_t u32(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0])
+            | (static_cast<uint32_t>(data[1]) << 8)
+            | (static_cast<uint32_t>(data[2]) << 16)
+            | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    void fail(Error error) {
+        _state = State::Error;
+        _error = error;
+    }
+
+    // fixed-size blocks may be split between the writes
+    bool collect(const uint8_t*& it, const uint8_t* end, size_t size) {
+        while ((_buffer_size < size) && (it != end)) {
+            _buffer[_buffer_size++] = *(it++);
+        }
+
+        if (_buffer_size == size) {
+            _buffer_size = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    void parse_header() {
+        if (!header(_buffer.data(), HeaderSize)) {
+            fail(Error::Header);
+            return;
+        }
+
+        const auto* ptr = &_buffer[MagicSize];
+
+        _header.old_size = u32(ptr);
+        ptr += 4;
+
+        _header.new_size = u32(ptr);
+        ptr += 4;
+
+        std::copy(ptr, ptr + HashSize, _header.old_hash.begin());
+        ptr += HashSize;
+
+        std::copy(ptr, ptr + HashSize, _header.new_hash.begin());
+
+        if (!_header.new_size) {
+            fail(Error::Header);
+            return;
+        }
+
+        if (_verify && !_verify(_header)) {
+            fail(Error::Verify);
+            return;
+        }
+
+        _state = State::Control;
+    }
+
+    void parse_control() {
+        _add = u32(&_buffer[0]);
+        _extra = u32(&_buffer[4]);
+        _seek = static_cast<int32_t>(u32(&_buffer[8]));
+
+        const auto left = static_cast<uint64_t>(_header.new_size) - _total_out;
+        if ((static_cast<uint64_t>(_add) + _extra) > left) {
+            fail(Error::Control);
+            return;
+        }
+
+        next();
+    }
+
+    // old position only matters when something is read from it, so it is allowed to point anywhere in-between
+    void next() {
+        if (_add) {
+            _state = State::Add;
+        } else if (_extra) {
+            _state = State::Extra;
+        } else {
+            _old += _seek;
+            _state = (_total_out == _header.new_size)
+                ? State::Done
+                : State::Control;
+        }
+    }
+
+    const uint8_t* add(const uint8_t* it, const uint8_t* end) {
+        size_t size = end - it;
+        if (size > _add) {
+            size = _add;
+        }
+        if (size > _buffer.size()) {
+            size = _buffer.size();
+        }
+
+        if ((_old < 0) || ((_old + static_cast<int64_t>(size)) > static_cast<int64_t>(_header.old_size))) {
+            fail(Error::Control);
+            return it;
+        }
+
+        if (!_source(static_cast<size_t>(_old), _buffer.data(), size)) {
+            fail(Error::Source);
+            return it;
+        }
+
+        for (size_t index = 0; index < size; ++index) {
+            _buffer[index] += it[index];
+        }
+
+        if (!_output(_buffer.data(), size)) {
+            fail(Error::Output);
+            return it;
+        }
+
+        _old += size;
+        _add -= size;
+        _total_out += size;
+        it += size;
+
+        next();
+
+        return it;
+    }
+
+    // no need to buffer anything, input is passed through as-is
+    const uint8_t* extra(const uint8_t* it, const uint8_t* end) {
+        size_t size = end - it;
+        if (size > _extra) {
+            size = _extra;
+        }
+
+        if (!_output(it, size)) {
+            fail(Error::Output);
+            return it;
+        }
+
+        _extra -= size;
+        _total_out += size;
+        it += size;
+
+        next();
+
+        return it;
+    }
+
+    Source _source;
+    Output _output;
+    Verify _verify;
+
+    State _state { State::Header };
+    Error _error { Error::None };
+
+    Header _header{};
+
+    std::array<uint8_t, BufferSize> _buffer;
+    size_t _buffer_size { 0 };
+
+    uint32_t _add { 0 };
+    uint32_t _extra { 0 };
+    int32_t _seek { 0 };
+    int64_t _old { 0 };
+
+    size_t _total_in { 0 };
+    size_t _total_out { 0 };
+};
+
+} // namespace ota
+} // namespace espurna
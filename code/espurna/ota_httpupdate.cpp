@@ -7,7 +7,7 @@ Copyright (C) 2019 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 */
 
 // -----------------------------------------------------------------------------
-// OTA by using Core's HTTP(s) updater
+// OTA by using Core's HTTP(s) client
 // -----------------------------------------------------------------------------
 
 #include "espurna.h"
@@ -20,7 +20,6 @@ Copyright (C) 2019 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 #include "terminal.h"
 
 #include <ESP8266HTTPClient.h>
-#include <ESP8266httpUpdate.h>
 
 #include "libs/TypeChecks.h"
 #include "libs/SecureClientHelpers.h"
@@ -52,32 +51,93 @@ namespace {
 // Generic update methods
 // -----------------------------------------------------------------------------
 
+// Updater is fed manually instead of using ESPhttpUpdate, so that the image could be inflated on the way.
+// Same as ESPhttpUpdate, x-MD5 header is checked when the image is written as-is. zlib'ed image and
+// the patch have their own checksums instead
 void run(WiFiClient* client, const String& url) {
     // Disabling EEPROM rotation to prevent writing to EEPROM after the upgrade
     // Must happen right now, since HTTP updater will block until it's done
     eepromRotate(false);
 
     DEBUG_MSG_P(PSTR("[OTA] Downloading %s ...\n"), url.c_str());
-    ESPhttpUpdate.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    ESPhttpUpdate.rebootOnUpdate(false);
-
-    t_httpUpdate_return result = HTTP_UPDATE_NO_UPDATES;
-    result = ESPhttpUpdate.update(*client, url);
-
-    switch (result) {
-    case HTTP_UPDATE_FAILED:
-        DEBUG_MSG_P(PSTR("[OTA] Update failed (error %d): %s\n"), ESPhttpUpdate.getLastError(), ESPhttpUpdate.getLastErrorString().c_str());
-        break;
-    case HTTP_UPDATE_NO_UPDATES:
-        DEBUG_MSG_P(PSTR("[OTA] No updates"));
-        break;
-    case HTTP_UPDATE_OK:
-        DEBUG_MSG_P(PSTR("[OTA] Done, restarting..."));
-        prepareReset(CustomResetReason::Ota);
+
+    HTTPClient http;
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    http.useHTTP10(true);
+
+    if (!http.begin(*client, url)) {
+        DEBUG_MSG_P(PSTR("[OTA] Invalid URL\n"));
+        eepromRotate(true);
+        return;
+    }
+
+    const char* headers[] { "x-MD5" };
+    http.collectHeaders(headers, std::size(headers));
+
+    const int code = http.GET();
+    if (code != HTTP_CODE_OK) {
+        DEBUG_MSG_P(PSTR("[OTA] Update failed (HTTP %d): %s\n"),
+            code, http.errorToString(code).c_str());
+        eepromRotate(true);
+        return;
+    }
+
+    // -1 when server did not send the Content-Length, read until the connection is closed
+    const int length = http.getSize();
+    const auto md5 = http.header("x-MD5");
+    auto& stream = http.getStream();
+
+    uint8_t buffer[512];
+    size_t total { 0 };
+
+    while ((length < 0) || (total < static_cast<size_t>(length))) {
+        const auto read = stream.readBytes(buffer, sizeof(buffer));
+        if (!read) {
+            break;
+        }
+
+        // Check header before anything is written to the flash
+        if (!total) {
+            if (!otaVerifyHeader(buffer, read)) {
+                DEBUG_MSG_P(PSTR("[OTA] ERROR: No magic byte / invalid flash config\n"));
+                eepromRotate(true);
+                return;
+            }
+
+            if (!otaBegin(buffer, read)) {
+                otaPrintError();
+                eepromRotate(true);
+                return;
+            }
+        }
+
+        if (!otaWrite(buffer, read)) {
+            break;
+        }
+
+        if (!total && md5.length()) {
+            if (otaSetMD5(md5)) {
+                DEBUG_MSG_P(PSTR("[OTA] Expecting md5 %s\n"), md5.c_str());
+            }
+        }
+
+        total += read;
+        otaProgress(total);
+    }
+
+    if (!total) {
+        DEBUG_MSG_P(PSTR("[OTA] No data\n"));
+        eepromRotate(true);
         return;
     }
 
-    eepromRotate(true);
+    // Incomplete image is rejected by the Updater, since it expects to reach the end of the allocated space.
+    // Without the Content-Length, only the zlib stream or the patch can tell whether the image is complete
+    const bool complete = (length < 0)
+        ? otaStreamComplete()
+        : (total == static_cast<size_t>(length));
+    DEBUG_MSG_P(PSTR("\n"));
+    otaFinalize(total, CustomResetReason::Ota, complete);
 }
 
 void clientFromHttp(const String& url) {
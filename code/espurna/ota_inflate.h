@@ -0,0 +1,759 @@
+/*
+
+Part of the OTA MODULE
+
+Based on:
+- https://www.rfc-editor.org/rfc/rfc1950 ZLIB Compressed Data Format Specification version 3.3
+- https://www.rfc-editor.org/rfc/rfc1951 DEFLATE Compressed Data Format Specification version 1.3
+- https://github.com/madler/zlib/blob/master/contrib/puff/puff.c
+
+Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace espurna {
+namespace ota {
+
+// Zlib stream decoder that does not need the whole input at once. Input is pushed in chunks of any size
+// and decoding stops whenever it runs out of data, resuming from the same spot with the next chunk.
+// Window is also used as the output buffer, output callback receives at most window size bytes at a time.
+// Streams compressed with a larger window than ours (as declared in the zlib header) are rejected.
+class Inflate {
+public:
+    // false stops the decoder
+    using Output = std::function<bool(const uint8_t*, size_t)>;
+
+    enum class Status {
+        Pending,
+        Done,
+        Error,
+    };
+
+    enum class Error {
+        None,
+        Header,
+        Window,
+        Block,
+        Code,
+        Distance,
+        Checksum,
+        Output,
+    };
+
+    static constexpr size_t WindowBitsMin { 8 };
+    static constexpr size_t WindowBitsMax { 15 };
+
+    // CMF and FLG bytes. method is 'deflate', FCHECK is valid and there is no preset dictionary
+    static bool header(const uint8_t* data, size_t size) {
+        return (size >= 2)
+            && ((data[0] & 0x0f) == 8)
+            && ((data[0] >> 4) <= (WindowBitsMax - WindowBitsMin))
+            && ((data[1] & 0x20) == 0)
+            && ((((data[0] << 8) | data[1]) % 31) == 0);
+    }
+
+    Inflate(size_t window_bits, Output output) :
+        _output(std::move(output)),
+        _window_bits(clamp(window_bits)),
+        _window_size(1 << _window_bits),
+        _window(new uint8_t[_window_size])
+    {}
+
+    Inflate(const Inflate&) = delete;
+    Inflate& operator=(const Inflate&) = delete;
+
+    Status status() const {
+        switch (_state) {
+        case State::Done:
+            return Status::Done;
+        case State::Error:
+            return Status::Error;
+        default:
+            break;
+        }
+
+        return Status::Pending;
+    }
+
+    Error error() const {
+        return _error;
+    }
+
+    size_t window() const {
+        return _window_size;
+    }
+
+    size_t total_in() const {
+        return _total_in;
+    }
+
+    size_t total_out() const {
+        return _total_out;
+    }
+
+    // Any data after the end of the stream is ignored
+    Status write(const uint8_t* data, size_t size) {
+        _in = data;
+        _in_end = data + size;
+
+        const auto start = _in;
+        run();
+        _total_in += _in - start;
+
+        if ((_state != State::Error) && !flush()) {
+            fail(Error::Output);
+        }
+
+        return status();
+    }
+
+private:
+    static constexpr size_t MaxBits { 15 };
+    static constexpr size_t LiteralCodes { 288 };
+    static constexpr size_t DistanceCodes { 30 };
+    static constexpr size_t LengthCodes { 19 };
+
+    enum class State : uint8_t {
+        Header,
+        Block,
+        StoredHeader,
+        Stored,
+        TableHeader,
+        TableLengths,
+        CodeLengths,
+        Symbol,
+        LengthExtra,
+        Distance,
+        DistanceExtra,
+        Copy,
+        Trailer,
+        Done,
+        Error,
+    };
+
+    // Canonical Huffman code, described by the number of codes of each length
+    // and the symbols ordered by their codes
+    template <size_t Size>
+    struct Table {
+        uint16_t counts[MaxBits + 1];
+        uint16_t symbols[Size];
+    };
+
+    static size_t clamp(size_t bits) {
+        return (bits < WindowBitsMin)
+            ? WindowBitsMin
+            : (bits > WindowBitsMax)
+                ? WindowBitsMax
+                : bits;
+    }
+
+    // Incomplete codes are allowed, over-subscribed ones are not
+    template <size_t Size>
+    static bool build(Table<Size>& table, const uint8_t* lengths, size_t size) {
+        for (auto& count : table.counts) {
+            count = 0;
+        }
+
+        for (size_t index = 0; index < size; ++index) {
+            ++table.counts[lengths[index]];
+        }
+
+        if (table.counts[0] == size) {
+            return true;
+        }
+
+        int left = 1;
+        for (size_t len = 1; len <= MaxBits; ++len) {
+            left <<= 1;
+            left -= table.counts[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+
+        uint16_t offsets[MaxBits + 1];
+        offsets[1] = 0;
+        for (size_t len = 1; len < MaxBits; ++len) {
+            offsets[len + 1] = offsets[len] + table.counts[len];
+        }
+
+        for (size_t index = 0; index < size; ++index) {
+            if (lengths[index]) {
+                table.symbols[offsets[lengths[index]]++] = index;
+            }
+        }
+
+        return true;
+    }
+
+    // -------------------------------------------------------------------------
+
+    // bits are kept in the accumulator between the calls, nothing is lost when input runs out
+    void fill() {
+        while ((_bits_count <= 24) && (_in != _in_end)) {
+            _bits |= static_cast<uint32_t>(*_in) << _bits_count;
+            _bits_count += 8;
+            ++_in;
+        }
+    }
+
+    bool need(size_t bits) {
+        if (_bits_count < bits) {
+            fill();
+        }
+
+        return _bits_count >= bits;
+    }
+
+    uint32_t take(size_t bits) {
+        const auto out = _bits & ((1ul << bits) - 1);
+        _bits >>= bits;
+        _bits_count -= bits;
+        return out;
+    }
+
+    void align() {
+        take(_bits_count % 8);
+    }
+
+    static constexpr int NeedMore { -1 };
+    static constexpr int Invalid { -2 };
+
+    // symbol bits are only consumed when the whole code is available
+    template <size_t Size>
+    int decode(const Table<Size>& table) {
+        fill();
+
+        int code = 0;
+        int first = 0;
+        int index = 0;
+
+        for (size_t len = 1; len <= MaxBits; ++len) {
+            if (len > _bits_count) {
+                return NeedMore;
+            }
+
+            code |= (_bits >> (len - 1)) & 1;
+
+            const int count = table.counts[len];
+            if (code - count < first) {
+                take(len);
+                return table.symbols[index + (code - first)];
+            }
+
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+
+        return Invalid;
+    }
+
+    // -------------------------------------------------------------------------
+
+    // as a side-effect, window is also our output buffer. it is flushed when it is full,
+    // and at the end of every write() call
+    bool put(uint8_t value) {
+        _window[_pos++] = value;
+        ++_total_out;
+
+        if (_pos == _window_size) {
+            if (!flush()) {
+                return false;
+            }
+
+            _pos = 0;
+            _flushed = 0;
+        }
+
+        return true;
+    }
+
+    bool flush() {
+        if (_pos > _flushed) {
+            const auto* data = &_window[_flushed];
+            const auto size = _pos - _flushed;
+            _flushed = _pos;
+
+            adler32(data, size);
+            return _output(data, size);
+        }
+
+        return true;
+    }
+
+    void adler32(const uint8_t* data, size_t size) {
+        static constexpr uint32_t Base { 65521 };
+        static constexpr size_t Max { 5552 };
+
+        while (size) {
+            const auto block = (size < Max) ? size : Max;
+            size -= block;
+
+            for (size_t index = 0; index < block; ++index) {
+                _adler_a += data[index];
+                _adler_b += _adler_a;
+            }
+
+            data += block;
+            _adler_a %= Base;
+            _adler_b %= Base;
+        }
+    }
+
+    void fail(Error error) {
+        _state = State::Error;
+        _error = error;
+    }
+
+    void end_of_block() {
+        _state = _final
+            ? State::Trailer
+            : State::Block;
+        if (_final) {
+            align();
+        }
+    }
+
+    void fixed() {
+        uint8_t lengths[LiteralCodes];
+
+        size_t index = 0;
+        for (; index < 144; ++index) {
+            lengths[index] = 8;
+        }
+        for (; index < 256; ++index) {
+            lengths[index] = 9;
+        }
+        for (; index < 280; ++index) {
+            lengths[index] = 7;
+        }
+        for (; index < LiteralCodes; ++index) {
+            lengths[index] = 8;
+        }
+        build(_literals, lengths, LiteralCodes);
+
+        for (index = 0; index < DistanceCodes; ++index) {
+            lengths[index] = 5;
+        }
+        build(_distances, lengths, DistanceCodes);
+    }
+
+    // -------------------------------------------------------------------------
+
+    void run() {
+        static constexpr uint16_t LengthBase[] {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t LengthExtraBits[] {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+        static constexpr uint16_t DistanceBase[] {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+            8193, 12289, 16385, 24577};
+        static constexpr uint8_t DistanceExtraBits[] {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+            12, 12, 13, 13};
+
+        static constexpr uint8_t LengthsOrder[LengthCodes] {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        for (;;) {
+            switch (_state) {
+
+            case State::Header:
+            {
+                if (!need(16)) {
+                    return;
+                }
+
+                const uint8_t header[2] {
+                    static_cast<uint8_t>(take(8)),
+                    static_cast<uint8_t>(take(8))};
+                if (!Inflate::header(header, sizeof(header))) {
+                    fail(Error::Header);
+                    return;
+                }
+
+                if (((header[0] >> 4) + WindowBitsMin) > _window_bits) {
+                    fail(Error::Window);
+                    return;
+                }
+
+                _state = State::Block;
+                break;
+            }
+
+            case State::Block:
+                if (!need(3)) {
+                    return;
+                }
+
+                _final = take(1);
+                switch (take(2)) {
+                case 0:
+                    align();
+                    _state = State::StoredHeader;
+                    break;
+                case 1:
+                    fixed();
+                    _state = State::Symbol;
+                    break;
+                case 2:
+                    _state = State::TableHeader;
+                    break;
+                default:
+                    fail(Error::Block);
+                    return;
+                }
+                break;
+
+            case State::StoredHeader:
+            {
+                if (!need(32)) {
+                    return;
+                }
+
+                const auto len = take(16);
+                const auto nlen = take(16);
+                if (len != (~nlen & 0xffff)) {
+                    fail(Error::Block);
+                    return;
+                }
+
+                _left = len;
+                _state = State::Stored;
+                break;
+            }
+
+            case State::Stored:
+                // accumulator may still have some bytes left, everything else is copied directly
+                while (_left) {
+                    if (_bits_count >= 8) {
+                        if (!put(take(8))) {
+                            fail(Error::Output);
+                            return;
+                        }
+                    } else if (_in != _in_end) {
+                        if (!put(*(_in++))) {
+                            fail(Error::Output);
+                            return;
+                        }
+                    } else {
+                        return;
+                    }
+
+                    --_left;
+                }
+
+                end_of_block();
+                break;
+
+            case State::TableHeader:
+                if (!need(14)) {
+                    return;
+                }
+
+                _literals_size = take(5) + 257;
+                _distances_size = take(5) + 1;
+                _lengths_size = take(4) + 4;
+
+                if ((_literals_size > 286) || (_distances_size > DistanceCodes)) {
+                    fail(Error::Block);
+                    return;
+                }
+
+                for (auto& length : _lengths) {
+                    length = 0;
+                }
+
+                _index = 0;
+                _state = State::TableLengths;
+                break;
+
+            case State::TableLengths:
+                while (_index < _lengths_size) {
+                    if (!need(3)) {
+                        return;
+                    }
+
+                    _lengths[LengthsOrder[_index++]] = take(3);
+                }
+
+                if (!build(_code_lengths, _lengths, LengthCodes)) {
+                    fail(Error::Code);
+                    return;
+                }
+
+                _index = 0;
+                _repeat = 0;
+                _state = State::CodeLengths;
+                break;
+
+            case State::CodeLengths:
+            {
+                const size_t total = _literals_size + _distances_size;
+                while (_index < total) {
+                    // repeat codes have extra bits, keep the symbol around until those are available
+                    if (!_repeat) {
+                        const auto symbol = decode(_code_lengths);
+                        if (symbol == NeedMore) {
+                            return;
+                        }
+
+                        if (symbol < 0) {
+                            fail(Error::Code);
+                            return;
+                        }
+
+                        if (symbol < 16) {
+                            _lengths[_index++] = symbol;
+                            continue;
+                        }
+
+                        if ((symbol == 16) && !_index) {
+                            fail(Error::Code);
+                            return;
+                        }
+
+                        _repeat = symbol;
+                    }
+
+                    uint8_t value { 0 };
+                    size_t times { 0 };
+
+                    switch (_repeat) {
+                    case 16:
+                        if (!need(2)) {
+                            return;
+                        }
+                        value = _lengths[_index - 1];
+                        times = 3 + take(2);
+                        break;
+                    case 17:
+                        if (!need(3)) {
+                            return;
+                        }
+                        times = 3 + take(3);
+                        break;
+                    default:
+                        if (!need(7)) {
+                            return;
+                        }
+                        times = 11 + take(7);
+                        break;
+                    }
+
+                    _repeat = 0;
+                    if (_index + times > total) {
+                        fail(Error::Code);
+                        return;
+                    }
+
+                    while (times--) {
+                        _lengths[_index++] = value;
+                    }
+                }
+
+                // there must be a way to end the block
+                if (!_lengths[256]) {
+                    fail(Error::Code);
+                    return;
+                }
+
+                if (!build(_literals, _lengths, _literals_size)
+                    || !build(_distances, _lengths + _literals_size, _distances_size))
+                {
+                    fail(Error::Code);
+                    return;
+                }
+
+                _state = State::Symbol;
+                break;
+            }
+
+            case State::Symbol:
+                for (;;) {
+                    const auto symbol = decode(_literals);
+                    if (symbol == NeedMore) {
+                        return;
+                    }
+
+                    if (symbol < 0) {
+                        fail(Error::Code);
+                        return;
+                    }
+
+                    if (symbol < 256) {
+                        if (!put(symbol)) {
+                            fail(Error::Output);
+                            return;
+                        }
+                        continue;
+                    }
+
+                    if (symbol == 256) {
+                        end_of_block();
+                        break;
+                    }
+
+                    const auto code = symbol - 257;
+                    if (code >= static_cast<int>(sizeof(LengthBase) / sizeof(LengthBase[0]))) {
+                        fail(Error::Code);
+                        return;
+                    }
+
+                    _length = LengthBase[code];
+                    _extra = LengthExtraBits[code];
+                    _state = State::LengthExtra;
+                    break;
+                }
+                break;
+
+            case State::LengthExtra:
+                if (!need(_extra)) {
+                    return;
+                }
+
+                _length += take(_extra);
+                _state = State::Distance;
+                break;
+
+            case State::Distance:
+            {
+                const auto symbol = decode(_distances);
+                if (symbol == NeedMore) {
+                    return;
+                }
+
+                if ((symbol < 0) || (symbol >= static_cast<int>(DistanceCodes))) {
+                    fail(Error::Code);
+                    return;
+                }
+
+                _distance = DistanceBase[symbol];
+                _extra = DistanceExtraBits[symbol];
+                _state = State::DistanceExtra;
+                break;
+            }
+
+            case State::DistanceExtra:
+                if (!need(_extra)) {
+                    return;
+                }
+
+                _distance += take(_extra);
+                if ((_distance > _total_out) || (_distance > _window_size)) {
+                    fail(Error::Distance);
+                    return;
+                }
+
+                _state = State::Copy;
+                break;
+
+            // window size is a power of 2, so the index simply wraps around
+            case State::Copy:
+                while (_length) {
+                    const auto index = (_pos - _distance) & (_window_size - 1);
+                    if (!put(_window[index])) {
+                        fail(Error::Output);
+                        return;
+                    }
+
+                    --_length;
+                }
+
+                _state = State::Symbol;
+                break;
+
+            // checksum is big-endian and it is computed over the output that is not yet flushed
+            case State::Trailer:
+                while (_trailer_size < 4) {
+                    if (!need(8)) {
+                        return;
+                    }
+
+                    _trailer = (_trailer << 8) | take(8);
+                    ++_trailer_size;
+                }
+
+                if (!flush()) {
+                    fail(Error::Output);
+                    return;
+                }
+
+                if (_trailer != ((_adler_b << 16) | _adler_a)) {
+                    fail(Error::Checksum);
+                    return;
+                }
+
+                _state = State::Done;
+                return;
+
+            case State::Done:
+            case State::Error:
+                return;
+
+            }
+        }
+    }
+
+    Output _output;
+
+    size_t _window_bits;
+    size_t _window_size;
+    std::unique_ptr<uint8_t[]> _window;
+
+    size_t _pos { 0 };
+    size_t _flushed { 0 };
+
+    size_t _total_in { 0 };
+    size_t _total_out { 0 };
+
+    uint32_t _adler_a { 1 };
+    uint32_t _adler_b { 0 };
+
+    const uint8_t* _in { nullptr };
+    const uint8_t* _in_end { nullptr };
+
+    uint32_t _bits { 0 };
+    size_t _bits_count { 0 };
+
+    State _state { State::Header };
+    Error _error { Error::None };
+    bool _final { false };
+
+    size_t _left { 0 };
+
+    size_t _literals_size { 0 };
+    size_t _distances_size { 0 };
+    size_t _lengths_size { 0 };
+    size_t _index { 0 };
+    int _repeat { 0 };
+    uint8_t _lengths[286 + DistanceCodes];
+
+    Table<LiteralCodes> _literals;
+    Table<DistanceCodes> _distances;
+    Table<LengthCodes> _code_lengths;
+
+    size_t _length { 0 };
+    size_t _distance { 0 };
+    size_t _extra { 0 };
+
+    uint32_t _trailer { 0 };
+    size_t _trailer_size { 0 };
+};
+
+} // namespace ota
+} // namespace espurna
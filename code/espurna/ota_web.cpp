@@ -103,10 +103,9 @@ void onFile(AsyncWebServerRequest *request, String filename, size_t index, uint8
         eepromRotate(false);
 
         DEBUG_MSG_P(PSTR("[UPGRADE] Start: %s\n"), filename.c_str());
-        Update.runAsync(true);
 
         // Note: cannot use request->contentLength() for multipart/form-data
-        if (!Update.begin((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000)) {
+        if (!otaBegin(data, len)) {
             setStatus(request, 500);
             eepromRotate(true);
             return;
@@ -122,10 +121,9 @@ void onFile(AsyncWebServerRequest *request, String filename, size_t index, uint8
         return;
     }
 
-    if (Update.write(data, len) != len) {
+    if (!otaWrite(data, len)) {
         setStatus(request, 500);
-        Update.end();
-        eepromRotate(true);
+        otaFinalize(index + len, CustomResetReason::Ota, false);
         return;
     }
 
@@ -319,15 +319,22 @@ namespace internal {
 size_t channels;
 uint32_t period;
 
+// when driver is built with PWM_DITHER_BITS, duty is N times finer than the period
+uint32_t dither;
+
 } // namespace internal
 
 constexpr size_t ChannelsMax { 8 };
 using Channels = std::vector<pwm_pin_info>;
 
+uint32_t period_dithered() {
+    return internal::period << internal::dither;
+}
+
 PwmRange range() {
     return PwmRange{
         .min = 0,
-        .max = internal::period,
+        .max = period_dithered(),
     };
 }
 
@@ -368,12 +375,12 @@ void update() {
 }
 
 void duty(uint32_t channel, uint32_t value) {
-    ::pwm_set_duty(
+    ::pwm_set_duty_dithered(
         std::min(driver::pwm::internal::duty_limit, value), channel);
 }
 
 void duty(uint32_t channel, float value) {
-    duty(channel, scale::duty(value, internal::period));
+    duty(channel, scale::duty(value, period_dithered()));
 }
 
 void setup() {
@@ -381,13 +388,18 @@ void setup() {
     internal::period = scale::period(frequency);
     DEBUG_MSG_P(PSTR("[PWM] Generic - Frequency %u (Hz), period %u (ns)\n"), frequency, internal::period);
 
+    internal::dither = ::pwm_get_dither_bits();
+    if (internal::dither) {
+        DEBUG_MSG_P(PSTR("[PWM] Dithering over %u periods\n"), 1u << internal::dither);
+    }
+
     const auto limit = settings::limit();
     driver::pwm::internal::duty_limit =
         (limit < 100.f)
-            ? (static_cast<float>(internal::period) / 100.f) * limit
-            : internal::period;
+            ? (static_cast<float>(period_dithered()) / 100.f) * limit
+            : period_dithered();
 
-    if (internal::period != driver::pwm::internal::duty_limit) {
+    if (period_dithered() != driver::pwm::internal::duty_limit) {
         DEBUG_MSG_P(PSTR("[PWM] Duty limit %u (%s%%)\n"),
             driver::pwm::internal::duty_limit, String(limit, 3).c_str());
     }
@@ -19,6 +19,10 @@ Copyright (C) 2019-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 #include "ws.h"
 #endif
 
+#if MCP23S08_SUPPORT
+#include "mcp23s08.h"
+#endif
+
 #include "mqtt.h"
 #include "relay.h"
 #include "fan.h"
@@ -1334,6 +1338,7 @@ bool _relay_report_ws { false };
 
 void _relayScheduleWsReport() {
     _relay_report_ws = true;
+    espurnaLoopWake();
 }
 
 #endif // WEB_SUPPORT
@@ -1424,6 +1429,11 @@ struct GpioProvider : public RelayProviderBase {
                 _reset_pin->digitalWrite(pulse);
             }
 
+#if MCP23S08_SUPPORT
+            // pulse edges cannot wait for the end of the batch
+            MCP23S08Flush();
+#endif
+
             // notice that this stalls loop() execution, since
             // we need to ensure only relay task is active
             espurna::time::blockingDelay(espurna::relay::build::latchingPulse());
@@ -1432,6 +1442,10 @@ struct GpioProvider : public RelayProviderBase {
             if (_reset_pin) {
                 _reset_pin->digitalWrite(!pulse);
             }
+
+#if MCP23S08_SUPPORT
+            MCP23S08Flush();
+#endif
         }
         }
     }
@@ -1467,7 +1481,7 @@ public:
             const auto port = uartPort(RELAY_PROVIDER_DUAL_PORT - 1);
             if (port) {
                 DualProvider::_port = port->stream;
-                espurnaRegisterLoop(loop);
+                espurnaRegisterLoop(loop, STRING_VIEW("relay.dual"));
                 return true;
             }
 
@@ -1579,7 +1593,7 @@ public:
             const auto port = uartPort(RELAY_PROVIDER_STM_PORT - 1);
             if (port) {
                 StmProvider::_port = port->stream;
-                espurnaRegisterLoop(loop);
+                espurnaRegisterLoop(loop, STRING_VIEW("relay.stm"));
                 return true;
             }
 
@@ -1948,6 +1962,9 @@ void _relaySync(size_t target) {
 bool _relayStatus(size_t id, bool status, bool report, bool group_report) {
     auto& relay = _relays[id];
 
+    // target status is applied by the loop, even when the relay is locked
+    espurnaLoopWake();
+
     if (!_relayStatusCheckLock(relay, status)) {
         DEBUG_MSG_P(PSTR("[RELAY] #%u is locked to %s\n"),
             id, relay.current_status ? PSTR("ON") : PSTR("OFF"));
@@ -2074,7 +2091,9 @@ void _relaySave(bool persist) {
     // thus storing the last relay value is not absolutely necessary.
     // Nevertheless, we store the value in the EEPROM buffer so it will be written
     // on the next commit.
+    // Since the status is also kept in the rtcmem, flash write itself may be deferred and merged with other commits.
     if (persist) {
+        EepromDeferredCommit deferred;
         espurna::relay::settings::bootMask(mask);
         eepromCommit(); // TODO: should this respect settings auto-save?
     }
@@ -3002,6 +3021,11 @@ bool _relayProcess(bool mode) {
     const auto relays = _relays.size();
     bool changed { false };
 
+#if MCP23S08_SUPPORT
+    // relays switched at the same time share a single expander write
+    MCP23S08Batch batch;
+#endif
+
     for (size_t id = 0; id < relays; ++id) {
         // Only process the relays:
         // - target mode in the one requested by the arg
@@ -3043,7 +3067,30 @@ bool _relayProcess(bool mode) {
 
 namespace {
 
-void _relayLoop() {
+// Nearest time when one of the pending relays is allowed to change.
+// Pulse, save and unlock are timer based, which would wake up the loop by themselves
+espurna::duration::Milliseconds _relayDeadline() {
+    auto out = LoopIdle;
+
+    const auto now = Relay::TimeSource::now();
+    for (const auto& relay : _relays) {
+        if (relay.target_status == relay.current_status) {
+            continue;
+        }
+
+        // _relayProcess() expects the delay to be exceeded
+        const auto elapsed = now - relay.change_start;
+        if (!relay.change_delay.count() || (elapsed > relay.change_delay)) {
+            return espurna::duration::Milliseconds::zero();
+        }
+
+        out = std::min(out, relay.change_delay - elapsed + espurna::duration::Milliseconds(1));
+    }
+
+    return out;
+}
+
+espurna::duration::Milliseconds _relayLoop() {
     const bool changed[] {
         _relayProcess(false),
         _relayProcess(true),
@@ -3058,6 +3105,8 @@ void _relayLoop() {
 
     _relayReport();
     _relaySave();
+
+    return _relayDeadline();
 }
 
 } // namespace
@@ -3301,7 +3350,7 @@ void relaySetup() {
     #endif
 
     // Main callbacks
-    espurnaRegisterLoop(_relayLoop);
+    espurnaRegisterLoop(_relayLoop, STRING_VIEW("relay"));
     espurnaRegisterReload(_relayConfigure);
 
 }
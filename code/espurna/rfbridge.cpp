@@ -19,16 +19,18 @@ Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
 #include "utils.h"
 
 #include <algorithm>
+#include <array>
 #include <bitset>
 #include <cstring>
-#include <list>
 #include <memory>
+#include <vector>
 
 // -----------------------------------------------------------------------------
 // GLOBALS TO THE MODULE
 // -----------------------------------------------------------------------------
 
 unsigned char _rfb_repeats = RFB_SEND_REPEATS;
+unsigned long _rfb_repeat_window = RFB_RECEIVE_REPEAT_WINDOW;
 
 #if RFB_PROVIDER == RFB_PROVIDER_RCSWITCH
 
@@ -297,9 +299,13 @@ struct RfbParser {
 #if RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
 
 struct RfbMessage {
+    RfbMessage() = default;
     RfbMessage(const RfbMessage&) = default;
     RfbMessage(RfbMessage&&) = default;
 
+    RfbMessage& operator=(const RfbMessage&) = default;
+    RfbMessage& operator=(RfbMessage&&) = default;
+
     explicit RfbMessage(uint8_t (&data)[RfbParser::PayloadSizeBasic], unsigned char repeats_) :
         repeats(repeats_)
     {
@@ -326,7 +332,93 @@ struct RfbMessage {
 
 #endif // RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
 
-static std::list<RfbMessage> _rfb_message_queue;
+// Outbound messages are kept in preallocated slots, nothing is allocated when sending.
+// Queue is split in two classes:
+// - 'send' for messages that were just requested (relay status, mqtt, api, terminal)
+// - 'repeat' for the remaining repeats of the messages that were already sent once
+// New requests are always sent first, so a long burst of repeats does not delay them.
+// (learn and ack requests are written to the port directly and never queued)
+template <size_t Size>
+struct RfbMessageQueue {
+    static_assert(Size > 0, "");
+
+    bool push(const RfbMessage& message) {
+        if (_size == Size) {
+            ++_dropped;
+            return false;
+        }
+
+        _messages[(_head + _size) % Size] = message;
+        ++_size;
+        ++_pushed;
+
+        _high_water = std::max(_high_water, _size);
+
+        return true;
+    }
+
+    const RfbMessage& front() const {
+        return _messages[_head];
+    }
+
+    void pop() {
+        _head = (_head + 1) % Size;
+        --_size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    static constexpr size_t capacity() {
+        return Size;
+    }
+
+    size_t highWater() const {
+        return _high_water;
+    }
+
+    size_t pushed() const {
+        return _pushed;
+    }
+
+    size_t dropped() const {
+        return _dropped;
+    }
+
+    void resetStats() {
+        _high_water = _size;
+        _pushed = 0;
+        _dropped = 0;
+    }
+
+private:
+    std::array<RfbMessage, Size> _messages{};
+    size_t _head { 0 };
+    size_t _size { 0 };
+
+    size_t _high_water { 0 };
+    size_t _pushed { 0 };
+    size_t _dropped { 0 };
+};
+
+using RfbQueue = RfbMessageQueue<RFB_SEND_QUEUE_SIZE>;
+
+static RfbQueue _rfb_message_queue;
+static RfbQueue _rfb_repeat_queue;
+
+bool _rfbEnqueueMessage(const RfbMessage& message) {
+    if (!_rfb_message_queue.push(message)) {
+        DEBUG_MSG_P(PSTR("[RF] Queue is full, dropping the message\n"));
+        return false;
+    }
+
+    return true;
+}
 
 void _rfbLearnImpl();
 void _rfbReceiveImpl();
@@ -368,7 +460,10 @@ void on(size_t id, const String& value) {
 } // namespace settings
 } // namespace rfbridge
 
+void _rfbCodeIndexInvalidate();
+
 void _rfbStore(size_t id, bool status, String code) {
+    _rfbCodeIndexInvalidate();
     if (status) {
         rfbridge::settings::on(id, code);
     } else {
@@ -487,24 +582,139 @@ bool _rfbCompare(const char* lhs, const char* rhs, size_t length) {
 
 #endif // RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
 
+// FNV-1a, only used to speed up lookups. Matching is always confirmed with _rfbCompare()
+constexpr uint32_t RfbHashBasis { 2166136261ul };
+constexpr uint32_t RfbHashPrime { 16777619ul };
+
+uint32_t _rfbHash(uint32_t hash, const char* begin, const char* end) {
+    for (auto it = begin; it != end; ++it) {
+        hash = (hash ^ static_cast<uint8_t>(*it)) * RfbHashPrime;
+    }
+
+    return hash;
+}
+
+uint32_t _rfbHash(espurna::StringView code) {
+    return _rfbHash(RfbHashBasis, code.begin(), code.end());
+}
+
+#if RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
+
+bool _rfbCompareLength(size_t length) {
+    return length >= 6;
+}
+
+// hash only the part that is checked by the _rfbCompare()
+uint32_t _rfbCompareHash(espurna::StringView code) {
+    return _rfbHash(RfbHashBasis, code.end() - 6, code.end());
+}
+
+#elif RFB_PROVIDER == RFB_PROVIDER_RCSWITCH
+
+bool _rfbCompareLength(size_t length) {
+    return length >= 10;
+}
+
+uint32_t _rfbCompareHash(espurna::StringView code) {
+    return _rfbHash(
+        _rfbHash(RfbHashBasis, code.begin() + 2, code.begin() + 4),
+        code.begin() + 10, code.end());
+}
+
+#endif // RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
+
+// Remote keeps sending the same frame for as long as the button is held.
+// Everything received within the window since the last identical frame is treated as a repeat,
+// and the window is extended every time one arrives.
+// (note that only the hash of the frame is kept, a collision within the window is not expected)
+struct RfbRepeat {
+    uint32_t hash;
+    size_t length;
+    unsigned long ts;
+};
+
+static RfbRepeat _rfb_repeat { 0ul, 0ul, 0ul };
+
+bool _rfbRepeated(espurna::StringView code) {
+    const auto hash = _rfbHash(code);
+    const auto now = millis();
+
+    const bool repeated = _rfb_repeat_window
+        && (_rfb_repeat.length == code.length())
+        && (_rfb_repeat.hash == hash)
+        && (now - _rfb_repeat.ts < _rfb_repeat_window);
+
+    _rfb_repeat.hash = hash;
+    _rfb_repeat.length = code.length();
+    _rfb_repeat.ts = now;
+
+    return repeated;
+}
+
 #if RELAY_SUPPORT
 
-// try to find the 'code' saves as either rfbON# or rfbOFF#
-//
-// **always** expect full length code as input to simplify comparison
-// previous implementation tried to help MQTT / API requests to match based on the saved code,
-// thus requiring us to 'return' value from settings as the real code, replacing input
-RfbRelayMatch _rfbMatch(espurna::StringView code) {
-    RfbRelayMatch matched;
-    if (!relayCount()) {
-        return matched;
+// Every rfbON# and rfbOFF# value, sorted by the _rfbCompareHash() of the code.
+// Built on demand when something is received, dropped when codes are stored or removed and on settings reload.
+struct RfbCodeEntry {
+    uint32_t hash;
+    String code;
+    size_t id;
+    PayloadStatus status;
+};
+
+static std::vector<RfbCodeEntry> _rfb_code_index;
+static bool _rfb_code_index_valid { false };
+
+void _rfbCodeIndexInvalidate() {
+    _rfb_code_index.clear();
+    _rfb_code_index.shrink_to_fit();
+    _rfb_code_index_valid = false;
+}
+
+// codes could also be changed without the reload, e.g. by the terminal 'set' and 'del'
+void _rfbSettingsChanged(espurna::StringView key) {
+    if (espurna::settings::query::samePrefix(key, STRING_VIEW("rfbON"))
+        || espurna::settings::query::samePrefix(key, STRING_VIEW("rfbOFF")))
+    {
+        _rfbCodeIndexInvalidate();
+    }
+}
+
+void _rfbCodeIndexInsert(size_t id, PayloadStatus status, String code) {
+    const auto hash = _rfbCompareHash(code);
+
+    for (auto& entry : _rfb_code_index) {
+        if ((entry.hash != hash) || (entry.code.length() != code.length())) {
+            continue;
+        }
+
+        if (!_rfbCompare(entry.code.c_str(), code.c_str(), code.length())) {
+            continue;
+        }
+
+        // when we see the same id twice, we match the opposite statuses
+        // otherwise, the lowest relay id wins
+        if (entry.id == id) {
+            entry.status = PayloadStatus::Toggle;
+        } else if (id < entry.id) {
+            entry.id = id;
+            entry.status = status;
+        }
+
+        return;
     }
 
+    _rfb_code_index.push_back(RfbCodeEntry{hash, std::move(code), id, status});
+}
+
+void _rfbCodeIndexBuild() {
+    _rfb_code_index.clear();
+
     // we gather all available options, as the kv store might be defined in any order
     // scan kvs only once, since we want both ON and OFF options and don't want to depend on the relayCount()
     espurna::settings::foreach_prefix(
-        [code, &matched](espurna::StringView prefix, String key, const espurna::settings::kvs_type::ReadResult& value) {
-            if (code.length() != value.length()) {
+        [](espurna::StringView prefix, String key, const espurna::settings::kvs_type::ReadResult& value) {
+            if (!_rfbCompareLength(value.length())) {
                 return;
             }
 
@@ -517,10 +727,6 @@ RfbRelayMatch _rfbMatch(espurna::StringView code) {
                 return;
             }
 
-            if (!_rfbCompare(code.begin(), value.read().begin(), code.length())) {
-                return;
-            }
-
             espurna::StringView id_view(key.begin() + prefix.length(), key.end());
             if (!id_view.length() || (*id_view.begin()) == '\0') {
                 return;
@@ -531,19 +737,55 @@ RfbRelayMatch _rfbMatch(espurna::StringView code) {
                 return;
             }
 
-            // when we see the same id twice, we match the opposite statuses
-            if (matched && (id == matched.id())) {
-                matched.reset(matched.id(), PayloadStatus::Toggle);
-                return;
-            }
-
-            matched.reset(matched ? std::min(id, matched.id()) : id, status);
+            _rfbCodeIndexInsert(id, status, value.read());
         },
         {
             rfbridge::settings::keys::On,
             rfbridge::settings::keys::Off
         });
 
+    std::sort(_rfb_code_index.begin(), _rfb_code_index.end(),
+        [](const RfbCodeEntry& lhs, const RfbCodeEntry& rhs) {
+            return lhs.hash < rhs.hash;
+        });
+
+    _rfb_code_index_valid = true;
+    DEBUG_MSG_P(PSTR("[RF] Indexed %u code(s)\n"), _rfb_code_index.size());
+}
+
+// try to find the 'code' saves as either rfbON# or rfbOFF#
+//
+// **always** expect full length code as input to simplify comparison
+// previous implementation tried to help MQTT / API requests to match based on the saved code,
+// thus requiring us to 'return' value from settings as the real code, replacing input
+RfbRelayMatch _rfbMatch(espurna::StringView code) {
+    RfbRelayMatch matched;
+    if (!relayCount() || !_rfbCompareLength(code.length())) {
+        return matched;
+    }
+
+    if (!_rfb_code_index_valid) {
+        _rfbCodeIndexBuild();
+    }
+
+    const auto hash = _rfbCompareHash(code);
+
+    auto it = std::lower_bound(_rfb_code_index.begin(), _rfb_code_index.end(), hash,
+        [](const RfbCodeEntry& entry, uint32_t value) {
+            return entry.hash < value;
+        });
+
+    for (; (it != _rfb_code_index.end()) && ((*it).hash == hash); ++it) {
+        if ((*it).code.length() != code.length()) {
+            continue;
+        }
+
+        if (_rfbCompare(code.begin(), (*it).code.c_str(), code.length())) {
+            matched.reset((*it).id, (*it).status);
+            break;
+        }
+    }
+
     return matched;
 }
 
@@ -643,7 +885,7 @@ void _rfbLearnFromReceived(std::unique_ptr<RfbLearn>& learn, espurna::StringView
 
 void _rfbEnqueue(uint8_t (&code)[RfbParser::PayloadSizeBasic], unsigned char repeats = 1u) {
     if (!_rfb_transmit) return;
-    _rfb_message_queue.push_back(RfbMessage(code, repeats));
+    _rfbEnqueueMessage(RfbMessage(code, repeats));
 }
 
 bool _rfbEnqueue(espurna::StringView code, unsigned char repeats = 1u) {
@@ -714,16 +956,21 @@ void _rfbParse(uint8_t code, const std::vector<uint8_t>& payload) {
         if (hexEncode(payload.data(), payload.size(), buffer, sizeof(buffer))) {
             DEBUG_MSG_P(PSTR("[RF] Received code: %s\n"), buffer);
 
+            const auto repeated = (CodeRecvBasic == code)
+                && _rfbRepeated(espurna::StringView(buffer, payload.size() * 2));
+
 #if RELAY_SUPPORT
             if (CodeLearnOk == code) {
                 _rfbLearnFromString(_rfb_learn, buffer);
-            } else {
+            } else if (!repeated) {
                 _rfbRelayHandler(buffer, true);
             }
 #endif
 
 #if MQTT_SUPPORT
-            mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+            if (!repeated) {
+                mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+            }
 #endif
 
             for (auto& handler : _rfb_code_handlers) {
@@ -746,7 +993,9 @@ void _rfbParse(uint8_t code, const std::vector<uint8_t>& payload) {
             );
 
 #if MQTT_SUPPORT
-            mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+            if (!_rfbRepeated(espurna::StringView(buffer, payload.size() * 2))) {
+                mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+            }
 #endif
 
             // ref. https://github.com/Portisch/RF-Bridge-EFM8BB1/wiki/0xA6#example-of-a-received-decoded-protocol
@@ -853,7 +1102,7 @@ template <>
 
 void _rfbEnqueue(uint8_t protocol, uint16_t timing, uint8_t bits, RfbMessage::code_type code, unsigned char repeats = 1u) {
     if (!_rfb_transmit) return;
-    _rfb_message_queue.push_back(RfbMessage{protocol, timing, bits, code, repeats});
+    _rfbEnqueueMessage(RfbMessage{protocol, timing, bits, code, repeats});
 }
 
 void _rfbEnqueue(espurna::StringView message, unsigned char repeats = 1u) {
@@ -969,16 +1218,21 @@ void _rfbReceiveImpl() {
     if (hexEncode(message, real_msgsize, buffer, sizeof(buffer))) {
         DEBUG_MSG_P(PSTR("[RF] Received code: %s\n"), buffer);
 
+        const auto repeated = _rfbRepeated(
+            espurna::StringView(buffer, real_msgsize * 2));
+
 #if RELAY_SUPPORT
         if (_rfb_learn) {
             _rfbLearnFromReceived(_rfb_learn, buffer);
-        } else {
+        } else if (!repeated) {
             _rfbRelayHandler(buffer, true);
         }
 #endif
 
 #if MQTT_SUPPORT
-        mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+        if (!repeated) {
+            mqttSend(MQTT_TOPIC_RFIN, buffer, false, false);
+        }
 #endif
 
         for (auto& handler : _rfb_code_handlers) {
@@ -998,21 +1252,25 @@ void _rfbReceiveImpl() {
 void _rfbSendQueued() {
 
     if (!_rfb_transmit) return;
-    if (_rfb_message_queue.empty()) return;
+    if (_rfb_message_queue.empty() && _rfb_repeat_queue.empty()) return;
 
     static unsigned long last = 0;
     if (millis() - last < RFB_SEND_DELAY) return;
     last = millis();
 
-    auto message = _rfb_message_queue.front();
-    _rfb_message_queue.pop_front();
+    auto& queue = !_rfb_message_queue.empty()
+        ? _rfb_message_queue
+        : _rfb_repeat_queue;
+
+    auto message = queue.front();
+    queue.pop();
 
     _rfbSendImpl(message);
 
     // Sometimes we really want to repeat the message, not only to rely on built-in transfer repeat
     if (message.repeats > 1) {
         message.repeats -= 1;
-        _rfb_message_queue.push_back(std::move(message));
+        _rfb_repeat_queue.push(message);
     }
 
     yield();
@@ -1233,6 +1491,29 @@ static void _rfbCommandForget(::terminal::CommandContext&& ctx) {
 }
 #endif // if RELAY_SUPPORT
 
+PROGMEM_STRING(RfbCommandQueue, "RFB.QUEUE");
+
+static void _rfbCommandQueue(::terminal::CommandContext&& ctx) {
+    const auto reset = (ctx.argv.size() == 2)
+        && (ctx.argv[1].equalsIgnoreCase(F("reset")));
+
+    const auto print = [&](const char* name, RfbQueue& queue) {
+        ctx.output.printf_P(
+            PSTR("%-6s size:%u capacity:%u high-water:%u pushed:%u dropped:%u\n"),
+            name,
+            queue.size(), queue.capacity(), queue.highWater(),
+            queue.pushed(), queue.dropped());
+        if (reset) {
+            queue.resetStats();
+        }
+    };
+
+    print("send", _rfb_message_queue);
+    print("repeat", _rfb_repeat_queue);
+
+    terminalOK(ctx);
+}
+
 #if RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
 PROGMEM_STRING(RfbCommandWrite, "RFB.WRITE");
 
@@ -1248,6 +1529,7 @@ static void _rfbCommandWrite(::terminal::CommandContext&& ctx) {
 
 static constexpr ::terminal::Command RfbCommands[] PROGMEM {
     {RfbCommandSend, _rfbCommandSend},
+    {RfbCommandQueue, _rfbCommandQueue},
 #if RELAY_SUPPORT
     {RfbCommandLearn, _rfbCommandLearn},
     {RfbCommandForget, _rfbCommandForget},
@@ -1298,6 +1580,7 @@ void rfbLearn(size_t id, bool status) {
 void rfbForget(size_t id, bool status) {
 
     delSetting({status ? F("rfbON") : F("rfbOFF"), id});
+    _rfbCodeIndexInvalidate();
 
     // Websocket update needs to happen right here, since the only time
     // we send these in bulk is at the very start of the connection
@@ -1363,6 +1646,14 @@ void _rfbSettingsMigrate(int version) {
 
 #endif
 
+void _rfbConfigure() {
+    _rfb_repeats = getSetting("rfbRepeat", RFB_SEND_REPEATS);
+    _rfb_repeat_window = getSetting("rfbRecvWindow", RFB_RECEIVE_REPEAT_WINDOW);
+#if RELAY_SUPPORT
+    _rfbCodeIndexInvalidate();
+#endif
+}
+
 void rfbSetup() {
 #if RFB_PROVIDER == RFB_PROVIDER_EFM8BB1
     const auto port = uartPort(RFB_PORT - 1);
@@ -1432,14 +1723,18 @@ void rfbSetup() {
     _rfbCommandsSetup();
 #endif
 
-    _rfb_repeats = getSetting("rfbRepeat", RFB_SEND_REPEATS);
+    _rfbConfigure();
+    espurnaRegisterReload(_rfbConfigure);
+#if RELAY_SUPPORT
+    settingsRegisterChange(_rfbSettingsChanged);
+#endif
 
     // Note: as rfbridge protocol is simplistic enough, we rely on Serial queue to deliver timely updates
     //       learn / command acks / etc. are not queued, only RF messages are
     espurnaRegisterLoop([]() {
         _rfbReceiveImpl();
         _rfbSendQueued();
-    });
+    }, STRING_VIEW("rfbridge"));
 
 }
 
@@ -471,7 +471,7 @@ void rfm69Setup() {
         .onKeyCheck(_rfm69WebSocketOnKeyCheck);
 #endif
 
-    espurnaRegisterLoop(_rfm69Loop);
+    espurnaRegisterLoop(_rfm69Loop, STRING_VIEW("rfm69"));
     espurnaRegisterReload(_rfm69Configure);
 }
 
@@ -715,8 +715,8 @@ void init(rpn_context& context) {
     registerGenericTimestampOperator(context, "utc_hour", ::utc_hour);
     registerGenericTimestampOperator(context, "hour", ::hour);
 
-    registerGenericTimestampOperator(context, "utc_minute", ::utc_hour);
-    registerGenericTimestampOperator(context, "minute", ::hour);
+    registerGenericTimestampOperator(context, "utc_minute", ::utc_minute);
+    registerGenericTimestampOperator(context, "minute", ::minute);
 }
 
 #undef registerGenericTimestampOperator
@@ -1352,7 +1352,7 @@ void setup() {
 #endif
 
     espurnaRegisterReload(configure);
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("rpn"));
 
     reset(true);
 }
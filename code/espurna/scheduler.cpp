@@ -689,8 +689,7 @@ RestoredAction prepareAction(const Schedule& schedule, int daysAgo) {
 void restore(time_t timestamp, const Schedules& schedules) {
     RestoredActions restored;
 
-    tm today;
-    localtime_r(&timestamp, &today);
+    const auto today = ntpLocalTime(timestamp);
 
     for (auto& schedule : schedules) {
         if (schedule.enabled && schedule.restore && !schedule.utc) {
@@ -737,11 +736,8 @@ void restore(time_t timestamp, const Schedules& schedules) {
 }
 
 void check(time_t timestamp, const Schedules& schedules) {
-    tm utc;
-    gmtime_r(&timestamp, &utc);
-
-    tm local;
-    localtime_r(&timestamp, &local);
+    const auto utc = ntpUtcTime(timestamp);
+    const auto local = ntpLocalTime(timestamp);
 
     for (auto& schedule : schedules) {
         if (!schedule.enabled) {
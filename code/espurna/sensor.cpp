@@ -2550,13 +2550,32 @@ void load() {
             return;
         }
 
-        auto* sensor = PZEM004TV30Sensor::make(port->stream,
-            getSetting("pzemv30Addr", PZEM004TV30Sensor::DefaultAddress),
+        auto master = PZEM004TV30Sensor::makeMaster(port->stream,
             getSetting("pzemv30ReadTimeout", PZEM004TV30Sensor::DefaultReadTimeout));
-        sensor->setDebug(
-            getSetting("pzemv30Debug", PZEM004TV30Sensor::DefaultDebug));
+        const auto debug = getSetting("pzemv30Debug", PZEM004TV30Sensor::DefaultDebug);
+
+        // first device keeps using the original key, others are only enabled when address is set
+        for (size_t index = 0; index < PZEM004TV30Sensor::DevicesMax; ++index) {
+            auto address = PZEM004TV30Sensor::DefaultAddress;
+            if (index) {
+                const auto value = getSetting({"pzemv30Addr", index});
+                if (!value.length()) {
+                    break;
+                }
 
-        add(sensor);
+                address = espurna::settings::internal::convert<uint8_t>(value);
+            } else {
+                address = getSetting("pzemv30Addr", PZEM004TV30Sensor::DefaultAddress);
+            }
+
+            auto* sensor = PZEM004TV30Sensor::make(master, address);
+            if (!sensor) {
+                break;
+            }
+
+            sensor->setDebug(debug);
+            add(sensor);
+        }
     }
 #endif
 }
@@ -2801,7 +2820,9 @@ struct Persist {
         _energy(energy)
     {}
 
+    // totals are also in the rtcmem, flash write may be deferred and merged with other commits
     void operator()() const {
+        EepromDeferredCommit deferred;
         setSetting({F("eneTotal"), _index}, _energy.asString());
 #if NTP_SUPPORT
         if (ntpSynced()) {
@@ -4206,7 +4227,7 @@ void setup() {
     systemBeforeSleep(sensor::suspend);
     systemAfterSleep(sensor::resume);
 
-    espurnaRegisterLoop(sensor::loop);
+    espurnaRegisterLoop(sensor::loop, STRING_VIEW("sensor"));
     espurnaRegisterReload(sensor::configure);
 }
 
@@ -9,9 +9,13 @@
 #pragma once
 
 #include "BaseEmonSensor.h"
+#include "EmonSampleWindow.h"
 
 #include "../libs/fs_math.h"
 
+#include <algorithm>
+#include <cstdint>
+
 class BaseAnalogEmonSensor : public BaseEmonSensor {
 public:
     static const BaseSensor::ClassKind Kind;
@@ -20,7 +24,11 @@ public:
     }
 
     using TimeSource = espurna::time::CoreClock;
-    static constexpr auto MaxTime = TimeSource::duration { EMON_MAX_TIME };
+
+    // Every burst is made of whole mains cycles, see EmonSampleWindow.h
+    using SampleTimeSource = espurna::time::SystemClock;
+    static constexpr auto SampleTime = SampleTimeSource::duration {
+        (EMON_SAMPLE_CYCLES * 1000000ul) / EMON_MAINS_FREQUENCY };
 
     static constexpr double IRef { EMON_CURRENT_RATIO };
 
@@ -63,7 +71,6 @@ public:
     }
 
     void setSamplesMax(size_t samples) {
-        _samples = samples;
         _samples_max = samples;
         _dirty = true;
     }
@@ -83,6 +90,8 @@ public:
         setPivot(_adc_counts >> 1); // aka divide by 2
         calculateFactors();
 
+        _window.reset(static_cast<int>(_adc_counts >> 1));
+
         _ready = true;
         _dirty = false;
 
@@ -136,41 +145,44 @@ public:
         return 0.0;
     }
 
-    double sampleCurrent() {
-        int max = 0;
-        int min = _adc_counts;
-        double sum = 0;
-
-        auto pivot = getPivot();
+    // Instead of blocking the loop until every sample is collected, take a burst of whole mains cycles on every tick().
+    // Window stops growing after the configured number of samples, pre() takes whatever was collected until then
+    void tick() override {
+        if (!_ready || sampled()) {
+            return;
+        }
 
-        const auto time_span = TimeSource::now();
-        for (size_t i = 0; i < _samples; i++) {
-            int sample;
-            double filtered;
+        if (!_window.count) {
+            _window_start = TimeSource::now();
+        }
 
-            sample = this->analogRead();
-            if (sample > max) max = sample;
-            if (sample < min) min = sample;
+        espurna::sensor::emon::burst<SampleTimeSource>(_window, SampleTime,
+            [&]() {
+                return this->analogRead();
+            });
+    }
 
-            // Digital low pass filter extracts the VDC offset
-            pivot = (pivot + (sample - pivot) / EMON_FILTER_SPEED);
-            filtered = sample - pivot;
+    // Whether the window has all of the samples it needs, until it is finished by pre()
+    bool sampled() const {
+        return _window.count >= _samples_max;
+    }
 
-            // Root-mean-square method
-            sum += (filtered * filtered);
+    // Finish the current window, and start a new one using its DC offset as the pivot
+    double sampleCurrent() {
+        const auto window = _window;
+        if (!window.count) {
+            return getCurrent();
         }
 
-        const auto elapsed = TimeSource::now() - time_span;
-
-        // Quick fix
-        if (pivot < min || max < pivot) {
-            pivot = (max + min) / 2.0;
-        }
+        const auto elapsed [[gnu::unused]] = TimeSource::now() - _window_start;
 
+        const double pivot = window.pivot + window.mean();
         setPivot(pivot);
 
+        _window.reset(static_cast<int>(std::lround(pivot)));
+
         // Calculate current
-        double rms = _samples > 0 ? fs_sqrt(sum / _samples) : 0;
+        const double rms = fs_sqrt(window.variance());
         double current = _current_factor * rms;
 
         current = (double) (int(current * _multiplier) - 1) / _multiplier;
@@ -179,22 +191,17 @@ public:
         }
 
 #if SENSOR_DEBUG
-        DEBUG_MSG_P(PSTR("[EMON] Total samples: %d\n"), _samples);
+        DEBUG_MSG_P(PSTR("[EMON] Total samples: %u\n"), window.count);
         DEBUG_MSG_P(PSTR("[EMON] Total time (ms): %u\n"), elapsed.count());
-        DEBUG_MSG_P(PSTR("[EMON] Sample frequency (Hz): %d\n"), int(1000 * _samples / elapsed.count()));
-        DEBUG_MSG_P(PSTR("[EMON] Max value: %d\n"), max);
-        DEBUG_MSG_P(PSTR("[EMON] Min value: %d\n"), min);
+        DEBUG_MSG_P(PSTR("[EMON] Sample frequency (Hz): %d\n"),
+            elapsed.count() ? int(1000 * window.count / elapsed.count()) : 0);
+        DEBUG_MSG_P(PSTR("[EMON] Max value: %d\n"), window.max);
+        DEBUG_MSG_P(PSTR("[EMON] Min value: %d\n"), window.min);
         DEBUG_MSG_P(PSTR("[EMON] Midpoint value: %d\n"), int(getPivot()));
         DEBUG_MSG_P(PSTR("[EMON] RMS value: %d\n"), int(rms));
         DEBUG_MSG_P(PSTR("[EMON] Current (mA): %d\n"), int(1000 * current));
 #endif
 
-        if ((elapsed > MaxTime)
-            || ((elapsed < MaxTime) && (_samples < _samples_max)))
-        {
-            _samples = (_samples * MaxTime.count()) / elapsed.count();
-        }
-
         return current;
     }
 
@@ -214,14 +221,18 @@ public:
     }
 
 private:
+    using Window = espurna::sensor::emon::Window;
+
     TimeSource::time_point _last_reading;
     bool _initial { true };
 
+    Window _window;
+    TimeSource::time_point _window_start;
+
     double _current_factor { 1.0 };                 // Calculated, reads (RMS) to current
     unsigned int _multiplier { 1 };                 // Calculated, error
 
-    size_t _samples_max { EMON_MAX_SAMPLES };       // Number of samples, will be adjusted at runtime
-    size_t _samples { _samples_max };               // based on the maximum value
+    size_t _samples_max { EMON_MAX_SAMPLES };       // Number of samples per reading
 
     size_t _resolution { EMON_ANALOG_RESOLUTION };  // ADC resolution (in bits)
     size_t _adc_counts { static_cast<size_t>(1) << _resolution };       // Max count
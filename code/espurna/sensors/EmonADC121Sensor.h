@@ -89,10 +89,9 @@ public:
 
         config();
 
-        // Init base class and do a warm-up run
+        // Init base class, samples are collected in tick()
         setResolution(ADC121_RESOLUTION);
         BaseAnalogEmonSensor::begin();
-        BaseAnalogEmonSensor::sampleCurrent();
 
         _dirty = false;
     }
@@ -157,6 +157,23 @@ public:
             return _gain;
         }
 
+        // Channels sharing the port are sampled one at a time, each one collecting the whole window
+        // before passing the port to the next one. Otherwise, every channel switch reconfigures the chip
+        // and waits for the conversion, and the results are mixed with the conversions of other channels
+        bool acquire(const void* owner) {
+            if (!_owner) {
+                _owner = owner;
+            }
+
+            return _owner == owner;
+        }
+
+        void release(const void* owner) {
+            if (_owner == owner) {
+                _owner = nullptr;
+            }
+        }
+
         unsigned int read(unsigned char channel) {
             // Make sure we configure the correct channel for reading
             // Force stop by setting single mode and back to continuous
@@ -186,6 +203,7 @@ public:
 
     private:
         I2CSensorAddress _sensor_address;
+        const void* _owner { nullptr };
         uint8_t _channel { 0xff };
         uint8_t _address { 0x00 };
         uint8_t _type { ADS1X15_CHIP_ADS1115 };
@@ -232,7 +250,6 @@ public:
         setResolution(ADS1X15_RESOLUTION);
         setReferenceVoltage(gainToReference(_port->gain()));
         BaseAnalogEmonSensor::begin();
-        BaseAnalogEmonSensor::sampleCurrent();
 
         _dirty = false;
     }
@@ -266,6 +283,17 @@ public:
         return String(buffer);
     }
 
+    void tick() override {
+        if (!_port->acquire(this)) {
+            return;
+        }
+
+        BaseAnalogEmonSensor::tick();
+        if (!ready() || sampled()) {
+            _port->release(this);
+        }
+    }
+
     unsigned int analogRead() override {
         return _port->read(_channel);
     }
@@ -26,7 +26,6 @@ public:
     void begin() override {
         if (_dirty) {
             BaseAnalogEmonSensor::begin();
-            BaseAnalogEmonSensor::sampleCurrent();
             _dirty = false;
         }
         _ready = true;
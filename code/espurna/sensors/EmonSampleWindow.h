@@ -0,0 +1,79 @@
+// -----------------------------------------------------------------------------
+// Energy Monitor sampling window, shared by the analog EMON sensors
+// Copyright (C) 2020-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+namespace espurna {
+namespace sensor {
+namespace emon {
+
+// Integer-only running totals of the sampling window. Samples are offset by the pivot (DC offset
+// found in the previous window), which keeps the squares small. Whatever offset remains is
+// the mean of the window, and it is removed from the sum of squares only when the window is finished.
+struct Window {
+    void reset(int value) {
+        *this = Window();
+        pivot = value;
+    }
+
+    void add(int sample) {
+        const int32_t delta = sample - pivot;
+        const uint32_t magnitude = std::abs(delta);
+
+        sum += delta;
+        squares += magnitude * magnitude;
+
+        min = std::min(min, sample);
+        max = std::max(max, sample);
+
+        ++count;
+    }
+
+    double mean() const {
+        return count
+            ? static_cast<double>(sum) / count
+            : 0.0;
+    }
+
+    // RMS is the square root of this, without the DC offset
+    double variance() const {
+        if (!count) {
+            return 0.0;
+        }
+
+        const double average = mean();
+        const double out = (static_cast<double>(squares) / count) - (average * average);
+
+        return (out > 0.0) ? out : 0.0;
+    }
+
+    int64_t sum { 0 };
+    uint64_t squares { 0 };
+    size_t count { 0 };
+    int pivot { 0 };
+    int min { INT_MAX };
+    int max { INT_MIN };
+};
+
+// Samples are taken back-to-back for the whole 'duration'. When it is a whole number of mains cycles,
+// every burst covers every phase of the waveform equally, no matter when the loop decides to call it.
+// (shorter bursts started at the loop interval lock to the waveform phase and bias the RMS)
+template <typename TimeSource, typename Read>
+void burst(Window& window, typename TimeSource::duration duration, Read&& read) {
+    const auto start = TimeSource::now();
+    do {
+        window.add(static_cast<int>(read()));
+    } while (TimeSource::now() - start < duration);
+}
+
+} // namespace emon
+} // namespace sensor
+} // namespace espurna
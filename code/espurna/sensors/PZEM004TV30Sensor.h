@@ -13,11 +13,13 @@ Copyright (C) 2020 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 
 #include "BaseEmonSensor.h"
 
+#include "../modbus_rtu.h"
 #include "../utils.h"
 #include "../terminal.h"
 
 #include <cstdint>
-#include <array>
+#include <memory>
+#include <vector>
 
 #if DEBUG_SUPPORT
 #define PZEM_DEBUG_MSG_P(...) do { if (_debug) {\
@@ -32,30 +34,36 @@ public:
     using TimeSource = espurna::time::CoreClock;
     using Instance = std::unique_ptr<PZEM004TV30Sensor>;
 
+    using Frame = espurna::modbus::Frame;
+    using Master = espurna::modbus::Master;
+    using MasterPtr = std::shared_ptr<Master>;
+
+    static constexpr size_t DevicesMax { PZEM004TV30_DEVICES_MAX };
+
+    // Every device on the line shares the same master, requests are queued and never block the loop
+    static MasterPtr makeMaster(Stream* port, TimeSource::duration timeout) {
+        static_assert(std::is_same<TimeSource::duration, espurna::duration::Milliseconds>::value, "");
+        return std::make_shared<Master>(*port, timeout, DefaultSilence);
+    }
+
     // Note that the device (aka slave) address needs be changed first via
     // - some external tool. For example, using USB2TTL adapter and a PC app
-    // - `pzem.address` with **only** one device on the line
+    // - `pz.address` with **only** one device on the line
     //    (because we would change all 0xf8-addressed devices at the same time)
-    static PZEM004TV30Sensor* make(Stream* port, uint8_t address, TimeSource::duration timeout) {
-        static_assert(std::is_same<TimeSource::duration, espurna::duration::Milliseconds>::value, "");
-        if (!_instance) {
-            _instance.reset(new PZEM004TV30Sensor(port, address, timeout));
-            return _instance.get();
+    static PZEM004TV30Sensor* make(MasterPtr master, uint8_t address) {
+        if (_instances.size() >= DevicesMax) {
+            return nullptr;
         }
 
-        return nullptr;
-    }
+        for (const auto& instance : _instances) {
+            if (instance->_address == address) {
+                return nullptr;
+            }
+        }
 
-    // per MODBUS application protocol specification
-    // > 4.1 Protocol description
-    // > ...
-    // > The size of the MODBUS PDU is limited by the size constraint inherited from the first
-    // > MODBUS implementation on Serial Line network (max. RS485 ADU = 256 bytes).
-    // > Therefore:
-    // > MODBUS PDU for serial line communication = 256 - Server address (1 byte) - CRC (2
-    // > bytes) = 253 bytes.
-    // However, we only ever expect very small payloads. Maximum being 10 registers at the same time.
-    static constexpr size_t BufferSize = 25u;
+        _instances.emplace_back(new PZEM004TV30Sensor(std::move(master), address));
+        return _instances.back().get();
+    }
 
     // stock address, cannot be used with multiple devices on the line
     static constexpr uint8_t DefaultAddress = 0xf8;
@@ -65,18 +73,22 @@ public:
     static constexpr auto DefaultUpdateInterval = espurna::duration::Milliseconds { 200 };
     static constexpr bool DefaultDebug { 1 == PZEM004TV30_DEBUG };
 
+    // enough to finish the reading that is already in-flight, and then to wait for the response
+    static constexpr auto CommandTimeout = espurna::duration::Milliseconds { 1000 };
+
+    // 3.5 character times at 9600 baud (1 start bit, 8 data bits, 1 stop bit), rounded up
+    static constexpr auto DefaultSilence = espurna::duration::Milliseconds { 4 };
+
     // Device uses Modbus-RTU protocol and implements the following function codes:
     // - 0x03 (Read Holding Register) (NOT IMPLEMENTED)
     // - 0x04 (Read Input Register) (measurements readout)
     // - 0x06 (Write Single Register) (set device address, set alarm is NOT IMPLEMENTED)
     // - 0x41 (Calibration) (NOT IMPLEMENTED)
     // - 0x42 (Reset energy) (can only reset to 0)
-    static constexpr uint8_t ReadInputCode = 0x04;
-    static constexpr uint8_t WriteCode = 0x06;
+    static constexpr uint8_t ReadInputCode = espurna::modbus::ReadInputRegisters;
+    static constexpr uint8_t WriteCode = espurna::modbus::WriteSingleRegister;
     static constexpr uint8_t ResetEnergyCode = 0x42;
 
-    static constexpr uint8_t ErrorMask = 0x80;
-
     // We **can** reset PZEM energy, unlike the original PZEM004T
     // However, we can't set it to a specific value, we can only start from 0
     void resetEnergy(unsigned char index, espurna::sensor::Energy) override {
@@ -108,207 +120,96 @@ public:
 
     // ---------------------------------------------------------------------
 
-    using buffer_type = std::array<uint8_t, BufferSize>;
-
-    // - PZEM manual "2.7 CRC check":
-    // > CRC check use 16bits format, occupy two bytes, the generator polynomial is X16 + X15 + X2 +1,
-    // > the polynomial value used for calculation is 0xA001.
-    // - Note that we use a simple function instead of a table to save space and RAM.
-    static uint16_t crc16modbus(uint8_t* data, size_t size) {
-        auto crc16_update = [](uint16_t crc, uint8_t value) {
-            crc ^= static_cast<uint16_t>(value);
-            for (size_t index = 0; index < 8; ++index) {
-                if (crc & 1) {
-                    crc = (crc >> 1) ^ 0xa001;
-                } else {
-                    crc = (crc >> 1);
-                }
-            }
-            return crc;
-        };
-
-        uint16_t crc = 0xffff;
-        for (size_t index = 0; index < size; ++index) {
-            crc = crc16_update(crc, data[index]);
-        }
-
-        return crc;
+    void modbusDebugFrame(const String& message, const Frame& frame) {
+        hexEncode(frame.begin(), frame.size, _debug_buffer, sizeof(_debug_buffer));
+        PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] %s: %s (%u bytes)\n"), message.c_str(), _debug_buffer, frame.size);
     }
 
-    struct adu_builder {
-        adu_builder(uint8_t device_address, uint8_t fcode) :
-            buffer({device_address, fcode}),
-            size(2)
-        {}
-
-        adu_builder& add(uint8_t value) {
-            if (!locked && (size < buffer.size())) {
-                buffer[size] = value;
-                size += 1;
-            }
-            return *this;
-        }
-
-        adu_builder& add(uint16_t value) {
-            if (!locked && ((size + 1) < buffer.size())) {
-                buffer[size] = static_cast<uint8_t>((value >> 8) & 0xff);
-                buffer[size + 1] = static_cast<uint8_t>(value & 0xff);
-                size += 2;
-            }
-            return *this;
-        }
-
-        // Note that CRC order is reversed in comparison to every other value
-        adu_builder& end() {
-            static_assert(BufferSize >= 4, "Cannot fit the minimal request");
-            if (!locked) {
-                uint16_t value = crc16modbus(buffer.data(), size);
-                buffer[size] = static_cast<uint8_t>(value & 0xff);
-                buffer[size + 1] = static_cast<uint8_t>((value >> 8) & 0xff);
-                size += 2;
-                locked = true;
-            }
-            return *this;
+    // Request is queued and the callback is only called when the response passes all of the checks.
+    // Only one request per device is allowed to be in-flight
+    template <typename Callback>
+    bool modbusSend(Frame request, Callback callback) {
+        if (_pending) {
+            return false;
         }
 
-        buffer_type buffer;
-        size_t size { 0 };
-        bool locked { false };
-    };
-
-    void modbusDebugBuffer(const String& message, buffer_type& buffer, size_t size) {
-        hexEncode(buffer.data(), size, _debug_buffer, sizeof(_debug_buffer));
-        PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] %s: %s (%u bytes)\n"), message.c_str(), _debug_buffer, size);
-    }
+        const auto result = _master->send(std::move(request),
+            [this, callback](espurna::modbus::Error error, const Frame& response) {
+                _pending = false;
+                modbusResponse(error, response, callback);
+            });
 
-    static size_t modbusExpect(const adu_builder& builder) {
-        if (!builder.locked) {
-            return 0;
+        if (result != espurna::modbus::Error::None) {
+            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: Cannot queue the request\n"));
+            return false;
         }
 
-        switch (builder.buffer[1]) {
-        case ReadInputCode:
-            if (builder.size >= 6) {
-                return 3 + (2 * ((builder.buffer[4] << 8) | (builder.buffer[5]))) + 2;
-            }
-            return 0;
-        case WriteCode:
-            return builder.size;
-        case ResetEnergyCode:
-            return builder.size;
-        default:
-            return 0;
-        }
+        _pending = true;
+        return true;
     }
 
     template <typename Callback>
-    void modbusProcess(const adu_builder& builder, Callback callback) {
-        if (!builder.locked) {
-            return;
-        }
-
-        _port->write(builder.buffer.data(), builder.size);
-
-        size_t expect = modbusExpect(builder);
-        if (!expect) {
-            return;
-        }
-
-        uint8_t code = builder.buffer[1];
-        uint8_t error_code = ErrorMask | code;
-
-        size_t bytes = 0;
-
-        buffer_type buffer;
-
-        // In case we need multiple devices, we need to manually set each one with an unique address **and** also provide
-        // a way to distinguish between bus messages based on addresses received. Multiple instances **could** work,
-        // based on the idea that we never receive replies from unknown addresses i.e. we never NOT read responses fully
-        // and leave something in the serial buffers.
-        // TODO: testing is much easier, b/c we can just grab any modbus simulator and set up multiple devices
-        const auto ts = TimeSource::now();
-        while ((bytes < expect) && (TimeSource::now() - ts < _read_timeout)) {
-            int c = _port->read();
-            if (c < 0) {
-                continue;
-            }
-
-            if ((0 == bytes) && (_address != c)) {
-                continue;
-            }
-
-            if (1 == bytes) {
-                if (error_code == c) {
-                    expect = 5;
-                } else if (code != c) {
-                    bytes = 0;
-                    continue;
-                }
-            }
-
-            buffer[bytes++] = static_cast<uint8_t>(c);
-        }
-
-        if (bytes && _debug) {
-            modbusDebugBuffer(F("Received"), buffer, bytes);
+    void modbusResponse(espurna::modbus::Error error, const Frame& response, const Callback& callback) {
+        if (response.size && _debug) {
+            modbusDebugFrame(F("Received"), response);
         }
 
-        if (bytes != expect) {
-            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: Expected %u bytes, got %u\n"), expect, bytes);
-            _error = SENSOR_ERROR_OTHER; // TODO: more error codes
-            return;
-        }
+        switch (error) {
+        case espurna::modbus::Error::None:
+            _last_error = SENSOR_ERROR_OK;
+            callback(response);
+            break;
 
-        uint16_t received_crc = static_cast<uint16_t>(buffer[bytes - 1] << 8) | static_cast<uint16_t>(buffer[bytes - 2]);
-        uint16_t crc = crc16modbus(buffer.data(), bytes - 2);
-        if (received_crc != crc) {
-            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: CRC invalid: expected %04X expected, received %04X\n"), crc, received_crc);
-            _error = SENSOR_ERROR_CRC;
-            return;
-        }
+        case espurna::modbus::Error::Crc:
+            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: CRC invalid\n"));
+            _last_error = SENSOR_ERROR_CRC;
+            break;
 
-        if (buffer[1] & ErrorMask) {
+        case espurna::modbus::Error::Exception:
             PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: %s (0x%02X)\n"),
-                errorToString(buffer[2]).c_str(), buffer[2]);
-            return;
-        }
+                errorToString(response.buffer[2]).c_str(), response.buffer[2]);
+            _last_error = SENSOR_ERROR_OTHER;
+            break;
 
-        callback(std::move(buffer), bytes);
+        case espurna::modbus::Error::Invalid:
+        case espurna::modbus::Error::QueueFull:
+        case espurna::modbus::Error::Timeout:
+            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] ERROR: No response, got %u bytes\n"), response.size);
+            _last_error = SENSOR_ERROR_OTHER; // TODO: more error codes
+            break;
+        }
     }
 
     // Energy reset is a 'custom' function, and it does not take any function params
+    // quoting pzem user manual: "Set up correctly, the slave return to the data which is sent from the master.",
     bool modbusResetEnergy() {
-        const auto request = adu_builder(_address, ResetEnergyCode)
+        const auto request = espurna::modbus::Builder(_address, ResetEnergyCode)
             .end();
 
-        // quoting pzem user manual: "Set up correctly, the slave return to the data which is sent from the master.",
-        bool result = false;
-        modbusProcess(request, [&](buffer_type&& buffer, size_t size) {
-            result = std::equal(request.buffer.begin(), request.buffer.begin() + size, buffer.begin());
-        });
-
-        return result;
+        return modbusSend(request,
+            [this, request](const Frame& response) {
+                const auto result [[gnu::unused]] = std::equal(
+                    request.begin(), request.end(), response.begin(), response.end());
+                PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] Energy reset - %s\n"),
+                    result ? PSTR("OK") : PSTR("FAIL"));
+            });
     }
 
     // Address setter is only needed when we are using multiple devices.
     // Note that we would no longer be able to receive replies without changing _address member too
-    bool modbusChangeAddress(uint8_t to) {
-        if (_address == to) {
-            return true;
-        }
-
-        const auto request = adu_builder(_address, WriteCode)
+    // Same as for resetEnergy, we receive echo
+    template <typename Callback>
+    bool modbusChangeAddress(uint8_t to, Callback callback) {
+        const auto request = espurna::modbus::Builder(_address, WriteCode)
             .add(static_cast<uint16_t>(2))
             .add(static_cast<uint16_t>(to))
             .end();
 
-        // same as for resetEnergy, we receive echo
-        bool result = false;
-        modbusProcess(request, [&](buffer_type&& buffer, size_t size) {
-            result = std::equal(request.buffer.begin(), request.buffer.begin() + size, buffer.begin());
-        });
-
-        return result;
+        return modbusSend(request,
+            [request, callback](const Frame& response) {
+                callback(std::equal(
+                    request.begin(), request.end(), response.begin(), response.end()));
+            });
     }
 
     // For more, see MODBUS application protocol specification, 7 MODBUS Exception Responses
@@ -363,15 +264,15 @@ public:
         bool ok { false };
     };
 
-    static Reading parseReading(buffer_type&& buffer, size_t size) {
+    static Reading parseReading(const Frame& frame) {
         Reading out;
 
-        if (25 != size) {
+        if (25 != frame.size) {
             return out;
         }
 
-        auto it = buffer.begin() + 3;
-        auto end = buffer.end();
+        auto it = frame.begin() + 3;
+        auto end = frame.end();
 
         auto take_2 = [&]() -> double {
             double value = 0.0;
@@ -446,17 +347,16 @@ public:
     // ReadInput reply can be one of:
     // - addr, 0x04, nbytes, rndatahigh, rndatalow, rndata..., crchigh, crclow (on success)
     // - addr, 0x84, error_code, crchigh, crclow (on error. modbus rtu sets high bit to 1 i.e. 0b00000100 becomes 0b10000100)
-    void modbusReadValues() {
-        _error = SENSOR_ERROR_OK;
-
-        const auto request = adu_builder(_address, ReadInputCode)
+    // Energy delta is accumulated until the next pre(), there could be multiple readings in-between
+    bool modbusReadValues() {
+        const auto request = espurna::modbus::Builder(_address, ReadInputCode)
             .add(static_cast<uint16_t>(0))
             .add(static_cast<uint16_t>(10))
             .end();
 
-        modbusProcess(request,
-            [&](buffer_type&& buffer, size_t size) {
-                const auto reading = parseReading(std::move(buffer), size);
+        return modbusSend(request,
+            [this](const Frame& response) {
+                const auto reading = parseReading(response);
                 if (!reading.ok) {
                     PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] Could not parse latest reading\n"));
                     return;
@@ -465,7 +365,7 @@ public:
                 if (_last_reading.ok && reading.ok) {
                     const auto delta = energyDelta(
                         _last_reading.energy_active, reading.energy_active);
-                    _energy_delta = delta.value;
+                    _energy_delta_pending += delta.value;
                 }
 
                 _last_reading = reading;
@@ -547,51 +447,63 @@ public:
         return 0.0;
     }
 
-    void pre() override {
-        consumeAvailable(*_port);
+    // Shared master is ticked by every instance, which is harmless as nothing happens
+    // until the line is quiet or the response arrives
+    void tick() override {
+        const auto now = TimeSource::now();
+        _master->tick(now.time_since_epoch());
+
+        if (_pending) {
+            return;
+        }
 
         if (_reset_energy) {
-            const auto result [[gnu::unused]] = modbusResetEnergy();
-            PZEM_DEBUG_MSG_P(PSTR("[PZEM004TV3] Energy reset - %s\n"),
-                result ? PSTR("OK") : PSTR("FAIL"));
-            _reset_energy = false;
-            consumeAvailable(*_port);
+            _reset_energy = !modbusResetEnergy();
+            return;
         }
 
-        if (TimeSource::now() - _last_update > _update_interval) {
-            modbusReadValues();
-            _last_update = TimeSource::now();
+        if (now - _last_update > _update_interval) {
+            if (modbusReadValues()) {
+                _last_update = now;
+            }
         }
     }
 
+    void pre() override {
+        _error = _last_error;
+        _energy_delta = _energy_delta_pending;
+        _energy_delta_pending = 0.0;
+    }
+
 #if TERMINAL_SUPPORT
     static void command_address(::terminal::CommandContext&&);
 #endif
 private:
     PZEM004TV30Sensor() = delete;
-    PZEM004TV30Sensor(Stream* port, uint8_t address, TimeSource::duration timeout) :
+    PZEM004TV30Sensor(MasterPtr master, uint8_t address) :
         BaseEmonSensor(Magnitudes),
-        _port(port),
-        _address(address),
-        _read_timeout(timeout)
+        _master(std::move(master)),
+        _address(address)
     {}
 
-    Stream* _port { nullptr };
+    MasterPtr _master;
     uint8_t _address { DefaultAddress };
-    TimeSource::duration _read_timeout { DefaultReadTimeout };
 
     bool _debug { false };
-    char _debug_buffer[(BufferSize * 2) + 1];
+    char _debug_buffer[(espurna::modbus::FrameSize * 2) + 1];
 
+    bool _pending { false };
     bool _reset_energy { false };
+    int _last_error { SENSOR_ERROR_OK };
 
     TimeSource::duration _update_interval { DefaultUpdateInterval };
     TimeSource::time_point _last_update;
 
-    double _energy_delta;
+    double _energy_delta { 0.0 };
+    double _energy_delta_pending { 0.0 };
     Reading _last_reading;
 
-    static Instance _instance;
+    static std::vector<Instance> _instances;
 };
 
 #if __cplusplus < 201703L
@@ -600,8 +512,10 @@ constexpr BaseEmonSensor::Magnitude PZEM004TV30Sensor::Magnitudes[];
 
 constexpr espurna::duration::Milliseconds PZEM004TV30Sensor::DefaultReadTimeout;
 constexpr espurna::duration::Milliseconds PZEM004TV30Sensor::DefaultUpdateInterval;
+constexpr espurna::duration::Milliseconds PZEM004TV30Sensor::DefaultSilence;
+constexpr espurna::duration::Milliseconds PZEM004TV30Sensor::CommandTimeout;
 
-PZEM004TV30Sensor::Instance PZEM004TV30Sensor::_instance{};
+std::vector<PZEM004TV30Sensor::Instance> PZEM004TV30Sensor::_instances;
 
 PROGMEM_STRING(PzemV3Address, "PZ.ADDRESS");
 
@@ -611,11 +525,39 @@ void PZEM004TV30Sensor::command_address(::terminal::CommandContext&& ctx) {
         return;
     }
 
-    uint8_t address = espurna::settings::internal::convert<uint8_t>(ctx.argv[1]);
+    if (_instances.empty()) {
+        terminalError(ctx, F("No devices"));
+        return;
+    }
+
+    const auto address = espurna::settings::internal::convert<uint8_t>(ctx.argv[1]);
+
+    auto& instance = *_instances.front();
+    if (instance._address == address) {
+        terminalOK(ctx);
+        return;
+    }
+
+    // Since this only works with a single device on the line, simply wait for the response right here.
+    // Result is shared with the callback, in case it never arrives in time
+    auto result = std::make_shared<bool>(false);
+    bool sent { false };
+
+    espurna::time::blockingDelay(CommandTimeout, espurna::duration::Milliseconds(1),
+        [&]() {
+            if (!sent) {
+                sent = instance.modbusChangeAddress(address,
+                    [result](bool value) {
+                        *result = value;
+                    });
+            }
+
+            instance._master->tick(TimeSource::now().time_since_epoch());
+            return !sent || instance._pending;
+        });
 
-    consumeAvailable(*(_instance->_port));
-    if (_instance->modbusChangeAddress(address)) {
-        _instance->_address = address;
+    if (*result) {
+        instance._address = address;
         setSetting("pzemv30Addr", address);
         terminalOK(ctx);
         return;
@@ -51,6 +51,15 @@ class SHT3XI2CSensor : public I2CSensor<> {
 
     public:
 
+        using TimeSource = espurna::time::CoreClock;
+
+        // Measurement is scheduled in the background and pre() only picks up the latest result.
+        // Datasheet recommends to not measure more often than once per second, to avoid self-heating.
+        static constexpr auto UpdateInterval = espurna::duration::Seconds(1);
+
+        // High repeatability measurement takes up to 15ms
+        static constexpr auto MeasurementTime = espurna::duration::Milliseconds(20);
+
         // ---------------------------------------------------------------------
         // Sensor API
         // ---------------------------------------------------------------------
@@ -98,28 +107,37 @@ class SHT3XI2CSensor : public I2CSensor<> {
             return MAGNITUDE_NONE;
         }
 
-        // Pre-read hook (usually to populate registers with up-to-date data)
-        void pre() override {
-            _error = SENSOR_ERROR_OK;
+        // Conversion wait is handled by the I2C scheduler, other devices are free to use the bus in the meantime
+        void tick() override {
+            if (!_ready || _pending) {
+                return;
+            }
 
-            const auto address = lockedAddress();
+            const auto now = TimeSource::now();
+            if (now - _last_update < UpdateInterval) {
+                return;
+            }
 
             // Measurement High Repeatability with Clock Stretch Enabled
-            i2c_write_uint8(address, 0x2C, 0x06);
-            espurna::time::blockingDelay(
-                espurna::duration::Milliseconds(20));
-
-            unsigned char buffer[6];
-            i2c_read_buffer(address, buffer, std::size(buffer));
-
-            // result bytes are as follows
-            // cTemp msb, cTemp lsb, cTemp crc, humidity msb, humidity lsb, humidity crc
-            if ((_sht3x_crc8(buffer[0], buffer[1], buffer[2])) && (_sht3x_crc8(buffer[3], buffer[4], buffer[5]))) {
-                _temperature = ((((buffer[0] * 256.0) + buffer[1]) * 175) / 65535.0) - 45;
-                _humidity = ((((buffer[3] * 256.0) + buffer[4]) * 100) / 65535.0);
-            } else {
-                _error = SENSOR_ERROR_CRC;
+            const auto result = i2cSchedule(
+                espurna::i2c::Plan(lockedAddress())
+                    .write({0x2C, 0x06})
+                    .wait(MeasurementTime)
+                    .read(6),
+                [this](espurna::i2c::Error error, uint8_t, const espurna::i2c::Plan& plan) {
+                    _pending = false;
+                    _measurement(error, plan);
+                });
+
+            if (result == espurna::i2c::Error::None) {
+                _pending = true;
+                _last_update = now;
             }
+        }
+
+        // Pre-read hook (usually to populate registers with up-to-date data)
+        void pre() override {
+            _error = _last_error;
 
 #if SENSOR_DEBUG
             _statusRegister();
@@ -135,6 +153,23 @@ class SHT3XI2CSensor : public I2CSensor<> {
 
     private:
 
+        // result bytes are as follows
+        // cTemp msb, cTemp lsb, cTemp crc, humidity msb, humidity lsb, humidity crc
+        void _measurement(espurna::i2c::Error error, const espurna::i2c::Plan& plan) {
+            if (error != espurna::i2c::Error::None) {
+                _last_error = SENSOR_ERROR_I2C;
+                return;
+            }
+
+            if ((_sht3x_crc8(plan[0], plan[1], plan[2])) && (_sht3x_crc8(plan[3], plan[4], plan[5]))) {
+                _temperature = (((plan.value16(0)) * 175) / 65535.0) - 45;
+                _humidity = (((plan.value16(3)) * 100) / 65535.0);
+                _last_error = SENSOR_ERROR_OK;
+            } else {
+                _last_error = SENSOR_ERROR_CRC;
+            }
+        }
+
         // Read the status register and output to Debug log
         void _statusRegister() {
             const auto address = lockedAddress();
@@ -174,6 +209,10 @@ class SHT3XI2CSensor : public I2CSensor<> {
         double _temperature = 0;
         double _humidity = 0;
 
+        TimeSource::time_point _last_update;
+        int _last_error { SENSOR_ERROR_WARM_UP };
+        bool _pending { false };
+
 };
 
 #endif // SENSOR_SUPPORT && SHT3X_I2C_SUPPORT
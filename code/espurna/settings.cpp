@@ -13,6 +13,7 @@ Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
 #include "storage_eeprom.h"
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 #include <cstdlib>
 
@@ -139,16 +140,40 @@ bool EnumerationNumericHelper::check(const String& value) {
 
 } // namespace options
 
+namespace internal {
+namespace {
+
+std::forward_list<ChangeCallback> change_callbacks;
+
+void changed(const String& key) {
+    for (const auto& callback : change_callbacks) {
+        callback(StringView{key});
+    }
+}
+
+} // namespace
+} // namespace internal
+
 ValueResult get(const String& key) {
     return kv_store.get(key);
 }
 
 bool set(const String& key, const String& value) {
-    return kv_store.set(key, value);
+    const auto out = kv_store.set(key, value);
+    if (out) {
+        internal::changed(key);
+    }
+
+    return out;
 }
 
 bool del(const String& key) {
-    return kv_store.del(key);
+    const auto out = kv_store.del(key);
+    if (out) {
+        internal::changed(key);
+    }
+
+    return out;
 }
 
 bool has(const String& key) {
@@ -168,6 +193,23 @@ size_t available() {
     return kv_store.available();
 }
 
+KeyValues snapshot() {
+    return embedis::snapshot(kv_store);
+}
+
+KeyValues snapshot(query::StringViewIterator prefixes) {
+    return embedis::snapshot(kv_store,
+        [&](const String& key) {
+            for (auto it = prefixes.begin(); it != prefixes.end(); ++it) {
+                if (query::samePrefix(StringView{key}, (*it))) {
+                    return true;
+                }
+            }
+
+            return false;
+        });
+}
+
 size_t size() {
     return kv_store.size();
 }
@@ -176,6 +218,125 @@ void foreach(KeyValueResultCallback&& callback) {
     kv_store.foreach(callback);
 }
 
+Restore::Restore() {
+    eepromTransactionBegin();
+}
+
+Restore::~Restore() {
+    if ((_state != State::Done) && (_state != State::Failed)) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] Restore was interrupted\n"));
+        _rollback();
+    }
+}
+
+void Restore::_rollback() {
+    _state = State::Failed;
+    eepromTransactionRollback();
+
+    // storage contents were replaced, positions are no longer valid
+    kv_store.invalidate();
+}
+
+// .../config places metadata right after the header. Pairs are only written after
+// all of it is known, since 'backup' key would otherwise reset the already written pairs
+void Restore::_header() {
+    if (_reset) {
+        resetSettings();
+        _reset = false;
+    }
+
+    _state = State::Pairs;
+}
+
+// Note: we try to match what /config generates, expect {"app":"ESPURNA",...}
+// before anything else, so nothing is written when it is not our backup
+bool Restore::_pair(const String& key, const String& value) {
+    if (_state == State::App) {
+        if (key != F("app")) {
+            DEBUG_MSG_P(PSTR("[SETTINGS] Missing 'app' key\n"));
+            return false;
+        }
+
+        if (buildApp().name != StringView(value)) {
+            DEBUG_MSG_P(PSTR("[SETTINGS] Invalid 'app' key\n"));
+            return false;
+        }
+
+        _state = State::Header;
+        return true;
+    }
+
+    // .../config will add this key, but it is optional
+    if (key.startsWith(F("backup"))) {
+        if (_state != State::Header) {
+            DEBUG_MSG_P(PSTR("[SETTINGS] 'backup' key must precede the settings\n"));
+            return false;
+        }
+
+        _reset = internal::convert<bool>(value);
+        return true;
+    }
+
+    // these are just metadata, no need to actually store them
+    if (key.startsWith(F("app")) || key.startsWith(F("version"))) {
+        return true;
+    }
+
+    if (_state == State::Header) {
+        _header();
+    }
+
+    if (!set(key, value)) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] Not enough space for '%s'\n"), key.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Restore::feed(const uint8_t* data, size_t size) {
+    if ((_state == State::Done) || (_state == State::Failed)) {
+        return false;
+    }
+
+    const auto result = _parser.feed(data, size,
+        [&](const String& key, const String& value) {
+            return _pair(key, value);
+        });
+
+    if (!result) {
+        if (_parser.error() != json::Parser::Error::Aborted) {
+            DEBUG_MSG_P(PSTR("[SETTINGS] JSON parsing error\n"));
+        }
+        _rollback();
+    }
+
+    return result;
+}
+
+bool Restore::finish() {
+    if (_state == State::Failed) {
+        return false;
+    }
+
+    if (!_parser.finish() || (_state == State::App)) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] Incomplete JSON\n"));
+        _rollback();
+        return false;
+    }
+
+    if (_state == State::Header) {
+        _header();
+    }
+
+    _state = State::Done;
+    eepromTransactionCommit();
+    saveSettings();
+
+    DEBUG_MSG_P(PSTR("[SETTINGS] Settings restored successfully\n"));
+    return true;
+}
+
 void foreach_prefix(PrefixResultCallback&& callback, query::StringViewIterator prefixes) {
     kv_store.foreach([&](kvs_type::KeyValueResult&& kv) {
         auto key = kv.key.read();
@@ -221,37 +382,107 @@ void dump(const ::terminal::CommandContext& ctx, const query::IndexedSetting* be
 
 namespace commands {
 
+// Both CONFIG and KEYS output is generated one key at a time,
+// allowing slow outputs to only ask for more when they are ready
+struct SnapshotOutput {
+    KeyValues kvs;
+    size_t index { 0 };
+};
+
+using SnapshotOutputPtr = std::shared_ptr<SnapshotOutput>;
+
+// Optional arguments are key prefixes, e.g. `KEYS relay rfb`
+SnapshotOutputPtr make_snapshot_output(const ::terminal::CommandContext& ctx) {
+    KeyValues kvs;
+    if (ctx.argv.size() > 1) {
+        std::vector<StringView> prefixes(ctx.argv.begin() + 1, ctx.argv.end());
+        kvs = settings::snapshot(
+            query::StringViewIterator(prefixes.data(), prefixes.data() + prefixes.size()));
+    } else {
+        kvs = settings::snapshot();
+    }
+
+    return std::make_shared<SnapshotOutput>(
+        SnapshotOutput{
+            .kvs = std::move(kvs),
+            .index = 0,
+        });
+}
+
+void print_escaped(Print& out, const String& value) {
+    for (auto c : value) {
+        switch (c) {
+        case '"':
+        case '\\':
+            out.print('\\');
+            out.print(c);
+            break;
+        default:
+            if (static_cast<uint8_t>(c) < 0x20) {
+                out.printf_P(PSTR("\\u%04x"), static_cast<uint8_t>(c));
+                break;
+            }
+            out.print(c);
+            break;
+        }
+    }
+}
+
 PROGMEM_STRING(Config, "CONFIG");
 
 void config(::terminal::CommandContext&& ctx) {
-    DynamicJsonBuffer jsonBuffer(1024);
-    JsonObject& root = jsonBuffer.createObject();
-    settingsGetJson(root);
-    root.prettyPrintTo(ctx.output);
-    terminalOK(ctx);
+    ::terminal::generate(ctx,
+        [output = make_snapshot_output(ctx)](Print& out) {
+            const auto& kvs = output->kvs;
+            if (!kvs.size()) {
+                out.print(F("{}\n"));
+                ::terminal::ok(out);
+                return false;
+            }
+
+            if (output->index < kvs.size()) {
+                out.print((output->index == 0) ? F("{\n  \"") : F(",\n  \""));
+
+                const auto& kv = kvs[output->index++];
+                print_escaped(out, kv.key);
+                out.print(F("\": \""));
+                print_escaped(out, kv.value);
+                out.print('"');
+
+                return true;
+            }
+
+            out.print(F("\n}\n"));
+            ::terminal::ok(out);
+
+            return false;
+        });
 }
 
 PROGMEM_STRING(Keys, "KEYS");
 
 void keys(::terminal::CommandContext&& ctx) {
-    const auto keys = settings::sorted_keys();
-
-    String value;
-    for (const auto& key : keys) {
-        value = getSetting(key);
-        ctx.output.printf_P(PSTR("> %s => \"%s\"\n"),
-            key.c_str(), value.c_str());
-    }
+    ::terminal::generate(ctx,
+        [output = make_snapshot_output(ctx)](Print& out) {
+            const auto& kvs = output->kvs;
+            if (output->index < kvs.size()) {
+                const auto& kv = kvs[output->index++];
+                out.printf_P(PSTR("> %s => \"%s\"\n"),
+                    kv.key.c_str(), kv.value.c_str());
+                return true;
+            }
 
-    const auto size = settings::size();
-    if (size > 0) {
-        const auto available = settings::available();
-        ctx.output.printf_P(PSTR("Number of keys: %u\n"), keys.size());
-        ctx.output.printf_P(PSTR("Available: %u bytes (%u%%)\n"),
-                available, (100 * available) / size);
-    }
+            const auto size = settings::size();
+            if (size > 0) {
+                const auto available = settings::available();
+                out.printf_P(PSTR("Number of keys: %u\n"), kvs.size());
+                out.printf_P(PSTR("Available: %u bytes (%u%%)\n"),
+                        available, (100 * available) / size);
+            }
 
-    terminalOK(ctx);
+            ::terminal::ok(out);
+            return false;
+        });
 }
 
 PROGMEM_STRING(Gc, "GC");
@@ -428,6 +659,10 @@ espurna::settings::Keys settingsKeys() {
     return espurna::settings::sorted_keys();
 }
 
+void settingsRegisterChange(espurna::settings::ChangeCallback callback) {
+    espurna::settings::internal::change_callbacks.push_front(callback);
+}
+
 void settingsRegisterQueryHandler(espurna::settings::query::Handler handler) {
     espurna::settings::query::internal::handlers.push_front(handler);
 }
@@ -656,31 +891,6 @@ bool settingsRestoreJson(JsonObject& data) {
     return true;
 }
 
-bool settingsRestoreJson(char* json_string, size_t json_buffer_size) {
-
-     // XXX: as of right now, arduinojson cannot trigger callbacks for each key individually
-    // Manually separating kv pairs can allow to parse only a small chunk, since we know that there is only string type used (even with bools / ints). Can be problematic when parsing data that was not generated by us.
-    // Current parsing method is limited only by keys (~sizeof(uintptr_t) bytes per key, data is not copied when string is non-const)
-    DynamicJsonBuffer jsonBuffer(json_buffer_size);
-    JsonObject& root = jsonBuffer.parseObject((char *) json_string);
-
-    if (!root.success()) {
-        DEBUG_MSG_P(PSTR("[SETTINGS] JSON parsing error\n"));
-        return false;
-    }
-
-    return settingsRestoreJson(root);
-
- }
-
-void settingsGetJson(JsonObject& root) {
-    auto keys = espurna::settings::sorted_keys();
-    for (const auto& key : keys) {
-        auto value = getSetting(key);
-        root[key] = value;
-    }
-}
-
 // -----------------------------------------------------------------------------
 // Initialization
 // -----------------------------------------------------------------------------
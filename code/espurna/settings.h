@@ -23,6 +23,7 @@ Copyright (C) 2020-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 #include "settings_convert.h"
 #include "settings_helpers.h"
 #include "settings_embedis.h"
+#include "settings_json.h"
 #include "terminal.h"
 
 // --------------------------------------------------------------------------
@@ -86,6 +87,42 @@ size_t size();
 using KeyValueResultCallback = std::function<void(settings::kvs_type::KeyValueResult&&)>;
 void foreach(KeyValueResultCallback&&);
 
+// Incremental restore of the /config backup object. Every pair is written as soon as it is parsed,
+// while storage commits are postponed until the input is complete. When anything fails (or restore
+// object is destroyed before finish() is called), storage is reloaded from the last committed state
+class Restore {
+public:
+    Restore();
+    ~Restore();
+
+    Restore(const Restore&) = delete;
+    Restore& operator=(const Restore&) = delete;
+
+    bool feed(const uint8_t* data, size_t size);
+    bool finish();
+
+private:
+    enum class State {
+        App,
+        Header,
+        Pairs,
+        Done,
+        Failed,
+    };
+
+    bool _pair(const String& key, const String& value);
+    void _header();
+    void _rollback();
+
+    json::Parser _parser;
+    State _state { State::App };
+    bool _reset { false };
+};
+
+// Every key with its value, sorted by key. Optionally, only include keys with the specified prefixes
+KeyValues snapshot();
+KeyValues snapshot(query::StringViewIterator prefixes);
+
 using PrefixResultCallback = std::function<void(StringView prefix, String key, const kvs_type::ReadResult& value)>;
 void foreach_prefix(PrefixResultCallback&&, settings::query::StringViewIterator);
 
@@ -102,9 +139,14 @@ struct Handler {
 };
 
 } // namespace query
+
+// Called after the key was successfully written or removed (e.g. via the terminal or the WebUI)
+using ChangeCallback = void(*)(StringView key);
+
 } // namespace settings
 } // namespace espurna
 
+void settingsRegisterChange(espurna::settings::ChangeCallback);
 void settingsRegisterQueryHandler(espurna::settings::query::Handler);
 String settingsQuery(espurna::StringView key);
 
@@ -174,8 +216,6 @@ void settingsDump(const espurna::terminal::CommandContext& ctx, const T& setting
     settingsDump(ctx, std::begin(settings), std::end(settings), index);
 }
 
-void settingsGetJson(JsonObject& data);
-bool settingsRestoreJson(char* json_string, size_t json_buffer_size = 1024);
 bool settingsRestoreJson(JsonObject& data);
 
 size_t settingsKeyCount();
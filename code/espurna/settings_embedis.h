@@ -22,6 +22,14 @@ Reimplementation of the Embedis storage format:
 
 namespace espurna {
 namespace settings {
+
+struct KeyValue {
+    String key;
+    String value;
+};
+
+using KeyValues = std::vector<KeyValue>;
+
 namespace embedis {
 
 // Sum total is calculated from:
@@ -336,6 +344,29 @@ public:
         } while (_state != State::End);
     }
 
+    // Resumable version of foreach(), for consumers that can't process everything at once.
+    // Start with the `end()` position and keep passing it back until the result is empty.
+    // XXX: position is only valid until the storage is modified, which is tracked by `generation()`
+    KeyValueResult next(uint16_t& position) {
+        _cursor_set_position(position);
+        auto kv = _read_kv();
+        position = _cursor.position();
+        return kv;
+    }
+
+    uint16_t end() const {
+        return _cursor.end();
+    }
+
+    uint32_t generation() const {
+        return _generation;
+    }
+
+    // when the storage contents were changed externally (e.g. reloaded from the flash)
+    void invalidate() {
+        ++_generation;
+    }
+
     // set or update key with value contents. ensure 'key' isn't empty, 'value' can be empty
     bool set(const String& key, const String& value) {
 
@@ -390,6 +421,8 @@ public:
 
         // we should only insert when possition is still within possible size
         if (start_pos && (start_pos >= need)) {
+            ++_generation;
+
             auto writer = Cursor::fromEnd(_storage, start_pos - need, start_pos);
 
             // put the length of the value as 2 bytes and then write the data
@@ -545,6 +578,8 @@ public:
     };
 
     void _raw_erase(size_t start_pos, Cursor& to_erase) {
+        ++_generation;
+
         // we either end up to the left or to the right of the boundary
 
         size_t new_pos = (start_pos < to_erase.begin())
@@ -657,8 +692,37 @@ return_result:
     RawStorageBase _storage;
     Cursor _cursor;
     State _state { State::Begin };
+    uint32_t _generation { 0 };
 };
 
+// Both keys and values are read in a single pass over the storage, sorted by key afterwards.
+// (instead of a separate get() for every key, which would re-scan the storage each time)
+template <typename T, typename Filter>
+KeyValues snapshot(KeyValueStore<T>& store, Filter&& filter) {
+    KeyValues out;
+
+    store.foreach([&](typename KeyValueStore<T>::KeyValueResult&& kv) {
+        auto key = kv.key.read();
+        if (filter(key)) {
+            out.push_back(KeyValue{std::move(key), kv.value.read()});
+        }
+    });
+
+    std::sort(out.begin(), out.end(),
+        [](const KeyValue& lhs, const KeyValue& rhs) -> bool {
+            return rhs.key.compareTo(lhs.key) > 0;
+        });
+
+    return out;
+}
+
+template <typename T>
+KeyValues snapshot(KeyValueStore<T>& store) {
+    return snapshot(store, [](const String&) {
+        return true;
+    });
+}
+
 } // namespace embedis
 } // namespace settings
 } // namespace espurna
@@ -0,0 +1,439 @@
+/*
+
+Part of SETTINGS MODULE
+
+Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
+Copyright (C) 2019-2023 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace espurna {
+namespace settings {
+namespace json {
+
+// Incremental parser for the flat {"key": "value", ...} object, as generated by the /config backup.
+// Input can be split at any byte, only the pair that is currently being parsed is kept in memory.
+// Non-string values (numbers, true, false, null) are passed to the callback in their text form.
+class Parser {
+public:
+    static constexpr size_t KeyLimit { 128 };
+    static constexpr size_t ValueLimit { 1024 };
+
+    enum class Error {
+        None,
+        Syntax,
+        KeyTooLong,
+        ValueTooLong,
+        Aborted,
+        Incomplete,
+    };
+
+    // callback is `bool(const String& key, const String& value)`
+    // returning `false` stops the parser with `Error::Aborted`
+    template <typename T>
+    bool feed(const uint8_t* data, size_t size, T&& callback) {
+        for (const auto* it = data; it != data + size; ++it) {
+            if (!_parse(static_cast<char>(*it), callback)) {
+                return false;
+            }
+        }
+
+        return _error == Error::None;
+    }
+
+    template <typename T>
+    bool feed(const char* data, size_t size, T&& callback) {
+        return feed(reinterpret_cast<const uint8_t*>(data), size, callback);
+    }
+
+    // input is complete, there should be nothing left besides the whitespace
+    bool finish() {
+        if ((_error == Error::None) && (_state != State::End)) {
+            _fail(Error::Incomplete);
+        }
+
+        return _error == Error::None;
+    }
+
+    bool done() const {
+        return (_error == Error::None) && (_state == State::End);
+    }
+
+    Error error() const {
+        return _error;
+    }
+
+    size_t pairs() const {
+        return _pairs;
+    }
+
+    // amount of data held while waiting for the rest of the pair
+    size_t buffered() const {
+        return _key.length() + _value.length();
+    }
+
+    void reset() {
+        *this = Parser();
+    }
+
+private:
+    enum class State {
+        Begin,
+        KeyOrEnd,
+        Key,
+        Colon,
+        Value,
+        String,
+        Escape,
+        Unicode,
+        Literal,
+        CommaOrEnd,
+        End,
+        Failed,
+    };
+
+    static bool _space(char c) {
+        return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+    }
+
+    static bool _literal(char c) {
+        return ((c >= '0') && (c <= '9'))
+            || ((c >= 'a') && (c <= 'z'))
+            || (c == '-') || (c == '+') || (c == '.')
+            || (c == 'E');
+    }
+
+    static int _hex(char c) {
+        if ((c >= '0') && (c <= '9')) {
+            return c - '0';
+        }
+
+        if ((c >= 'a') && (c <= 'f')) {
+            return c - 'a' + 10;
+        }
+
+        if ((c >= 'A') && (c <= 'F')) {
+            return c - 'A' + 10;
+        }
+
+        return -1;
+    }
+
+    bool _fail(Error error) {
+        _error = error;
+        _state = State::Failed;
+        _key = String();
+        _value = String();
+        return false;
+    }
+
+    String& _target() {
+        return _in_key ? _key : _value;
+    }
+
+    bool _push(char c) {
+        auto& target = _target();
+        if (target.length() >= (_in_key ? KeyLimit : ValueLimit)) {
+            return _fail(_in_key ? Error::KeyTooLong : Error::ValueTooLong);
+        }
+
+        target += c;
+        return true;
+    }
+
+    bool _push_codepoint(uint32_t code) {
+        if (code < 0x80) {
+            return _push(static_cast<char>(code));
+        }
+
+        if (code < 0x800) {
+            return _push(static_cast<char>(0xc0 | (code >> 6)))
+                && _push(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+
+        if (code < 0x10000) {
+            return _push(static_cast<char>(0xe0 | (code >> 12)))
+                && _push(static_cast<char>(0x80 | ((code >> 6) & 0x3f)))
+                && _push(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+
+        return _push(static_cast<char>(0xf0 | (code >> 18)))
+            && _push(static_cast<char>(0x80 | ((code >> 12) & 0x3f)))
+            && _push(static_cast<char>(0x80 | ((code >> 6) & 0x3f)))
+            && _push(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+
+    // \uXXXX is complete. surrogate pairs are expected to be written as two consecutive escapes
+    bool _unicode() {
+        const auto code = _code;
+        _code = 0;
+        _digits = 0;
+
+        if ((code >= 0xd800) && (code <= 0xdbff)) {
+            if (_high) {
+                return _fail(Error::Syntax);
+            }
+
+            _high = code;
+            return true;
+        }
+
+        if ((code >= 0xdc00) && (code <= 0xdfff)) {
+            if (!_high) {
+                return _fail(Error::Syntax);
+            }
+
+            const auto high = _high;
+            _high = 0;
+
+            return _push_codepoint(0x10000
+                + ((high - 0xd800) << 10)
+                + (code - 0xdc00));
+        }
+
+        if (_high) {
+            return _fail(Error::Syntax);
+        }
+
+        return _push_codepoint(code);
+    }
+
+    template <typename T>
+    bool _pair(T&& callback) {
+        ++_pairs;
+
+        const bool result = callback(_key, _value);
+
+        // keep the allocated buffers around, next pair is likely to be of similar size
+        _key = "";
+        _value = "";
+
+        if (!result) {
+            return _fail(Error::Aborted);
+        }
+
+        _state = State::CommaOrEnd;
+        return true;
+    }
+
+    template <typename T>
+    bool _parse(char c, T&& callback) {
+        switch (_state) {
+        case State::Begin:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == '{') {
+                _state = State::KeyOrEnd;
+                return true;
+            }
+
+            break;
+
+        case State::KeyOrEnd:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == '}') {
+                _state = State::End;
+                return true;
+            }
+
+            if (c == '"') {
+                _in_key = true;
+                _state = State::String;
+                return true;
+            }
+
+            break;
+
+        case State::Key:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == '"') {
+                _in_key = true;
+                _state = State::String;
+                return true;
+            }
+
+            break;
+
+        case State::Colon:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == ':') {
+                _state = State::Value;
+                return true;
+            }
+
+            break;
+
+        case State::Value:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == '"') {
+                _in_key = false;
+                _state = State::String;
+                return true;
+            }
+
+            if (_literal(c)) {
+                _in_key = false;
+                _state = State::Literal;
+                return _push(c);
+            }
+
+            break;
+
+        case State::String:
+            if (_high && (c != '\\')) {
+                break;
+            }
+
+            if (c == '"') {
+                if (_in_key) {
+                    if (!_key.length()) {
+                        break;
+                    }
+
+                    _state = State::Colon;
+                    return true;
+                }
+
+                return _pair(callback);
+            }
+
+            if (c == '\\') {
+                _state = State::Escape;
+                return true;
+            }
+
+            if (static_cast<uint8_t>(c) < 0x20) {
+                break;
+            }
+
+            return _push(c);
+
+        case State::Escape:
+            if (_high && (c != 'u')) {
+                break;
+            }
+
+            _state = State::String;
+
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                return _push(c);
+            case 'b':
+                return _push('\b');
+            case 'f':
+                return _push('\f');
+            case 'n':
+                return _push('\n');
+            case 'r':
+                return _push('\r');
+            case 't':
+                return _push('\t');
+            case 'u':
+                _state = State::Unicode;
+                return true;
+            }
+
+            break;
+
+        case State::Unicode: {
+            const auto digit = _hex(c);
+            if (digit < 0) {
+                break;
+            }
+
+            _code = (_code << 4) | static_cast<uint32_t>(digit);
+            if (++_digits < 4) {
+                return true;
+            }
+
+            _state = State::String;
+            return _unicode();
+        }
+
+        case State::Literal:
+            if (_literal(c)) {
+                return _push(c);
+            }
+
+            if (_space(c) || (c == ',') || (c == '}')) {
+                if (!_pair(callback)) {
+                    return false;
+                }
+
+                return _space(c) || _parse(c, callback);
+            }
+
+            break;
+
+        case State::CommaOrEnd:
+            if (_space(c)) {
+                return true;
+            }
+
+            if (c == ',') {
+                _state = State::Key;
+                return true;
+            }
+
+            if (c == '}') {
+                _state = State::End;
+                return true;
+            }
+
+            break;
+
+        case State::End:
+            if (_space(c)) {
+                return true;
+            }
+
+            break;
+
+        case State::Failed:
+            return false;
+        }
+
+        return _fail(Error::Syntax);
+    }
+
+    String _key;
+    String _value;
+
+    State _state { State::Begin };
+    Error _error { Error::None };
+
+    size_t _pairs { 0 };
+
+    uint32_t _code { 0 };
+    uint32_t _high { 0 };
+    uint8_t _digits { 0 };
+
+    bool _in_key { false };
+};
+
+} // namespace json
+} // namespace settings
+} // namespace espurna
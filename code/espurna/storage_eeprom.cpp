@@ -11,11 +11,40 @@ EEPROM_Rotate EEPROMr;
 
 namespace {
 
+struct EepromRange {
+    explicit operator bool() const {
+        return end > begin;
+    }
+
+    void add(size_t address, size_t size) {
+        begin = std::min(begin, address);
+        end = std::max(end, address + size);
+        bytes += size;
+    }
+
+    size_t begin { EepromSize };
+    size_t end { 0 };
+    size_t bytes { 0 };
+};
+
+constexpr espurna::duration::Milliseconds EepromDeferredCommitDelay { EEPROM_DEFERRED_COMMIT_DELAY };
+
 bool _eeprom_commit = false;
 
+bool _eeprom_deferred = false;
+size_t _eeprom_deferred_scope = 0;
+espurna::time::CoreClock::time_point _eeprom_deferred_since;
+
+EepromRange _eeprom_dirty;
+EepromRange _eeprom_last_dirty;
+
 uint32_t _eeprom_commit_count = 0;
+uint32_t _eeprom_skipped_count = 0;
+uint32_t _eeprom_deferred_count = 0;
+uint32_t _eeprom_last_commit_time = 0;
 bool _eeprom_last_commit_result = false;
 bool _eeprom_ready = false;
+bool _eeprom_transaction = false;
 
 } // namespace
 
@@ -30,6 +59,7 @@ void eepromRotate(bool value) {
         // Because .rotate(false) marks EEPROM as dirty, this is equivalent to the .backup(0)
         DEBUG_MSG_P(PSTR("[EEPROM] %s EEPROM rotation\n"), value ? "Enabling" : "Disabling");
         EEPROMr.rotate(value);
+        eepromDirty(0, EepromSize);
         eepromCommit();
     }
 }
@@ -52,18 +82,95 @@ void eepromSectorsDebug() {
     DEBUG_MSG_P(PSTR("[MAIN] EEPROM current: %lu\n"), eepromCurrent());
 }
 
-bool _eepromCommit() {
+void eepromDirty(size_t address, size_t size) {
+    _eeprom_dirty.add(address, size);
+}
+
+// Every commit is a sector erase + write, avoid it when no bytes were changed
+bool _eepromCommit(bool force) {
+    _eeprom_commit = false;
+    _eeprom_deferred = false;
+
+    if (!force && !_eeprom_dirty) {
+        _eeprom_skipped_count++;
+        return true;
+    }
+
+    const auto start = micros();
+
     _eeprom_commit_count++;
     _eeprom_last_commit_result = EEPROMr.commit();
+    _eeprom_last_commit_time = micros() - start;
+
+    _eeprom_last_dirty = _eeprom_dirty;
+    _eeprom_dirty = EepromRange();
+
     return _eeprom_last_commit_result;
 }
 
+bool _eepromPending() {
+    return _eeprom_commit || _eeprom_deferred;
+}
+
+void _eepromDefer() {
+    _eeprom_deferred_count++;
+    if (!_eeprom_deferred) {
+        _eeprom_deferred = true;
+        _eeprom_deferred_since = espurna::time::CoreClock::now();
+        espurnaLoopWake();
+    }
+}
+
+EepromDeferredCommit::EepromDeferredCommit() {
+    ++_eeprom_deferred_scope;
+}
+
+EepromDeferredCommit::~EepromDeferredCommit() {
+    --_eeprom_deferred_scope;
+}
+
 void eepromForceCommit() {
-    _eepromCommit();
+    _eepromCommit(true);
 }
 
 void eepromCommit() {
+    if (_eeprom_deferred_scope && (EepromDeferredCommitDelay.count() > 0)) {
+        _eepromDefer();
+        return;
+    }
+
     _eeprom_commit = true;
+    espurnaLoopWake();
+}
+
+void eepromFlush() {
+    if (!_eeprom_transaction && _eepromPending()) {
+        _eepromCommit(false);
+    }
+}
+
+bool eepromTransaction() {
+    return _eeprom_transaction;
+}
+
+void eepromTransactionBegin() {
+    // anything pending belongs to the previous state
+    eepromFlush();
+    _eeprom_transaction = true;
+}
+
+void eepromTransactionCommit() {
+    _eeprom_transaction = false;
+    espurnaLoopWake();
+}
+
+void eepromTransactionRollback() {
+    // re-reading the sector also resets the dirty flag
+    EEPROMr.begin(EepromSize);
+    _eeprom_dirty = EepromRange();
+    _eeprom_commit = false;
+    _eeprom_deferred = false;
+    _eeprom_transaction = false;
 }
 
 void eepromBackup(uint32_t index){
@@ -77,8 +184,20 @@ static void _eepromCommand(::terminal::CommandContext&& ctx) {
     ctx.output.printf_P(PSTR("Sectors: %s, current: %lu\n"),
             eepromSectors().c_str(), eepromCurrent());
     if (_eeprom_commit_count > 0) {
-        ctx.output.printf_P(PSTR("Commits done: %lu, last: %s\n"),
-            _eeprom_commit_count, _eeprom_last_commit_result ? "OK" : "ERROR");
+        ctx.output.printf_P(PSTR("Commits done: %lu, last: %s (%lu us)\n"),
+            _eeprom_commit_count, _eeprom_last_commit_result ? "OK" : "ERROR",
+            _eeprom_last_commit_time);
+        if (_eeprom_last_dirty) {
+            ctx.output.printf_P(PSTR("Last commit changed %u bytes within %u...%u\n"),
+                _eeprom_last_dirty.bytes, _eeprom_last_dirty.begin, _eeprom_last_dirty.end - 1);
+        }
+    }
+    ctx.output.printf_P(PSTR("Skipped (unchanged): %lu, deferred: %lu\n"),
+        _eeprom_skipped_count, _eeprom_deferred_count);
+    if (_eeprom_dirty) {
+        ctx.output.printf_P(PSTR("Pending %u bytes within %u...%u%s\n"),
+            _eeprom_dirty.bytes, _eeprom_dirty.begin, _eeprom_dirty.end - 1,
+            _eeprom_deferred ? " (deferred)" : "");
     }
     terminalOK(ctx);
 }
@@ -86,7 +205,7 @@ static void _eepromCommand(::terminal::CommandContext&& ctx) {
 PROGMEM_STRING(EepromCommit, "EEPROM.COMMIT");
 
 static void _eepromCommandCommit(::terminal::CommandContext&& ctx) {
-    _eepromCommit();
+    _eepromCommit(true);
     terminalOK(ctx);
 }
 
@@ -128,11 +247,27 @@ void _eepromCommandsSetup() {
 
 // -----------------------------------------------------------------------------
 
-void eepromLoop() {
+espurna::duration::Milliseconds eepromLoop() {
+    if (_eeprom_transaction) {
+        return LoopIdle;
+    }
+
     if (_eeprom_commit) {
-        _eepromCommit();
-        _eeprom_commit = false;
+        _eepromCommit(false);
+        return LoopIdle;
+    }
+
+    if (_eeprom_deferred) {
+        const auto elapsed = espurna::time::CoreClock::now() - _eeprom_deferred_since;
+        if (elapsed >= EepromDeferredCommitDelay) {
+            _eepromCommit(false);
+            return LoopIdle;
+        }
+
+        return EepromDeferredCommitDelay - elapsed;
     }
+
+    return LoopIdle;
 }
 
 void eepromSetup() {
@@ -157,6 +292,6 @@ void eepromSetup() {
     _eepromCommandsSetup();
 #endif
 
-    espurnaRegisterLoop(eepromLoop);
+    espurnaRegisterLoop(eepromLoop, STRING_VIEW("eeprom"));
     _eeprom_ready = true;
 }
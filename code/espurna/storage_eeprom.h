@@ -36,6 +36,30 @@ void eepromBackup(uint32_t index);
 
 void eepromForceCommit();
 void eepromCommit();
+void eepromFlush();
+
+// Range of bytes that were actually modified since the last commit. When nothing
+// was changed, commit request does not result in the sector being re-written
+void eepromDirty(size_t address, size_t size);
+
+// Frequently changing values (relay status mask, energy totals) are also kept in RTC memory,
+// so their commits may be postponed. Such changes are written together with the next regular
+// commit, when the EEPROM_DEFERRED_COMMIT_DELAY expires or right before the device resets
+// (when the delay is 0, which is the default, this is the same as the regular commit)
+struct EepromDeferredCommit {
+    EepromDeferredCommit();
+    ~EepromDeferredCommit();
+
+    EepromDeferredCommit(const EepromDeferredCommit&) = delete;
+    EepromDeferredCommit& operator=(const EepromDeferredCommit&) = delete;
+};
+
+// Hold off every commit until the transaction ends. Rollback reloads the data from flash,
+// discarding any change made since the transaction was started.
+void eepromTransactionBegin();
+void eepromTransactionCommit();
+void eepromTransactionRollback();
+bool eepromTransaction();
 
 void eepromSetup();
 
@@ -54,7 +78,13 @@ inline unsigned long eepromSpace() {
 inline void eepromClear() {
     auto* ptr = EEPROMr.getDataPtr();
     std::fill(ptr + EepromReservedSize, ptr + EepromSize, 0xFF);
-    EEPROMr.commit();
+    eepromDirty(EepromReservedSize, EepromSize - EepromReservedSize);
+    if (eepromTransaction()) {
+        eepromCommit();
+        return;
+    }
+
+    eepromForceCommit();
 }
 
 inline uint8_t eepromRead(int address) {
@@ -62,7 +92,10 @@ inline uint8_t eepromRead(int address) {
 }
 
 inline void eepromWrite(int address, unsigned char value) {
-    EEPROMr.write(address, value);
+    if (EEPROMr.read(address) != value) {
+        EEPROMr.write(address, value);
+        eepromDirty(address, 1);
+    }
 }
 
 inline void eepromGet(int address, unsigned char& value) {
@@ -81,18 +114,28 @@ inline void eepromGet(int address, unsigned long& value) {
     EEPROMr.get(address, value);
 }
 
+template <typename T>
+inline void eepromPutValue(int address, T value) {
+    T current;
+    EEPROMr.get(address, current);
+    if (current != value) {
+        EEPROMr.put(address, value);
+        eepromDirty(address, sizeof(T));
+    }
+}
+
 inline void eepromPut(int address, unsigned char value) {
-    EEPROMr.put(address, value);
+    eepromPutValue(address, value);
 }
 
 inline void eepromPut(int address, unsigned short value) {
-    EEPROMr.put(address, value);
+    eepromPutValue(address, value);
 }
 
 inline void eepromPut(int address, unsigned int value) {
-    EEPROMr.put(address, value);
+    eepromPutValue(address, value);
 }
 
 inline void eepromPut(int address, unsigned long value) {
-    EEPROMr.put(address, value);
+    eepromPutValue(address, value);
 }
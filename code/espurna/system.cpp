@@ -716,6 +716,9 @@ void SystemTimer::callback() {
 
     _callback();
 
+    // whatever the callback did is likely to be processed by the loop
+    espurnaLoopWake();
+
     if (_repeat) {
         if (_tick) {
             _tick->count = 0;
@@ -1191,7 +1194,8 @@ constexpr Mask value() {
         | (Report::Interval * (HEARTBEAT_REPORT_INTERVAL))
         | (Report::Range * (HEARTBEAT_REPORT_RANGE))
         | (Report::RemoteTemp * (HEARTBEAT_REPORT_REMOTE_TEMP))
-        | (Report::Bssid * (HEARTBEAT_REPORT_BSSID));
+        | (Report::Bssid * (HEARTBEAT_REPORT_BSSID))
+        | (Report::ConnectTime * (HEARTBEAT_REPORT_CONNECT_TIME));
 }
 
 } // namespace build
@@ -1477,6 +1481,7 @@ void reset(CustomResetReason reason) {
 // always needs a reason, so it can be displayed in logs and / or trigger some actions on boot
 void pending_reset_loop() {
     if (internal::reset_reason != CustomResetReason::None) {
+        eepromFlush();
         reset();
     }
 }
@@ -1537,7 +1542,7 @@ void setup() {
 
     system::settings::query::setup();
 
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("system"));
     heartbeat::init();
 }
 
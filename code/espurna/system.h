@@ -310,7 +310,8 @@ enum class Report : Mask {
     Description = 1 << 18,
     Range = 1 << 19,
     RemoteTemp = 1 << 20,
-    Bssid = 1 << 21
+    Bssid = 1 << 21,
+    ConnectTime = 1 << 22
 };
 
 constexpr Mask operator*(Report lhs, Mask rhs) {
@@ -39,8 +39,10 @@ Updated to use WiFiServer and support reverse connections by Niek van der Maas <
 
 #include "libs/URL.h"
 
+#include <cstring>
 #include <forward_list>
 #include <list>
+#include <new>
 #include <vector>
 
 namespace espurna {
@@ -59,6 +61,11 @@ namespace build {
 
 constexpr size_t LineBufferSize { TELNET_LINE_BUFFER_SIZE };
 
+constexpr size_t OutputBuffers { TELNET_OUTPUT_BUFFERS };
+static_assert(OutputBuffers > 0, "");
+
+constexpr espurna::duration::Milliseconds SlowClientTimeout { TELNET_SLOW_CLIENT_TIMEOUT };
+
 constexpr size_t ClientsMax { TELNET_MAX_CLIENTS };
 static_assert(ClientsMax > 0, "");
 
@@ -145,23 +152,105 @@ void setup() {
 
 // Generic TCP interface assumes we only have the network buffer available to us.
 // Since we can't chain-in additional backing storage through the provided LWIP API,
-// force every write to either go through the usual means or cache it using extra N
-// u8 arrays that are created when writing data and then destroyed when it is sent
+// force every write to either go through the usual means or cache it in the output buffers.
+// Buffers are shared by all of the clients and are never allocated more than `build::OutputBuffers` times.
+struct OutputBuffer {
+    static constexpr size_t Size = TCP_MSS;
+
+    OutputBuffer* next;
+    uint16_t size;
+    uint16_t offset;
+    uint8_t data[Size];
+};
+
+class OutputBufferPool {
+public:
+    OutputBuffer* acquire() {
+        OutputBuffer* out = nullptr;
+
+        if (_free) {
+            out = _free;
+            _free = _free->next;
+        } else if (_allocated < build::OutputBuffers) {
+            out = new (std::nothrow) OutputBuffer;
+            if (out) {
+                ++_allocated;
+            }
+        }
+
+        if (out) {
+            out->next = nullptr;
+            out->size = 0;
+            out->offset = 0;
+            ++_used;
+        }
+
+        return out;
+    }
+
+    void release(OutputBuffer* buffer) {
+        buffer->next = _free;
+        _free = buffer;
+        --_used;
+    }
+
+    // no longer keep unused buffers around
+    void trim() {
+        while (_free) {
+            auto* next = _free->next;
+            delete _free;
+            _free = next;
+            --_allocated;
+        }
+    }
+
+    size_t available() const {
+        return build::OutputBuffers - _used;
+    }
+
+    size_t used() const {
+        return _used;
+    }
+
+private:
+    OutputBuffer* _free { nullptr };
+    size_t _allocated { 0 };
+    size_t _used { 0 };
+};
+
+namespace internal {
+
+OutputBufferPool pool;
+
+} // namespace internal
+
 struct ClientWriter {
+    using TimeSource = espurna::time::CoreClock;
+
+    ClientWriter() = default;
+
+    ClientWriter(const ClientWriter&) = delete;
+    ClientWriter& operator=(const ClientWriter&) = delete;
+
+    ClientWriter(ClientWriter&&) = delete;
+    ClientWriter& operator=(ClientWriter&&) = delete;
+
+    ~ClientWriter() {
+        reset();
+    }
+
     size_t write(tcp_pcb* pcb, const uint8_t* data, size_t size) {
         if (!size || (pcb->state != ESTABLISHED)) {
             return 0;
         }
 
-        int8_t flags = TCP_WRITE_FLAG_COPY;
-
         // first, trying to write directly into the network stack buffers
         size_t written = 0;
-        if (_list.empty()) {
+        if (!_head) {
             size_t available = tcp_sndbuf(pcb);
             written = std::min(available, size);
 
-            auto err = tcp_write(pcb, data, written, flags);
+            auto err = tcp_write(pcb, data, written, TCP_WRITE_FLAG_COPY);
             if (err != ERR_OK) {
                 return 0;
             }
@@ -169,41 +258,32 @@ struct ClientWriter {
             if (written == size) {
                 return size;
             }
+
+            _progress = TimeSource::now();
         }
 
         // second, cache the data on the app level
-        size_t left { size - written };
-
-        const auto* ptr = data + written;
-        flags |= TCP_WRITE_FLAG_MORE;
-
-        while (left) {
-            if (_list.empty() && !make_buffer()) {
-                break;
-            }
-
-            auto& current = _list.back();
-            const auto have = current.capacity() - current.size();
-            if (have < left) {
-                current.insert(current.end(), ptr, ptr + have);
-                if (!make_buffer()) {
+        while (written < size) {
+            if (!_tail || (_tail->size == OutputBuffer::Size)) {
+                if (!push_buffer()) {
+                    _dropped += size - written;
                     break;
                 }
-
-                ptr += have;
-                written += have;
-                left -= have;
-            } else {
-                current.insert(current.end(), ptr, ptr + left);
-                written = size;
-                break;
             }
+
+            const auto chunk = std::min(
+                size - written,
+                OutputBuffer::Size - _tail->size);
+            std::memcpy(&_tail->data[_tail->size], data + written, chunk);
+
+            _tail->size += chunk;
+            written += chunk;
         }
 
         // to avoid dumping sources like printf("%02X ") in a loop immediately,
         // stall calling tcp_output until there's a large chunk of data available
         // plus, lwip loop & poll will dump things periodically
-        if (!_list.empty()) {
+        if (_head) {
             tcp_output(pcb);
         }
 
@@ -214,60 +294,103 @@ struct ClientWriter {
         return write(pcb, reinterpret_cast<const uint8_t*>(data.c_str()), data.length());
     }
 
+    // push as much of the cached data as the network buffers allow, and only then
+    // ask lwip to send it. buffer may be partially written, the rest stays for later
     void flush(tcp_pcb* pcb) {
         bool wrote { false };
-        while (!_list.empty()) {
-            auto& chunk = _list.front();
 
-            const size_t available = tcp_sndbuf(pcb);
-            if (available < chunk.size()) {
-                break;
+        size_t available = tcp_sndbuf(pcb);
+        while (_head && available) {
+            const size_t left = _head->size - _head->offset;
+            const size_t chunk = std::min(left, available);
+
+            uint8_t flags = TCP_WRITE_FLAG_COPY;
+            if ((chunk < left) || _head->next) {
+                flags |= TCP_WRITE_FLAG_MORE;
             }
 
-            auto err = tcp_write(pcb, chunk.data(), chunk.size(), TCP_WRITE_FLAG_COPY);
+            auto err = tcp_write(pcb, &_head->data[_head->offset], chunk, flags);
             if (err != ERR_OK) {
                 break;
             }
 
             wrote = true;
-            _list.pop_front();
+            available -= chunk;
+            _head->offset += chunk;
+
+            if (_head->offset == _head->size) {
+                pop_buffer();
+            }
         }
 
         if (wrote) {
+            _progress = TimeSource::now();
             tcp_output(pcb);
         }
     }
 
     size_t writeable(tcp_pcb* pcb) const {
-        return _list.empty() && (tcp_sndbuf(pcb) > 0);
+        return !_head && (tcp_sndbuf(pcb) > 0);
+    }
+
+    // amount of data that can be written without anything being dropped
+    size_t available(tcp_pcb* pcb) const {
+        size_t out = _head ? 0 : tcp_sndbuf(pcb);
+        if (_tail) {
+            out += OutputBuffer::Size - _tail->size;
+        }
+
+        return out + (internal::pool.available() * OutputBuffer::Size);
+    }
+
+    // cached data was not sent for a while, most likely nothing is being received on the other side
+    bool stalled(TimeSource::duration timeout) const {
+        return _head && (TimeSource::now() - _progress > timeout);
+    }
+
+    size_t dropped() const {
+        return _dropped;
     }
 
     void reset() {
-        _list.clear();
+        while (_head) {
+            pop_buffer();
+        }
     }
 
 private:
-    using Buffer = std::vector<uint8_t>;
-    using List = std::list<Buffer>;
-
-    constexpr static size_t BufferSize = TCP_MSS;
-    constexpr static size_t BuffersMax =
-        (BufferSize == 1460)
-            ? 2  // MSS is 1460 bytes, additional 2920 bytes
-            : 5; // MSS is 536 bytes, additional 2680 bytes
-
-    bool make_buffer() {
-        if (_list.size() < BuffersMax) {
-            Buffer buffer;
-            buffer.reserve(TCP_MSS);
-            _list.push_back(std::move(buffer));
-            return true;
+    bool push_buffer() {
+        auto* buffer = internal::pool.acquire();
+        if (!buffer) {
+            return false;
         }
 
-        return false;
+        if (!_head) {
+            _head = buffer;
+            _progress = TimeSource::now();
+        } else {
+            _tail->next = buffer;
+        }
+
+        _tail = buffer;
+        return true;
     }
 
-    List _list;
+    void pop_buffer() {
+        auto* next = _head->next;
+        internal::pool.release(_head);
+
+        _head = next;
+        if (!_head) {
+            _tail = nullptr;
+        }
+    }
+
+    OutputBuffer* _head { nullptr };
+    OutputBuffer* _tail { nullptr };
+
+    TimeSource::time_point _progress;
+    size_t _dropped { 0 };
 };
 
 namespace message {
@@ -280,18 +403,19 @@ PROGMEM_STRING(OkPassword, "+OK\n");
 } // namespace message
 
 // Terminal output works through Arduino `Print` interface, and everything there uses basic `write`.
-// Really really flush both network and internal buffer(s), or we stall our `loop` with the arbitrary
-// timeout option it selects for us. (ref. Core files for more)
+// Output is written right away as long as there is enough space in the network and output buffers.
+// Otherwise, this has to wait for the client to receive some of the data first, but only until
+// the slow client timeout expires. Long outputs should use generators instead, see `Client::generate()`
 // Plus, we don't force either `Print` or `Stream` class inheritance for the `T`.
 template <typename T>
-struct ExhaustingPrint : public Print {
-    ExhaustingPrint() = delete;
-    explicit ExhaustingPrint(T* client) :
+struct ClientPrint : public Print {
+    ClientPrint() = delete;
+    explicit ClientPrint(T* client) :
         _client(client)
     {}
 
     size_t write(const uint8_t* ptr, size_t length) override {
-        flush();
+        wait(length);
         return _client->write(ptr, length);
     }
 
@@ -299,17 +423,24 @@ struct ExhaustingPrint : public Print {
         return write(&c, 1);
     }
 
-    // ... but, we still dont want to block forever, wait for 3sec
-    // but make it wake up every 10ms to try to flush things
     void flush() override {
-        while (_client->connected() && !_client->writeable()) {
+        wait(0);
+    }
+
+private:
+    // wake up every 10ms to try to flush things
+    void wait(size_t length) {
+        while (_client->connected()
+            && !_client->writeable()
+            && (!length || (_client->available() < length))
+            && !_client->stalled())
+        {
             _client->flush();
             espurna::time::blockingDelay(
                 espurna::duration::Milliseconds(10));
         }
     }
 
-private:
     T* _client;
 };
 
@@ -336,7 +467,7 @@ String address_string(Address address) {
 }
 
 // tracks the provided TCP `pcb`, cannot instantiate one by itself
-class Client {
+class Client : public ::terminal::DeferredOutput {
 public:
     Client() = delete;
     Client(tcp_pcb* pcb, bool auth) :
@@ -374,7 +505,7 @@ public:
     Client(Client&& other) = delete;
     Client& operator=(Client&&) = delete;
 
-    ~Client() {
+    ~Client() override {
         close();
     }
 
@@ -420,6 +551,13 @@ public:
             _pcb = nullptr;
         }
 
+        // data is either copied by lwip already, or will never be sent
+        _writer.reset();
+#if TERMINAL_SUPPORT
+        _generator = nullptr;
+        _cmds.clear();
+#endif
+
         return err;
     }
 
@@ -459,6 +597,22 @@ public:
         return false;
     }
 
+    size_t available() {
+        if (_pcb) {
+            return _writer.available(_pcb);
+        }
+
+        return 0;
+    }
+
+    bool stalled() const {
+        return _pcb && _writer.stalled(build::SlowClientTimeout);
+    }
+
+    size_t dropped() const {
+        return _writer.dropped();
+    }
+
     void maybe_ask_auth() {
         if (_request_auth) {
             write_message(message::PasswordRequest);
@@ -466,21 +620,46 @@ public:
     }
 
 #if TERMINAL_SUPPORT
+    // generator output goes first, next command is only called after it is done
     void process() {
-        while (!_cmds.empty()) {
+        generate();
+
+        while (!_generator && !_cmds.empty()) {
             auto cmd = std::move(_cmds.front());
             _cmds.pop_front();
 
-            ExhaustingPrint<Client> print(this);
-            if (!espurna::terminal::find_and_call(cmd, print)) {
+            ClientPrint<Client> print(this);
+            if (!espurna::terminal::find_and_call(cmd, print, this)) {
                 _cmds.clear();
                 break;
             }
+
+            generate();
         }
     }
+
+#endif
+
+    void defer(::terminal::Generator generator) override {
+#if TERMINAL_SUPPORT
+        _generator = std::move(generator);
 #endif
+    }
 
 private:
+#if TERMINAL_SUPPORT
+    // only ask for more when there is enough space for at least a single buffer worth of output
+    // (unless it is a really long line, this does not have to wait)
+    void generate() {
+        ClientPrint<Client> print(this);
+        while (_generator && connected() && (available() >= OutputBuffer::Size)) {
+            if (!_generator(print)) {
+                _generator = nullptr;
+            }
+        }
+    }
+#endif
+
     // can't use an arbitrary `pbuf` with `tcp_write`, since this may
     // be a flash string and without `memcpy_P` we can't read it.
     void write_message(StringView message) {
@@ -497,6 +676,7 @@ private:
         _last_err = err;
         _writer.reset();
         _cmds.clear();
+        _generator = nullptr;
 
         DEBUG_MSG_P(PSTR("[TELNET] %s ERROR %s\n"),
             address_string(_remote).c_str(),
@@ -676,12 +856,23 @@ next:
 #if TERMINAL_SUPPORT
     ::terminal::LineBuffer<build::LineBufferSize> _line_buffer;
     std::list<String> _cmds;
+    ::terminal::Generator _generator;
 #endif
     ClientWriter _writer;
 };
 
 using ClientPtr = std::unique_ptr<Client>;
 
+// also drop the client that does not receive anything, so it won't hold the shared buffers forever
+void flush_client(Client& client) {
+    client.flush();
+    if (client.stalled()) {
+        DEBUG_MSG_P(PSTR("[TELNET] %s is not receiving, %u bytes dropped\n"),
+            address_string(client.remote()).c_str(), client.dropped());
+        client.close();
+    }
+}
+
 template <size_t Size>
 struct Clients {
     using List = std::forward_list<ClientPtr>;
@@ -734,11 +925,21 @@ struct Clients {
     void flush() {
         for (auto& client : _clients) {
             if (client) {
-                client->flush();
+                flush_client(*client);
             }
         }
     }
 
+    bool active() const {
+        for (auto& client : _clients) {
+            if (client && client->connected()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     template <typename T>
     void foreach(T&& callback) {
         for (auto& client : _clients) {
@@ -788,10 +989,14 @@ struct Clients<1> {
 
     void flush() {
         if (_client) {
-            _client->flush();
+            flush_client(*_client);
         }
     }
 
+    bool active() const {
+        return _client && _client->connected();
+    }
+
     template <typename T>
     void foreach(T&& callback) {
         if (_client) {
@@ -835,6 +1040,11 @@ bool write(StringView data) {
 
 void flush() {
     internal::clients.flush();
+
+    // output buffers are only kept while someone is connected
+    if (!internal::clients.active() && !internal::pool.used()) {
+        internal::pool.trim();
+    }
 }
 
 void process() {
@@ -1079,7 +1289,7 @@ void setup() {
     ::espurnaRegisterLoop([]() {
         flush();
         process();
-    });
+    }, STRING_VIEW("telnet"));
 }
 
 } // namespace
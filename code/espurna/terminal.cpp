@@ -823,7 +823,7 @@ void setup() {
     commands::setup();
 
     // Register loop
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("terminal"));
 }
 
 } // namespace
@@ -103,7 +103,17 @@ void error(const espurna::terminal::CommandContext& ctx, const String& message)
     error(ctx.error, message);
 }
 
-bool find_and_call(CommandLine cmd, Print& output, Print& error_output) {
+void generate(const espurna::terminal::CommandContext& ctx, Generator generator) {
+    if (ctx.deferred) {
+        ctx.deferred->defer(std::move(generator));
+        return;
+    }
+
+    while (generator(ctx.output)) {
+    }
+}
+
+bool find_and_call(CommandLine cmd, Print& output, Print& error_output, DeferredOutput* deferred) {
     const auto* command = find(cmd.argv[0]);
     if (command) {
         (*command).func(
@@ -111,6 +121,7 @@ bool find_and_call(CommandLine cmd, Print& output, Print& error_output) {
                 .argv = std::move(cmd.argv),
                 .output = output,
                 .error = error_output,
+                .deferred = deferred,
             });
 
         return true;
@@ -120,11 +131,15 @@ bool find_and_call(CommandLine cmd, Print& output, Print& error_output) {
     return false;
 }
 
+bool find_and_call(CommandLine cmd, Print& output, Print& error_output) {
+    return find_and_call(std::move(cmd), output, error_output, nullptr);
+}
+
 bool find_and_call(CommandLine cmd, Print& output) {
     return find_and_call(cmd, output, output);
 }
 
-bool find_and_call(StringView cmd, Print& output, Print& error_output) {
+bool find_and_call(StringView cmd, Print& output, Print& error_output, DeferredOutput* deferred) {
     auto result = parse_line(cmd);
     if (result.error != parser::Error::Ok) {
         String message;
@@ -138,7 +153,15 @@ bool find_and_call(StringView cmd, Print& output, Print& error_output) {
         return false;
     }
 
-    return find_and_call(std::move(result), output, error_output);
+    return find_and_call(std::move(result), output, error_output, deferred);
+}
+
+bool find_and_call(StringView cmd, Print& output, Print& error_output) {
+    return find_and_call(cmd, output, error_output, nullptr);
+}
+
+bool find_and_call(StringView cmd, Print& output, DeferredOutput* deferred) {
+    return find_and_call(cmd, output, output, deferred);
 }
 
 bool find_and_call(StringView cmd, Print& output) {
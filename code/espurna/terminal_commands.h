@@ -19,12 +19,25 @@ Copyright (C) 2020 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 namespace espurna {
 namespace terminal {
 
+// Long output can be produced in parts. Every call writes the next part of it,
+// returning `true` while there is still something left to write
+using Generator = std::function<bool(Print&)>;
+
+// Output that would rather call the generator at its own pace,
+// e.g. only when the network buffers are available
+class DeferredOutput {
+public:
+    virtual ~DeferredOutput() = default;
+    virtual void defer(Generator) = 0;
+};
+
 // We need to be able to pass arbitrary Args structure into the command function
 // Like Embedis implementation, we only pass things that we actually use instead of complete obj instance
 struct CommandContext {
     Argv argv;
     Print& output;
     Print& error;
+    DeferredOutput* deferred { nullptr };
 };
 
 using CommandFunc = void(*)(CommandContext&&);
@@ -72,6 +85,10 @@ bool find_and_call(CommandLine, Print& output);
 // try and call an already parsed command line
 bool find_and_call(CommandLine, Print& output, Print& error);
 
+// same as above, but allow to defer command output generator
+bool find_and_call(StringView, Print& output, DeferredOutput*);
+bool find_and_call(CommandLine, Print& output, Print& error, DeferredOutput*);
+
 // search the given string for valid commands and call them in sequence
 bool api_find_and_call(StringView, Print& output);
 
@@ -86,6 +103,10 @@ void ok(const espurna::terminal::CommandContext&);
 void error(Print&, const String&);
 void error(const espurna::terminal::CommandContext&, const String&);
 
+// either pass the generator to the deferred output, or call it right away until it is done
+// (generator is also expected to write the final +OK or -ERROR)
+void generate(const espurna::terminal::CommandContext&, Generator);
+
 
 } // namespace terminal
 } // namespace espurna
@@ -682,7 +682,7 @@ void displaySetup() {
 
   displayOn();
 
-  espurnaRegisterLoop(displayLoop);
+  espurnaRegisterLoop(displayLoop, STRING_VIEW("display"));
 }
 
 //------------------------------------------------------------------------------
@@ -851,7 +851,7 @@ void thermostatSetup() {
           .onAction(_thermostatWebSocketOnAction);
   #endif
 
-  espurnaRegisterLoop(thermostatLoop);
+  espurnaRegisterLoop(thermostatLoop, STRING_VIEW("thermostat"));
   espurnaRegisterReload(_thermostatReload);
 }
 
@@ -17,7 +17,10 @@ Copyright (C) 2019 by Xose Pérez <xose dot perez at gmail dot com>
 #include "thingspeak.h"
 #include "ws.h"
 
+#include <algorithm>
+#include <ctime>
 #include <memory>
+#include <vector>
 
 #if THINGSPEAK_USE_ASYNC
 #include <ESPAsyncTCP.h>
@@ -47,13 +50,27 @@ static constexpr auto FlushInterval = espurna::duration::Milliseconds(THINGSPEAK
 static constexpr size_t Retries { THINGSPEAK_TRIES };
 static constexpr size_t BufferSize { 256 };
 
+// created_at timestamps only have the resolution of a second
+static constexpr auto RecordInterval = espurna::duration::Seconds(1);
+static constexpr auto BulkInterval = espurna::duration::Seconds(THINGSPEAK_BULK_INTERVAL);
+static constexpr size_t BulkRecords { THINGSPEAK_BULK_RECORDS };
+static constexpr size_t BulkBufferSize { 1024 };
+
 PROGMEM_STRING(ApiKey, THINGSPEAK_APIKEY);
 PROGMEM_STRING(Address, THINGSPEAK_ADDRESS);
+PROGMEM_STRING(Channel, THINGSPEAK_CHANNEL);
+
+PROGMEM_STRING(FormType, "application/x-www-form-urlencoded");
+PROGMEM_STRING(JsonType, "application/json");
 
 constexpr bool enabled() {
     return 1 == THINGSPEAK_ENABLED;
 }
 
+constexpr bool bulk() {
+    return 1 == THINGSPEAK_BULK_ENABLED;
+}
+
 constexpr bool clearCache() {
     return 1 == THINGSPEAK_CLEAR_CACHE;
 }
@@ -67,6 +84,9 @@ PROGMEM_STRING(Enabled, "tspkEnabled");
 PROGMEM_STRING(ApiKey, "tspkKey");
 PROGMEM_STRING(ClearCache, "tspkClear");
 PROGMEM_STRING(Address, "tspkAddress");
+PROGMEM_STRING(Bulk, "tspkBulk");
+PROGMEM_STRING(BulkInterval, "tspkBulkInterval");
+PROGMEM_STRING(Channel, "tspkChannel");
 
 PROGMEM_STRING(Relay, "tspkRelay");
 PROGMEM_STRING(Magnitude, "tspkMagnitude");
@@ -97,6 +117,20 @@ String address() {
     return getSetting(FPSTR(keys::Address), FPSTR(build::Address));
 }
 
+bool bulk() {
+    return getSetting(FPSTR(keys::Bulk), build::bulk());
+}
+
+espurna::duration::Seconds bulkInterval() {
+    return std::max(
+        getSetting(FPSTR(keys::BulkInterval), build::BulkInterval),
+        std::chrono::duration_cast<espurna::duration::Seconds>(build::FlushInterval));
+}
+
+String channel() {
+    return getSetting(FPSTR(keys::Channel), FPSTR(build::Channel));
+}
+
 #if RELAY_SUPPORT
 size_t relay(size_t index) {
     return getSetting({FPSTR(keys::Relay), index}, build::Unset);
@@ -115,6 +149,15 @@ size_t magnitude(size_t index) {
 // -----------------------------------------------------------------------------
 
 namespace client {
+
+using Completion = void(*)(int, const String&);
+
+// Field values formatted as JSON object members, ready to be included in the bulk update
+struct Record {
+    time_t timestamp;
+    String values;
+};
+
 namespace internal {
 namespace {
 
@@ -127,8 +170,17 @@ TimeSource::time_point last_flush;
 size_t retries = 0;
 bool flush = false;
 
+// request body is built here and kept around until the response arrives.
+// buffer is never released, so it is only allocated once
 String data;
 
+bool bulk = false;
+TimeSource::duration bulk_interval;
+
+std::vector<Record> records;
+TimeSource::time_point last_record;
+size_t sent = 0;
+
 } // namespace
 } // namespace internal
 
@@ -185,10 +237,11 @@ bool enqueueMagnitude(size_t index, const String& value) {
 }
 #endif
 
-void maybe_retry(const String& body) {
-    DEBUG_MSG_P(PSTR("[THINGSPEAK] Response: %s\n"), body.c_str());
+void maybe_retry(int code, const String& body) {
+    DEBUG_MSG_P(PSTR("[THINGSPEAK] Response: HTTP %d %s\n"), code, body.c_str());
 
-    if ((!body.length() || body.equals(F("0"))) && (internal::retries < build::Retries)) {
+    const bool failed = (code != 200) || !body.length() || body.equals(F("0"));
+    if (failed && (internal::retries < build::Retries)) {
         DEBUG_MSG_P(PSTR("[THINGSPEAK] Re-scheduling flush, attempt %u / %u\n"),
             ++internal::retries, build::Retries);
         schedule_flush();
@@ -203,6 +256,35 @@ void maybe_retry(const String& body) {
     }
 }
 
+// Records that were sent are only removed on success. Retries happen on the next flush,
+// which is allowed to include the newer records as well
+void bulk_response(int code, const String& body) {
+    DEBUG_MSG_P(PSTR("[THINGSPEAK] Response: HTTP %d %s\n"), code, body.c_str());
+
+    const auto sent = std::min(internal::sent, internal::records.size());
+    internal::sent = 0;
+
+    if ((code == 200) || (code == 202)) {
+        internal::records.erase(
+            internal::records.begin(),
+            internal::records.begin() + sent);
+        internal::retries = 0;
+        return;
+    }
+
+    if (internal::retries < build::Retries) {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Re-scheduling bulk update, attempt %u / %u\n"),
+            ++internal::retries, build::Retries);
+        return;
+    }
+
+    DEBUG_MSG_P(PSTR("[THINGSPEAK] Dropping %u record(s)\n"), sent);
+    internal::records.erase(
+        internal::records.begin(),
+        internal::records.begin() + sent);
+    internal::retries = 0;
+}
+
 #if !THINGSPEAK_USE_ASYNC
 namespace sync {
 namespace internal {
@@ -253,8 +335,8 @@ SecureClientConfig secure_config {
 
 namespace {
 
-void send(WiFiClient& client, const URL& url, const String& data) {
-    DEBUG_MSG_P(PSTR("[THINGSPEAK] POST %s?%s\n"), url.path.c_str(), data.c_str());
+void send(WiFiClient& client, const URL& url, const String& type, const String& data, Completion completion) {
+    DEBUG_MSG_P(PSTR("[THINGSPEAK] POST %s\n"), url.path.c_str());
 
     HTTPClient http;
     http.begin(client, url.host, url.port, url.path,
@@ -262,12 +344,12 @@ void send(WiFiClient& client, const URL& url, const String& data) {
 
     const auto app = buildApp();
     http.addHeader(F("User-Agent"), String(app.name));
-    http.addHeader(F("Content-Type"), F("application/x-www-form-urlencoded"));
+    http.addHeader(F("Content-Type"), type);
 
     const auto response = http.POST(data);
 
     String body;
-    if (response == 200) {
+    if ((response == 200) || (response == 202)) {
         if (http.getSize()) {
             body = http.getString();
         }
@@ -275,16 +357,11 @@ void send(WiFiClient& client, const URL& url, const String& data) {
         DEBUG_MSG_P(PSTR("[THINGSPEAK] ERROR: HTTP %d\n"), response);
     }
 
-    if (body.length()) {
-        DEBUG_MSG_P(PSTR("[THINGSPEAK] Response: %s\n"), body.c_str());
-    } else {
-        DEBUG_MSG_P(PSTR("[THINGSPEAK] Empty body\n"));
-    }
-
-    maybe_retry(body);
+    completion(response, body);
 }
 
-void send(const String& address, const String& data) {
+// false when the request was not sent and completion callback will not be called
+bool send(const String& address, const String& type, const String& data, Completion completion) {
     const URL url(address);
 
 #if SECURE_CLIENT == SECURE_CLIENT_BEARSSL
@@ -292,24 +369,26 @@ void send(const String& address, const String& data) {
         const int check = internal::secure_config.on_check();
         if (!ntpSynced() && (check == SECURE_CLIENT_CHECK_CA)) {
             DEBUG_MSG_P(PSTR("[THINGSPEAK] Time not synced! Cannot use CA validation\n"));
-            return;
+            return false;
         }
 
         auto client = std::make_unique<SecureClient>(internal::secure_config);
         if (!client->beforeConnected()) {
-            return;
+            return false;
         }
 
-        send(client->get(), url, data);
-        return;
+        send(client->get(), url, type, data, completion);
+        return true;
     }
 #endif
 
     if (url.protocol.equals(F("http"))) {
         auto client = std::make_unique<WiFiClient>();
-        send(*client.get(), url, data);
-        return;
+        send(*client.get(), url, type, data, completion);
+        return true;
     }
+
+    return false;
 }
 
 } // namespace
@@ -320,50 +399,75 @@ void send(const String& address, const String& data) {
 namespace async {
 namespace {
 
+// Connection is kept open after the response, so the next request could skip the handshake.
+// That only works when response length is known beforehand, otherwise the connection is closed
+// as soon as some of the body is received. Server is also allowed to close the connection at any time.
 class Client {
 public:
     static constexpr auto Timeout = espurna::duration::Seconds(15);
 
-    using Completion = void(*)(const String&);
+    static constexpr size_t HeadersSize { 256 };
+    static constexpr size_t LineSize { 128 };
+    static constexpr size_t BodySize { 128 };
 
     using ClientState = AsyncClientState;
     enum class ParserState {
-        Init,
+        Status,
         Headers,
         Body,
         End,
     };
 
-    bool send(const String& data, Completion completion) {
-        if (_client_state == ClientState::Disconnected) {
-            _data = data;
-            _completion = completion;
-
-            if (!_client) {
-                _client = std::make_unique<AsyncClient>();
-                _client->onDisconnect(Client::_onDisconnected, this);
-                _client->onConnect(Client::_onConnect, this);
-                _client->onTimeout(Client::_onTimeout, this);
-                _client->onPoll(Client::_onPoll, this);
-                _client->onData(Client::_onData, this);
+    // Data is not copied and is expected to stay valid until the completion callback
+    bool send(const String& address, const String& type, const String& data, Completion completion) {
+        if (_busy) {
+            return false;
+        }
+
+        URL url(address);
+        if (_client_state != ClientState::Disconnected) {
+            if ((_client_state != ClientState::Connected)
+                || (url.host != _address.host)
+                || (url.port != _address.port))
+            {
+                _client->close(true);
+                return false;
             }
+        }
 
-            _connection_start = TimeSource::now();
-            _client_state = ClientState::Connecting;
+        _address = std::move(url);
+        _type = type;
+        _data = &data;
+        _completion = completion;
+        _busy = true;
 
-            if (_client->connect(_address.host.c_str(), _address.port)) {
-                return true;
-            }
+        if (_client_state == ClientState::Connected) {
+            DEBUG_MSG_P(PSTR("[THINGSPEAK] Re-using the connection\n"));
+            _request();
+            return true;
+        }
 
-            _client->close(true);
+        if (!_client) {
+            _client = std::make_unique<AsyncClient>();
+            _client->onDisconnect(Client::_onDisconnected, this);
+            _client->onConnect(Client::_onConnect, this);
+            _client->onTimeout(Client::_onTimeout, this);
+            _client->onPoll(Client::_onPoll, this);
+            _client->onAck(Client::_onAck, this);
+            _client->onData(Client::_onData, this);
         }
 
-        return false;
-    }
+        _request_start = TimeSource::now();
+        _client_state = ClientState::Connecting;
+
+        if (_client->connect(_address.host.c_str(), _address.port)) {
+            return true;
+        }
 
-    bool send(const String& address, const String& data, Completion completion) {
-        _address = URL(address);
-        return send(data, completion);
+        _busy = false;
+        _client->close(true);
+
+        return false;
     }
 
     void disconnect() {
@@ -376,16 +480,21 @@ public:
         return _address;
     }
 
+    // only true while the request is in-flight, idle connection is allowed to be re-used
     explicit operator bool() const {
-        return _client_state != ClientState::Disconnected;
+        return _busy;
     }
 
 private:
     void onDisconnected() {
         DEBUG_MSG_P(PSTR("[THINGSPEAK] Disconnected\n"));
-        _parser_state = ParserState::Init;
+        _parser_state = ParserState::End;
         _client_state = ClientState::Disconnected;
-        _data = "";
+
+        // request was not completed, allow to retry
+        if (_busy) {
+            _complete(0);
+        }
     }
 
     void onTimeout(uint32_t timestamp) {
@@ -393,141 +502,232 @@ private:
         _client->close(true);
     }
 
-    bool _sendPendingData() {
-        if (!_data.length()) {
-            return true;
-        }
+    // headers are written first, both strings are treated as a single stream of data
+    void _sendPendingData() {
+        const auto total = _headers.length() + _data->length();
+        while (_offset < total) {
+            const auto space = _client->space();
+            if (!space) {
+                break;
+            }
 
-        size_t wrote = _client->write(_data.c_str(), _data.length());
-        if (wrote == _data.length()) {
-            _data = "";
-            return true;
-        }
+            const char* ptr;
+            size_t left;
+            if (_offset < _headers.length()) {
+                ptr = _headers.c_str() + _offset;
+                left = _headers.length() - _offset;
+            } else {
+                ptr = _data->c_str() + (_offset - _headers.length());
+                left = total - _offset;
+            }
 
-        return false;
+            const auto wrote = _client->write(ptr, std::min(space, left));
+            if (!wrote) {
+                break;
+            }
+
+            _offset += wrote;
+        }
     }
 
     void onPoll() {
-        if (_client_state != ClientState::Connected) {
+        if (!_busy || (_client_state != ClientState::Connected)) {
             return;
         }
 
-        if (!_sendPendingData()) {
-            return;
-        }
+        _sendPendingData();
 
         const auto now = TimeSource::now();
-        if (now - _connection_start > Timeout) {
+        if (now - _request_start > Timeout) {
             DEBUG_MSG_P(PSTR("[THINGSPEAK] ERROR: Timeout after %ums\n"),
-                (now - _connection_start).count());
+                (now - _request_start).count());
             _client->close(true);
         }
     }
 
+    void onAck() {
+        if (_busy && (_client_state == ClientState::Connected)) {
+            _sendPendingData();
+        }
+    }
+
     void onConnect() {
-            _parser_state = ParserState::Init;
-            _client_state = ClientState::Connected;
+        _client_state = ClientState::Connected;
+
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Connected to %s:%hu\n"),
+            _address.host.c_str(), _address.port);
 
-            DEBUG_MSG_P(PSTR("[THINGSPEAK] Connected to %s:%hu\n"),
-                _address.host.c_str(), _address.port);
+        _request();
+    }
 
-            DEBUG_MSG_P(PSTR("[THINGSPEAK] POST %s?%s\n"),
-                    _address.path.c_str(), _data.c_str());
+    void _request() {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] POST %s\n"), _address.path.c_str());
 
-            static constexpr size_t HeadersSize { 256 };
+        _request_start = TimeSource::now();
 
-            String headers;
-            headers.reserve(HeadersSize);
-            auto append = [&](const String& key, const String& value) {
-                headers += key;
-                headers += F(": ");
-                headers += value;
-                headers += F("\r\n");
-            };
+        _parser_state = ParserState::Status;
+        _line = "";
+        _body = "";
+        _code = 0;
+        _content_length = -1;
+        _keep_alive = true;
 
-            headers += F("POST ");
-            headers += _address.path;
-            headers += F(" HTTP/1.1");
-            headers += F("\r\n");
+        _headers.reserve(HeadersSize);
+        _headers = "";
 
-            const auto app = buildApp();
+        auto append = [&](const String& key, const String& value) {
+            _headers += key;
+            _headers += F(": ");
+            _headers += value;
+            _headers += F("\r\n");
+        };
 
-            append(F("Host"), _address.host);
-            append(F("User-Agent"), String(app.name));
-            append(F("Connection"), F("close"));
-            append(F("Content-Type"), F("application/x-www-form-urlencoded"));
-            append(F("Content-Length"), String(_data.length(), 10));
+        _headers += F("POST ");
+        _headers += _address.path;
+        _headers += F(" HTTP/1.1");
+        _headers += F("\r\n");
 
-            headers += F("\r\n");
+        const auto app = buildApp();
 
-            _client->write(headers.c_str(), headers.length());
-            _sendPendingData();
+        append(F("Host"), _address.host);
+        append(F("User-Agent"), String(app.name));
+        append(F("Connection"), F("keep-alive"));
+        append(F("Content-Type"), _type);
+        append(F("Content-Length"), String(_data->length(), 10));
+
+        _headers += F("\r\n");
+
+        _offset = 0;
+        _sendPendingData();
     }
 
-    void onData(const uint8_t* data, size_t len) {
-        if (_data.length()) {
-            _parser_state = ParserState::End;
-            _client->close(true);
+    void _complete(int code) {
+        _busy = false;
+        _data = nullptr;
+        _completion(code, _body);
+    }
+
+    void _header(const String& line) {
+        const auto separator = line.indexOf(':');
+        if (separator <= 0) {
             return;
         }
 
-        PROGMEM_STRING(Status, "HTTP/1.1 200 OK");
-        PROGMEM_STRING(Break, "\r\n\r\n");
+        auto key = line.substring(0, separator);
+        key.toLowerCase();
 
-        auto begin = reinterpret_cast<const char*>(data);
-        auto end = begin + len;
+        auto value = line.substring(separator + 1);
+        value.trim();
+        value.toLowerCase();
 
-        const char* ptr { nullptr };
+        if (key.equals(F("content-length"))) {
+            _content_length = value.toInt();
+        } else if (key.equals(F("connection"))) {
+            _keep_alive = !value.equals(F("close"));
+        } else if (key.equals(F("transfer-encoding"))) {
+            _content_length = -1;
+        }
+    }
 
-        do {
-            switch (_parser_state) {
+    // returns true when the line is complete
+    bool _readLine(const char*& ptr, const char* end) {
+        while (ptr != end) {
+            const char c = *(ptr++);
+            if (c == '\n') {
+                _line.trim();
+                return true;
+            }
 
-            case ParserState::End:
-                break;
+            if (_line.length() < LineSize) {
+                _line += c;
+            }
+        }
 
-            case ParserState::Init:
-            {
-                ptr = strnstr(begin, Status, len);
-                if (!ptr) {
-                    _client->close(true);
-                    return;
+        return false;
+    }
+
+    void onData(const uint8_t* data, size_t len) {
+        if (!_busy) {
+            _client->close(true);
+            return;
+        }
+
+        auto ptr = reinterpret_cast<const char*>(data);
+        auto end = ptr + len;
+
+        while ((ptr != end) && (_parser_state != ParserState::End)) {
+            switch (_parser_state) {
+
+            case ParserState::Status:
+                if (_readLine(ptr, end)) {
+                    // HTTP/1.1 200 OK
+                    const auto space = _line.indexOf(' ');
+                    if (!_line.startsWith(F("HTTP/")) || (space < 0)) {
+                        _client->close(true);
+                        return;
+                    }
+
+                    _code = _line.substring(space + 1).toInt();
+                    _line = "";
+                    _parser_state = ParserState::Headers;
                 }
-                _parser_state = ParserState::Headers;
                 break;
-            }
 
             case ParserState::Headers:
-            {
-                ptr = strnstr(ptr, Break, len);
-                if (!ptr) {
-                    return;
+                if (_readLine(ptr, end)) {
+                    if (!_line.length()) {
+                        _parser_state = ParserState::Body;
+                        if (_content_length == 0) {
+                            _finish();
+                            return;
+                        }
+                        break;
+                    }
+
+                    _header(_line);
+                    _line = "";
                 }
-
-                ptr = ptr + __builtin_strlen(Break);
-                _parser_state = ParserState::Body;
-            }
+                break;
 
             case ParserState::Body:
             {
-                if (!ptr) {
-                    ptr = begin;
-                }
+                const size_t size = end - ptr;
+                const size_t left = (_content_length > 0)
+                    ? std::min(size, static_cast<size_t>(_content_length))
+                    : size;
 
-                if (end - ptr) {
-                    String body;
-                    body.concat(ptr, end - ptr);
+                if (_body.length() < BodySize) {
+                    _body.concat(ptr, std::min(left, BodySize - _body.length()));
+                }
 
-                    _completion(body);
-                    _client->close(true);
+                ptr += left;
+                if (_content_length > 0) {
+                    _content_length -= left;
+                }
 
-                    _parser_state = ParserState::End;
+                if (_content_length <= 0) {
+                    _finish();
+                    return;
                 }
-                return;
+                break;
             }
 
+            case ParserState::End:
+                break;
+
             }
+        }
+    }
+
+    void _finish() {
+        _parser_state = ParserState::End;
 
-        } while (_parser_state != ParserState::End);
+        const bool keep_alive = _keep_alive && (_content_length == 0);
+        _complete(_code);
+
+        if (!keep_alive) {
+            _client->close(true);
+        }
     }
 
     static void _onDisconnected(void* ptr, AsyncClient*) {
@@ -546,18 +746,34 @@ private:
         reinterpret_cast<Client*>(ptr)->onPoll();
     }
 
+    static void _onAck(void* ptr, AsyncClient*, size_t, uint32_t) {
+        reinterpret_cast<Client*>(ptr)->onAck();
+    }
+
     static void _onData(void* ptr, AsyncClient*, const void* data, size_t len) {
         reinterpret_cast<Client*>(ptr)->onData(reinterpret_cast<const uint8_t*>(data), len);
     }
 
-    ParserState _parser_state = ParserState::Init;
+    ParserState _parser_state = ParserState::End;
     ClientState _client_state = ClientState::Disconnected;
 
-    TimeSource::time_point _connection_start;
+    TimeSource::time_point _request_start;
 
     URL _address;
+    String _type;
     Completion _completion;
-    String _data;
+
+    String _headers;
+    const String* _data { nullptr };
+    size_t _offset { 0 };
+    bool _busy { false };
+
+    String _line;
+    String _body;
+    int _code { 0 };
+    long _content_length { -1 };
+    bool _keep_alive { true };
+
     std::unique_ptr<AsyncClient> _client;
 };
 
@@ -573,14 +789,18 @@ Client client;
 
 namespace {
 
-void send(const String& address, const String& data) {
+// false when the request was not sent and completion callback will not be called
+bool send(const String& address, const String& type, const String& data, Completion completion) {
     if (internal::client) {
-        return;
+        return false;
     }
 
-    if (!internal::client.send(address, data, maybe_retry)) {
+    if (!internal::client.send(address, type, data, completion)) {
         DEBUG_MSG_P(PSTR("[THINGSPEAK] Connection failed\n"));
+        return false;
     }
+
+    return true;
 }
 
 } // namespace
@@ -595,14 +815,163 @@ bool ready() {
 #endif
 }
 
-void send(const String& address, const String& data) {
+bool send(const String& address, const String& type, const String& data, Completion completion) {
 #if THINGSPEAK_USE_ASYNC
-    async::send(address, data);
+    return async::send(address, type, data, completion);
 #else
-    sync::send(address, data);
+    return sync::send(address, type, data, completion);
 #endif
 }
 
+namespace bulk {
+
+bool synced() {
+#if NTP_SUPPORT
+    return ntpSynced();
+#else
+    return false;
+#endif
+}
+
+// Same host as the regular updates, but the path includes the channel ID
+// e.g. http://api.thingspeak.com/channels/123456/bulk_update.json
+String address(const String& channel) {
+    const URL url(settings::address());
+
+    String out;
+    out.reserve(build::BufferSize);
+
+    out += url.protocol;
+    out += F("://");
+    out += url.host;
+    out += ':';
+    out += String(url.port, 10);
+    out += F("/channels/");
+    out += channel;
+    out += F("/bulk_update.json");
+
+    return out;
+}
+
+// Current fields are saved as a new record, at most once per RecordInterval.
+// Oldest record that is not currently being sent is replaced when there is no more space left
+void record() {
+    if (!internal::flush) {
+        return;
+    }
+
+    const auto now = TimeSource::now();
+    if (internal::records.size() && (now - internal::last_record < build::RecordInterval)) {
+        return;
+    }
+
+    if (!synced()) {
+        return;
+    }
+
+    internal::flush = false;
+    internal::last_record = now;
+
+    String values;
+    for (size_t id = 0; id < std::size(internal::fields); ++id) {
+        if (internal::fields[id].length()) {
+            if (values.length()) {
+                values += ',';
+            }
+
+            char buf[48] = {0};
+            snprintf_P(buf, sizeof(buf), PSTR("\"field%u\":\"%s\""),
+                (id + 1), internal::fields[id].c_str());
+            values += buf;
+        }
+    }
+
+    if (!values.length()) {
+        return;
+    }
+
+    if (internal::records.size() >= build::BulkRecords) {
+        if (internal::sent >= internal::records.size()) {
+            DEBUG_MSG_P(PSTR("[THINGSPEAK] No space left for the record\n"));
+            return;
+        }
+
+        internal::records.erase(internal::records.begin() + internal::sent);
+    }
+
+    internal::records.push_back(
+        Record{std::time(nullptr), std::move(values)});
+
+    if (internal::clear) {
+        for (auto& field : internal::fields) {
+            field = "";
+        }
+    }
+}
+
+// {"write_api_key":"...","updates":[{"created_at":"2021-01-01T00:00:00Z","field1":"1.000"},...]}
+void flush() {
+    if (!internal::records.size() || !ready()) {
+        return;
+    }
+
+    // api rate limit still applies. but, retries and full buffer do not need to wait for the whole interval
+    const auto now = TimeSource::now();
+    const auto elapsed = now - internal::last_flush;
+    if (elapsed < build::FlushInterval) {
+        return;
+    }
+
+    const bool full = internal::records.size() >= build::BulkRecords;
+    if (!full && !internal::retries && (elapsed < internal::bulk_interval)) {
+        return;
+    }
+
+    const auto channel = settings::channel();
+    if (!channel.length()) {
+        return;
+    }
+
+    internal::last_flush = now;
+
+    internal::data.reserve(build::BulkBufferSize);
+    internal::data = "";
+
+    internal::data += F("{\"write_api_key\":\"");
+    internal::data += settings::apiKey();
+    internal::data += F("\",\"updates\":[");
+
+    for (const auto& record : internal::records) {
+        if (&record != &internal::records.front()) {
+            internal::data += ',';
+        }
+
+        tm out;
+        gmtime_r(&record.timestamp, &out);
+
+        char buf[48] = {0};
+        snprintf_P(buf, sizeof(buf), PSTR("{\"created_at\":\"%04d-%02d-%02dT%02d:%02d:%02dZ\","),
+            out.tm_year + 1900, out.tm_mon + 1, out.tm_mday,
+            out.tm_hour, out.tm_min, out.tm_sec);
+
+        internal::data += buf;
+        internal::data += record.values;
+        internal::data += '}';
+    }
+
+    internal::data += F("]}");
+
+    DEBUG_MSG_P(PSTR("[THINGSPEAK] Sending %u record(s)\n"), internal::records.size());
+
+    // records are only removed by the response handler, the next flush will include them again
+    internal::sent = internal::records.size();
+    if (!send(address(channel), FPSTR(build::JsonType), internal::data, bulk_response)) {
+        internal::sent = 0;
+    }
+}
+
+} // namespace bulk
+
 void flush() {
     static bool initial { true };
     if (!internal::flush) {
@@ -623,9 +992,7 @@ void flush() {
     internal::flush = false;
 
     internal::data.reserve(build::BufferSize);
-    if (internal::data.length()) {
-        internal::data = "";
-    }
+    internal::data = "";
 
     // Walk the fields, IDs are mapped to indexes of the array
     for (size_t id = 0; id < std::size(internal::fields); ++id) {
@@ -643,12 +1010,11 @@ void flush() {
 
     // POST data if any
     if (internal::data.length()) {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Sending %s\n"), internal::data.c_str());
         internal::data.concat(F("&api_key="));
         internal::data.concat(settings::apiKey());
-        send(settings::address(), internal::data);
+        send(settings::address(), FPSTR(build::FormType), internal::data, maybe_retry);
     }
-
-    internal::data = "";
 }
 
 void configure() {
@@ -661,6 +1027,34 @@ void configure() {
     }
 
     internal::clear = settings::clearCache();
+
+    auto bulk = settings::bulk();
+#if NTP_SUPPORT
+    if (internal::enabled && bulk && !settings::channel().length()) {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Bulk updates require the channel ID, using regular updates\n"));
+        bulk = false;
+    }
+#else
+    if (internal::enabled && bulk) {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Bulk updates require NTP support, using regular updates\n"));
+        bulk = false;
+    }
+#endif
+
+    if (bulk && !internal::bulk) {
+        internal::records.reserve(build::BulkRecords);
+    } else if (!bulk && internal::bulk) {
+        internal::records.clear();
+        internal::records.shrink_to_fit();
+        internal::sent = 0;
+    }
+
+    internal::bulk = bulk;
+    internal::bulk_interval = settings::bulkInterval();
+
+    if (internal::bulk && !bulk::synced()) {
+        DEBUG_MSG_P(PSTR("[THINGSPEAK] Bulk updates require synced time\n"));
+    }
 }
 
 void loop() {
@@ -668,6 +1062,14 @@ void loop() {
         return;
     }
 
+    if (internal::bulk) {
+        bulk::record();
+        if (wifiConnected() || wifiConnectable()) {
+            bulk::flush();
+        }
+        return;
+    }
+
     if (wifiConnected() || wifiConnectable()) {
         flush();
     }
@@ -703,6 +1105,9 @@ void onConnected(JsonObject& root) {
     root[FPSTR(settings::keys::ApiKey)] = settings::apiKey();
     root[FPSTR(settings::keys::ClearCache)] = settings::clearCache();
     root[FPSTR(settings::keys::Address)] = settings::address();
+    root[FPSTR(settings::keys::Bulk)] = settings::bulk();
+    root[FPSTR(settings::keys::BulkInterval)] = settings::bulkInterval().count();
+    root[FPSTR(settings::keys::Channel)] = settings::channel();
 
 #if RELAY_SUPPORT
     JsonArray& relays = root.createNestedArray(F("tspkRelays"));
@@ -743,7 +1148,7 @@ void setup() {
     }
 #endif
 
-    espurnaRegisterLoop(client::loop);
+    espurnaRegisterLoop(client::loop, STRING_VIEW("thingspeak"));
     espurnaRegisterReload(client::configure);
 }
 
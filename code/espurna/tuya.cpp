@@ -199,7 +199,7 @@ namespace tuya {
         if (!transportDebug) return;
         StreamString out;
         Output writer(out, frame.length());
-        writer.writeHex(frame.serialize());
+        writer.writeFrameHex(frame);
         DEBUG_MSG("[TUYA] %s: %s\n", tag, out.c_str());
     }
 
@@ -509,7 +509,7 @@ error:
         if (!outputFrames.empty()) {
             auto& frame = outputFrames.top();
             dataframeDebugSend("=>", frame);
-            tuyaSerial->write(frame.serialize());
+            tuyaSerial->writeFrame(frame);
             outputFrames.pop();
         }
 
@@ -664,7 +664,7 @@ error:
 
         // Install main loop method and WiFiStatus ping (only works with specific mode)
         
-        ::espurnaRegisterLoop(loop);
+        ::espurnaRegisterLoop(loop, STRING_VIEW("tuya"));
         ::wifiRegister([](espurna::wifi::Event event) {
             switch (event) {
             case espurna::wifi::Event::StationConnected:
@@ -11,6 +11,7 @@ Copyright (C) 2019 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 #include <Print.h>
 #include <StreamString.h>
 
+#include <algorithm>
 #include <iterator>
 #include <vector>
 
@@ -30,18 +31,61 @@ namespace tuya {
     class PrintHex {
     public:
         static void write(Print& printer, uint8_t data) {
-            char buffer[3] = {0};
-            snprintf(buffer, sizeof(buffer), "%02x", data);
-            printer.write(buffer, 2);
+            write(printer, &data, 1);
         }
 
         static void write(Print& printer, const uint8_t* data, size_t size) {
-            for (size_t n = 0; n < size; ++n) {
-                write(printer, data[n]);
+            static constexpr char Digits[] = "0123456789abcdef";
+
+            char buffer[64];
+            while (size) {
+                const size_t chunk = std::min(size, sizeof(buffer) / 2);
+                for (size_t n = 0; n < chunk; ++n) {
+                    buffer[n * 2] = Digits[(data[n] >> 4) & 0xf];
+                    buffer[n * 2 + 1] = Digits[data[n] & 0xf];
+                }
+
+                printer.write(buffer, chunk * 2);
+                data += chunk;
+                size -= chunk;
             }
         }
     };
 
+    // Whole frame is assembled on the stack and handed to the printer with a single write() call
+    // (only frames larger than the buffer are split, which is not expected per SDK recommendations)
+    template <typename PrintType>
+    class FrameBuffer {
+    public:
+        static constexpr size_t Size = 256;
+
+        explicit FrameBuffer(Print& printer) :
+            _printer(printer)
+        {}
+
+        FrameBuffer(const FrameBuffer&) = delete;
+        FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+        void push(uint8_t value) {
+            if (_size == Size) {
+                flush();
+            }
+
+            _buffer[_size++] = value;
+        }
+
+        void flush() {
+            if (_size) {
+                PrintType::write(_printer, _buffer, _size);
+                _size = 0;
+            }
+        }
+
+    private:
+        Print& _printer;
+        uint8_t _buffer[Size];
+        size_t _size { 0 };
+    };
 
     class StreamWrapper {
     protected:
@@ -70,24 +114,55 @@ namespace tuya {
         Output(StreamString& stream, size_t length) :
             Output(stream)
         {
-            stream.reserve((length * 2) + 1);
+            stream.reserve(((length + 7) * 2) + 1);
         }
 
+        // serialized frame data, header and checksum are added here
         template <typename T, typename PrintType>
         void _write(const T& data) {
+            FrameBuffer<PrintType> out(_stream);
 
-            const uint8_t header[2] = {0x55, 0xaa};
+            // 0x55 + 0xaa
             uint8_t checksum = 0xff;
-
-            PrintType::write(_stream, header, 2);
+            out.push(0x55);
+            out.push(0xaa);
 
             for (auto it = data.cbegin(); it != data.cend(); ++it) {
                 checksum += *it;
-                PrintType::write(_stream, *it);
+                out.push(*it);
             }
 
-            PrintType::write(_stream, checksum);
+            out.push(checksum);
+            out.flush();
+        }
+
+        // same as above, but without the intermediate container
+        template <typename T, typename PrintType>
+        void _writeFrame(const T& frame) {
+            FrameBuffer<PrintType> out(_stream);
+
+            uint8_t checksum = 0xff;
+            out.push(0x55);
+            out.push(0xaa);
+
+            const uint8_t head[4] {
+                frame.version(),
+                frame.command(),
+                static_cast<uint8_t>((frame.length() >> 8) & 0xff),
+                static_cast<uint8_t>(frame.length() & 0xff)};
+
+            for (auto value : head) {
+                checksum += value;
+                out.push(value);
+            }
+
+            for (auto it = frame.cbegin(); it != frame.cend(); ++it) {
+                checksum += *it;
+                out.push(*it);
+            }
 
+            out.push(checksum);
+            out.flush();
         }
 
         template <typename T>
@@ -100,10 +175,20 @@ namespace tuya {
             _write<T, PrintHex>(data);
         }
 
+        template <typename T>
+        void writeFrame(const T& frame) {
+            _writeFrame<T, PrintRaw>(frame);
+        }
+
+        template <typename T>
+        void writeFrameHex(const T& frame) {
+            _writeFrame<T, PrintHex>(frame);
+        }
 
     };
 
     class Input : public virtual StreamWrapper {
+    public:
         // Buffer depth based on the SDK recommendations
         constexpr static size_t LIMIT = 256;
 
@@ -111,21 +196,20 @@ namespace tuya {
         // 256 * 1.04 = 266.24
         constexpr static size_t TIME_LIMIT = 267;
 
-    public:
         using const_iterator = std::vector<uint8_t>::const_iterator;
 
+        // Buffer is allocated once and re-used for every frame
         Input(Stream& stream) :
-            StreamWrapper(stream)
-        {
-            _buffer.reserve(LIMIT);
-        }
+            StreamWrapper(stream),
+            _buffer(LIMIT, 0)
+        {}
 
-        bool full() { return (_index >= LIMIT); }
-        bool done() { return _done; }
-        size_t size() { return _index; }
+        bool full() const { return (_index >= LIMIT); }
+        bool done() const { return _done; }
+        size_t size() const { return _index; }
 
         uint8_t operator[](size_t i) const {
-            if (i > LIMIT) return 0;
+            if (i >= LIMIT) return 0;
             return _buffer[i];
         }
 
@@ -134,28 +218,23 @@ namespace tuya {
         }
 
         const_iterator cend() const {
-            return _buffer.cend();
+            return _buffer.cbegin() + _index;
         }
 
-        void read() {
-
-            if (_done) return;
-            if (full()) return;
-
-            if (_last && (millis() - _last > TIME_LIMIT)) reset();
-            _last = millis();
-
-            int byte = _stream.read();
-            if (byte < 0) return;
-
-            //DEBUG_MSG("i=%u byte=%u chk=%u:%u\n",
-            //  _index, byte, _checksum, uint8_t(_checksum + byte));
+        // Consume a single byte. Returns true when the frame is complete,
+        // it can then be accessed through the DataFrameView until the next reset()
+        bool parse(uint8_t byte) {
+            if (_done || full()) return _done;
 
             // check that header value is 0x55aa
             if (0 == _index) {
-                if (0x55 != byte) return;
+                if (0x55 != byte) return false;
             } else if (1 == _index) {
-                if (0xaa != byte) return;
+                // 0x55 could also be the start of the next frame
+                if (0xaa != byte) {
+                    if (0x55 != byte) reset();
+                    return false;
+                }
             }
 
             // set read boundary from received length
@@ -165,20 +244,22 @@ namespace tuya {
 
             if (5 == _index) {
                 _read_until += byte + _index + 1;
-                //DEBUG_MSG("read_until=%u\n", _read_until);
+                // frame would never fit into the buffer
+                if (_read_until >= LIMIT) {
+                    reset();
+                    return false;
+                }
             }
 
             // verify that the checksum byte is the same that we got so far
             if ((_index > 5) && (_index >= _read_until)) {
                 if (_checksum != byte) {
-                    //DEBUG_MSG("chk err, recv=%u calc=%u\n", byte, _checksum);
                     reset();
-                    return;
+                    return false;
                 }
 
-                //DEBUG_MSG("chk ok\n");
                 _done = true;
-                return;
+                return true;
             }
 
             _buffer[_index] = byte;
@@ -186,10 +267,25 @@ namespace tuya {
 
             ++_index;
 
+            return false;
+        }
+
+        void read() {
+
+            if (_done) return;
+            if (full()) return;
+
+            if (_last && (millis() - _last > TIME_LIMIT)) reset();
+            _last = millis();
+
+            int byte = _stream.read();
+            if (byte < 0) return;
+
+            parse(static_cast<uint8_t>(byte));
+
         }
 
         void reset() {
-            std::fill(_buffer.begin(), _buffer.end(), 0);
             _read_until = LIMIT;
             _checksum = 0;
             _index = 0;
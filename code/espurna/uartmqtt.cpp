@@ -15,10 +15,11 @@ Support queueing and handling input without termination by Maxim Prokhorov <prok
 
 #include "espurna.h"
 #include "mqtt.h"
+#include "uart.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <array>
-#include <queue>
 
 namespace espurna {
 namespace uart_mqtt {
@@ -26,14 +27,14 @@ namespace {
 
 namespace build {
 
-// TODO: these time values are arbitrary, specific values might need to depend on the baudrate?
-// TODO: output is not a ring-buffer, overflow is handled by stalling until we have more space
+// TODO: time value is arbitrary, specific value might need to depend on the baudrate?
 constexpr auto ReadInterval = duration::Milliseconds { 100 };
-constexpr auto WriteWindow = duration::Milliseconds { 100 };
 
 constexpr size_t BufferSize { UART_MQTT_BUFFER_SIZE };
 constexpr size_t SerializedSize { (BufferSize * 2) + 1 };
 
+constexpr size_t OutputSize { UART_MQTT_OUTPUT_SIZE };
+
 constexpr uint8_t TerminateIn { UART_MQTT_TERMINATE_IN };
 constexpr uint8_t TerminateOut { UART_MQTT_TERMINATE_OUT };
 
@@ -45,24 +46,10 @@ constexpr bool Decode { UART_MQTT_DECODE };
 // Output is capped, prepare using a fixed-size buffer
 using Serialized = std::array<char, build::SerializedSize>;
 
-// TODO: use hwserial buffer directly? needs additional code to
-// use `peekBuffer()` and (possibly) allocate based on `BufferSize`
-// (aka serial rx buffer size)
+// Only used when frame cannot be sent directly from the serial RX buffer
+// (when stream does not provide `peekBuffer()`, or frame wraps around the end of it)
 using Buffer = std::array<uint8_t, build::BufferSize>;
 
-// Prefer smaller output instead of using `Serialized` directly
-using Queue = std::queue<String>;
-
-namespace internal {
-
-Buffer buffer;
-auto cursor = buffer.begin();
-
-Queue queue;
-Stream* port;
-
-} // namespace internal
-
 struct Span {
     Span() = delete;
     constexpr Span(const uint8_t* data, size_t size) :
@@ -96,50 +83,181 @@ private:
     size_t _size;
 };
 
-String serialize(Span bytes, bool encode) {
-    String out;
+// MQTT payloads are written to the serial in the order they were received, as soon as serial has space for them.
+// Every payload is either stored as a whole (including the termination byte), or discarded when there is no space left.
+struct Output {
+    using Data = std::array<uint8_t, build::OutputSize>;
 
-    Serialized string;
-    if (encode) {
-        const auto length = hexEncode(
-            bytes.data(), bytes.size(),
-            string.data(), string.size());
+    bool empty() const {
+        return _size == 0;
+    }
 
-        if (length) {
-            out.concat(string.data(), length);
+    size_t free() const {
+        return _data.size() - _size;
+    }
+
+    // Contiguous chunk at the start of the queue, at most `size` bytes
+    Span front(size_t size) const {
+        return Span(&_data[_head],
+            std::min({size, _size, _data.size() - _head}));
+    }
+
+    void pop(size_t size) {
+        _head = (_head + size) % _data.size();
+        _size -= size;
+    }
+
+    bool push(StringView payload, uint8_t termination, bool decode) {
+        const auto length = decode
+            ? (payload.length() / 2)
+            : payload.length();
+        if (decode && (!length || (payload.length() & 1))) {
+            return false;
         }
-    } else {
-        const auto length = std::min(string.size(), bytes.size());
-        bytes = Span(bytes.begin(), length);
-            
-        std::copy(bytes.begin(), bytes.end(),
-            string.begin());
-        out.concat(string.begin(), length);
+
+        if ((length + (termination ? 1 : 0)) > free()) {
+            return false;
+        }
+
+        // at most two chunks, before and after the end of the array
+        auto tail = (_head + _size) % _data.size();
+        auto in = payload.begin();
+
+        size_t left = length;
+        while (left) {
+            const auto chunk = std::min(left, _data.size() - tail);
+            if (decode) {
+                if (hexDecode(in, chunk * 2, &_data[tail], chunk) != chunk) {
+                    return false;
+                }
+
+                in += chunk * 2;
+            } else {
+                std::copy(in, in + chunk, &_data[tail]);
+                in += chunk;
+            }
+
+            tail = (tail + chunk) % _data.size();
+            left -= chunk;
+        }
+
+        if (termination) {
+            _data[tail] = termination;
+        }
+
+        _size += length + (termination ? 1 : 0);
+
+        return true;
     }
 
-    return out;
-}
+private:
+    Data _data{};
+    size_t _head { 0 };
+    size_t _size { 0 };
+};
+
+namespace internal {
+
+Buffer buffer;
+auto cursor = buffer.begin();
+bool overflow { false };
+
+Output output;
+
+String topic;
+
+Stream* port;
+driver::uart::Type type;
+
+} // namespace internal
 
 // Client shares the internal payload buffer for the whole 'connection', so it is possible
 // to lose data here when network is either too slow or the network stack did not (yet)
 // have time to send the previously buffered data.
-void send(String data) {
-    mqttSendRaw(
-        mqttTopic(MQTT_TOPIC_UARTIN).c_str(),
-        data.c_str(), false, 0);
+void send(Span span, bool encode) {
+    if (!span.size()) {
+        return;
+    }
+
+    // frame can be larger than our buffer when it is sent directly from the RX buffer
+    if (encode) {
+        if (span.size() > build::BufferSize) {
+            DEBUG_MSG_P(PSTR("[UART_MQTT] Discarding %u bytes frame\n"), span.size());
+            return;
+        }
+
+        Serialized out;
+
+        const auto length = hexEncode(
+            span.data(), span.size(),
+            out.data(), out.size());
+        if (length) {
+            mqttSendRaw(internal::topic.c_str(),
+                out.data(), length - 1, false, 0);
+        }
+
+        return;
+    }
+
+    mqttSendRaw(internal::topic.c_str(),
+        reinterpret_cast<const char*>(span.data()), span.size(), false, 0);
 }
 
-void send(Span span, bool encode) {
-    send(serialize(span, encode));
+// Send every complete frame, return the number of bytes used (incl. termination)
+size_t send_frames(Span span, uint8_t termination, bool encode) {
+    auto begin = span.begin();
+    for (;;) {
+        const auto it = std::find(begin, span.end(), termination);
+        if (it == span.end()) {
+            break;
+        }
+
+        send(Span(begin, it), encode);
+        begin = it + 1;
+    }
+
+    return std::distance(span.begin(), begin);
+}
+
+void buffer_reset() {
+    internal::cursor = internal::buffer.begin();
+}
+
+Span buffered() {
+    return Span(internal::buffer.data(), internal::cursor);
+}
+
+// Incomplete frame is kept in the buffer. Not fitting into it discards everything buffered so far,
+// as well as the rest of the frame until the next termination byte (see `skip_overflow()`)
+void buffer_append(Span span) {
+    const size_t capacity = std::distance(internal::cursor, internal::buffer.end());
+    if (span.size() >= capacity) {
+        internal::overflow = true;
+        buffer_reset();
+        return;
+    }
+
+    internal::cursor = std::copy(span.begin(), span.end(), internal::cursor);
+}
+
+// Return the number of bytes that are still part of the discarded frame
+size_t skip_overflow(Span span, uint8_t termination) {
+    const auto it = std::find(span.begin(), span.end(), termination);
+    if (it == span.end()) {
+        return span.size();
+    }
+
+    internal::overflow = false;
+    return std::distance(span.begin(), it) + 1;
 }
 
 void read_no_termination(Stream& stream, bool encode) {
     const size_t capacity = std::distance(internal::cursor, internal::buffer.end());
-    const size_t available = stream.available();
-    if (available && capacity) {
+    const int available = stream.available();
+    if ((available > 0) && capacity) {
         internal::cursor += stream.readBytes(
             internal::cursor,
-            std::min(capacity, available));
+            std::min(capacity, static_cast<size_t>(available)));
     }
 
     using Clock = time::CoreClock;
@@ -151,11 +269,8 @@ void read_no_termination(Stream& stream, bool encode) {
             && (now - last > build::ReadInterval)))
     {
         last = now;
-        if (mqttConnected()) {
-            send({internal::buffer.data(), internal::cursor}, encode);
-        }
-
-        internal::cursor = internal::buffer.begin();
+        send(buffered(), encode);
+        buffer_reset();
     }
 }
 
@@ -165,102 +280,214 @@ void read(Stream& stream, uint8_t termination, bool encode) {
         return;
     }
 
-    const size_t available = stream.available();
     const size_t capacity = std::distance(internal::cursor, internal::buffer.end());
-    if (available && capacity) {
-        const auto length = std::min(capacity, available);
-        internal::cursor += stream.readBytes(internal::cursor, length);
-            
-        if (!mqttConnected()) {
-            internal::cursor = internal::buffer.begin();
-            return;
-        }
+    const int available = stream.available();
+    if ((available > 0) && capacity) {
+        internal::cursor += stream.readBytes(
+            internal::cursor,
+            std::min(capacity, static_cast<size_t>(available)));
 
         const auto begin = internal::buffer.begin();
-        const auto cursor = internal::cursor;
 
-        do {
-            auto it = std::find(begin, cursor, termination);
-            if (it == cursor) {
-                break;
-            }
+        size_t used = 0;
+        if (internal::overflow) {
+            used = skip_overflow(buffered(), termination);
+        }
 
-            // `std::find` points to `termination`
-            const auto data = Span(begin, it - 1);
-            if (data.size()) {
-                send(data, encode);
-            }
-            
-            ++it;
-            internal::cursor = std::copy(it, cursor, begin);
-        } while (internal::cursor != begin);
+        used += send_frames(Span(begin + used, internal::cursor), termination, encode);
+        internal::cursor = std::copy(begin + used, internal::cursor, begin);
     }
 
-    if (!capacity) {
-        internal::cursor = internal::buffer.begin();
-        return;
+    if (internal::cursor == internal::buffer.end()) {
+        internal::overflow = true;
+        buffer_reset();
     }
 }
 
-// Only handle writes in the main loop(), both HW and SW serial streams may block
-void enqueue(String data) {
-    internal::queue.emplace(std::move(data));
+#if defined(ARDUINO_ESP8266_RELEASE_2_7_2) \
+    || defined(ARDUINO_ESP8266_RELEASE_2_7_3) \
+    || defined(ARDUINO_ESP8266_RELEASE_2_7_4)
+bool peek_supported(Stream&) {
+    return false;
 }
 
-void write(Print& print, uint8_t termination, bool decode) {
+void peek_read(Stream&, uint8_t, bool) {
+}
+#else
+// Recent Core versions allow to access RX buffer directly, frames are sent without copying them anywhere
+// (unless encoding is needed). Note that the buffer is a ring, so only part of it may be available at once.
+bool peek_supported(Stream& stream) {
+    return stream.hasPeekBufferAPI();
+}
+
+Span peek(Stream& stream) {
+    return Span(
+        reinterpret_cast<const uint8_t*>(stream.peekBuffer()),
+        stream.peekAvailable());
+}
+
+// Data is kept in the RX buffer until either the interval passes or there is enough of it for a single payload
+void peek_read_no_termination(Stream& stream, bool encode) {
     using Clock = time::CoreClock;
-    
-    const auto start = Clock::now();
-    while (!internal::queue.empty() && (Clock::now() - start < build::WriteWindow)) {
-        const auto& front = internal::queue.front();
-        if (decode) {
-            Buffer decoded;
-            const auto size = hexDecode(
-                front.begin(), front.length(),
-                decoded.data(), decoded.size());
-
-            if (size) {
-                print.write(decoded.data(), size);
-            }
+    static auto last = Clock::now();
+
+    const auto now = Clock::now();
+    const bool flush = (now - last > build::ReadInterval);
+
+    for (;;) {
+        const int available = stream.available();
+        if (available <= 0) {
+            break;
+        }
+
+        if (!flush && (static_cast<size_t>(available) < build::BufferSize)) {
+            break;
+        }
+
+        last = now;
+
+        const auto span = peek(stream);
+        const auto size = std::min(span.size(), build::BufferSize);
+
+        send(Span(span.data(), size), encode);
+        stream.peekConsume(size);
+    }
+}
+
+void peek_read(Stream& stream, uint8_t termination, bool encode) {
+    if (termination == 0) {
+        peek_read_no_termination(stream, encode);
+        return;
+    }
+
+    for (;;) {
+        const auto span = peek(stream);
+        if (!span.size()) {
+            break;
+        }
 
-            if (size && termination) {
-                print.write(termination);
+        if (internal::overflow) {
+            stream.peekConsume(skip_overflow(span, termination));
+            continue;
+        }
+
+        // beginning of the frame is already in the buffer, can only send it from there
+        if (internal::cursor != internal::buffer.begin()) {
+            const auto it = std::find(span.begin(), span.end(), termination);
+            buffer_append(Span(span.begin(), it));
+
+            if (it == span.end()) {
+                stream.peekConsume(span.size());
+                continue;
             }
-        } else {
-            print.write(front.begin(), front.length());
-            if (termination) {
-                print.write(termination);
+
+            if (!internal::overflow) {
+                send(buffered(), encode);
             }
+
+            internal::overflow = false;
+            buffer_reset();
+
+            stream.peekConsume(std::distance(span.begin(), it) + 1);
+            continue;
         }
 
-        internal::queue.pop();
+        const auto used = send_frames(span, termination, encode);
+        stream.peekConsume(used);
+
+        // incomplete frame stays in the RX buffer, unless it reached the end of the ring
+        // (or it is too large to ever be sent). only then, it is moved into our buffer
+        const auto left = span.size() - used;
+        if (!left) {
+            continue;
+        }
+
+        if ((left < build::BufferSize)
+            && (static_cast<size_t>(stream.available()) == left))
+        {
+            break;
+        }
+
+        buffer_append(Span(span.begin() + used, span.end()));
+        stream.peekConsume(left);
     }
 }
+#endif
 
+void discard(Stream& stream) {
+    internal::overflow = false;
+    buffer_reset();
+    while (stream.available() > 0) {
+        stream.read();
+    }
+}
+
+// Only handle writes in the main loop(), both HW and SW serial streams may block.
+void enqueue(StringView payload, uint8_t termination, bool decode) {
+    if (!internal::output.push(payload, termination, decode)) {
+        DEBUG_MSG_P(PSTR("[UART_MQTT] Discarding %u bytes payload\n"), payload.length());
+    }
+}
+
+// HW serial only has the TX FIFO and would block until there is space for the rest of the data.
+// SW serial always blocks, so at least limit the amount of data written in a single loop()
+size_t writable(Print& print) {
+    if (internal::type == driver::uart::Type::Software) {
+        return build::BufferSize;
+    }
+
+    const int available = print.availableForWrite();
+    if (available > 0) {
+        return available;
+    }
+
+    return 0;
+}
+
+void write(Print& print) {
+    auto available = writable(print);
+    while (available && !internal::output.empty()) {
+        const auto span = internal::output.front(available);
+
+        const auto written = print.write(span.data(), span.size());
+        internal::output.pop(written);
+        if (written != span.size()) {
+            break;
+        }
+
+        available -= written;
+    }
+}
 
 void mqtt_callback(unsigned int type, StringView topic, StringView payload) {
     static constexpr char Subscription[] = MQTT_TOPIC_UARTOUT;
 
     switch (type) {
     case MQTT_CONNECT_EVENT:
+        internal::topic = mqttTopic(MQTT_TOPIC_UARTIN);
         mqttSubscribe(Subscription);
         break;
     case MQTT_MESSAGE_EVENT:
         const auto t = mqttMagnitude(topic);
         if (t.equals(Subscription)) {
-            enqueue(payload.toString());
+            enqueue(payload, build::TerminateOut, build::Decode);
         }
         break;
     }
 }
 
 void loop() {
-    read(*internal::port,
-        build::TerminateIn,
-        build::Encode);
-    write(*internal::port,
-        build::TerminateOut,
-        build::Decode);
+    auto& port = *internal::port;
+
+    if (!mqttConnected()) {
+        discard(port);
+    } else if (peek_supported(port)) {
+        peek_read(port, build::TerminateIn, build::Encode);
+    } else {
+        read(port, build::TerminateIn, build::Encode);
+    }
+
+    write(port);
 }
 
 void setup() {
@@ -270,9 +497,10 @@ void setup() {
     }
 
     internal::port = port->stream;
+    internal::type = port->type;
 
     mqttRegister(mqtt_callback);
-    espurnaRegisterLoop(loop);
+    espurnaRegisterLoop(loop, STRING_VIEW("uartmqtt"));
 }
 
 } // namespace
@@ -210,13 +210,13 @@ size_t RequestPrint::write(const uint8_t* data, size_t size) {
 namespace {
 
 PROGMEM_STRING(LastModified, __DATE__ " " __TIME__ " GMT");
-static constexpr size_t WebConfigBufferMax { 4096 };
 
 // server instance can't (yet) be static, port is the ctor argument :/
 AsyncWebServer* _server;
 
-// XXX shared between requests!
-std::vector<uint8_t>* _webConfigBuffer;
+// XXX shared between requests! new upload cancels the one in progress
+std::unique_ptr<espurna::settings::Restore> _web_config_restore;
+AsyncWebServerRequest* _web_config_request { nullptr };
 bool _webConfigSuccess = false;
 
 // TODO server may not cache the full body
@@ -318,56 +318,141 @@ void _onDiscover(AsyncWebServerRequest *request) {
     request->send(response);
 }
 
-void _onGetConfig(AsyncWebServerRequest *request) {
-    if (!_authenticateRequest(request)) {
-        _webRequestAuth(request);
-        return;
-    }
+// Backup is generated on demand while the response is being sent, one key-value pair at a time.
+// Only the list of keys is gathered up front, values are read when the pair is about to be sent.
+// Settings modified in the meantime are either skipped (when removed) or sent with the updated value.
+class ConfigGenerator {
+public:
+    ConfigGenerator() :
+        _keys(espurna::settings::keys())
+    {}
+
+    size_t fill(uint8_t* buffer, size_t size) {
+        size_t out = 0;
+
+        while (out < size) {
+            if (_offset >= _pending.length()) {
+                if (!_prepare()) {
+                    break;
+                }
+            }
 
-    auto out = std::make_shared<String>();
-    out->reserve(TCP_MSS);
+            const auto chunk = std::min(size - out, _pending.length() - _offset);
+            const auto* ptr = _pending.c_str() + _offset;
+            std::copy(ptr, ptr + chunk, buffer + out);
 
-    const auto app = buildApp();
+            _offset += chunk;
+            out += chunk;
+        }
 
-    char buffer[256];
-    int prefix_len = snprintf_P(buffer, sizeof(buffer),
-            PSTR("{\n\"app\": \"%s\",\n\"version\": \"%s\",\n\"backup\": \"1\""),
-            app.name.c_str(), app.version.c_str());
-    if (prefix_len <= 0) {
-        request->send(500);
-        return;
+        return out;
     }
-    out->concat(buffer, prefix_len);
 
-    espurna::settings::foreach([&](espurna::settings::kvs_type::KeyValueResult&& kv) {
-        auto key = kv.key.read();
-        auto value = kv.value.read();
+private:
+    enum class State {
+        Header,
+        Pairs,
+        Footer,
+        Done,
+    };
 
-        int len = snprintf_P(buffer, sizeof(buffer), PSTR("\"%s\": \"%s\""), key.c_str(), value.c_str());
-        if (len > 0) {
-            *out += ",\n";
-            out->concat(buffer, len);
+    void _escape(const String& value) {
+        for (auto c : value) {
+            switch (c) {
+            case '"':
+            case '\\':
+                _pending += '\\';
+                _pending += c;
+                break;
+            default:
+                if (static_cast<uint8_t>(c) < 0x20) {
+                    char buffer[7];
+                    snprintf_P(buffer, sizeof(buffer), PSTR("\\u%04x"), static_cast<uint8_t>(c));
+                    _pending += buffer;
+                    break;
+                }
+                _pending += c;
+                break;
+            }
         }
-    });
-    *out += "\n}";
+    }
 
-    AsyncWebServerResponse* response = request->beginChunkedResponse(
-        F("application/json"),
-        [out](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
-            auto len = out->length();
-            if (index == len) {
-                return 0;
-            }
+    bool _prepare() {
+        _offset = 0;
+        _pending = "";
+
+        switch (_state) {
+        case State::Header: {
+            const auto app = buildApp();
+
+            _pending += F("{\n\"app\": \"");
+            _escape(app.name.toString());
+            _pending += F("\",\n\"version\": \"");
+            _escape(app.version.toString());
+            _pending += F("\",\n\"backup\": \"1\"");
+
+            _state = State::Pairs;
+            return true;
+        }
+
+        case State::Pairs:
+            while (_index < _keys.size()) {
+                auto key = std::move(_keys[_index++]);
 
-            auto* ptr = out->c_str() + index;
-            size_t have = std::min(len - index, maxLen);
-            if (have) {
-                std::copy(ptr, ptr + have, buffer);
+                auto value = espurna::settings::get(key);
+                if (!value) {
+                    continue;
+                }
+
+                _pending += F(",\n\"");
+                _escape(key);
+                _pending += F("\": \"");
+                _escape(value.ref());
+                _pending += '"';
+                return true;
             }
 
-            return have;
+            _keys.clear();
+            _state = State::Footer;
+            return _prepare();
+
+        case State::Footer:
+            _pending += F("\n}");
+            _state = State::Done;
+            return true;
+
+        case State::Done:
+            break;
+        }
+
+        return false;
+    }
+
+    espurna::settings::Keys _keys;
+    size_t _index { 0 };
+
+    State _state { State::Header };
+
+    String _pending;
+    size_t _offset { 0 };
+};
+
+void _onGetConfig(AsyncWebServerRequest *request) {
+    if (!_authenticateRequest(request)) {
+        _webRequestAuth(request);
+        return;
+    }
+
+    auto generator = std::make_shared<ConfigGenerator>();
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        F("application/json"),
+        [generator](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+            return generator->fill(buffer, maxLen);
         });
 
+    char buffer[256];
+
     auto get_timestamp = []() -> String {
 #if NTP_SUPPORT
         if (ntpSynced()) {
@@ -408,40 +493,34 @@ void _onPostConfigFile(AsyncWebServerRequest *request, String, size_t index, uin
         return;
     }
 
-    // No buffer
-    if (final && (index == 0)) {
-        _webConfigSuccess = settingsRestoreJson((char*) data);
-        return;
-    }
-
-    // Buffer start => reset
-    if (index == 0) if (_webConfigBuffer) delete _webConfigBuffer;
-
-    // init buffer if it doesn't exist
-    if (!_webConfigBuffer) {
-        _webConfigBuffer = new std::vector<uint8_t>();
+    // Settings are applied while the body is still arriving, nothing is buffered besides the current kv pair
+    // (and the storage is reverted when the request goes away before the upload is finished)
+    if (index == 0) {
         _webConfigSuccess = false;
+        _web_config_restore.reset();
+        _web_config_restore = std::make_unique<espurna::settings::Restore>();
+        _web_config_request = request;
+
+        request->onDisconnect([request]() {
+            if (_web_config_request == request) {
+                _web_config_restore.reset();
+                _web_config_request = nullptr;
+            }
+        });
     }
 
-    // Copy
-    if (len > 0) {
-        if ((_webConfigBuffer->size() + len) > std::min(WebConfigBufferMax, systemFreeHeap() - sizeof(std::vector<uint8_t>))) {
-            delete _webConfigBuffer;
-            _webConfigBuffer = nullptr;
-            request->send(500);
-            return;
-        }
-        _webConfigBuffer->reserve(_webConfigBuffer->size() + len);
-        _webConfigBuffer->insert(_webConfigBuffer->end(), data, data + len);
+    if (!_web_config_restore || (_web_config_request != request)) {
+        return;
     }
 
-    // Ending
-    if (final) {
-
-        _webConfigBuffer->push_back(0);
-        _webConfigSuccess = settingsRestoreJson((char*) _webConfigBuffer->data());
-        delete _webConfigBuffer;
+    auto result = _web_config_restore->feed(data, len);
+    if (result && final) {
+        _webConfigSuccess = _web_config_restore->finish();
+    }
 
+    if (!result || final) {
+        _web_config_restore.reset();
+        _web_config_request = nullptr;
     }
 
 }
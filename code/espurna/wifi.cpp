@@ -13,6 +13,7 @@ Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 #include "espurna.h"
 
 #include "wifi.h"
+#include "rtcmem.h"
 
 #include <IPAddress.h>
 #include <AddrList.h>
@@ -23,6 +24,11 @@ Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 #include <queue>
 #include <vector>
 
+#if API_SUPPORT
+#include "api.h"
+#include "mqtt.h"
+#endif
+
 #if WEB_SUPPORT
 #include "ws.h"
 #endif
@@ -1585,6 +1591,16 @@ bool persist { false };
 using TaskPtr = std::unique_ptr<Task>;
 TaskPtr task;
 
+// direct connection to the cached network, see sta::fast
+bool fast { false };
+
+// time it took from the connection request until the network is up
+bool measuring { false };
+time::CoreClock::time_point started;
+
+duration::Milliseconds elapsed { 0 };
+bool elapsedFast { false };
+
 } // namespace internal
 
 void persist(bool value) {
@@ -1601,14 +1617,16 @@ void stop() {
     internal::preparedNetworks.clear();
     internal::timer.stop();
     internal::task.reset();
+    internal::fast = false;
 }
 
 bool start(String&& hostname) {
     if (!internal::task) {
+        // direct connection is only attempted once, scan is more useful than retrying
         internal::task = std::make_unique<internal::Task>(
             std::move(hostname),
             std::move(internal::preparedNetworks),
-            build::ConnectionRetries);
+            internal::fast ? 0 : build::ConnectionRetries);
         internal::timer.stop();
         return true;
     }
@@ -1697,6 +1715,35 @@ void prepare(Networks&& networks) {
     std::swap(internal::preparedNetworks, networks);
 }
 
+bool fast() {
+    return internal::fast;
+}
+
+void measure() {
+    if (!internal::measuring) {
+        internal::measuring = true;
+        internal::started = time::CoreClock::now();
+    }
+}
+
+void measured(bool success) {
+    if (internal::measuring && success) {
+        internal::elapsed = time::CoreClock::now() - internal::started;
+        internal::elapsedFast = internal::fast;
+    }
+
+    internal::measuring = false;
+    internal::fast = false;
+}
+
+duration::Milliseconds elapsed() {
+    return internal::elapsed;
+}
+
+bool elapsedFast() {
+    return internal::elapsedFast;
+}
+
 bool prepared() {
     return internal::preparedNetworks.size() > 0;
 }
@@ -1922,6 +1969,187 @@ bool scanProcessResults() {
 
 } // namespace connection
 
+// Last successful connection is kept in the RTC memory, so the next boot (e.g. after deep sleep)
+// can skip the scan and connect to the same BSSID and channel right away.
+// When that fails, cached values are discarded and the usual scan & connect routine takes over.
+namespace fast {
+namespace build {
+
+constexpr bool enabled() {
+    return 1 == WIFI_FAST_CONNECT;
+}
+
+constexpr bool ip() {
+    return 1 == WIFI_FAST_CONNECT_IP;
+}
+
+} // namespace build
+
+namespace settings {
+namespace keys {
+
+PROGMEM_STRING(Enabled, "wifiFast");
+PROGMEM_STRING(Ip, "wifiFastIp");
+
+} // namespace keys
+
+bool enabled() {
+    return getSetting(keys::Enabled, build::enabled());
+}
+
+bool ip() {
+    return getSetting(keys::Ip, build::ip());
+}
+
+namespace query {
+
+EXACT_VALUE(enabled, settings::enabled)
+EXACT_VALUE(ip, settings::ip)
+
+} // namespace query
+} // namespace settings
+
+namespace internal {
+
+// only used to tell whether cached BSSID still belongs to one of the configured networks
+uint32_t hash(const String& value) {
+    uint32_t out { 2166136261ul };
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        out = (out ^ static_cast<uint8_t>(*it)) * 16777619ul;
+    }
+
+    return out;
+}
+
+Mac bssid() {
+    const uint32_t low = Rtcmem->wifi.bssid[0];
+    const uint32_t high = Rtcmem->wifi.bssid[1];
+
+    return Mac{{
+        static_cast<uint8_t>(low),
+        static_cast<uint8_t>(low >> 8),
+        static_cast<uint8_t>(low >> 16),
+        static_cast<uint8_t>(low >> 24),
+        static_cast<uint8_t>(high),
+        static_cast<uint8_t>(high >> 8)}};
+}
+
+IpSettings ipSettings() {
+    const uint32_t ip = Rtcmem->wifi.ip;
+    const uint32_t netmask = Rtcmem->wifi.netmask;
+    const uint32_t gateway = Rtcmem->wifi.gateway;
+    const uint32_t dns = Rtcmem->wifi.dns;
+
+    return IpSettings{
+        IPAddress(ip),
+        IPAddress(netmask),
+        IPAddress(gateway),
+        IPAddress(dns)};
+}
+
+void clearIp() {
+    Rtcmem->wifi.ip = 0;
+    Rtcmem->wifi.netmask = 0;
+    Rtcmem->wifi.gateway = 0;
+    Rtcmem->wifi.dns = 0;
+}
+
+// whether the current connection is using the cached lease instead of the DHCP
+bool lease { false };
+
+} // namespace internal
+
+bool available() {
+    return rtcmemStatus() && (Rtcmem->wifi.channel != 0);
+}
+
+void reset() {
+    Rtcmem->wifi.bssid[0] = 0;
+    Rtcmem->wifi.bssid[1] = 0;
+    Rtcmem->wifi.channel = 0;
+    Rtcmem->wifi.ssid = 0;
+    internal::clearIp();
+    internal::lease = false;
+}
+
+void store() {
+    station_config config{};
+    wifi_station_get_config(&config);
+
+    const auto bssid = convertBssid(config);
+    const uint32_t low = static_cast<uint32_t>(bssid[0])
+        | (static_cast<uint32_t>(bssid[1]) << 8)
+        | (static_cast<uint32_t>(bssid[2]) << 16)
+        | (static_cast<uint32_t>(bssid[3]) << 24);
+    const uint32_t high = static_cast<uint32_t>(bssid[4])
+        | (static_cast<uint32_t>(bssid[5]) << 8);
+    const uint32_t ssid = internal::hash(convertSsid(config));
+
+    const bool same = (Rtcmem->wifi.bssid[0] == low)
+        && (Rtcmem->wifi.bssid[1] == high)
+        && (Rtcmem->wifi.ssid == ssid);
+
+    Rtcmem->wifi.bssid[0] = low;
+    Rtcmem->wifi.bssid[1] = high;
+    Rtcmem->wifi.channel = channel();
+    Rtcmem->wifi.ssid = ssid;
+
+    // DHCP is not running when the cached lease was used. Keep it as-is, unless the network is different now
+    ip_info info{};
+    if (wifi_station_dhcpc_status() == DHCP_STARTED) {
+        if (wifi_get_ip_info(STATION_IF, &info) && info.ip.addr) {
+            Rtcmem->wifi.ip = info.ip.addr;
+            Rtcmem->wifi.netmask = info.netmask.addr;
+            Rtcmem->wifi.gateway = info.gw.addr;
+            Rtcmem->wifi.dns = IPAddress(dns_getserver(0)).v4();
+        } else {
+            internal::clearIp();
+        }
+    } else if (!internal::lease || !same) {
+        internal::clearIp();
+    }
+
+    internal::lease = false;
+}
+
+// Replace prepared networks with the cached one, as long as its SSID is still configured
+bool prepare() {
+    connection::internal::fast = false;
+    internal::lease = false;
+    if (!settings::enabled() || !available()) {
+        return false;
+    }
+
+    auto& networks = connection::internal::preparedNetworks;
+
+    const uint32_t ssid = Rtcmem->wifi.ssid;
+    auto it = std::find_if(networks.begin(), networks.end(),
+        [&](const Network& network) {
+            return internal::hash(network.ssid()) == ssid;
+        });
+
+    if (it == networks.end()) {
+        return false;
+    }
+
+    const uint32_t ip = Rtcmem->wifi.ip;
+    internal::lease = ip && (*it).dhcp() && settings::ip();
+
+    auto network = internal::lease
+        ? Network(String((*it).ssid()), String((*it).passphrase()), internal::ipSettings())
+        : Network(*it);
+
+    Networks out;
+    out.emplace_back(std::move(network), internal::bssid(), Rtcmem->wifi.channel);
+    std::swap(networks, out);
+
+    connection::internal::fast = true;
+
+    return true;
+}
+
+} // namespace fast
+
 void configure() {
     auto enabled = (StaMode::Enabled == sta::settings::mode());
     connection::persist(enabled);
@@ -2244,7 +2472,7 @@ void configure() {
 namespace settings {
 namespace query {
 
-static constexpr std::array<espurna::settings::query::Setting, 11> Settings PROGMEM {
+static constexpr std::array<espurna::settings::query::Setting, 13> Settings PROGMEM {
     {{ap::settings::keys::Ssid, ap::settings::ssid},
      {ap::settings::keys::Passphrase, ap::settings::passphrase},
      {ap::settings::keys::Captive, ap::settings::query::internal::captive},
@@ -2253,6 +2481,8 @@ static constexpr std::array<espurna::settings::query::Setting, 11> Settings PROG
      {sta::settings::keys::Mode, sta::settings::query::internal::mode},
      {sta::scan::settings::keys::Enabled, sta::scan::settings::query::enabled},
      {sta::scan::periodic::settings::keys::Threshold, sta::scan::periodic::settings::query::threshold},
+     {sta::fast::settings::keys::Enabled, sta::fast::settings::query::enabled},
+     {sta::fast::settings::keys::Ip, sta::fast::settings::query::ip},
      {settings::keys::TxPower, query::internal::txPower},
      {settings::keys::Sleep, query::internal::sleep},
      {settings::keys::Boot, query::internal::bootMode},
@@ -2430,6 +2660,9 @@ void wifi(::terminal::CommandContext&& ctx) {
             ctx.output.printf_P(PSTR("STA: bssid %s rssi %hhd channel %hhu ssid \"%s\"\n"),
                 debug::mac(network.bssid).c_str(),
                 network.rssi, network.channel, network.ssid.c_str());
+            ctx.output.printf_P(PSTR("connected in %u (ms)%s\n"),
+                sta::connection::elapsed().count(),
+                sta::connection::elapsedFast() ? " without scanning" : "");
         } else {
             ctx.output.printf_P(PSTR("STA: %s\n"),
                     sta::connecting() ? "connecting" : "disconnected");
@@ -2856,7 +3089,14 @@ void loop() {
             break;
         }
 
+        sta::connection::measure();
         sta::scan::periodic::stop();
+
+        if (sta::fast::prepare()) {
+            state = State::Connect;
+            break;
+        }
+
         if (sta::scan::settings::enabled()) {
             if (sta::scanning()) {
                 break;
@@ -2890,6 +3130,7 @@ void loop() {
         break;
 
     case State::Fallback:
+        sta::connection::measured(false);
         state = State::Idle;
         sta::connection::schedule_new();
         if (ApMode::Fallback == ap::settings::mode()) {
@@ -2954,6 +3195,14 @@ void loop() {
     // Current logic closely follows the SDK connection routine with reconnect enabled,
     // and will retry the same network multiple times before giving up.
     case State::Timeout:
+        if (sta::connection::fast()) {
+            DEBUG_MSG_P(PSTR("[WIFI] Direct connection failed, scanning\n"));
+            sta::fast::reset();
+            sta::connection::stop();
+            state = State::Init;
+            break;
+        }
+
         if (sta::connecting() && sta::connection::next()) {
             state = State::Idle;
             sta::connection::schedule_next();
@@ -2965,7 +3214,12 @@ void loop() {
         break;
 
     case State::Connected:
+        sta::connection::measured(true);
         sta::connection::stop();
+        sta::fast::store();
+        DEBUG_MSG_P(PSTR("[WIFI] Connected in %u (ms)%s\n"),
+            sta::connection::elapsed().count(),
+            sta::connection::elapsedFast() ? " without scanning" : "");
         if (sta::scan::settings::enabled()) {
             sta::scan::periodic::start();
         }
@@ -3051,7 +3305,7 @@ void setup() {
     terminal::init();
 #endif
 
-    espurnaRegisterLoop(internal::loop);
+    espurnaRegisterLoop(internal::loop, STRING_VIEW("wifi"));
     espurnaRegisterReload(settings::configure);
 }
 
@@ -3083,6 +3337,10 @@ IPAddress wifiStaIp() {
     return {};
 }
 
+espurna::duration::Milliseconds wifiConnectTime() {
+    return espurna::wifi::sta::connection::elapsed();
+}
+
 String wifiStaSsid() {
     if (espurna::wifi::opmode() & espurna::wifi::OpmodeSta) {
         auto current = espurna::wifi::sta::current();
@@ -3148,6 +3406,18 @@ IPAddress wifiApIp() {
     return espurna::wifi::ap::ip();
 }
 
+#if API_SUPPORT
+void wifiApiSetup() {
+    apiRegister(F(MQTT_TOPIC_CONNECT_TIME),
+        [](ApiRequest& request) {
+            request.send(String(wifiConnectTime().count(), 10));
+            return true;
+        },
+        nullptr
+    );
+}
+#endif
+
 void wifiSetup() {
     espurna::wifi::setup();
 }
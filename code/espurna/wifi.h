@@ -10,6 +10,8 @@ Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
 
 #include <Arduino.h>
 
+#include "types.h"
+
 #include <lwip/init.h>
 #if LWIP_VERSION_MAJOR == 1
 #include <netif/etharp.h>
@@ -92,6 +94,9 @@ IPAddress wifiApIp();
 String wifiStaSsid();
 IPAddress wifiStaIp();
 
+// Time it took to connect to the current network, from the connection request until the network is up
+espurna::duration::Milliseconds wifiConnectTime();
+
 // Request to change the current STA / AP status
 // Current state persists until reset or configuration reload
 void wifiStartAp();
@@ -112,4 +117,5 @@ void wifiTurnOn();
 void wifiApCheck();
 
 void wifiRegister(espurna::wifi::EventCallback);
+void wifiApiSetup();
 void wifiSetup();
@@ -913,7 +913,7 @@ void wsSetup() {
         .onConnected(_wsOnConnected)
         .onKeyCheck(_wsOnKeyCheck);
 
-    espurnaRegisterLoop(_wsLoop);
+    espurnaRegisterLoop(_wsLoop, STRING_VIEW("ws"));
 }
 
 #endif // WEB_SUPPORT
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+# coding=utf-8
+#
+# Delta OTA patch generator, applied by the espurna/ota_delta.h
+# Based on bsdiff by Colin Percival, http://www.daemonology.net/bsdiff/
+#
+# Copyright (C) 2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Old image must be exactly the same .bin that is currently running on the device,
+# since the patch is only applied when size and md5 match (see `md5:` line in the `info` command output)
+#
+# $ python scripts/ota_delta.py old.bin new.bin update.delta
+# $ curl -F "upgrade=@update.delta" http://<device>/upgrade?apikey=...
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"EDLT"
+
+# Original bsdiff uses suffix array to find the longest match. Here, it is a list of candidates
+# from the index of short sequences of the old image, plus the position right after the previous match
+GRAM = 8
+CANDIDATES = 16
+
+# Default window of the device decompressor, see OTA_INFLATE_WINDOW_BITS
+WINDOW_BITS = 13
+
+
+def match_length(old, old_pos, new, new_pos):
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    if limit <= 0:
+        return 0
+
+    # binary search using slice comparison, which is a lot faster than comparing byte-by-byte
+    low = 0
+    high = limit
+    while low < high:
+        mid = (low + high + 1) // 2
+        if old[old_pos : old_pos + mid] == new[new_pos : new_pos + mid]:
+            low = mid
+        else:
+            high = mid - 1
+
+    return low
+
+
+class Index:
+    def __init__(self, old):
+        self.old = old
+        self.index = {}
+        for pos in range(len(old) - GRAM + 1):
+            positions = self.index.setdefault(old[pos : pos + GRAM], [])
+            if len(positions) < CANDIDATES:
+                positions.append(pos)
+
+    def search(self, new, scan, expected):
+        best = 0
+        pos = 0
+        if expected < len(self.old):
+            best = match_length(self.old, expected, new, scan)
+            pos = expected
+
+        for candidate in self.index.get(new[scan : scan + GRAM], ()):
+            length = match_length(self.old, candidate, new, scan)
+            if length > best:
+                best = length
+                pos = candidate
+
+        return best, pos
+
+
+def diff(old, new):
+    index = Index(old)
+
+    oldsize = len(old)
+    newsize = len(new)
+
+    scan = 0
+    length = 0
+    pos = 0
+    lastscan = 0
+    lastpos = 0
+    lastoffset = 0
+
+    while scan < newsize:
+        oldscore = 0
+        scan += length
+        scsc = scan
+        while scan < newsize:
+            length, pos = index.search(new, scan, scan + lastoffset)
+
+            while scsc < scan + length:
+                if (scsc + lastoffset < oldsize) and (old[scsc + lastoffset] == new[scsc]):
+                    oldscore += 1
+                scsc += 1
+
+            if ((length == oldscore) and (length != 0)) or (length > oldscore + 8):
+                break
+
+            if (scan + lastoffset < oldsize) and (old[scan + lastoffset] == new[scan]):
+                oldscore -= 1
+
+            scan += 1
+
+        if (length == oldscore) and (scan != newsize):
+            continue
+
+        s = 0
+        sf = 0
+        lenf = 0
+        i = 0
+        while (lastscan + i < scan) and (lastpos + i < oldsize):
+            if old[lastpos + i] == new[lastscan + i]:
+                s += 1
+            i += 1
+            if s * 2 - i > sf * 2 - lenf:
+                sf = s
+                lenf = i
+
+        lenb = 0
+        if scan < newsize:
+            s = 0
+            sb = 0
+            i = 1
+            while (scan >= lastscan + i) and (pos >= i):
+                if old[pos - i] == new[scan - i]:
+                    s += 1
+                if s * 2 - i > sb * 2 - lenb:
+                    sb = s
+                    lenb = i
+                i += 1
+
+        if lastscan + lenf > scan - lenb:
+            overlap = (lastscan + lenf) - (scan - lenb)
+            s = 0
+            ss = 0
+            lens = 0
+            for i in range(overlap):
+                if new[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i]:
+                    s += 1
+                if new[scan - lenb + i] == old[pos - lenb + i]:
+                    s -= 1
+                if s > ss:
+                    ss = s
+                    lens = i + 1
+
+            lenf += lens - overlap
+            lenb -= lens
+
+        extra = (scan - lenb) - (lastscan + lenf)
+        seek = (pos - lenb) - (lastpos + lenf)
+
+        yield struct.pack("<IIi", lenf, extra, seek)
+        yield bytes(
+            (new[lastscan + i] - old[lastpos + i]) & 0xFF for i in range(lenf)
+        )
+        yield new[lastscan + lenf : lastscan + lenf + extra]
+
+        lastscan = scan - lenb
+        lastpos = pos - lenb
+        lastoffset = pos - scan
+
+
+def patch(old, new):
+    out = bytearray(MAGIC)
+    out += struct.pack("<II", len(old), len(new))
+    out += hashlib.md5(old).digest()
+    out += hashlib.md5(new).digest()
+    for chunk in diff(old, new):
+        out += chunk
+
+    return bytes(out)
+
+
+def compress(data, window_bits):
+    compressor = zlib.compressobj(9, zlib.DEFLATED, window_bits)
+    return compressor.compress(data) + compressor.flush()
+
+
+def parse_args(args):
+    parser = argparse.ArgumentParser(
+        description="Generate delta OTA patch from the currently running and the new firmware image"
+    )
+    parser.add_argument("old", type=argparse.FileType("rb"), help="Currently running .bin")
+    parser.add_argument("new", type=argparse.FileType("rb"), help="New .bin")
+    parser.add_argument("output", type=argparse.FileType("wb"), help="Resulting patch")
+    parser.add_argument(
+        "--window-bits",
+        type=int,
+        default=WINDOW_BITS,
+        help="zlib window size of the device decompressor, as 2^N bytes (default %(default)s)",
+    )
+    parser.add_argument(
+        "--raw", action="store_true", help="Do not compress the resulting patch"
+    )
+
+    return parser.parse_args(args)
+
+
+if __name__ == "__main__":
+    args = parse_args(sys.argv[1:])
+
+    old = args.old.read()
+    new = args.new.read()
+
+    output = patch(old, new)
+    if not args.raw:
+        output = compress(output, args.window_bits)
+
+    args.output.write(output)
+
+    print(
+        "{} -> {} bytes ({:.1f}% of the new image)".format(
+            len(new), len(output), 100.0 * len(output) / len(new)
+        ),
+        file=sys.stderr,
+    )
@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/unitygit-populate"
+  "CMakeFiles/unitygit-populate-complete"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-build"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-configure"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-download"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-install"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-mkdir"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-patch"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-test"
+  "unitygit-populate-prefix/src/unitygit-populate-stamp/unitygit-populate-update"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/unitygit-populate.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,22 @@
+# Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+# file Copyright.txt or https://cmake.org/licensing for details.
+
+cmake_minimum_required(VERSION 3.5)
+
+file(MAKE_DIRECTORY
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-src"
+  "/tmp/_gate_build/_deps/unitygit-build"
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix"
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/tmp"
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/src/unitygit-populate-stamp"
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/src"
+  "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/src/unitygit-populate-stamp"
+)
+
+set(configSubDirs )
+foreach(subDir IN LISTS configSubDirs)
+    file(MAKE_DIRECTORY "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/src/unitygit-populate-stamp/${subDir}")
+endforeach()
+if(cfgdir)
+  file(MAKE_DIRECTORY "/root/repo/code/test/unit/cache/unitygit-v2.5.2-subbuild/unitygit-populate-prefix/src/unitygit-populate-stamp${cfgdir}") # cfgdir has leading slash
+endif()
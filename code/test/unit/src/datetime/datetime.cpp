@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <espurna/datetime.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace espurna::datetime;
+
+namespace {
+
+void set_tz(const char* tz) {
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+void assert_tm(const tm& expected, const tm& value) {
+    TEST_ASSERT_EQUAL(expected.tm_year, value.tm_year);
+    TEST_ASSERT_EQUAL(expected.tm_mon, value.tm_mon);
+    TEST_ASSERT_EQUAL(expected.tm_mday, value.tm_mday);
+    TEST_ASSERT_EQUAL(expected.tm_hour, value.tm_hour);
+    TEST_ASSERT_EQUAL(expected.tm_min, value.tm_min);
+    TEST_ASSERT_EQUAL(expected.tm_sec, value.tm_sec);
+    TEST_ASSERT_EQUAL(expected.tm_wday, value.tm_wday);
+    TEST_ASSERT_EQUAL(expected.tm_yday, value.tm_yday);
+    TEST_ASSERT_EQUAL(expected.tm_isdst, value.tm_isdst);
+}
+
+template <typename T>
+double measure(T&& callback, size_t count) {
+    const auto start = std::chrono::steady_clock::now();
+    callback();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count() / count;
+}
+
+// TZ rules with regular, half-hour and 45 minute offsets, for both hemispheres
+constexpr const char* Zones[] {
+    "UTC0",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "<+0545>-5:45",
+    "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+};
+
+} // namespace
+
+void test_days() {
+    for (int64_t days = -1000000; days < 1000000; ++days) {
+        const auto date = civil_from_days(days);
+        TEST_ASSERT_EQUAL(days, days_from_civil(date.year, date.month, date.day));
+    }
+
+    TEST_ASSERT_EQUAL(0, days_from_civil(1970, 1, 1));
+    TEST_ASSERT_EQUAL(4, weekday_from_days(0));
+    TEST_ASSERT_EQUAL(3, weekday_from_days(-1));
+
+    const auto date = civil_from_days(days_from_civil(2000, 2, 29));
+    TEST_ASSERT_EQUAL(2000, date.year);
+    TEST_ASSERT_EQUAL(2, date.month);
+    TEST_ASSERT_EQUAL(29, date.day);
+}
+
+void test_utc() {
+    set_tz("UTC0");
+
+    std::mt19937_64 rng(1234);
+    for (size_t index = 0; index < 1000000; ++index) {
+        const time_t timestamp = static_cast<int64_t>(rng() % (400ull * 366 * 86400)) - (100ll * 366 * 86400);
+
+        tm expected{};
+        gmtime_r(&timestamp, &expected);
+        assert_tm(expected, utc(timestamp));
+    }
+
+    // every day boundary from 1901 to 2100
+    for (time_t timestamp = -2145916800; timestamp < 4102444800; timestamp += 86400) {
+        for (const time_t shift : {-1, 0, 1}) {
+            const time_t value = timestamp + shift;
+
+            tm expected{};
+            gmtime_r(&value, &expected);
+            assert_tm(expected, utc(value));
+        }
+    }
+}
+
+void test_local() {
+    for (const auto* zone : Zones) {
+        set_tz(zone);
+
+        // both sequential, as it would be used for the current time, and randomly picked timestamps
+        Local local;
+        for (time_t timestamp = 1609459200; timestamp < 1672531200; timestamp += 7 * 60 + 13) {
+            tm expected{};
+            localtime_r(&timestamp, &expected);
+            assert_tm(expected, local(timestamp));
+        }
+
+        std::mt19937 rng(4321);
+        for (size_t index = 0; index < 100000; ++index) {
+            const time_t timestamp = 1609459200 + (rng() % (2 * 366 * 86400));
+
+            tm expected{};
+            localtime_r(&timestamp, &expected);
+            assert_tm(expected, local(timestamp));
+        }
+    }
+}
+
+// Both transitions of the year, every second around them
+void test_transition() {
+    set_tz("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    Local local;
+    for (const time_t transition : {1648342800, 1667091600}) {
+        for (time_t timestamp = transition - 3600; timestamp < transition + 3600; ++timestamp) {
+            tm expected{};
+            localtime_r(&timestamp, &expected);
+            assert_tm(expected, local(timestamp));
+        }
+    }
+}
+
+void test_benchmark() {
+    static constexpr size_t Count { 1000000 };
+    static constexpr time_t Start { 1640995200 };
+
+    set_tz("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    volatile int sink { 0 };
+
+    const auto libc_local = measure([&]() {
+        for (size_t index = 0; index < Count; ++index) {
+            const time_t timestamp = Start + index;
+            tm out{};
+            localtime_r(&timestamp, &out);
+            sink = sink + out.tm_min;
+        }
+    }, Count);
+
+    const auto fast_local = measure([&]() {
+        Local local;
+        for (size_t index = 0; index < Count; ++index) {
+            sink = sink + local(Start + index).tm_min;
+        }
+    }, Count);
+
+    const auto libc_utc = measure([&]() {
+        for (size_t index = 0; index < Count; ++index) {
+            const time_t timestamp = Start + index;
+            tm out{};
+            gmtime_r(&timestamp, &out);
+            sink = sink + out.tm_min;
+        }
+    }, Count);
+
+    const auto fast_utc = measure([&]() {
+        for (size_t index = 0; index < Count; ++index) {
+            sink = sink + utc(Start + index).tm_min;
+        }
+    }, Count);
+
+    char message[128];
+    std::snprintf(message, sizeof(message),
+        "localtime_r %.1fns, Local %.1fns, gmtime_r %.1fns, utc %.1fns",
+        libc_local, fast_local, libc_utc, fast_utc);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(libc_local, fast_local);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_days);
+    RUN_TEST(test_utc);
+    RUN_TEST(test_local);
+    RUN_TEST(test_transition);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
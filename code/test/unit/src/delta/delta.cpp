@@ -0,0 +1,481 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <espurna/ota_delta.h>
+#include <espurna/ota_inflate.h>
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace espurna::ota;
+
+using container = std::vector<uint8_t>;
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// Reference encoder, same algorithm as scripts/ota_delta.py
+// Original bsdiff uses suffix array to find the longest match. Here, it is a list of candidates
+// from the index of short sequences of the old image, plus the position right after the previous match
+// -----------------------------------------------------------------------------
+
+constexpr size_t Gram { 8 };
+constexpr size_t Candidates { 16 };
+
+struct Index {
+    explicit Index(const container& old) :
+        old(old)
+    {
+        for (size_t pos = 0; pos + Gram <= old.size(); ++pos) {
+            auto& positions = map[key(&old[pos])];
+            if (positions.size() < Candidates) {
+                positions.push_back(pos);
+            }
+        }
+    }
+
+    static uint64_t key(const uint8_t* data) {
+        uint64_t out;
+        std::memcpy(&out, data, sizeof(out));
+        return out;
+    }
+
+    size_t match(const container& input, size_t scan, size_t pos) const {
+        size_t len = 0;
+        while ((scan + len < input.size()) && (pos + len < old.size())
+            && (input[scan + len] == old[pos + len]))
+        {
+            ++len;
+        }
+
+        return len;
+    }
+
+    size_t search(const container& input, size_t scan, size_t expected, size_t& pos) const {
+        size_t best = 0;
+        if (expected < old.size()) {
+            best = match(input, scan, expected);
+            pos = expected;
+        }
+
+        if (scan + Gram > input.size()) {
+            return best;
+        }
+
+        auto it = map.find(key(&input[scan]));
+        if (it == map.end()) {
+            return best;
+        }
+
+        for (const auto candidate : (*it).second) {
+            const auto len = match(input, scan, candidate);
+            if (len > best) {
+                best = len;
+                pos = candidate;
+            }
+        }
+
+        return best;
+    }
+
+    const container& old;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> map;
+};
+
+void put32(container& out, uint32_t value) {
+    out.push_back(value & 0xff);
+    out.push_back((value >> 8) & 0xff);
+    out.push_back((value >> 16) & 0xff);
+    out.push_back((value >> 24) & 0xff);
+}
+
+container header(const container& old, const container& input) {
+    container out;
+    put32(out, Delta::Magic);
+    put32(out, old.size());
+    put32(out, input.size());
+    out.insert(out.end(), Delta::HashSize, 0xaa);
+    out.insert(out.end(), Delta::HashSize, 0xbb);
+    return out;
+}
+
+container encode(const container& old, const container& input) {
+    auto out = header(old, input);
+
+    const Index index(old);
+
+    const auto oldsize = static_cast<ssize_t>(old.size());
+    const auto newsize = static_cast<ssize_t>(input.size());
+
+    ssize_t scan = 0;
+    ssize_t len = 0;
+    ssize_t pos = 0;
+    ssize_t lastscan = 0;
+    ssize_t lastpos = 0;
+    ssize_t lastoffset = 0;
+
+    while (scan < newsize) {
+        ssize_t oldscore = 0;
+        ssize_t scsc = scan += len;
+        for (; scan < newsize; ++scan) {
+            size_t found = 0;
+            len = index.search(input, scan, scan + lastoffset, found);
+            pos = found;
+
+            for (; scsc < scan + len; ++scsc) {
+                if ((scsc + lastoffset < oldsize) && (old[scsc + lastoffset] == input[scsc])) {
+                    ++oldscore;
+                }
+            }
+
+            if (((len == oldscore) && (len != 0)) || (len > oldscore + 8)) {
+                break;
+            }
+
+            if ((scan + lastoffset < oldsize) && (old[scan + lastoffset] == input[scan])) {
+                --oldscore;
+            }
+        }
+
+        if ((len == oldscore) && (scan != newsize)) {
+            continue;
+        }
+
+        ssize_t s = 0;
+        ssize_t sf = 0;
+        ssize_t lenf = 0;
+        for (ssize_t i = 0; (lastscan + i < scan) && (lastpos + i < oldsize);) {
+            if (old[lastpos + i] == input[lastscan + i]) {
+                ++s;
+            }
+            ++i;
+            if (s * 2 - i > sf * 2 - lenf) {
+                sf = s;
+                lenf = i;
+            }
+        }
+
+        ssize_t lenb = 0;
+        if (scan < newsize) {
+            ssize_t sb = 0;
+            s = 0;
+            for (ssize_t i = 1; (scan >= lastscan + i) && (pos >= i); ++i) {
+                if (old[pos - i] == input[scan - i]) {
+                    ++s;
+                }
+                if (s * 2 - i > sb * 2 - lenb) {
+                    sb = s;
+                    lenb = i;
+                }
+            }
+        }
+
+        if (lastscan + lenf > scan - lenb) {
+            const auto overlap = (lastscan + lenf) - (scan - lenb);
+            ssize_t ss = 0;
+            ssize_t lens = 0;
+            s = 0;
+            for (ssize_t i = 0; i < overlap; ++i) {
+                if (input[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i]) {
+                    ++s;
+                }
+                if (input[scan - lenb + i] == old[pos - lenb + i]) {
+                    --s;
+                }
+                if (s > ss) {
+                    ss = s;
+                    lens = i + 1;
+                }
+            }
+
+            lenf += lens - overlap;
+            lenb -= lens;
+        }
+
+        const auto extra = (scan - lenb) - (lastscan + lenf);
+        put32(out, lenf);
+        put32(out, extra);
+        put32(out, static_cast<uint32_t>((pos - lenb) - (lastpos + lenf)));
+
+        for (ssize_t i = 0; i < lenf; ++i) {
+            out.push_back(input[lastscan + i] - old[lastpos + i]);
+        }
+
+        out.insert(out.end(),
+            input.begin() + lastscan + lenf,
+            input.begin() + lastscan + lenf + extra);
+
+        lastscan = scan - lenb;
+        lastpos = pos - lenb;
+        lastoffset = pos - scan;
+    }
+
+    return out;
+}
+
+container compress(const container& input, int window_bits) {
+    z_stream stream{};
+    TEST_ASSERT_EQUAL(Z_OK, deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 9, Z_DEFAULT_STRATEGY));
+
+    container out(deflateBound(&stream, input.size()));
+    stream.next_in = const_cast<uint8_t*>(input.data());
+    stream.avail_in = input.size();
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+
+    TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&stream, Z_FINISH));
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return out;
+}
+
+// Something resembling the code, where most of the words are instructions that refer to some other address
+container firmware(std::mt19937& rng, size_t size) {
+    container out;
+    out.reserve(size);
+
+    while (out.size() < size) {
+        const uint32_t value = 0x40200000 | ((rng() % 0x10000) << 2);
+        out.push_back(0x0c | (rng() & 0x30));
+        out.push_back(value & 0xff);
+        out.push_back((value >> 8) & 0xff);
+        out.push_back((value >> 16) & 0xff);
+        if ((rng() % 16) == 0) {
+            const char text[] = "[OTA] Progress";
+            out.insert(out.end(), std::begin(text), std::end(text));
+        }
+    }
+
+    out.resize(size);
+    return out;
+}
+
+// New version of the code. Some functions were added, and everything after them moved a bit.
+// Every reference to the moved code was updated as well
+container rebuild(std::mt19937& rng, const container& old) {
+    container out(old);
+
+    for (size_t change = 0; change < 8; ++change) {
+        const auto at = rng() % out.size();
+        container code(64 + (rng() % 512));
+        for (auto& value : code) {
+            value = rng() & 0xff;
+        }
+        out.insert(out.begin() + at, code.begin(), code.end());
+    }
+
+    for (size_t index = 0; index + 4 <= out.size(); index += 4) {
+        if ((out[index] & 0x0f) == 0x0c) {
+            out[index + 1] += 0x10;
+        }
+    }
+
+    return out;
+}
+
+struct Result {
+    Delta::Status status;
+    Delta::Error error;
+    container output;
+};
+
+Result apply(const container& old, const container& patch, size_t chunk, Delta::Verify verify = nullptr) {
+    Result out;
+
+    Delta delta(
+        [&](size_t offset, uint8_t* data, size_t size) {
+            TEST_ASSERT(offset + size <= old.size());
+            std::memcpy(data, &old[offset], size);
+            return true;
+        },
+        [&](const uint8_t* data, size_t size) {
+            out.output.insert(out.output.end(), data, data + size);
+            return true;
+        },
+        std::move(verify));
+
+    auto status = Delta::Status::Pending;
+    for (size_t offset = 0; (offset < patch.size()) && (status == Delta::Status::Pending); offset += chunk) {
+        status = delta.write(&patch[offset], std::min(chunk, patch.size() - offset));
+    }
+
+    out.status = status;
+    out.error = delta.error();
+
+    return out;
+}
+
+} // namespace
+
+void test_round_trip() {
+    std::mt19937 rng(1234);
+
+    const auto old = firmware(rng, 256 * 1024);
+    const auto input = rebuild(rng, old);
+
+    const auto patch = encode(old, input);
+    const auto result = apply(old, patch, 1460);
+    TEST_ASSERT(Delta::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+
+    const auto full = compress(input, 13);
+    const auto compressed = compress(patch, 13);
+
+    char message[128];
+    std::snprintf(message, sizeof(message), "image %zu (%zu compressed), patch %zu (%zu compressed)",
+        input.size(), full.size(), patch.size(), compressed.size());
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(full.size() / 10, compressed.size());
+}
+
+void test_single_byte() {
+    std::mt19937 rng(4321);
+
+    const auto old = firmware(rng, 16 * 1024);
+    const auto input = rebuild(rng, old);
+
+    const auto result = apply(old, encode(old, input), 1);
+    TEST_ASSERT(Delta::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+}
+
+void test_unrelated() {
+    std::mt19937 rng(5678);
+
+    const auto old = firmware(rng, 16 * 1024);
+    const auto input = firmware(rng, 20 * 1024);
+
+    const auto result = apply(old, encode(old, input), 333);
+    TEST_ASSERT(Delta::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+}
+
+// the way it would be done by the OTA, network data -> inflate -> delta -> output
+void test_inflate() {
+    std::mt19937 rng(8765);
+
+    const auto old = firmware(rng, 64 * 1024);
+    const auto input = rebuild(rng, old);
+    const auto patch = compress(encode(old, input), 13);
+
+    container output;
+
+    Delta delta(
+        [&](size_t offset, uint8_t* data, size_t size) {
+            std::memcpy(data, &old[offset], size);
+            return true;
+        },
+        [&](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        },
+        nullptr);
+
+    Inflate inflate(13,
+        [&](const uint8_t* data, size_t size) {
+            return delta.write(data, size) != Delta::Status::Error;
+        });
+
+    size_t offset = 0;
+    while (offset < patch.size()) {
+        const auto size = std::min<size_t>(1 + (rng() % 1460), patch.size() - offset);
+        TEST_ASSERT(Inflate::Status::Error != inflate.write(&patch[offset], size));
+        offset += size;
+    }
+
+    TEST_ASSERT(Inflate::Status::Done == inflate.status());
+    TEST_ASSERT(Delta::Status::Done == delta.status());
+    TEST_ASSERT(input == output);
+}
+
+void test_verify() {
+    std::mt19937 rng(1111);
+
+    const auto old = firmware(rng, 8 * 1024);
+    const auto input = rebuild(rng, old);
+    const auto patch = encode(old, input);
+
+    Delta::Header header{};
+    auto result = apply(old, patch, 7,
+        [&](const Delta::Header& value) {
+            header = value;
+            return true;
+        });
+    TEST_ASSERT(Delta::Status::Done == result.status);
+    TEST_ASSERT_EQUAL(old.size(), header.old_size);
+    TEST_ASSERT_EQUAL(input.size(), header.new_size);
+    TEST_ASSERT_EQUAL_HEX8(0xaa, header.old_hash[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xbb, header.new_hash[Delta::HashSize - 1]);
+
+    result = apply(old, patch, 7,
+        [&](const Delta::Header&) {
+            return false;
+        });
+    TEST_ASSERT(Delta::Status::Error == result.status);
+    TEST_ASSERT(Delta::Error::Verify == result.error);
+    TEST_ASSERT_EQUAL(0, result.output.size());
+}
+
+void test_invalid() {
+    std::mt19937 rng(2222);
+
+    const auto old = firmware(rng, 8 * 1024);
+    const auto input = rebuild(rng, old);
+
+    // not a patch
+    auto result = apply(old, input, 64);
+    TEST_ASSERT(Delta::Status::Error == result.status);
+    TEST_ASSERT(Delta::Error::Header == result.error);
+
+    // reading outside of the old image
+    auto patch = header(old, input);
+    put32(patch, 16);
+    put32(patch, 0);
+    put32(patch, old.size());
+    patch.insert(patch.end(), 16, 0);
+    put32(patch, 16);
+    put32(patch, 0);
+    put32(patch, 0);
+    patch.insert(patch.end(), 16, 0);
+
+    result = apply(old, patch, 64);
+    TEST_ASSERT(Delta::Status::Error == result.status);
+    TEST_ASSERT(Delta::Error::Control == result.error);
+    TEST_ASSERT_EQUAL(16, result.output.size());
+
+    // writing more than the new image size
+    patch = header(old, input);
+    put32(patch, 0);
+    put32(patch, input.size() + 1);
+    put32(patch, 0);
+
+    result = apply(old, patch, 64);
+    TEST_ASSERT(Delta::Status::Error == result.status);
+    TEST_ASSERT(Delta::Error::Control == result.error);
+
+    // incomplete
+    patch = encode(old, input);
+    patch.resize(patch.size() - 1);
+
+    result = apply(old, patch, 64);
+    TEST_ASSERT(Delta::Status::Pending == result.status);
+    TEST_ASSERT_EQUAL(input.size() - 1, result.output.size());
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_single_byte);
+    RUN_TEST(test_unrelated);
+    RUN_TEST(test_inflate);
+    RUN_TEST(test_verify);
+    RUN_TEST(test_invalid);
+    return UNITY_END();
+}
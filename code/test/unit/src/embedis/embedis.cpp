@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <numeric>
 #include <random>
 
@@ -501,6 +502,55 @@ void test_keys_iterator() {
 
 }
 
+void test_keys_resumable_iterator() {
+
+    TestStorageHandler instance;
+    TestSequentialKvGenerator generator;
+
+    const auto kvs = generator.make(32);
+    for (const auto& kv : kvs) {
+        TEST_ASSERT(instance.kvs.set(kv.first, kv.second));
+    }
+
+    // same order as foreach, one kv at a time
+    size_t index { 0 };
+    uint16_t position { instance.kvs.end() };
+    for (;;) {
+        auto kv = instance.kvs.next(position);
+        if (!kv) {
+            break;
+        }
+
+        TEST_ASSERT(index < kvs.size());
+        TEST_ASSERT_EQUAL_STRING(kvs[index].first.c_str(), kv.key.read().c_str());
+        TEST_ASSERT_EQUAL_STRING(kvs[index].second.c_str(), kv.value.read().c_str());
+
+        // other operations in between should not affect the iteration
+        TEST_ASSERT(static_cast<bool>(instance.kvs.get(kvs[0].first)));
+        ++index;
+    }
+
+    TEST_ASSERT_EQUAL(kvs.size(), index);
+    TEST_ASSERT_FALSE(static_cast<bool>(instance.kvs.next(position)));
+
+    // only writes invalidate the position
+    const auto generation = instance.kvs.generation();
+    TEST_ASSERT(instance.kvs.set(kvs[0].first, kvs[0].second));
+    TEST_ASSERT_EQUAL(generation, instance.kvs.generation());
+
+    TEST_ASSERT(instance.kvs.set(kvs[0].first, "changed"));
+    TEST_ASSERT(generation != instance.kvs.generation());
+
+    const auto changed = instance.kvs.generation();
+    TEST_ASSERT(instance.kvs.del(kvs[1].first));
+    TEST_ASSERT(changed != instance.kvs.generation());
+
+    // e.g. storage was reloaded from the flash
+    const auto deleted = instance.kvs.generation();
+    instance.kvs.invalidate();
+    TEST_ASSERT(deleted != instance.kvs.generation());
+}
+
 // noticed when storing varying data that gets rotated from time to time
 // needs more capacity than general tests; force to set() and then clean
 // everything until the next round of set()
@@ -583,6 +633,113 @@ err:
     assert_keys();
 }
 
+// same as the static storage, but also tracks the number of reads
+template <typename T>
+struct CountingStorage : public StaticArrayStorage<T> {
+    CountingStorage(T& blob, size_t& reads) :
+        StaticArrayStorage<T>(blob),
+        _reads(reads)
+    {}
+
+    uint8_t read(size_t index) const {
+        ++_reads;
+        return StaticArrayStorage<T>::read(index);
+    }
+
+    size_t& _reads;
+};
+
+void test_snapshot() {
+    constexpr size_t Size { 16384 };
+    constexpr size_t Keys { 500 };
+
+    using array_type = std::array<uint8_t, Size>;
+    using storage_type = CountingStorage<array_type>;
+
+    array_type blob;
+    blob.fill(0xff);
+
+    size_t reads { 0 };
+    KeyValueStore<storage_type> kvs(storage_type{blob, reads}, 0, Size);
+
+    TestSequentialKvGenerator generator;
+    auto pairs = generator.make(Keys);
+    for (const auto& pair : pairs) {
+        TEST_ASSERT(kvs.set(pair.first, pair.second));
+    }
+
+    std::sort(pairs.begin(), pairs.end(),
+        [](const TestSequentialKvGenerator::kv& lhs, const TestSequentialKvGenerator::kv& rhs) {
+            return rhs.first.compareTo(lhs.first) > 0;
+        });
+
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    // the old way, sorted keys and a separate lookup for every value
+    reads = 0;
+
+    auto start = Clock::now();
+
+    std::vector<String> keys;
+    kvs.foreach([&](KeyValueStore<storage_type>::KeyValueResult&& kv) {
+        keys.push_back(kv.key.read());
+    });
+    std::sort(keys.begin(), keys.end(),
+        [](const String& lhs, const String& rhs) {
+            return rhs.compareTo(lhs) > 0;
+        });
+
+    std::vector<String> values;
+    for (const auto& key : keys) {
+        values.push_back(kvs.get(key).get());
+    }
+
+    const auto lookup_elapsed = std::chrono::duration_cast<Seconds>(Clock::now() - start);
+    const auto lookup_reads = reads;
+
+    // and a single pass
+    reads = 0;
+
+    start = Clock::now();
+    const auto snapshot = embedis::snapshot(kvs);
+
+    const auto snapshot_elapsed = std::chrono::duration_cast<Seconds>(Clock::now() - start);
+    const auto snapshot_reads = reads;
+
+    TEST_ASSERT_EQUAL(Keys, snapshot.size());
+    TEST_ASSERT_EQUAL(Keys, values.size());
+    for (size_t index = 0; index < Keys; ++index) {
+        TEST_ASSERT_EQUAL_STRING(pairs[index].first.c_str(), snapshot[index].key.c_str());
+        TEST_ASSERT_EQUAL_STRING(pairs[index].second.c_str(), snapshot[index].value.c_str());
+        TEST_ASSERT_EQUAL_STRING(pairs[index].second.c_str(), values[index].c_str());
+    }
+
+    // every byte is read at most once for the kv header and once for the contents
+    TEST_ASSERT(snapshot_reads <= (2 * Size));
+    TEST_ASSERT(snapshot_reads * 10 < lookup_reads);
+
+    printf("snapshot of %zu keys: %zu reads in %.6fs, with lookups: %zu reads in %.6fs\n",
+        Keys, snapshot_reads, snapshot_elapsed.count(),
+        lookup_reads, lookup_elapsed.count());
+
+    // filtering by prefix does not change the order
+    const auto filtered = embedis::snapshot(kvs,
+        [](const String& key) {
+            return key.startsWith("key1");
+        });
+
+    TEST_ASSERT_EQUAL(111, filtered.size());
+    for (const auto& kv : filtered) {
+        TEST_ASSERT(kv.key.startsWith("key1"));
+    }
+
+    TEST_ASSERT(std::is_sorted(filtered.begin(), filtered.end(),
+        [](const KeyValue& lhs, const KeyValue& rhs) {
+            return rhs.key.compareTo(lhs.key) > 0;
+        }));
+}
+
 } // namespace test
 
 } // namespace
@@ -597,12 +754,14 @@ int main(int, char**) {
 
     RUN_TEST(test_basic);
     RUN_TEST(test_keys_iterator);
+    RUN_TEST(test_keys_resumable_iterator);
     RUN_TEST(test_longkey);
     RUN_TEST(test_overflow);
     RUN_TEST(test_perseverance);
     RUN_TEST(test_remove_randomized);
     RUN_TEST(test_sizes);
     RUN_TEST(test_small_gaps);
+    RUN_TEST(test_snapshot);
     RUN_TEST(test_storage);
     RUN_TEST(test_varying_values);
 
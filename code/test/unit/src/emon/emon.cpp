@@ -0,0 +1,139 @@
+#include <unity.h>
+
+#include <espurna/sensors/EmonSampleWindow.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace espurna {
+namespace test {
+namespace {
+
+using namespace espurna::sensor;
+
+// Time only moves when something is sampled or when the loop is sleeping
+struct FakeClock {
+    using duration = std::chrono::duration<uint32_t, std::micro>;
+    using time_point = std::chrono::time_point<FakeClock, duration>;
+
+    static time_point now() {
+        return time_point(duration(current));
+    }
+
+    static uint32_t current;
+};
+
+uint32_t FakeClock::current { 0 };
+
+constexpr double Pi { 3.14159265358979323846 };
+
+struct Mains {
+    double frequency;
+    double amplitude;
+    double offset;
+    double phase;
+};
+
+struct Cadence {
+    uint32_t sample;  // (us) single analogRead()
+    uint32_t loop;    // (us) time between loop iterations, when not sampling
+    uint32_t jitter;  // (us) ...plus anything else the loop may be doing
+};
+
+// Same as the sensor tick(), burst is started on every loop until the window is full
+double measure(const Mains& mains, const Cadence& cadence, uint32_t cycles, size_t samples, std::mt19937& rng) {
+    const auto duration = FakeClock::duration(
+        static_cast<uint32_t>(std::lround(1000000.0 * cycles / mains.frequency)));
+
+    emon::Window window;
+    window.reset(512);
+
+    while (window.count < samples) {
+        emon::burst<FakeClock>(window, duration,
+            [&]() {
+                const double t = FakeClock::current / 1000000.0;
+                const double value = mains.offset
+                    + mains.amplitude * std::sin((2.0 * Pi * mains.frequency * t) + mains.phase);
+                FakeClock::current += cadence.sample;
+                return static_cast<unsigned int>(std::lround(value));
+            });
+
+        FakeClock::current += cadence.loop;
+        if (cadence.jitter) {
+            FakeClock::current += rng() % cadence.jitter;
+        }
+    }
+
+    return std::sqrt(window.variance());
+}
+
+void test_mains(double frequency, const Cadence& cadence) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> phases(0.0, 2.0 * Pi);
+
+    for (size_t index = 0; index < 1000; ++index) {
+        FakeClock::current = rng();
+
+        const Mains mains {frequency, 300.0, 530.0, phases(rng)};
+
+        const auto expected = mains.amplitude / std::sqrt(2.0);
+        const auto rms = measure(mains, cadence, 1, 1000, rng);
+
+        // quantization and the burst boundaries are allowed to shift it slightly
+        TEST_ASSERT_FLOAT_WITHIN(expected * 0.01, expected, rms);
+    }
+}
+
+void test_loop_50hz() {
+    test_mains(50.0, Cadence{100, 10000, 0});
+}
+
+void test_loop_60hz() {
+    test_mains(60.0, Cadence{100, 10000, 0});
+}
+
+void test_loop_jitter() {
+    test_mains(50.0, Cadence{100, 10000, 5000});
+}
+
+// tickless loop only wakes up every 100ms
+void test_loop_tickless() {
+    test_mains(50.0, Cadence{100, 100000, 0});
+}
+
+// e.g. i2c ADC, only a few samples per cycle
+void test_loop_slow_adc() {
+    test_mains(50.0, Cadence{1100, 10000, 2000});
+}
+
+void test_dc() {
+    emon::Window window;
+    window.reset(512);
+    for (size_t index = 0; index < 100; ++index) {
+        window.add(600);
+    }
+
+    TEST_ASSERT_EQUAL(100, window.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 88.0, window.mean());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.0, window.variance());
+    TEST_ASSERT_EQUAL(600, window.min);
+    TEST_ASSERT_EQUAL(600, window.max);
+}
+
+} // namespace
+} // namespace test
+} // namespace espurna
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    using namespace espurna::test;
+    RUN_TEST(test_dc);
+    RUN_TEST(test_loop_50hz);
+    RUN_TEST(test_loop_60hz);
+    RUN_TEST(test_loop_jitter);
+    RUN_TEST(test_loop_tickless);
+    RUN_TEST(test_loop_slow_adc);
+    return UNITY_END();
+}
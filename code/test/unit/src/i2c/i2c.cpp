@@ -0,0 +1,402 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <espurna/i2c_scheduler.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace espurna;
+using namespace espurna::i2c;
+
+using container = std::vector<uint8_t>;
+
+// Devices with a register file, where the first written byte selects the register
+// and reads continue from the selected one. Every bus access is logged as
+// "<w|r><address>" so tests could check the order of transactions
+class SimulatedTransport : public Transport {
+public:
+    static constexpr uint8_t Nack { 2 };
+
+    void add(uint8_t address, container registers) {
+        _devices[address] = Device{std::move(registers), 0};
+    }
+
+    uint8_t write(uint8_t address, const uint8_t* data, size_t size) override {
+        log('w', address);
+
+        auto it = _devices.find(address);
+        if (it == _devices.end()) {
+            return Nack;
+        }
+
+        auto& device = (*it).second;
+        if (size) {
+            device.pointer = data[0];
+            for (size_t index = 1; index < size; ++index) {
+                device.registers.at(device.pointer + index - 1) = data[index];
+            }
+        }
+
+        return 0;
+    }
+
+    uint8_t transfer(uint8_t address, const uint8_t* out, size_t out_size, uint8_t* in, size_t in_size) override {
+        if (out_size) {
+            const auto result = write(address, out, out_size);
+            if (result) {
+                return result;
+            }
+        }
+
+        log('r', address);
+
+        auto it = _devices.find(address);
+        if (it == _devices.end()) {
+            return Nack;
+        }
+
+        auto& device = (*it).second;
+        for (size_t index = 0; index < in_size; ++index) {
+            in[index] = device.registers.at(device.pointer + index);
+        }
+
+        return 0;
+    }
+
+    const std::string& history() const {
+        return _history;
+    }
+
+    void reset() {
+        _history.clear();
+    }
+
+private:
+    struct Device {
+        container registers;
+        uint8_t pointer;
+    };
+
+    void log(char kind, uint8_t address) {
+        if (_history.size()) {
+            _history += ' ';
+        }
+
+        char buffer[8];
+        snprintf(buffer, sizeof(buffer), "%c%02X", kind, address);
+        _history += buffer;
+    }
+
+    std::map<uint8_t, Device> _devices;
+    std::string _history;
+};
+
+struct Completion {
+    Error error { Error::Invalid };
+    uint8_t status { 0xff };
+    container data;
+    size_t calls { 0 };
+
+    Scheduler::Callback callback() {
+        return [this](Error error, uint8_t status, const Plan& plan) {
+            this->error = error;
+            this->status = status;
+            this->data.assign(plan.data(), plan.data() + plan.size());
+            ++this->calls;
+        };
+    }
+};
+
+void test_burst_read() {
+    SimulatedTransport transport;
+    transport.add(0x10, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06});
+
+    Scheduler scheduler(transport);
+
+    Completion done;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x10).read(0x02, 3).read(0x00, 1), done.callback()));
+
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL(1, done.calls);
+    TEST_ASSERT(Error::None == done.error);
+    TEST_ASSERT_EQUAL(0, done.status);
+    TEST_ASSERT(container({0x03, 0x04, 0x05, 0x01}) == done.data);
+    TEST_ASSERT_EQUAL_STRING("w10 r10 w10 r10", transport.history().c_str());
+    TEST_ASSERT_EQUAL(0, scheduler.pending());
+}
+
+void test_wait() {
+    SimulatedTransport transport;
+    transport.add(0x44, {0x00, 0x00, 0xbe, 0xef});
+
+    Scheduler scheduler(transport);
+
+    Completion done;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x44)
+            .write({0x00, 0xaa})
+            .wait(duration::Microseconds(1000))
+            .read(0x00, 4),
+        done.callback()));
+
+    scheduler.tick(duration::Microseconds(100));
+    TEST_ASSERT_EQUAL(0, done.calls);
+    TEST_ASSERT_EQUAL_STRING("w44", transport.history().c_str());
+
+    scheduler.tick(duration::Microseconds(1099));
+    TEST_ASSERT_EQUAL(0, done.calls);
+    TEST_ASSERT_EQUAL_STRING("w44", transport.history().c_str());
+
+    scheduler.tick(duration::Microseconds(1100));
+    TEST_ASSERT_EQUAL(1, done.calls);
+    TEST_ASSERT(container({0xaa, 0x00, 0xbe, 0xef}) == done.data);
+    TEST_ASSERT_EQUAL_STRING("w44 w44 r44", transport.history().c_str());
+}
+
+void test_trailing_wait() {
+    SimulatedTransport transport;
+    transport.add(0x44, {0x00});
+
+    Scheduler scheduler(transport);
+
+    Completion done;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x44)
+            .write({0x00, 0x01})
+            .wait(duration::Microseconds(500)),
+        done.callback()));
+
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL(0, done.calls);
+
+    scheduler.tick(duration::Microseconds(500));
+    TEST_ASSERT_EQUAL(1, done.calls);
+    TEST_ASSERT_EQUAL(0, done.data.size());
+}
+
+void test_overlap() {
+    SimulatedTransport transport;
+    transport.add(0x44, {0x11, 0x22});
+    transport.add(0x48, {0x33, 0x44});
+    transport.add(0x76, {0x55, 0x66});
+
+    Scheduler scheduler(transport);
+
+    Completion slow;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x44)
+            .write({0x00})
+            .wait(duration::Microseconds(20000))
+            .read(2),
+        slow.callback()));
+
+    Completion fast;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x48).read(0x00, 2),
+        fast.callback()));
+
+    Completion medium;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x76)
+            .write({0x01})
+            .wait(duration::Microseconds(5000))
+            .read(1),
+        medium.callback()));
+
+    TEST_ASSERT_EQUAL(3, scheduler.pending());
+
+    // reads of other devices happen while the first one is still busy
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL_STRING("w44 w48 r48 w76", transport.history().c_str());
+    TEST_ASSERT_EQUAL(0, slow.calls);
+    TEST_ASSERT_EQUAL(1, fast.calls);
+    TEST_ASSERT_EQUAL(0, medium.calls);
+    TEST_ASSERT(container({0x33, 0x44}) == fast.data);
+
+    transport.reset();
+    scheduler.tick(duration::Microseconds(5000));
+    TEST_ASSERT_EQUAL_STRING("r76", transport.history().c_str());
+    TEST_ASSERT_EQUAL(1, medium.calls);
+    TEST_ASSERT(container({0x66}) == medium.data);
+
+    transport.reset();
+    scheduler.tick(duration::Microseconds(20000));
+    TEST_ASSERT_EQUAL_STRING("r44", transport.history().c_str());
+    TEST_ASSERT_EQUAL(1, slow.calls);
+    TEST_ASSERT(container({0x11, 0x22}) == slow.data);
+
+    TEST_ASSERT_EQUAL(0, scheduler.pending());
+    TEST_ASSERT_EQUAL(3, scheduler.stats().completed);
+    TEST_ASSERT_EQUAL(2, scheduler.stats().waits);
+    TEST_ASSERT_EQUAL(3, scheduler.stats().pending_max);
+}
+
+void test_same_device_order() {
+    SimulatedTransport transport;
+    transport.add(0x44, {0x00, 0x00});
+
+    Scheduler scheduler(transport);
+
+    Completion first;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x44)
+            .write({0x00, 0x01})
+            .wait(duration::Microseconds(1000))
+            .read(0x00, 1),
+        first.callback()));
+
+    Completion second;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x44)
+            .write({0x00, 0x02})
+            .read(0x00, 1),
+        second.callback()));
+
+    scheduler.tick(duration::Microseconds(0));
+    scheduler.tick(duration::Microseconds(500));
+    TEST_ASSERT_EQUAL_STRING("w44", transport.history().c_str());
+    TEST_ASSERT_EQUAL(0, first.calls);
+    TEST_ASSERT_EQUAL(0, second.calls);
+
+    scheduler.tick(duration::Microseconds(1000));
+    TEST_ASSERT_EQUAL(1, first.calls);
+    TEST_ASSERT(container({0x01}) == first.data);
+
+    // second plan is no longer blocked and runs during the same tick
+    TEST_ASSERT_EQUAL(1, second.calls);
+    TEST_ASSERT(container({0x02}) == second.data);
+}
+
+void test_bus_error() {
+    SimulatedTransport transport;
+    transport.add(0x10, {0x01});
+
+    Scheduler scheduler(transport);
+
+    Completion missing;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x20)
+            .write({0x00})
+            .wait(duration::Microseconds(1000))
+            .read(1),
+        missing.callback()));
+
+    Completion present;
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x10).read(0x00, 1),
+        present.callback()));
+
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL(1, missing.calls);
+    TEST_ASSERT(Error::Bus == missing.error);
+    TEST_ASSERT_EQUAL(SimulatedTransport::Nack, missing.status);
+
+    TEST_ASSERT_EQUAL(1, present.calls);
+    TEST_ASSERT(Error::None == present.error);
+
+    TEST_ASSERT_EQUAL_STRING("w20 w10 r10", transport.history().c_str());
+    TEST_ASSERT_EQUAL(1, scheduler.stats().failed);
+    TEST_ASSERT_EQUAL(1, scheduler.stats().completed);
+}
+
+void test_invalid() {
+    SimulatedTransport transport;
+    Scheduler scheduler(transport);
+
+    TEST_ASSERT(Error::Invalid == scheduler.schedule(Plan(0x10), nullptr));
+
+    Plan steps(0x10);
+    for (size_t index = 0; index <= Plan::StepsMax; ++index) {
+        steps.read(1);
+    }
+    TEST_ASSERT_FALSE(steps.valid());
+    TEST_ASSERT(Error::Invalid == scheduler.schedule(steps, nullptr));
+
+    Plan result(0x10);
+    result.read(0x00, Plan::ResultSize);
+    TEST_ASSERT(result.valid());
+    result.read(1);
+    TEST_ASSERT_FALSE(result.valid());
+
+    uint8_t payload[Plan::PayloadSize + 1] {};
+    TEST_ASSERT_FALSE(Plan(0x10).write(payload, sizeof(payload)).valid());
+    TEST_ASSERT(Plan(0x10).write(payload, sizeof(payload) - 1).valid());
+
+    for (size_t index = 0; index < Scheduler::QueueSize; ++index) {
+        TEST_ASSERT(Error::None == scheduler.schedule(Plan(0x10).read(1), nullptr));
+    }
+    TEST_ASSERT(Error::QueueFull == scheduler.schedule(Plan(0x10).read(1), nullptr));
+}
+
+void test_reschedule() {
+    SimulatedTransport transport;
+    transport.add(0x10, {0x01, 0x02});
+
+    Scheduler scheduler(transport);
+
+    size_t calls { 0 };
+    std::function<void(Error, uint8_t, const Plan&)> callback;
+    callback = [&](Error error, uint8_t, const Plan&) {
+        TEST_ASSERT(Error::None == error);
+        if (++calls < 3) {
+            TEST_ASSERT(Error::None == scheduler.schedule(
+                Plan(0x10).read(0x00, 2), callback));
+        }
+    };
+
+    TEST_ASSERT(Error::None == scheduler.schedule(
+        Plan(0x10).read(0x00, 2), callback));
+
+    // every tick only handles plans that were there when it started
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(1, scheduler.pending());
+
+    scheduler.tick(duration::Microseconds(0));
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL(3, calls);
+    TEST_ASSERT_EQUAL(0, scheduler.pending());
+}
+
+void test_values() {
+    SimulatedTransport transport;
+    transport.add(0x10, {0x12, 0x34, 0x56});
+
+    Scheduler scheduler(transport);
+
+    Completion done;
+    Plan plan(0x10);
+    plan.read(0x00, 3);
+
+    uint16_t be { 0 };
+    uint16_t le { 0 };
+    uint8_t outside { 0xff };
+    TEST_ASSERT(Error::None == scheduler.schedule(std::move(plan),
+        [&](Error, uint8_t, const Plan& plan) {
+            be = plan.value16(0);
+            le = plan.value16_le(1);
+            outside = plan[3];
+        }));
+
+    scheduler.tick(duration::Microseconds(0));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, be);
+    TEST_ASSERT_EQUAL_HEX16(0x5634, le);
+    TEST_ASSERT_EQUAL_HEX8(0, outside);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_read);
+    RUN_TEST(test_wait);
+    RUN_TEST(test_trailing_wait);
+    RUN_TEST(test_overlap);
+    RUN_TEST(test_same_device_order);
+    RUN_TEST(test_bus_error);
+    RUN_TEST(test_invalid);
+    RUN_TEST(test_reschedule);
+    RUN_TEST(test_values);
+    return UNITY_END();
+}
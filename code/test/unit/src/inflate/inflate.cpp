@@ -0,0 +1,255 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <espurna/ota_inflate.h>
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace espurna::ota;
+
+using container = std::vector<uint8_t>;
+
+namespace {
+
+// reference stream, compressed by the system zlib
+container compress(const container& input, int window_bits, int level = Z_BEST_COMPRESSION, int strategy = Z_DEFAULT_STRATEGY) {
+    z_stream stream{};
+    TEST_ASSERT_EQUAL(Z_OK, deflateInit2(&stream, level, Z_DEFLATED, window_bits, 9, strategy));
+
+    container out(deflateBound(&stream, input.size()));
+    stream.next_in = const_cast<uint8_t*>(input.data());
+    stream.avail_in = input.size();
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+
+    TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&stream, Z_FINISH));
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return out;
+}
+
+// something resembling the firmware image. some code-like repeating sequences, some text and some noise
+container firmware(size_t size) {
+    container out;
+    out.reserve(size);
+
+    std::mt19937 rng(12345);
+    const char text[] = "espurna firmware / settings / relay / sensor / mqtt / terminal ";
+
+    while (out.size() < size) {
+        switch (rng() % 3) {
+        case 0:
+            for (size_t index = 0; index < 64; ++index) {
+                out.push_back(rng() & 0xff);
+            }
+            break;
+        case 1:
+        {
+            const auto base = rng();
+            for (size_t index = 0; index < 256; ++index) {
+                out.push_back((base >> ((index % 4) * 8)) & 0xf3);
+            }
+            break;
+        }
+        case 2:
+            out.insert(out.end(), std::begin(text), std::end(text) - 1);
+            break;
+        }
+    }
+
+    out.resize(size);
+    return out;
+}
+
+struct Result {
+    Inflate::Status status;
+    Inflate::Error error;
+    container output;
+};
+
+Result inflate(const container& input, size_t window_bits, size_t chunk) {
+    Result out;
+
+    Inflate inflate(window_bits,
+        [&](const uint8_t* data, size_t size) {
+            out.output.insert(out.output.end(), data, data + size);
+            return true;
+        });
+
+    auto status = Inflate::Status::Pending;
+    for (size_t offset = 0; (offset < input.size()) && (status == Inflate::Status::Pending); offset += chunk) {
+        const auto size = std::min(chunk, input.size() - offset);
+        status = inflate.write(&input[offset], size);
+    }
+
+    out.status = status;
+    out.error = inflate.error();
+
+    return out;
+}
+
+} // namespace
+
+void test_header() {
+    const auto data = compress(container{1, 2, 3}, 13);
+    TEST_ASSERT(Inflate::header(data.data(), data.size()));
+
+    const uint8_t raw[] {0xe9, 0x01, 0x02, 0x03};
+    TEST_ASSERT_FALSE(Inflate::header(raw, sizeof(raw)));
+
+    const uint8_t gzip[] {0x1f, 0x8b, 0x08, 0x00};
+    TEST_ASSERT_FALSE(Inflate::header(gzip, sizeof(gzip)));
+
+    TEST_ASSERT_FALSE(Inflate::header(data.data(), 1));
+}
+
+void test_firmware() {
+    const auto input = firmware(512 * 1024);
+    const auto compressed = compress(input, 13);
+
+    std::mt19937 rng(54321);
+
+    container output;
+    Inflate inflate(13,
+        [&](const uint8_t* data, size_t size) {
+            TEST_ASSERT(size <= inflate.window());
+            output.insert(output.end(), data, data + size);
+            return true;
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto status = Inflate::Status::Pending;
+    size_t offset = 0;
+    while (offset < compressed.size()) {
+        const auto size = std::min<size_t>(1 + (rng() % 1460), compressed.size() - offset);
+        status = inflate.write(&compressed[offset], size);
+        offset += size;
+        if (status != Inflate::Status::Pending) {
+            break;
+        }
+    }
+
+    const auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    TEST_ASSERT(Inflate::Status::Done == status);
+    TEST_ASSERT_EQUAL(compressed.size(), offset);
+    TEST_ASSERT_EQUAL(compressed.size(), inflate.total_in());
+    TEST_ASSERT_EQUAL(input.size(), inflate.total_out());
+    TEST_ASSERT(input == output);
+
+    char message[128];
+    std::snprintf(message, sizeof(message), "inflated %zu -> %zu bytes in %lldus (%.1f MiB/s)",
+        compressed.size(), output.size(), static_cast<long long>(time.count()),
+        (output.size() / (1024.0 * 1024.0)) / (time.count() / 1000000.0));
+    TEST_MESSAGE(message);
+}
+
+void test_single_byte() {
+    const auto input = firmware(32 * 1024);
+    const auto result = inflate(compress(input, 12), 12, 1);
+
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+}
+
+void test_blocks() {
+    const auto input = firmware(16 * 1024);
+
+    // stored
+    auto result = inflate(compress(input, 9, Z_NO_COMPRESSION), 9, 100);
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+
+    // fixed codes only
+    result = inflate(compress(input, 11, Z_BEST_SPEED, Z_FIXED), 11, 7);
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+
+    // dynamic codes with long runs of the same value
+    const container runs(20 * 1024, 0xff);
+    result = inflate(compress(runs, 15), 15, 333);
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT(runs == result.output);
+
+    // literals only
+    result = inflate(compress(input, 10, Z_BEST_COMPRESSION, Z_HUFFMAN_ONLY), 10, 64);
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT(input == result.output);
+}
+
+void test_empty() {
+    const auto result = inflate(compress(container{}, 9), 9, 16);
+    TEST_ASSERT(Inflate::Status::Done == result.status);
+    TEST_ASSERT_EQUAL(0, result.output.size());
+}
+
+void test_window_too_large() {
+    const auto input = firmware(4 * 1024);
+    const auto result = inflate(compress(input, 15), 13, 512);
+    TEST_ASSERT(Inflate::Status::Error == result.status);
+    TEST_ASSERT(Inflate::Error::Window == result.error);
+    TEST_ASSERT_EQUAL(0, result.output.size());
+}
+
+void test_checksum() {
+    const auto input = firmware(8 * 1024);
+
+    auto compressed = compress(input, 13);
+    compressed.back() ^= 0x01;
+
+    const auto result = inflate(compressed, 13, 512);
+    TEST_ASSERT(Inflate::Status::Error == result.status);
+    TEST_ASSERT(Inflate::Error::Checksum == result.error);
+}
+
+void test_truncated() {
+    const auto input = firmware(8 * 1024);
+
+    auto compressed = compress(input, 13);
+    compressed.resize(compressed.size() / 2);
+
+    const auto result = inflate(compressed, 13, 512);
+    TEST_ASSERT(Inflate::Status::Pending == result.status);
+    TEST_ASSERT(Inflate::Error::None == result.error);
+}
+
+void test_output_error() {
+    const auto input = firmware(64 * 1024);
+    const auto compressed = compress(input, 13);
+
+    size_t calls { 0 };
+    Inflate inflate(13,
+        [&](const uint8_t*, size_t) {
+            return ++calls < 3;
+        });
+
+    TEST_ASSERT(Inflate::Status::Error == inflate.write(compressed.data(), compressed.size()));
+    TEST_ASSERT(Inflate::Error::Output == inflate.error());
+    TEST_ASSERT_EQUAL(3, calls);
+
+    // nothing happens after the error
+    TEST_ASSERT(Inflate::Status::Error == inflate.write(compressed.data(), compressed.size()));
+    TEST_ASSERT_EQUAL(3, calls);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_header);
+    RUN_TEST(test_firmware);
+    RUN_TEST(test_single_byte);
+    RUN_TEST(test_blocks);
+    RUN_TEST(test_empty);
+    RUN_TEST(test_window_too_large);
+    RUN_TEST(test_checksum);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_output_error);
+    return UNITY_END();
+}
@@ -0,0 +1,267 @@
+#include <unity.h>
+#include <Arduino.h>
+
+#include <espurna/utils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+// Only the protocol IDs that are used in the tests, see IRremoteESP8266.h for the full list
+enum decode_type_t {
+    UNKNOWN = -1,
+    UNUSED = 0,
+    RC6 = 2,
+    LG = 10,
+    COOLIX = 15,
+    MITSUBISHI_AC = 20,
+    kLastDecodeType = 128,
+};
+
+#define IR_TX_ARENA_SIZE 4096
+
+namespace espurna {
+namespace ir {
+namespace {
+namespace tx {
+namespace internal {
+
+uint16_t repeats { 0 };
+uint8_t series { 1 };
+unsigned long delay { 100 };
+
+} // namespace internal
+} // namespace tx
+
+#include <espurna/ir_parse.h>
+
+} // namespace
+} // namespace ir
+
+namespace test {
+namespace {
+
+using namespace espurna::ir;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+void report_throughput(const char* name, size_t iterations, size_t bytes, T&& callback) {
+    const auto start = Clock::now();
+    for (size_t index = 0; index < iterations; ++index) {
+        callback();
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start);
+    printf("%s: %zu iterations in %.3fs (%.0f payloads/s, %.2f MiB/s)\n",
+        name, iterations, elapsed.count(),
+        iterations / elapsed.count(),
+        (iterations * bytes) / elapsed.count() / (1024.0 * 1024.0));
+}
+
+String make_raw(size_t size) {
+    String out;
+    out.reserve(size * 4);
+    out += "38:1:500:";
+
+    for (size_t index = 0; index < size; ++index) {
+        if (index) {
+            out += ',';
+        }
+        out += String(100 + (index % 50) * 10, 10);
+    }
+
+    return out;
+}
+
+void test_simple_invalid() {
+    TEST_ASSERT(!simple::parse(""));
+    TEST_ASSERT(!simple::parse(","));
+    TEST_ASSERT(!simple::parse("999::"));
+    TEST_ASSERT(!simple::parse("-5:doesntmatter"));
+    TEST_ASSERT(!simple::parse("2:0:31"));
+    TEST_ASSERT(!simple::parse("2:012:31"));
+    TEST_ASSERT(!simple::parse("2:112233445566778899AA:31"));
+}
+
+void test_simple_value() {
+    TEST_ASSERT_EQUAL_STRING("FFAABBCCDDEE", simple::value::encode(0xffaabbccddee).c_str());
+    TEST_ASSERT_EQUAL_STRING("0FAABBCCDDEE", simple::value::encode(0xfaabbccddee).c_str());
+    TEST_ASSERT_EQUAL_STRING("EE", simple::value::encode(0xee).c_str());
+    TEST_ASSERT_EQUAL_STRING("00", simple::value::encode(0).c_str());
+}
+
+void test_simple() {
+    {
+        auto result = simple::parse("2:7FAABBCC:31");
+        TEST_ASSERT(result.has_value());
+
+        const auto& payload = result.value();
+        TEST_ASSERT_EQUAL(decode_type_t::RC6, payload.type);
+        TEST_ASSERT(payload.value == static_cast<uint64_t>(0x7faabbcc));
+        TEST_ASSERT_EQUAL(31, payload.bits);
+        TEST_ASSERT_EQUAL(tx::internal::repeats, payload.repeats);
+        TEST_ASSERT_EQUAL(tx::internal::series, payload.series);
+        TEST_ASSERT_EQUAL(tx::internal::delay, payload.delay);
+    }
+
+    {
+        auto result = simple::parse("15:AABBCCDD:25:3");
+        TEST_ASSERT(result.has_value());
+
+        const auto& payload = result.value();
+        TEST_ASSERT_EQUAL(decode_type_t::COOLIX, payload.type);
+        TEST_ASSERT(payload.value == static_cast<uint64_t>(0xaabbccdd));
+        TEST_ASSERT_EQUAL(25, payload.bits);
+        TEST_ASSERT_EQUAL(3, payload.repeats);
+    }
+
+    {
+        auto result = simple::parse("10:0FEFEFEF:21:2:5:500");
+        TEST_ASSERT(result.has_value());
+
+        const auto& payload = result.value();
+        TEST_ASSERT_EQUAL(decode_type_t::LG, payload.type);
+        TEST_ASSERT(payload.value == static_cast<uint64_t>(0x0fefefef));
+        TEST_ASSERT_EQUAL(21, payload.bits);
+        TEST_ASSERT_EQUAL(2, payload.repeats);
+        TEST_ASSERT_EQUAL(5, payload.series);
+        TEST_ASSERT_EQUAL(500, payload.delay);
+    }
+}
+
+void test_state() {
+    TEST_ASSERT(!state::parse(""));
+    TEST_ASSERT(!state::parse(":"));
+    TEST_ASSERT(!state::parse("-1100,100,150"));
+    TEST_ASSERT(!state::parse("25:"));
+    TEST_ASSERT(!state::parse("30:C"));
+    TEST_ASSERT(state::parse("45:CD"));
+
+    auto result = state::parse("20:C7B7966A9B29CD3C5F2AC03B91B0B221:3:250");
+    TEST_ASSERT(result.has_value());
+
+    const auto& payload = result.value();
+    TEST_ASSERT_EQUAL(decode_type_t::MITSUBISHI_AC, payload.type);
+    TEST_ASSERT_EQUAL(3, payload.series);
+    TEST_ASSERT_EQUAL(250, payload.delay);
+
+    const uint8_t raw[] {
+        0xc7, 0xb7, 0x96, 0x6a,
+        0x9b, 0x29, 0xcd, 0x3c,
+        0x5f, 0x2a, 0xc0, 0x3b,
+        0x91, 0xb0, 0xb2, 0x21};
+
+    TEST_ASSERT(state::valid(payload));
+    TEST_ASSERT_EQUAL(sizeof(raw), payload.value.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(raw, payload.value.data(), sizeof(raw));
+}
+
+void test_raw() {
+    TEST_ASSERT(!raw::parse("-1:1:500:,200,150,250,50,100,100,150"));
+
+    auto result = raw::parse("38:1:500:100,200,150,250,50,100,100,150");
+    TEST_ASSERT(result.has_value());
+
+    const auto& payload = result.value();
+    TEST_ASSERT_EQUAL(38, payload.frequency);
+    TEST_ASSERT_EQUAL(1, payload.series);
+    TEST_ASSERT_EQUAL(500, payload.delay);
+
+    const uint16_t time[] {100, 200, 150, 250, 50, 100, 100, 150};
+    TEST_ASSERT(raw::valid(payload));
+    TEST_ASSERT_EQUAL(std::size(time), payload.time.size());
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(time, payload.time.data(), std::size(time));
+}
+
+void test_arena_reuse() {
+    TEST_ASSERT_EQUAL(0, arena().users());
+    TEST_ASSERT_EQUAL(0, arena().used());
+
+    {
+        auto first = raw::parse("38:1:500:100,200,150,250");
+        TEST_ASSERT(first.has_value());
+
+        // unused part of the claimed block should be returned
+        const auto used = arena().used();
+        TEST_ASSERT(used < arena().size());
+        TEST_ASSERT(used >= 4 * sizeof(uint16_t));
+
+        auto second = state::parse("20:C7B7966A9B29CD3C");
+        TEST_ASSERT(second.has_value());
+        TEST_ASSERT(arena().used() > used);
+        TEST_ASSERT_EQUAL(2, arena().users());
+    }
+
+    // nothing is using the arena, so it starts over
+    TEST_ASSERT_EQUAL(0, arena().users());
+    TEST_ASSERT_EQUAL(0, arena().used());
+
+    // failed parser gives back the memory
+    TEST_ASSERT(!raw::parse("38:1:500:"));
+    TEST_ASSERT_EQUAL(0, arena().users());
+    TEST_ASSERT_EQUAL(0, arena().used());
+}
+
+void test_arena_overflow() {
+    const auto payload = make_raw((IR_TX_ARENA_SIZE / sizeof(uint16_t)) + 1);
+
+    auto result = raw::parse(payload);
+    TEST_ASSERT(result.has_value());
+    TEST_ASSERT(result.value().time.overflow());
+    TEST_ASSERT(!raw::valid(result.value()));
+
+    auto other = raw::parse("38:1:500:100,200,150,250");
+    TEST_ASSERT(other.has_value());
+    TEST_ASSERT(!raw::valid(other.value()));
+}
+
+void test_throughput() {
+    const auto raw_payload = make_raw(512);
+    report_throughput("raw (512 values)", 10000, raw_payload.length(), [&]() {
+        auto result = raw::parse(raw_payload);
+        TEST_ASSERT(result.has_value());
+        TEST_ASSERT_EQUAL(512, result.value().time.size());
+    });
+
+    const String state_payload =
+        "20:C7B7966A9B29CD3C5F2AC03B91B0B221C7B7966A9B29CD3C5F2AC03B91B0B221"
+        "C7B7966A9B29CD3C5F2AC03B91B0B221C7B7966A9B29CD3C5F2AC03B91B0B221:2:100";
+    report_throughput("state (64 bytes)", 100000, state_payload.length(), [&]() {
+        auto result = state::parse(state_payload);
+        TEST_ASSERT(result.has_value());
+        TEST_ASSERT_EQUAL(64, result.value().value.size());
+    });
+
+    const String simple_payload = "10:0FEFEFEF:21:2:5:500";
+    report_throughput("simple", 1000000, simple_payload.length(), [&]() {
+        auto result = simple::parse(simple_payload);
+        TEST_ASSERT(result.has_value());
+    });
+
+    TEST_ASSERT_EQUAL(0, arena().users());
+}
+
+} // namespace
+} // namespace test
+} // namespace espurna
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    using namespace espurna::test;
+    RUN_TEST(test_simple_invalid);
+    RUN_TEST(test_simple_value);
+    RUN_TEST(test_simple);
+    RUN_TEST(test_state);
+    RUN_TEST(test_raw);
+    RUN_TEST(test_arena_reuse);
+    RUN_TEST(test_arena_overflow);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,410 @@
+#include <Arduino.h>
+#include <Stream.h>
+#include <unity.h>
+
+#include <espurna/modbus_rtu.h>
+
+#include <map>
+#include <vector>
+
+using namespace espurna;
+using namespace espurna::modbus;
+
+using container = std::vector<uint8_t>;
+
+// Serial line with a number of input register devices attached. Every written request
+// is answered by the addressed device, unless it does not exist. Response bytes are only
+// readable after release() or when `auto_release` is set. `prefix` is received before the response
+class SimulatedBus : public Stream {
+    public:
+        using Registers = std::vector<uint16_t>;
+
+        void add(uint8_t address, Registers registers) {
+            _devices[address] = std::move(registers);
+        }
+
+        // Print interface
+        size_t write(uint8_t c) {
+            return write(&c, 1);
+        }
+        size_t write(const unsigned char* data, unsigned long size) {
+            ++_requests;
+            _last_request.assign(data, data + size);
+            respond(container(data, data + size));
+            return size;
+        }
+        int availableForWrite() { return 1; }
+        void flush() {}
+        // Stream interface
+        int available() {
+            return _released;
+        }
+        int read() {
+            if (!_released) return -1;
+            int c = _rx.front();
+            _rx.erase(_rx.begin());
+            --_released;
+            return c;
+        }
+        int peek() {
+            if (!_released) return -1;
+            return _rx.front();
+        }
+
+        void release(size_t size) {
+            _released = std::min(_rx.size(), _released + size);
+        }
+
+        void release() {
+            _released = _rx.size();
+        }
+
+        void noise(container data) {
+            _rx.insert(_rx.end(), data.begin(), data.end());
+            if (auto_release) {
+                release();
+            }
+        }
+
+        size_t requests() const {
+            return _requests;
+        }
+
+        const container& last_request() const {
+            return _last_request;
+        }
+
+        container prefix;
+        bool auto_release { true };
+        bool corrupt { false };
+
+    private:
+        void push(container frame) {
+            const auto crc = crc16(frame.data(), frame.size());
+            frame.push_back(crc & 0xff);
+            frame.push_back((crc >> 8) & 0xff);
+            if (corrupt) {
+                frame.back() ^= 0xff;
+            }
+            noise(prefix);
+            noise(std::move(frame));
+        }
+
+        void respond(const container& request) {
+            auto it = _devices.find(request[0]);
+            if (it == _devices.end()) {
+                return;
+            }
+
+            const auto& registers = (*it).second;
+
+            const uint8_t code = request[1];
+            const uint16_t start = (request[2] << 8) | request[3];
+            const uint16_t amount = (request[4] << 8) | request[5];
+
+            if ((code != ReadInputRegisters) || ((start + amount) > registers.size())) {
+                push({request[0], static_cast<uint8_t>(code | ExceptionMask), 0x02});
+                return;
+            }
+
+            container out{request[0], code, static_cast<uint8_t>(amount * 2)};
+            for (size_t index = start; index < (start + amount); ++index) {
+                out.push_back(registers[index] >> 8);
+                out.push_back(registers[index] & 0xff);
+            }
+
+            push(std::move(out));
+        }
+
+        std::map<uint8_t, Registers> _devices;
+        container _rx;
+        container _last_request;
+        size_t _released { 0 };
+        size_t _requests { 0 };
+};
+
+struct Result {
+    Error error { Error::Invalid };
+    container data;
+    bool done { false };
+};
+
+static Master::Callback store(Result& result) {
+    return [&](Error error, const Frame& frame) {
+        result.error = error;
+        result.data.assign(frame.begin(), frame.end());
+        result.done = true;
+    };
+}
+
+static Frame read_input(uint8_t address, uint16_t start, uint16_t amount) {
+    return Builder(address, ReadInputRegisters)
+        .add(start)
+        .add(amount)
+        .end();
+}
+
+static constexpr auto Timeout = duration::Milliseconds(200);
+static constexpr auto Silence = duration::Milliseconds(4);
+
+void test_crc() {
+    // PZEM-004T V3 datasheet example, reading 10 registers from the address 0x01
+    const auto frame = read_input(0x01, 0, 10);
+    const container expected{0x01, 0x04, 0x00, 0x00, 0x00, 0x0a, 0x70, 0x0d};
+
+    TEST_ASSERT_EQUAL(expected.size(), frame.size);
+    TEST_ASSERT(std::equal(expected.begin(), expected.end(), frame.begin()));
+    TEST_ASSERT(frame.valid());
+    TEST_ASSERT_EQUAL(25, expect(frame));
+}
+
+void test_builder_overflow() {
+    Builder builder(0x01, WriteMultipleRegisters);
+    for (size_t index = 0; index < FrameSize; ++index) {
+        builder.add(static_cast<uint16_t>(index));
+    }
+
+    TEST_ASSERT_EQUAL(0, builder.end().size);
+
+    SimulatedBus bus;
+    Master master(bus, Timeout, Silence);
+    TEST_ASSERT(Error::Invalid == master.send(Frame{}, nullptr));
+    TEST_ASSERT(Error::Invalid == master.send(read_input(0x01, 0, 100), nullptr));
+    TEST_ASSERT_EQUAL(0, master.pending());
+}
+
+void test_multiple_devices() {
+    SimulatedBus bus;
+    bus.add(0x01, {2300, 0, 10});
+    bus.add(0x02, {2310, 1, 20});
+
+    Master master(bus, Timeout, Silence);
+
+    Result first;
+    Result second;
+    TEST_ASSERT(Error::None == master.send(read_input(0x01, 0, 3), store(first)));
+    TEST_ASSERT(Error::None == master.send(read_input(0x02, 1, 2), store(second)));
+    TEST_ASSERT_EQUAL(2, master.pending());
+
+    // nothing is sent until the line is quiet
+    auto now = duration::Milliseconds(1);
+    master.tick(now);
+    TEST_ASSERT_EQUAL(0, bus.requests());
+
+    now += Silence;
+    master.tick(now);
+    TEST_ASSERT_EQUAL(1, bus.requests());
+    TEST_ASSERT(master.busy());
+    TEST_ASSERT_FALSE(first.done);
+
+    master.tick(now);
+    TEST_ASSERT(first.done);
+    TEST_ASSERT(Error::None == first.error);
+    TEST_ASSERT_EQUAL(11, first.data.size());
+    TEST_ASSERT_EQUAL(0x01, first.data[0]);
+    TEST_ASSERT_EQUAL(6, first.data[2]);
+    TEST_ASSERT_EQUAL(2300, (first.data[3] << 8) | first.data[4]);
+    TEST_ASSERT_EQUAL(10, (first.data[7] << 8) | first.data[8]);
+
+    // second request waits for another silence period
+    master.tick(now);
+    TEST_ASSERT_EQUAL(1, bus.requests());
+    TEST_ASSERT_FALSE(second.done);
+
+    now += Silence;
+    master.tick(now);
+    master.tick(now);
+    TEST_ASSERT(second.done);
+    TEST_ASSERT(Error::None == second.error);
+    TEST_ASSERT_EQUAL(9, second.data.size());
+    TEST_ASSERT_EQUAL(0x02, second.data[0]);
+    TEST_ASSERT_EQUAL(1, (second.data[3] << 8) | second.data[4]);
+    TEST_ASSERT_EQUAL(20, (second.data[5] << 8) | second.data[6]);
+
+    TEST_ASSERT_EQUAL(0, master.pending());
+    TEST_ASSERT_FALSE(master.busy());
+}
+
+void test_partial_response() {
+    SimulatedBus bus;
+    bus.auto_release = false;
+    bus.add(0x05, {1, 2, 3, 4});
+
+    Master master(bus, Timeout, Silence);
+
+    Result result;
+    TEST_ASSERT(Error::None == master.send(read_input(0x05, 0, 4), store(result)));
+
+    auto now = Silence;
+    master.tick(now);
+    TEST_ASSERT_EQUAL(1, bus.requests());
+
+    // response is received over multiple ticks, without blocking any of them
+    for (size_t step = 0; step < 12; ++step) {
+        now += duration::Milliseconds(1);
+        bus.release(1);
+        master.tick(now);
+        TEST_ASSERT_FALSE(result.done);
+    }
+
+    bus.release(1);
+    master.tick(now);
+    TEST_ASSERT(result.done);
+    TEST_ASSERT(Error::None == result.error);
+    TEST_ASSERT_EQUAL(13, result.data.size());
+    TEST_ASSERT_EQUAL(4, (result.data[9] << 8) | result.data[10]);
+}
+
+void test_timeout() {
+    SimulatedBus bus;
+    bus.add(0x01, {1});
+
+    Master master(bus, Timeout, Silence);
+
+    Result missing;
+    Result present;
+    TEST_ASSERT(Error::None == master.send(read_input(0x03, 0, 1), store(missing)));
+    TEST_ASSERT(Error::None == master.send(read_input(0x01, 0, 1), store(present)));
+
+    auto now = Silence;
+    master.tick(now);
+    TEST_ASSERT_EQUAL(1, bus.requests());
+
+    now += Timeout;
+    master.tick(now);
+    TEST_ASSERT_FALSE(missing.done);
+
+    now += duration::Milliseconds(1);
+    master.tick(now);
+    TEST_ASSERT(missing.done);
+    TEST_ASSERT(Error::Timeout == missing.error);
+    TEST_ASSERT_EQUAL(0, missing.data.size());
+
+    // queue moves on to the next device
+    now += Silence;
+    master.tick(now);
+    master.tick(now);
+    TEST_ASSERT(present.done);
+    TEST_ASSERT(Error::None == present.error);
+    TEST_ASSERT_EQUAL(2, bus.requests());
+}
+
+void test_errors() {
+    SimulatedBus bus;
+    bus.add(0x01, {1, 2});
+
+    Master master(bus, Timeout, Silence);
+
+    Result exception;
+    TEST_ASSERT(Error::None == master.send(read_input(0x01, 1, 5), store(exception)));
+
+    auto now = Silence;
+    master.tick(now);
+    master.tick(now);
+    TEST_ASSERT(exception.done);
+    TEST_ASSERT(Error::Exception == exception.error);
+    TEST_ASSERT_EQUAL(5, exception.data.size());
+    TEST_ASSERT_EQUAL(0x84, exception.data[1]);
+    TEST_ASSERT_EQUAL(0x02, exception.data[2]);
+
+    bus.corrupt = true;
+
+    Result crc;
+    TEST_ASSERT(Error::None == master.send(read_input(0x01, 0, 2), store(crc)));
+
+    now += Silence;
+    master.tick(now);
+    master.tick(now);
+    TEST_ASSERT(crc.done);
+    TEST_ASSERT(Error::Crc == crc.error);
+}
+
+void test_foreign_bytes() {
+    SimulatedBus bus;
+    bus.add(0x07, {0x1234});
+
+    Master master(bus, Timeout, Silence);
+
+    // anything received while idle is dropped, and delays the next request
+    bus.noise({0x07, 0x04, 0x02});
+    master.tick(Silence);
+    TEST_ASSERT_EQUAL(0, bus.requests());
+    TEST_ASSERT_EQUAL(0, bus.available());
+
+    // late reply from some other device is skipped, up until the address and function code match
+    bus.prefix = {0x09, 0x07, 0x03, 0x07};
+
+    Result result;
+    TEST_ASSERT(Error::None == master.send(read_input(0x07, 0, 1), store(result)));
+
+    master.tick(Silence + Silence);
+    TEST_ASSERT_EQUAL(1, bus.requests());
+
+    master.tick(Silence + Silence);
+    TEST_ASSERT(result.done);
+    TEST_ASSERT(Error::None == result.error);
+    TEST_ASSERT_EQUAL(7, result.data.size());
+    TEST_ASSERT_EQUAL(0x1234, (result.data[3] << 8) | result.data[4]);
+}
+
+void test_queue() {
+    SimulatedBus bus;
+    bus.add(0x01, {1});
+
+    Master master(bus, Timeout, Silence);
+
+    size_t done { 0 };
+    for (size_t index = 0; index < Master::QueueSize; ++index) {
+        TEST_ASSERT(Error::None == master.send(read_input(0x01, 0, 1),
+            [&](Error error, const Frame&) {
+                TEST_ASSERT(Error::None == error);
+                ++done;
+            }));
+    }
+
+    TEST_ASSERT(Error::QueueFull == master.send(read_input(0x01, 0, 1), nullptr));
+
+    auto now = duration::Milliseconds(0);
+    for (size_t step = 0; step < (Master::QueueSize * 2); ++step) {
+        now += Silence;
+        master.tick(now);
+        master.tick(now);
+    }
+
+    TEST_ASSERT_EQUAL(Master::QueueSize, done);
+    TEST_ASSERT_EQUAL(Master::QueueSize, bus.requests());
+    TEST_ASSERT_EQUAL(0, master.pending());
+}
+
+void test_broadcast() {
+    SimulatedBus bus;
+    Master master(bus, Timeout, Silence);
+
+    const auto request = Builder(BroadcastAddress, WriteSingleRegister)
+        .add(static_cast<uint16_t>(2))
+        .add(static_cast<uint16_t>(1))
+        .end();
+
+    Result result;
+    TEST_ASSERT(Error::None == master.send(request, store(result)));
+
+    master.tick(Silence);
+    TEST_ASSERT(result.done);
+    TEST_ASSERT(Error::None == result.error);
+    TEST_ASSERT_EQUAL(0, result.data.size());
+    TEST_ASSERT_EQUAL(request.size, bus.last_request().size());
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc);
+    RUN_TEST(test_builder_overflow);
+    RUN_TEST(test_multiple_devices);
+    RUN_TEST(test_partial_response);
+    RUN_TEST(test_timeout);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_foreign_bytes);
+    RUN_TEST(test_queue);
+    RUN_TEST(test_broadcast);
+    return UNITY_END();
+}
@@ -0,0 +1,260 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <espurna/libs/esp8266_pwm_phases.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+constexpr size_t ChannelsMax { 8 };
+constexpr size_t PhasesMax { ChannelsMax + 2 };
+
+using Phases = std::array<pwm_phase, PhasesMax>;
+using Ticks = std::array<uint32_t, ChannelsMax>;
+
+// same as the board pinout, where some of GPIOs are not available
+constexpr std::array<uint16_t, ChannelsMax> Masks {
+    1 << 0, 1 << 2, 1 << 4, 1 << 5, 1 << 12, 1 << 13, 1 << 14, 1 << 15};
+
+struct Result {
+    uint32_t period;
+    Ticks on;
+};
+
+// Same as the interrupt handler, except that every phase takes exactly the amount of ticks it is supposed to.
+// Table is run twice, since the state at the start of the period depends on the previous one
+Result simulate(const Phases& phases, uint8_t last, size_t channels) {
+    Result out{};
+
+    uint16_t state { 0 };
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint8_t n = 0; n < last; ++n) {
+            state |= phases[n].on_mask;
+            state &= ~phases[n].off_mask;
+
+            const auto duration = phases[n].ticks + 1;
+            if (!pass) {
+                continue;
+            }
+
+            out.period += duration;
+            for (size_t channel = 0; channel < channels; ++channel) {
+                if (state & Masks[channel]) {
+                    out.on[channel] += duration;
+                }
+            }
+        }
+    }
+
+    return out;
+}
+
+template <typename T>
+double measure(T&& callback, size_t count) {
+    const auto start = std::chrono::steady_clock::now();
+    callback();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count() / count;
+}
+
+} // namespace
+
+void test_static() {
+    constexpr uint32_t Period { 10000 };
+
+    Phases phases;
+    const Ticks ticks{0, Period, 0, Period * 2};
+
+    const auto last = pwm_phases_prep(phases.data(), ticks.data(), Masks.data(), 4, Period);
+    TEST_ASSERT_EQUAL(1, last);
+    TEST_ASSERT_EQUAL_HEX16(Masks[1] | Masks[3], phases[0].on_mask);
+    TEST_ASSERT_EQUAL_HEX16(Masks[0] | Masks[2], phases[0].off_mask);
+
+    TEST_ASSERT_EQUAL(0, phases[1].ticks);
+    TEST_ASSERT_EQUAL(0, phases[1].on_mask);
+    TEST_ASSERT_EQUAL(0, phases[1].off_mask);
+}
+
+// Every channel is on for exactly the requested amount of ticks, no matter how close the edges are
+void test_duty() {
+    constexpr uint32_t Period { 5000 };
+
+    std::mt19937 rng(1234);
+    for (size_t index = 0; index < 100000; ++index) {
+        const size_t channels = 1 + (rng() % ChannelsMax);
+
+        Ticks ticks{};
+        for (size_t channel = 0; channel < channels; ++channel) {
+            // clustered values are more likely to trigger edge alignment
+            ticks[channel] = (rng() % 4)
+                ? (rng() % Period)
+                : ((Period / 2) + (rng() % 48) - 24);
+        }
+
+        Phases phases;
+        const auto last = pwm_phases_prep(phases.data(), ticks.data(), Masks.data(), channels, Period);
+        TEST_ASSERT_LESS_OR_EQUAL(channels + 1, last);
+
+        if (last == 1) {
+            continue;
+        }
+
+        TEST_ASSERT_EQUAL(0, phases[last].ticks);
+        TEST_ASSERT_EQUAL(0, phases[last].on_mask | phases[last].off_mask);
+
+        const auto result = simulate(phases, last, channels);
+        TEST_ASSERT_EQUAL(Period, result.period);
+        for (size_t channel = 0; channel < channels; ++channel) {
+            TEST_ASSERT_EQUAL(ticks[channel], result.on[channel]);
+        }
+    }
+}
+
+void test_dither_ticks() {
+    for (uint8_t bits = 0; bits <= 4; ++bits) {
+        const uint8_t frames = 1 << bits;
+
+        for (uint32_t duty = 0; duty < 4096; ++duty) {
+            uint32_t sum { 0 };
+            uint8_t upper { 0 };
+            uint8_t consecutive { 0 };
+            uint8_t longest { 0 };
+
+            for (uint8_t frame = 0; frame < frames; ++frame) {
+                const auto ticks = pwm_dither_ticks(duty, frame, bits);
+                TEST_ASSERT(((duty >> bits) == ticks) || (((duty >> bits) + 1) == ticks));
+                sum += ticks;
+
+                if (ticks != (duty >> bits)) {
+                    ++upper;
+                    ++consecutive;
+                    longest = std::max(longest, consecutive);
+                } else {
+                    consecutive = 0;
+                }
+            }
+
+            // average is exactly the dithered duty. and, upper values are never grouped together
+            // while there are enough of lower ones to put in between
+            TEST_ASSERT_EQUAL(duty, sum);
+            TEST_ASSERT_EQUAL(duty & (frames - 1), upper);
+            if (upper <= (frames / 2)) {
+                TEST_ASSERT_LESS_OR_EQUAL(1, longest);
+            }
+        }
+    }
+}
+
+// Low duty values, which would otherwise step from 0 to 1 tick, are spread across the frames
+void test_dither_frames() {
+    constexpr uint32_t Period { 250 };
+    constexpr uint8_t Bits { 4 };
+    constexpr uint8_t Frames { 1 << Bits };
+
+    std::mt19937 rng(4321);
+    for (size_t index = 0; index < 10000; ++index) {
+        constexpr size_t Channels { 5 };
+
+        Ticks dithered{};
+        for (size_t channel = 0; channel < Channels; ++channel) {
+            dithered[channel] = rng() % ((Period << Bits) + 1);
+        }
+
+        Ticks on{};
+        for (uint8_t frame = 0; frame < Frames; ++frame) {
+            Ticks ticks{};
+            for (size_t channel = 0; channel < Channels; ++channel) {
+                ticks[channel] = pwm_dither_ticks(dithered[channel], frame, Bits);
+            }
+
+            Phases phases;
+            const auto last = pwm_phases_prep(phases.data(), ticks.data(), Masks.data(), Channels, Period);
+            if (last == 1) {
+                for (size_t channel = 0; channel < Channels; ++channel) {
+                    on[channel] += (phases[0].on_mask & Masks[channel]) ? Period : 0;
+                }
+                continue;
+            }
+
+            const auto result = simulate(phases, last, Channels);
+            for (size_t channel = 0; channel < Channels; ++channel) {
+                on[channel] += result.on[channel];
+            }
+        }
+
+        for (size_t channel = 0; channel < Channels; ++channel) {
+            TEST_ASSERT_EQUAL(dithered[channel], on[channel]);
+        }
+    }
+}
+
+void test_benchmark() {
+    constexpr uint32_t Period { 10000 };
+    constexpr size_t Channels { 5 };
+    constexpr size_t Count { 100000 };
+    constexpr uint8_t Bits { 4 };
+
+    std::mt19937 rng(5678);
+
+    std::array<Ticks, 64> inputs;
+    for (auto& input : inputs) {
+        for (size_t channel = 0; channel < Channels; ++channel) {
+            input[channel] = rng() % (Period << Bits);
+        }
+    }
+
+    volatile uint32_t sink { 0 };
+
+    const auto single = measure([&]() {
+        for (size_t index = 0; index < Count; ++index) {
+            const auto& input = inputs[index % inputs.size()];
+
+            Ticks ticks{};
+            for (size_t channel = 0; channel < Channels; ++channel) {
+                ticks[channel] = input[channel] >> Bits;
+            }
+
+            Phases phases;
+            sink = sink + pwm_phases_prep(phases.data(), ticks.data(), Masks.data(), Channels, Period);
+        }
+    }, Count);
+
+    const auto dithered = measure([&]() {
+        for (size_t index = 0; index < Count; ++index) {
+            const auto& input = inputs[index % inputs.size()];
+
+            std::array<Phases, 1 << Bits> frames;
+            for (uint8_t frame = 0; frame < frames.size(); ++frame) {
+                Ticks ticks{};
+                for (size_t channel = 0; channel < Channels; ++channel) {
+                    ticks[channel] = pwm_dither_ticks(input[channel], frame, Bits);
+                }
+
+                sink = sink + pwm_phases_prep(frames[frame].data(), ticks.data(), Masks.data(), Channels, Period);
+            }
+        }
+    }, Count);
+
+    char message[128];
+    std::snprintf(message, sizeof(message),
+        "pwm_start() phases for %zu channels %.1fns, dithered over %d periods %.1fns",
+        Channels, single, 1 << Bits, dithered);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(single * (1 << Bits) * 2, dithered);
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    RUN_TEST(test_static);
+    RUN_TEST(test_duty);
+    RUN_TEST(test_dither_ticks);
+    RUN_TEST(test_dither_frames);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -2,6 +2,11 @@
 #include <Arduino.h>
 
 #include <espurna/settings_convert.h>
+#include <espurna/settings_json.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace espurna {
 namespace settings {
@@ -179,6 +184,227 @@ void test_parse_duration_spec() {
             parse("5m", std::milli{}).value.seconds);
 }
 
+using Pairs = std::vector<std::pair<String, String>>;
+
+String repeat(char c, size_t size) {
+    String out;
+    out.reserve(size);
+    for (size_t index = 0; index < size; ++index) {
+        out += c;
+    }
+
+    return out;
+}
+
+struct JsonResult {
+    bool ok { false };
+    Pairs pairs;
+};
+
+JsonResult parse_json(const char* input, size_t chunk) {
+    JsonResult out;
+
+    json::Parser parser;
+
+    const auto* ptr = input;
+    const auto* end = input + strlen(input);
+    while (ptr != end) {
+        const auto size = std::min(chunk, static_cast<size_t>(end - ptr));
+        if (!parser.feed(ptr, size,
+            [&](const String& key, const String& value) {
+                out.pairs.emplace_back(key, value);
+                return true;
+            }))
+        {
+            return out;
+        }
+        ptr += size;
+    }
+
+    out.ok = parser.finish();
+    return out;
+}
+
+void test_json_parse() {
+    const char input[] = R"(  {"app": "ESPURNA", "version" :"1.2.3",
+        "backup":"1","empty":"",
+        "escaped":"\"\\\/\b\f\n\r\t", "unicode":"\u0041\u00e9\u20ac\ud83d\ude00",
+        "number": -12.5e3, "flag":true}
+    )";
+
+    const Pairs expected {
+        {"app", "ESPURNA"},
+        {"version", "1.2.3"},
+        {"backup", "1"},
+        {"empty", ""},
+        {"escaped", "\"\\/\b\f\n\r\t"},
+        {"unicode", "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"},
+        {"number", "-12.5e3"},
+        {"flag", "true"},
+    };
+
+    // result does not depend on how the input is split
+    for (size_t chunk = 1; chunk < sizeof(input); ++chunk) {
+        const auto result = parse_json(input, chunk);
+        TEST_ASSERT(result.ok);
+        TEST_ASSERT_EQUAL(expected.size(), result.pairs.size());
+        for (size_t index = 0; index < expected.size(); ++index) {
+            TEST_ASSERT_EQUAL_STRING(
+                expected[index].first.c_str(), result.pairs[index].first.c_str());
+            TEST_ASSERT_EQUAL_STRING(
+                expected[index].second.c_str(), result.pairs[index].second.c_str());
+        }
+    }
+
+    TEST_ASSERT(parse_json("{}", 1).ok);
+    TEST_ASSERT(parse_json(" { \n } \n", 1).ok);
+}
+
+void test_json_parse_errors() {
+    const char* inputs[] {
+        "",
+        "{",
+        "{\"key\"",
+        "{\"key\":",
+        "{\"key\":\"value\"",
+        "{\"key\":\"value\",}",
+        "{\"key\":\"value\"}}",
+        "{\"\":\"value\"}",
+        "{\"key\" \"value\"}",
+        "{\"key\":[\"value\"]}",
+        "{\"key\":{\"inner\":\"value\"}}",
+        "{\"key\":\"va\nlue\"}",
+        "{\"key\":\"\\x\"}",
+        "{\"key\":\"\\u12g4\"}",
+        "{\"key\":\"\\ude00\"}",
+        "{\"key\":\"\\ud83d\"}",
+        "[\"key\",\"value\"]",
+    };
+
+    for (const auto* input : inputs) {
+        TEST_ASSERT_FALSE_MESSAGE(parse_json(input, 1).ok, input);
+        TEST_ASSERT_FALSE_MESSAGE(parse_json(input, 64).ok, input);
+    }
+
+    json::Parser parser;
+    TEST_ASSERT(parser.feed("{\"key\":\"val", 11, [](const String&, const String&) {
+        return true;
+    }));
+    TEST_ASSERT(!parser.finish());
+    TEST_ASSERT(json::Parser::Error::Incomplete == parser.error());
+
+    parser.reset();
+    TEST_ASSERT(!parser.feed("{\"a\":\"b\",\"c\":\"d\"}", 17,
+        [](const String& key, const String&) {
+            return key != "c";
+        }));
+    TEST_ASSERT(json::Parser::Error::Aborted == parser.error());
+    TEST_ASSERT_EQUAL(2, parser.pairs());
+
+    String long_key = String("{\"") + repeat('k', json::Parser::KeyLimit + 1) + String("\":\"value\"}");
+
+    parser.reset();
+    TEST_ASSERT(!parser.feed(long_key.c_str(), long_key.length(),
+        [](const String&, const String&) {
+            return true;
+        }));
+    TEST_ASSERT(json::Parser::Error::KeyTooLong == parser.error());
+
+    String long_value = String("{\"key\":\"") + repeat('v', json::Parser::ValueLimit + 1) + String("\"}");
+
+    parser.reset();
+    TEST_ASSERT(!parser.feed(long_value.c_str(), long_value.length(),
+        [](const String&, const String&) {
+            return true;
+        }));
+    TEST_ASSERT(json::Parser::Error::ValueTooLong == parser.error());
+}
+
+// restored data size is not limited by the parser, only the current pair is kept around
+void test_json_parse_bounded() {
+    constexpr size_t Size { 16 * 1024 };
+
+    String input;
+    input.reserve(Size + 256);
+    input += "{\"app\":\"ESPURNA\"";
+
+    Pairs expected;
+
+    uint32_t seed { 0x12345678 };
+    auto random = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    while (input.length() < Size) {
+        String key("key");
+        key += String(expected.size());
+
+        String value;
+        String escaped;
+
+        const auto length = random() % 96;
+        for (size_t index = 0; index < length; ++index) {
+            const auto c = static_cast<char>(0x20 + (random() % 0x5f));
+            value += c;
+            if ((c == '"') || (c == '\\')) {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+
+        input += ",\n\"";
+        input += key;
+        input += "\": \"";
+        input += escaped;
+        input += "\"";
+
+        expected.emplace_back(key, value);
+    }
+
+    input += "\n}\n";
+    TEST_ASSERT(input.length() >= Size);
+
+    json::Parser parser;
+
+    size_t index { 0 };
+    size_t peak { 0 };
+
+    auto callback = [&](const String& key, const String& value) {
+        if (key == "app") {
+            return true;
+        }
+
+        TEST_ASSERT(index < expected.size());
+        TEST_ASSERT_EQUAL_STRING(expected[index].first.c_str(), key.c_str());
+        TEST_ASSERT_EQUAL_STRING(expected[index].second.c_str(), value.c_str());
+        ++index;
+
+        return true;
+    };
+
+    const auto* ptr = input.c_str();
+    const auto* end = ptr + input.length();
+    while (ptr != end) {
+        const auto size = std::min(
+            static_cast<size_t>(1 + (random() % 128)),
+            static_cast<size_t>(end - ptr));
+        TEST_ASSERT(parser.feed(ptr, size, callback));
+        peak = std::max(peak, parser.buffered());
+        ptr += size;
+    }
+
+    TEST_ASSERT(parser.finish());
+    TEST_ASSERT(parser.done());
+    TEST_ASSERT_EQUAL(expected.size(), index);
+    TEST_ASSERT_EQUAL(expected.size() + 1, parser.pairs());
+
+    // longest key + value, nothing else is retained between chunks
+    TEST_ASSERT(peak < 128);
+}
+
 } // namespace
 } // namespace test
 } // namespace settings
@@ -197,5 +423,9 @@ int main(int, char**) {
     RUN_TEST(test_parse_duration);
     RUN_TEST(test_parse_duration_spec);
 
+    RUN_TEST(test_json_parse);
+    RUN_TEST(test_json_parse_errors);
+    RUN_TEST(test_json_parse_bounded);
+
     return UNITY_END();
 }
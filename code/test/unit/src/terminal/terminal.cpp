@@ -2,6 +2,8 @@
 #include <Arduino.h>
 #include <StreamString.h>
 
+#include <memory>
+
 #include <espurna/libs/PrintString.h>
 #include <espurna/terminal_commands.h>
 
@@ -443,6 +445,50 @@ void test_error_output() {
     TEST_ASSERT(err.length() > 0);
 }
 
+// long output can be generated in parts, either right away or whenever deferred output wants it
+void test_generator() {
+    add("test.generator", [](CommandContext&& ctx) {
+        auto counter = std::make_shared<int>(0);
+        generate(ctx, [counter](Print& out) {
+            if (*counter < 3) {
+                out.print(*counter);
+                ++(*counter);
+                return true;
+            }
+
+            ok(out);
+            return false;
+        });
+    });
+
+    PrintString out(64);
+    TEST_ASSERT(find_and_call("test.generator\n", out));
+    TEST_ASSERT_EQUAL_STRING("012+OK\n", out.c_str());
+
+    struct Deferred : public DeferredOutput {
+        void defer(Generator generator) override {
+            this->generator = std::move(generator);
+        }
+
+        Generator generator;
+    };
+
+    Deferred deferred;
+    out.clear();
+
+    TEST_ASSERT(find_and_call("test.generator\n", out, &deferred));
+    TEST_ASSERT_EQUAL(0, out.length());
+    TEST_ASSERT(static_cast<bool>(deferred.generator));
+
+    TEST_ASSERT(deferred.generator(out));
+    TEST_ASSERT_EQUAL_STRING("0", out.c_str());
+
+    TEST_ASSERT(deferred.generator(out));
+    TEST_ASSERT(deferred.generator(out));
+    TEST_ASSERT(!deferred.generator(out));
+    TEST_ASSERT_EQUAL_STRING("012+OK\n", out.c_str());
+}
+
 } // namespace
 } // namespace test
 } // namespace terminal
@@ -469,6 +515,7 @@ int main(int, char**) {
     RUN_TEST(test_line_buffer_overflow);
     RUN_TEST(test_line_buffer_multiple);
     RUN_TEST(test_error_output);
+    RUN_TEST(test_generator);
 
     return UNITY_END();
 }
@@ -6,8 +6,11 @@
 // Tests
 // -----------------------------------------------------------------------------
 
+#include <chrono>
+#include <cstdio>
 #include <type_traits>
 #include <queue>
+#include <vector>
 
 #include <espurna/libs/TypeChecks.h>
 #include <espurna/tuya_types.h>
@@ -298,6 +301,252 @@ void test_dataframe_echo() {
     }
 }
 
+// Keeps everything that was written, counting write() calls
+class VectorStream : public Stream {
+    public:
+        size_t write(uint8_t c) {
+            ++_writes;
+            _buffer.push_back(c);
+            return 1;
+        }
+        size_t write(const unsigned char* data, unsigned long size) {
+            ++_writes;
+            _buffer.insert(_buffer.end(), data, data + size);
+            return size;
+        }
+        int availableForWrite() { return 1; }
+        void flush() {}
+        int available() {
+            return _buffer.size() - _offset;
+        }
+        int read() {
+            if (_offset >= _buffer.size()) return -1;
+            return _buffer[_offset++];
+        }
+        int peek() {
+            if (_offset >= _buffer.size()) return -1;
+            return _buffer[_offset];
+        }
+
+        const container& buffer() const {
+            return _buffer;
+        }
+
+        size_t writes() const {
+            return _writes;
+        }
+
+        void clear() {
+            _buffer.clear();
+            _offset = 0;
+            _writes = 0;
+        }
+    private:
+        container _buffer;
+        size_t _offset { 0 };
+        size_t _writes { 0 };
+};
+
+// xorshift32, so every run is the same
+struct Random {
+    uint32_t next() {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+
+    uint8_t byte() {
+        return next() & 0xff;
+    }
+
+    uint32_t _state { 0x12345678 };
+};
+
+DataFrame random_frame(Random& random, size_t max_length) {
+    container data;
+    data.resize(random.next() % (max_length + 1));
+    for (auto& value : data) {
+        value = random.byte();
+    }
+
+    return DataFrame(static_cast<Command>(random.next() % 0x10), random.byte(), std::move(data));
+}
+
+template <typename T>
+bool frame_equals(const T& frame, const DataFrameView& view) {
+    return (frame.version() == view.version())
+        && (frame.command() == view.command())
+        && (frame.length() == view.length())
+        && std::equal(frame.cbegin(), frame.cend(), view.cbegin());
+}
+
+void test_transport_single_write() {
+    VectorStream stream;
+    Transport transport(stream);
+
+    const DataFrame frame(Command::SetDP, DataProtocol<uint32_t>(0x02, 0x66).serialize());
+    transport.writeFrame(frame);
+    TEST_ASSERT_EQUAL(1, stream.writes());
+
+    const auto expected = stream.buffer();
+    stream.clear();
+
+    transport.write(frame.serialize());
+    TEST_ASSERT_EQUAL(1, stream.writes());
+    TEST_ASSERT_EQUAL(expected.size(), stream.buffer().size());
+    TEST_ASSERT(std::equal(expected.begin(), expected.end(), stream.buffer().begin()));
+
+    const container header {0x55, 0xaa, 0x00, 0x06, 0x00, 0x08};
+    TEST_ASSERT(std::equal(header.begin(), header.end(), expected.begin()));
+}
+
+void test_transport_oversized() {
+    BufferedStream stream;
+    Transport transport(stream);
+
+    // frame can never fit into the input buffer, parser should drop it and continue
+    const container oversized {0x55, 0xaa, 0x00, 0x00, 0x01, 0x00};
+    for (auto value : oversized) {
+        transport.parse(value);
+    }
+    TEST_ASSERT_EQUAL(0, transport.size());
+
+    // header is allowed to start right after a stray 0x55
+    const container input {0x55, 0x55, 0xaa, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01};
+    bool done { false };
+    for (auto value : input) {
+        done = transport.parse(value);
+    }
+
+    TEST_ASSERT(done);
+    TEST_ASSERT_EQUAL(7, transport.size());
+}
+
+void test_transport_fuzz_frames() {
+    Random random;
+    VectorStream stream;
+    Transport transport(stream);
+
+    constexpr size_t Frames { 1000 };
+
+    std::vector<DataFrame> frames;
+    frames.reserve(Frames);
+
+    // garbage between frames must not contain the header byte, otherwise it might swallow the next frame
+    for (size_t index = 0; index < Frames; ++index) {
+        frames.push_back(random_frame(random, 128));
+        transport.writeFrame(frames.back());
+
+        const size_t garbage = random.next() % 8;
+        for (size_t n = 0; n < garbage; ++n) {
+            uint8_t value = random.byte();
+            if (value == 0x55) {
+                value = 0;
+            }
+            stream.write(&value, 1);
+        }
+    }
+
+    size_t found { 0 };
+    for (auto value : stream.buffer()) {
+        if (transport.parse(value)) {
+            TEST_ASSERT(found < frames.size());
+            TEST_ASSERT(frame_equals(frames[found], DataFrameView(transport)));
+            ++found;
+            transport.reset();
+        }
+    }
+
+    TEST_ASSERT_EQUAL(Frames, found);
+}
+
+void test_transport_fuzz_noise() {
+    Random random;
+    BufferedStream stream;
+    Transport transport(stream);
+
+    // anything accepted from the random input must still be a valid frame
+    size_t found { 0 };
+    for (size_t index = 0; index < (1024 * 1024); ++index) {
+        // bias towards the header bytes and short lengths, so something is actually parsed
+        uint8_t value = random.byte();
+        switch (random.next() % 8) {
+        case 0:
+            value = 0x55;
+            break;
+        case 1:
+            value = 0xaa;
+            break;
+        case 2:
+            value = 0x00;
+            break;
+        }
+
+        if (transport.parse(value)) {
+            TEST_ASSERT(transport.size() >= 6);
+            TEST_ASSERT(transport.size() < Input::LIMIT);
+
+            const DataFrameView frame(transport);
+            TEST_ASSERT_EQUAL(transport.size(), frame.length() + 6);
+
+            VectorStream out;
+            Transport(out).writeFrame(frame);
+            TEST_ASSERT_EQUAL(transport.size() + 1, out.buffer().size());
+            TEST_ASSERT(std::equal(transport.cbegin(), transport.cend(), out.buffer().begin()));
+
+            ++found;
+            transport.reset();
+        }
+
+        TEST_ASSERT(transport.size() <= Input::LIMIT);
+    }
+
+    printf("noise: %zu frame(s) accepted\n", found);
+}
+
+void test_transport_throughput() {
+    using Clock = std::chrono::steady_clock;
+
+    Random random;
+    VectorStream stream;
+    Transport transport(stream);
+
+    std::vector<DataFrame> frames;
+    for (size_t index = 0; index < 64; ++index) {
+        frames.push_back(random_frame(random, 64));
+    }
+
+    constexpr size_t Iterations { 2000 };
+
+    size_t bytes { 0 };
+    size_t found { 0 };
+
+    const auto start = Clock::now();
+    for (size_t iteration = 0; iteration < Iterations; ++iteration) {
+        stream.clear();
+        for (const auto& frame : frames) {
+            transport.writeFrame(frame);
+        }
+
+        bytes += stream.buffer().size();
+        for (auto value : stream.buffer()) {
+            if (transport.parse(value)) {
+                ++found;
+                transport.reset();
+            }
+        }
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start);
+    TEST_ASSERT_EQUAL(Iterations * frames.size(), found);
+
+    printf("transport: %zu frames in %.3fs (%.0f frames/s, %.2f MiB/s)\n",
+        found, elapsed.count(),
+        found / elapsed.count(),
+        bytes / elapsed.count() / (1024.0 * 1024.0));
+}
+
 int main(int, char**) {
 
     UNITY_BEGIN();
@@ -312,6 +561,11 @@ int main(int, char**) {
     RUN_TEST(test_dataframe_report);
     RUN_TEST(test_dataframe_echo);
     RUN_TEST(test_transport);
+    RUN_TEST(test_transport_single_write);
+    RUN_TEST(test_transport_oversized);
+    RUN_TEST(test_transport_fuzz_frames);
+    RUN_TEST(test_transport_fuzz_noise);
+    RUN_TEST(test_transport_throughput);
 
     return UNITY_END();
 
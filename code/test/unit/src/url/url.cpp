@@ -1,8 +1,11 @@
 #include <Arduino.h>
 #include <unity.h>
 
+#include <espurna/api_route.h>
 #include <espurna/libs/URL.h>
 
+using namespace espurna;
+
 void test_parse() {
     URL url("http://api.thingspeak.com/update");
     TEST_ASSERT_EQUAL_STRING("api.thingspeak.com", url.host.c_str());
@@ -10,8 +13,142 @@ void test_parse() {
     TEST_ASSERT_EQUAL(80, url.port);
 }
 
+void test_route_literal() {
+    api::Routes<int> routes;
+    TEST_ASSERT(routes.add("/api/relay", 1));
+    TEST_ASSERT(routes.add("/api/light", 2));
+    TEST_ASSERT(routes.add("/api/light/brightness", 3));
+    TEST_ASSERT_EQUAL(3, routes.size());
+
+    api::Captures captures;
+
+    const auto* value = routes.find("/api/relay", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(1, *value);
+    TEST_ASSERT_EQUAL(0, captures.size());
+
+    value = routes.find("/api/light/brightness", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(3, *value);
+
+    TEST_ASSERT_NULL(routes.find("/api", captures));
+    TEST_ASSERT_NULL(routes.find("/api/", captures));
+    TEST_ASSERT_NULL(routes.find("/api/relays", captures));
+    TEST_ASSERT_NULL(routes.find("/api/relay/0", captures));
+    TEST_ASSERT_NULL(routes.find("", captures));
+}
+
+void test_route_wildcard() {
+    api::Routes<int> routes;
+    TEST_ASSERT(routes.add("/api/relay/+", 1));
+    TEST_ASSERT(routes.add("/api/relay/+/pulse/+", 2));
+    TEST_ASSERT(routes.add("/api/relay/all", 3));
+    TEST_ASSERT(routes.add("/api/debug/#", 4));
+
+    api::Captures captures;
+
+    const char path[] = "/api/relay/5";
+    const auto* value = routes.find(path, captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(1, *value);
+    TEST_ASSERT_EQUAL(1, captures.size());
+    TEST_ASSERT(captures[0] == "5");
+    TEST_ASSERT(captures[0].begin() == (path + 11));
+
+    value = routes.find("/api/relay/all", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(3, *value);
+    TEST_ASSERT_EQUAL(0, captures.size());
+
+    value = routes.find("/api/relay/0/pulse/2.5", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(2, *value);
+    TEST_ASSERT_EQUAL(2, captures.size());
+    TEST_ASSERT(captures[0] == "0");
+    TEST_ASSERT(captures[1] == "2.5");
+    TEST_ASSERT_EQUAL(0, captures[2].length());
+
+    value = routes.find("/api/debug/one/two", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(4, *value);
+    TEST_ASSERT_EQUAL(1, captures.size());
+    TEST_ASSERT(captures[0] == "one/two");
+
+    value = routes.find("/api/debug", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(4, *value);
+    TEST_ASSERT_EQUAL(1, captures.size());
+    TEST_ASSERT_EQUAL(0, captures[0].length());
+
+    TEST_ASSERT_NULL(routes.find("/api/relay/0/pulse", captures));
+    TEST_ASSERT_NULL(routes.find("/api/relay/0/1", captures));
+    TEST_ASSERT_EQUAL(0, captures.size());
+}
+
+void test_route_backtrack() {
+    api::Routes<int> routes;
+    TEST_ASSERT(routes.add("a/b/c", 1));
+    TEST_ASSERT(routes.add("a/+/d", 2));
+    TEST_ASSERT(routes.add("a/#", 3));
+
+    api::Captures captures;
+
+    const auto* value = routes.find("a/b/c", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(1, *value);
+    TEST_ASSERT_EQUAL(0, captures.size());
+
+    value = routes.find("a/b/d", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(2, *value);
+    TEST_ASSERT_EQUAL(1, captures.size());
+    TEST_ASSERT(captures[0] == "b");
+
+    value = routes.find("a/b/e", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(3, *value);
+    TEST_ASSERT_EQUAL(1, captures.size());
+    TEST_ASSERT(captures[0] == "b/e");
+}
+
+void test_route_invalid() {
+    api::Routes<int> routes;
+    TEST_ASSERT_FALSE(routes.add("", 1));
+    TEST_ASSERT_FALSE(routes.add("a/+b", 1));
+    TEST_ASSERT_FALSE(routes.add("a/b#", 1));
+    TEST_ASSERT_FALSE(routes.add("a/#/b", 1));
+    TEST_ASSERT_EQUAL(0, routes.size());
+
+    // rejected pattern does not leave anything behind, tree must not reference it
+    {
+        String pattern("c/d/#/e");
+        TEST_ASSERT_FALSE(routes.add(pattern, 1));
+    }
+
+    {
+        String pattern("c/d/x+");
+        TEST_ASSERT_FALSE(routes.add(pattern, 1));
+    }
+
+    api::Captures captures;
+    TEST_ASSERT_NULL(routes.find("c/d", captures));
+    TEST_ASSERT_NULL(routes.find("c/d/e", captures));
+
+    TEST_ASSERT(routes.add("a/+", 1));
+    TEST_ASSERT_FALSE(routes.add("a/+", 2));
+    TEST_ASSERT_EQUAL(1, routes.size());
+
+    const auto* value = routes.find("a/+", captures);
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_EQUAL(1, *value);
+}
+
 int main(int, char**) {
     UNITY_BEGIN();
     RUN_TEST(test_parse);
+    RUN_TEST(test_route_literal);
+    RUN_TEST(test_route_wildcard);
+    RUN_TEST(test_route_backtrack);
+    RUN_TEST(test_route_invalid);
     return UNITY_END();
 }